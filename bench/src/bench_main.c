@@ -0,0 +1,1018 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Host-native end-to-end throughput benchmark for the JMSG_MQTT gateway
+**
+** Notes:
+**   1. The unmodified MQTT_MGR, MQMSG_TRANS and MQTT_CLIENT objects run
+**      against the stubs in bench/stubs and a loopback broker. The main
+**      thread plays the app's main task and drains the SB topic pipe, a
+**      second thread plays the network owner child task.
+**   2. Outbound (SB to MQTT) messages are generated by the SB receive stub
+**      and timed when the broker receives them. Inbound (MQTT to SB)
+**      messages are published by the broker and timed when the gateway
+**      sends them on the SB. Each message carries its send time in the
+**      JSON payload.
+**   3. With a zero rate each direction runs closed loop, new outbound
+**      messages are only generated while the publish queue has room and
+**      inbound publishing is paced by the TCP connection. Latencies are
+**      then latencies at saturation. Use a rate to measure latency at a
+**      given load.
+**   4. With more than one connection the outbound topic is published on
+**      shard connection 1, each shard's child task is played by its own
+**      thread.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <getopt.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "loopback_broker.h"
+#include "mqtt_mgr.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define BENCH_OUT_PLUGIN  0
+#define BENCH_IN_PLUGIN   1
+
+#define BENCH_OUT_MID          0x0F70
+#define BENCH_IN_MID           0x0F71
+#define BENCH_LATENCY_TLM_MID  0x0F72
+
+#define BENCH_OUT_TOPIC  "bench/out"
+#define BENCH_IN_TOPIC   "bench/in"
+
+/* Extra inbound topics for -t are bench/in/N with message ID BENCH_XTRA_MID+N */
+#define BENCH_XTRA_TOPIC_FMT  "bench/in/%u"
+#define BENCH_XTRA_MID        0x0F80
+#define BENCH_TOPIC_MAX       (JMSG_PLATFORM_TOPIC_PLUGIN_MAX - BENCH_IN_PLUGIN)
+
+/* TOPIC_CFG for -b, both bench topics are raw */
+#define BENCH_RAW_TOPIC_CFG  "0x0F70:raw,0x0F71:raw"
+
+/* TOPIC_CFG for -k, without and with -b */
+#define BENCH_SHARD_TOPIC_CFG      "0x0F70:shard1"
+#define BENCH_RAW_SHARD_TOPIC_CFG  "0x0F70:raw+shard1,0x0F71:raw"
+
+#define BENCH_DEF_MSG_CNT        100000
+#define BENCH_DEF_PAYLOAD_LEN    256
+#define BENCH_PAYLOAD_MAX_LEN    4096
+
+/* A direction is abandoned when no message arrives for this long */
+#define BENCH_STALL_NS  (5ULL*1000000000ULL)
+
+#define BENCH_NS_PER_US  1000ULL
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   CFE_MSG_TelemetryHeader_t  TelemetryHeader;
+   uint32  Seq;
+   uint32  JsonLen;
+   uint64  SendNs;
+
+} BENCH_SbMsg_t;
+
+typedef union
+{
+
+   CFE_SB_Buffer_t  SbBuf;
+   BENCH_SbMsg_t    Msg;
+   uint8            Byte[BENCH_PAYLOAD_MAX_LEN];
+
+} BENCH_SbBuf_t;
+
+/*
+** Results for one direction. Everything except RcvCnt is only written by
+** the thread that receives the direction's messages. RcvCnt is read by the
+** main thread to detect completion.
+*/
+
+typedef struct
+{
+
+   const char  *Name;
+   uint32   MsgCnt;
+   uint32   RcvCnt;
+   uint64   Bytes;
+   uint64   StartNs;
+   uint64   EndNs;
+   uint32  *LatencyUs;
+
+} BENCH_Direction_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void   BrokerPublishCallback(const char *Topic, const uint8 *Payload, uint32 PayloadLen);
+static uint32 BuildPayload(char *Buf, uint32 Seq, uint64 SendNs);
+static uint32 BuildSbMsg(BENCH_SbBuf_t *Buf, uint16 MsgId, uint32 Seq, uint64 SendNs);
+static int    CompareUint32(const void *A, const void *B);
+static bool   InJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen);
+static void   MeasureReconnect(void);
+static void  *NetworkOwnerTask(void *Arg);
+static bool   OutboundQueueFull(void);
+static bool   OutCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg);
+static uint64 ParseSendNs(const uint8 *Payload, uint32 PayloadLen);
+static uint64 ParseSbMsgSendNs(const uint8 *Payload, uint32 PayloadLen);
+static void   PrintGatewayLatency(void);
+static void   PrintResult(BENCH_Direction_t *Dir);
+static void   RecordMsg(BENCH_Direction_t *Dir, uint64 SendNs, uint32 Bytes);
+static void   RunInbound(void);
+static void   RunOutbound(void);
+static int32  SbReceiveHook(CFE_SB_Buffer_t **BufPtr, int32 TimeOut);
+static void   SbTransmitHook(const CFE_MSG_Message_t *MsgPtr);
+static void  *ShardTask(void *Arg);
+static void   SubscribeToPlugin(uint16 PluginId);
+static void   Usage(const char *Prog);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static uint32 MsgCnt     = BENCH_DEF_MSG_CNT;
+static uint32 PayloadLen = BENCH_DEF_PAYLOAD_LEN;
+static uint32 Rate       = 0;
+static uint32 CoalesceBytes = 0;
+static uint32 CoalesceUsec  = 1000;
+static uint32 PubQos        = 0;
+static uint32 MqttVersion   = MQTT_CLIENT_VERSION_31;
+static bool   Persistent    = false;
+static bool   Binary        = false;
+static uint32 ShardCnt      = 1;
+static uint32 TopicCnt      = 1;
+
+static INITBL_Class_t   IniTbl;
+static MQTT_MGR_Class_t MqttMgr;
+
+static volatile bool NetworkOwnerRun = true;
+
+static BENCH_Direction_t Outbound = { "sb->mqtt" };
+static BENCH_Direction_t Inbound  = { "mqtt->sb" };
+
+/* Outbound generator state, only used by the main thread */
+static uint32 GenCnt    = 0;
+static uint64 NextDueNs = 0;
+static BENCH_SbBuf_t OutSbBuf;
+static char OutJson[BENCH_PAYLOAD_MAX_LEN + 1];
+
+/* Inbound translation, only used by the network owner */
+static BENCH_SbMsg_t InSbMsg;
+
+static JMSG_MQTT_LatencyTlm_Payload_t GatewayLatency;
+static bool GatewayLatencyValid = false;
+
+
+/******************************************************************************
+** Function: main
+**
+*/
+int main(int argc, char *argv[])
+{
+
+   int       Opt;
+   bool      RunOut = true;
+   bool      RunIn  = true;
+   bool      Verbose = false;
+   uint16    BrokerPort;
+   int       i;
+   pthread_t OwnerThread;
+   pthread_t ShardThread[MQTT_SHARD_MAX-1];
+   const char *TopicCfg = "UNDEF";
+   const MQTT_SHARD_Conn_t *Shard;
+   char      XtraTopic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+
+   while ((Opt = getopt(argc, argv, "n:s:r:d:c:u:q:k:t:5pbvh")) != -1)
+   {
+      switch (Opt)
+      {
+         case 'n': MsgCnt     = strtoul(optarg, NULL, 0); break;
+         case 's': PayloadLen = strtoul(optarg, NULL, 0); break;
+         case 'r': Rate       = strtoul(optarg, NULL, 0); break;
+         case 'c': CoalesceBytes = strtoul(optarg, NULL, 0); break;
+         case 'u': CoalesceUsec  = strtoul(optarg, NULL, 0); break;
+         case 'q': PubQos        = strtoul(optarg, NULL, 0); break;
+         case 'k': ShardCnt      = strtoul(optarg, NULL, 0); break;
+         case 't': TopicCnt      = strtoul(optarg, NULL, 0); break;
+         case '5': MqttVersion = MQTT_CLIENT_VERSION_5; break;
+         case 'p': Persistent = true; break;
+         case 'b': Binary = true; break;
+         case 'd':
+            RunOut = (strcmp(optarg, "in") != 0);
+            RunIn  = (strcmp(optarg, "out") != 0);
+            break;
+         case 'v': Verbose = true; break;
+         default:
+            Usage(argv[0]);
+            return (Opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   if (MsgCnt == 0 || PayloadLen > BENCH_PAYLOAD_MAX_LEN || ShardCnt < 1 || ShardCnt > MQTT_SHARD_MAX ||
+       TopicCnt < 1 || TopicCnt > BENCH_TOPIC_MAX)
+   {
+      Usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (Binary && PayloadLen < sizeof(BENCH_SbMsg_t))
+   {
+      PayloadLen = sizeof(BENCH_SbMsg_t);
+   }
+
+   BENCH_STUB_SetVerbose(Verbose);
+   BENCH_STUB_SetSbHooks(SbReceiveHook, SbTransmitHook);
+
+   if (ShardCnt > 1)
+   {
+      TopicCfg = Binary ? BENCH_RAW_SHARD_TOPIC_CFG : BENCH_SHARD_TOPIC_CFG;
+   }
+   else if (Binary)
+   {
+      TopicCfg = BENCH_RAW_TOPIC_CFG;
+   }
+
+   if (!LOOPBACK_BROKER_Start(&BrokerPort, BrokerPublishCallback))
+   {
+      return EXIT_FAILURE;
+   }
+
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_JMSG_MQTT_LATENCY_TLM_TOPICID, BENCH_LATENCY_TLM_MID);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_TOPIC_PIPE_NAME,         "BENCH_TOPIC_PIPE");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_TOPIC_PIPE_DEPTH,        64);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_TOPIC_PIPE_PEND_TIME,    CFE_SB_POLL);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_MQTT_BROKER_ADDRESS,     "127.0.0.1");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_BROKER_PORT,        BrokerPort);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_MQTT_BROKER_ADDR_LIST,   "UNDEF");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_DNS_CACHE_SEC,      300);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_MQTT_BROKER_LIST,        "UNDEF");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_FAILOVER_RTT_MS,    0);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_ENABLE_RECONNECT,   0);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_RECONNECT_MIN_MS,   100);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_RECONNECT_MAX_MS,   2000);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_MQTT_CLIENT_NAME,        "jmsg_mqtt_bench");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_CLIENT_YIELD_TIME,  100);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_COALESCE_BYTES,     CoalesceBytes);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_COALESCE_USEC,      CoalesceUsec);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_PUB_QOS,            PubQos);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_SUB_QOS,            MQTT_CLIENT_QOS2);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_QOS_WINDOW,         16);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_QOS_RETRY_MS,       5000);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_VERSION,            MqttVersion);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_PERSISTENT_SESSION, Persistent ? 1 : 0);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT5_MSG_EXPIRY_SEC,    60);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT5_SESSION_EXPIRY_SEC, 60);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_MQTT_SHARD_CNT,          ShardCnt);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_MQTT_CHILD_NAME,         "BENCH_CHILD");
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_SPOOL_BUF_LEN,           0);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_SPOOL_DROP_POLICY,       MQTT_SPOOL_DROP_OLDEST);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_SPOOL_REPLAY_RATE,       1000);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_JOURNAL_FILE_LEN,        0);
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_TRACE_FILE,              "/tmp/jmsg_mqtt_bench_trace.dat");
+   BENCH_STUB_SetStrConfig(&IniTbl, CFG_TOPIC_CFG,               TopicCfg);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_ZLIB_MIN_BYTES,          512);
+   BENCH_STUB_SetIntConfig(&IniTbl, CFG_ZLIB_LEVEL,              6);
+
+   BENCH_TOPIC_TBL_AddPlugin(BENCH_OUT_PLUGIN, BENCH_OUT_TOPIC, BENCH_OUT_MID, true, OutCfeToJson, NULL);
+   BENCH_TOPIC_TBL_AddPlugin(BENCH_IN_PLUGIN,  BENCH_IN_TOPIC,  BENCH_IN_MID, false, NULL, InJsonToCfe);
+   for (i = 1; i < (int)TopicCnt; i++)
+   {
+      snprintf(XtraTopic, sizeof(XtraTopic), BENCH_XTRA_TOPIC_FMT, (unsigned)i);
+      BENCH_TOPIC_TBL_AddPlugin(BENCH_IN_PLUGIN + i, XtraTopic, BENCH_XTRA_MID + i, false, NULL, InJsonToCfe);
+   }
+
+   MQTT_MGR_Constructor(&MqttMgr, &IniTbl);
+
+   if (pthread_create(&OwnerThread, NULL, NetworkOwnerTask, NULL) != 0)
+   {
+      perror("network owner thread");
+      return EXIT_FAILURE;
+   }
+
+   /* The network owner completes the connect started by the constructor */
+   for (i = 0; i < 2000 && !MqttMgr.MqttClient.Connected; i++)
+   {
+      usleep(1000);
+   }
+   if (!MqttMgr.MqttClient.Connected)
+   {
+      fprintf(stderr, "Gateway failed to connect to the loopback broker on port %u\n", BrokerPort);
+      return EXIT_FAILURE;
+   }
+
+   /* The shards connect once the network owner has set their broker */
+   for (i = 0; i < (int)(ShardCnt - 1); i++)
+   {
+      if (pthread_create(&ShardThread[i], NULL, ShardTask, &MqttMgr.MqttShard.Conn[i]) != 0)
+      {
+         perror("shard thread");
+         return EXIT_FAILURE;
+      }
+   }
+   for (i = 0; i < 2000 && ShardCnt > 1 && !__atomic_load_n(&MqttMgr.MqttShard.Conn[0].Connected, __ATOMIC_ACQUIRE); i++)
+   {
+      usleep(1000);
+   }
+   if (ShardCnt > 1 && !__atomic_load_n(&MqttMgr.MqttShard.Conn[0].Connected, __ATOMIC_ACQUIRE))
+   {
+      fprintf(stderr, "Gateway shard 1 failed to connect to the loopback broker on port %u\n", BrokerPort);
+      return EXIT_FAILURE;
+   }
+
+   SubscribeToPlugin(BENCH_OUT_PLUGIN);
+   for (i = 0; i < (int)TopicCnt; i++)
+   {
+      SubscribeToPlugin(BENCH_IN_PLUGIN + i);
+   }
+
+   Outbound.MsgCnt    = MsgCnt;
+   Outbound.LatencyUs = calloc(MsgCnt, sizeof(uint32));
+   Inbound.MsgCnt     = MsgCnt;
+   Inbound.LatencyUs  = calloc(MsgCnt, sizeof(uint32));
+
+   printf("jmsg_mqtt bench: %u msgs, %u byte %s payload, %u connection%s, %s", MsgCnt, PayloadLen,
+          Binary ? "raw" : "JSON", ShardCnt, (ShardCnt > 1 ? "s" : ""), Rate ? "" : "closed loop\n");
+   if (Rate)
+   {
+      printf("%u msgs/s\n", Rate);
+   }
+   printf("%-10s %10s %8s %9s %12s %14s %9s %9s %9s\n", "direction", "msgs", "lost", "seconds",
+          "msgs/s", "bytes/s", "p50_us", "p99_us", "max_us");
+
+   if (RunOut)
+   {
+      RunOutbound();
+      PrintResult(&Outbound);
+   }
+   if (RunIn)
+   {
+      RunInbound();
+      PrintResult(&Inbound);
+   }
+
+   MQTT_LATENCY_SendTlmCmd(NULL, NULL);
+   PrintGatewayLatency();
+
+   MeasureReconnect();
+
+   if (CoalesceBytes > 0)
+   {
+      printf("Coalescing %u bytes/%u us: %u coalesced writes, %u writes saved\n", CoalesceBytes, CoalesceUsec,
+             MqttMgr.MqttClient.CoalesceFlushCnt, MqttMgr.MqttClient.CoalesceSavedCnt);
+   }
+
+   if (MqttVersion == MQTT_CLIENT_VERSION_5)
+   {
+      printf("MQTT 5: %u topic aliases, %u aliased publishes, %u topic bytes saved, receive maximum %u\n",
+             MqttMgr.MqttClient.Mqtt5.OutAliasCnt, MqttMgr.MqttClient.Mqtt5.AliasPubCnt,
+             MqttMgr.MqttClient.Mqtt5.AliasBytesSaved, MQTT_CLIENT_ReceiveMax());
+   }
+
+   for (i = 0; i < (int)(ShardCnt - 1); i++)
+   {
+      Shard = &MqttMgr.MqttShard.Conn[i];
+      printf("Shard %d: %u publishes, %u connects, %u overflows\n", i + 1,
+             Shard->PubCnt, Shard->ConnectCnt, Shard->OverflowCnt);
+   }
+
+   if (BENCH_STUB_EventErrCnt() > 0)
+   {
+      printf("%u gateway error events, rerun with -v to print them\n", BENCH_STUB_EventErrCnt());
+   }
+
+   NetworkOwnerRun = false;
+   pthread_join(OwnerThread, NULL);
+   for (i = 0; i < (int)(ShardCnt - 1); i++)
+   {
+      pthread_join(ShardThread[i], NULL);
+   }
+   LOOPBACK_BROKER_Stop();
+
+   return EXIT_SUCCESS;
+
+} /* End main() */
+
+
+/******************************************************************************
+** Function: BrokerPublishCallback
+**
+** Record an outbound message received by the broker.
+**
+*/
+static void BrokerPublishCallback(const char *Topic, const uint8 *Payload, uint32 PayloadLen)
+{
+
+   if (strcmp(Topic, BENCH_OUT_TOPIC) == 0)
+   {
+      RecordMsg(&Outbound, Binary ? ParseSbMsgSendNs(Payload, PayloadLen) : ParseSendNs(Payload, PayloadLen),
+                PayloadLen);
+   }
+
+} /* End BrokerPublishCallback() */
+
+
+/******************************************************************************
+** Function: BuildPayload
+**
+** Build a JSON payload of PayloadLen bytes, or the smallest payload that
+** holds the sequence and time when PayloadLen is smaller. Returns the length.
+**
+*/
+static uint32 BuildPayload(char *Buf, uint32 Seq, uint64 SendNs)
+{
+
+   uint32 Len = snprintf(Buf, BENCH_PAYLOAD_MAX_LEN, "{\"seq\":%u,\"t\":%llu,\"pad\":\"",
+                         Seq, (unsigned long long)SendNs);
+
+   if (PayloadLen > (Len + 2))
+   {
+      memset(&Buf[Len], 'x', PayloadLen - Len - 2);
+      Len = PayloadLen - 2;
+   }
+   Buf[Len++] = '"';
+   Buf[Len++] = '}';
+   Buf[Len]   = '\0';
+
+   return Len;
+
+} /* End BuildPayload() */
+
+
+/******************************************************************************
+** Function: BuildSbMsg
+**
+** Build an SB message of PayloadLen bytes. Returns the length.
+**
+*/
+static uint32 BuildSbMsg(BENCH_SbBuf_t *Buf, uint16 MsgId, uint32 Seq, uint64 SendNs)
+{
+
+   uint32 Len = Binary ? PayloadLen : sizeof(BENCH_SbMsg_t);
+
+   CFE_MSG_Init(CFE_MSG_PTR(Buf->Msg.TelemetryHeader), CFE_SB_ValueToMsgId(MsgId), Len);
+   CFE_SB_TimeStampMsg(CFE_MSG_PTR(Buf->Msg.TelemetryHeader));
+   Buf->Msg.Seq     = Seq;
+   Buf->Msg.JsonLen = Len;
+   Buf->Msg.SendNs  = SendNs;
+
+   return Len;
+
+} /* End BuildSbMsg() */
+
+
+/******************************************************************************
+** Function: CompareUint32
+**
+*/
+static int CompareUint32(const void *A, const void *B)
+{
+
+   uint32 ValA = *(const uint32 *)A;
+   uint32 ValB = *(const uint32 *)B;
+
+   return (ValA > ValB) - (ValA < ValB);
+
+} /* End CompareUint32() */
+
+
+/******************************************************************************
+** Function: InJsonToCfe
+**
+** Inbound topic plugin translation.
+**
+*/
+static bool InJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen)
+{
+
+   const char *Seq = memmem(JsonMsgPayload, PayloadLen, "\"seq\":", 6);
+
+   CFE_MSG_Init(CFE_MSG_PTR(InSbMsg.TelemetryHeader), CFE_SB_ValueToMsgId(BENCH_IN_MID), sizeof(InSbMsg));
+   InSbMsg.Seq     = (Seq == NULL) ? 0 : strtoul(Seq + 6, NULL, 10);
+   InSbMsg.JsonLen = PayloadLen;
+   InSbMsg.SendNs  = ParseSendNs((const uint8 *)JsonMsgPayload, PayloadLen);
+
+   *CfeMsg = CFE_MSG_PTR(InSbMsg.TelemetryHeader);
+
+   return (Seq != NULL);
+
+} /* End InJsonToCfe() */
+
+
+/******************************************************************************
+** Function: MeasureReconnect
+**
+** Time a reconnect command until the gateway reports the connection is
+** restored. A resumed session is done when the CONNACK is accepted, a
+** clean session also waits for the SUBACKs and the gateway's time to
+** subscribe is printed.
+**
+*/
+static void MeasureReconnect(void)
+{
+
+   uint32 ConnectCnt = LOOPBACK_BROKER_ConnectCnt();
+   uint64 StartNs    = BENCH_STUB_TimeNs();
+   uint64 EndNs;
+   int    i;
+
+   MQTT_MGR_ReconnectToMqttBrokerCmd(NULL, NULL);
+
+   for (i = 0; i < 200000; i++)
+   {
+      if (LOOPBACK_BROKER_ConnectCnt() != ConnectCnt && MqttMgr.MqttClient.Connected &&
+          MqttMgr.Reconnect.LostTime == 0)
+      {
+         break;
+      }
+      usleep(10);
+   }
+   EndNs = BENCH_STUB_TimeNs();
+
+   if (LOOPBACK_BROKER_ConnectCnt() == ConnectCnt)
+   {
+      printf("Reconnect: no CONNECT received\n");
+   }
+   else
+   {
+      printf("Reconnect: %.0f us, %s\n", (EndNs - StartNs) / 1000.0,
+             MqttMgr.MqttClient.SessionPresent ? "session resumed" : "clean session re-subscribed");
+      if (!MqttMgr.MqttClient.SessionPresent)
+      {
+         printf("Subscribe: %u topic filters in %u SUBSCRIBE packets, %u us\n",
+                MqttMgr.SubBatch.LastFilterCnt, MqttMgr.SubBatch.LastPacketCnt, MqttMgr.SubBatch.LastTimeUs);
+      }
+   }
+
+} /* End MeasureReconnect() */
+
+
+/******************************************************************************
+** Function: NetworkOwnerTask
+**
+*/
+static void *NetworkOwnerTask(void *Arg)
+{
+
+   while (NetworkOwnerRun)
+   {
+      MQTT_MGR_ChildTaskCallback(NULL);
+   }
+
+   return NULL;
+
+} /* End NetworkOwnerTask() */
+
+
+/******************************************************************************
+** Function: OutboundQueueFull
+**
+** Return true if the queue the outbound topic is published from is full.
+**
+*/
+static bool OutboundQueueFull(void)
+{
+
+   const MQTT_SHARD_Conn_t *Shard = &MqttMgr.MqttShard.Conn[0];
+
+   if (ShardCnt > 1 && PubQos == MQTT_CLIENT_QOS0 && MQTT_SHARD_Select(BENCH_OUT_MID, 1) != 0)
+   {
+      return ((__atomic_load_n(&Shard->Tail, __ATOMIC_ACQUIRE) -
+               __atomic_load_n(&Shard->Head, __ATOMIC_ACQUIRE)) >= MQTT_SHARD_DEPTH);
+   }
+
+   return (MQTT_PUBQ_Count() >= MQTT_PUBQ_DEPTH);
+
+} /* End OutboundQueueFull() */
+
+
+/******************************************************************************
+** Function: OutCfeToJson
+**
+** Outbound topic plugin translation.
+**
+*/
+static bool OutCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg)
+{
+
+   const BENCH_SbMsg_t *SbMsg = (const BENCH_SbMsg_t *)CfeMsg;
+
+   BuildPayload(OutJson, SbMsg->Seq, SbMsg->SendNs);
+   *JsonMsgPayload = OutJson;
+
+   return true;
+
+} /* End OutCfeToJson() */
+
+
+/******************************************************************************
+** Function: ParseSendNs
+**
+** Notes:
+**   1. Payloads always end with '}' so the number is terminated even though
+**      the payload isn't NUL terminated.
+**
+*/
+static uint64 ParseSendNs(const uint8 *Payload, uint32 PayloadLen)
+{
+
+   const char *Time = memmem(Payload, PayloadLen, "\"t\":", 4);
+
+   return (Time == NULL) ? 0 : strtoull(Time + 4, NULL, 10);
+
+} /* End ParseSendNs() */
+
+
+/******************************************************************************
+** Function: ParseSbMsgSendNs
+**
+** Notes:
+**   1. The payload is an unaligned BENCH_SbMsg_t image.
+**
+*/
+static uint64 ParseSbMsgSendNs(const uint8 *Payload, uint32 PayloadLen)
+{
+
+   uint64 SendNs = 0;
+
+   if (PayloadLen >= sizeof(BENCH_SbMsg_t))
+   {
+      memcpy(&SendNs, &Payload[offsetof(BENCH_SbMsg_t, SendNs)], sizeof(SendNs));
+   }
+
+   return SendNs;
+
+} /* End ParseSbMsgSendNs() */
+
+
+/******************************************************************************
+** Function: PrintGatewayLatency
+**
+** Print the gateway's own stage latencies for all topics.
+**
+*/
+static void PrintGatewayLatency(void)
+{
+
+   int i;
+   const JMSG_MQTT_LatencyStats_t *Stage;
+   static const char *StageName[] = { "sb_queue", "sb_xlate", "publish", "out_total",
+                                      "mqtt_xlate", "sb_send", "in_total", "ack" };
+
+   if (!GatewayLatencyValid)
+   {
+      return;
+   }
+
+   printf("\n%-10s %10s %9s %9s %9s\n", "stage", "cnt", "p50_us", "p99_us", "max_us");
+
+   Stage = &GatewayLatency.All.SbQueue;
+   for (i = 0; i < (int)(sizeof(StageName)/sizeof(StageName[0])); i++)
+   {
+      if (Stage[i].Cnt > 0)
+      {
+         printf("%-10s %10u %9u %9u %9u\n", StageName[i], Stage[i].Cnt, Stage[i].P50, Stage[i].P99, Stage[i].Max);
+      }
+   }
+
+} /* End PrintGatewayLatency() */
+
+
+/******************************************************************************
+** Function: PrintResult
+**
+*/
+static void PrintResult(BENCH_Direction_t *Dir)
+{
+
+   uint32 RcvCnt = __atomic_load_n(&Dir->RcvCnt, __ATOMIC_ACQUIRE);
+   double Seconds = (Dir->EndNs > Dir->StartNs) ? (Dir->EndNs - Dir->StartNs) / 1e9 : 0.0;
+
+   qsort(Dir->LatencyUs, RcvCnt, sizeof(uint32), CompareUint32);
+
+   printf("%-10s %10u %8u %9.3f %12.1f %14.0f", Dir->Name, RcvCnt, Dir->MsgCnt - RcvCnt, Seconds,
+          (Seconds > 0.0) ? RcvCnt / Seconds : 0.0, (Seconds > 0.0) ? Dir->Bytes / Seconds : 0.0);
+
+   if (RcvCnt > 0)
+   {
+      printf(" %9u %9u %9u\n", Dir->LatencyUs[(RcvCnt - 1) * 50 / 100],
+             Dir->LatencyUs[(RcvCnt - 1) * 99 / 100], Dir->LatencyUs[RcvCnt - 1]);
+   }
+   else
+   {
+      printf(" %9s %9s %9s\n", "-", "-", "-");
+   }
+
+} /* End PrintResult() */
+
+
+/******************************************************************************
+** Function: RecordMsg
+**
+*/
+static void RecordMsg(BENCH_Direction_t *Dir, uint64 SendNs, uint32 Bytes)
+{
+
+   uint64 Now = BENCH_STUB_TimeNs();
+   uint32 RcvCnt = Dir->RcvCnt;
+
+   if (RcvCnt < Dir->MsgCnt)
+   {
+      Dir->LatencyUs[RcvCnt] = (SendNs > 0 && Now > SendNs) ? (uint32)((Now - SendNs) / BENCH_NS_PER_US) : 0;
+      Dir->Bytes += Bytes;
+      Dir->EndNs  = Now;
+      __atomic_store_n(&Dir->RcvCnt, RcvCnt + 1, __ATOMIC_RELEASE);
+   }
+
+} /* End RecordMsg() */
+
+
+/******************************************************************************
+** Function: RunInbound
+**
+** Publish MQTT messages from the broker until they've all been sent on the
+** SB or the gateway stalls.
+**
+*/
+static void RunInbound(void)
+{
+
+   static char Payload[BENCH_PAYLOAD_MAX_LEN + 1];
+   static BENCH_SbBuf_t SbBuf;
+
+   const char *Data;
+   uint32 Seq;
+   uint32 Len;
+   uint64 Now;
+   uint32 LastRcvCnt = 0;
+   uint64 LastRcvNs;
+   uint64 PeriodNs = Rate ? (1000000000ULL / Rate) : 0;
+
+   Inbound.StartNs = BENCH_STUB_TimeNs();
+   NextDueNs = Inbound.StartNs;
+
+   for (Seq = 0; Seq < Inbound.MsgCnt; Seq++)
+   {
+      if (Rate)
+      {
+         while (BENCH_STUB_TimeNs() < NextDueNs)
+         {
+            sched_yield();
+         }
+         NextDueNs += PeriodNs;
+      }
+      if (Binary)
+      {
+         Len  = BuildSbMsg(&SbBuf, BENCH_IN_MID, Seq, BENCH_STUB_TimeNs());
+         Data = (const char *)SbBuf.Byte;
+      }
+      else
+      {
+         Len  = BuildPayload(Payload, Seq, BENCH_STUB_TimeNs());
+         Data = Payload;
+      }
+      if (!LOOPBACK_BROKER_Publish(BENCH_IN_TOPIC, Data, Len))
+      {
+         fprintf(stderr, "Loopback broker publish failed after %u messages\n", Seq);
+         break;
+      }
+   }
+
+   LastRcvNs = BENCH_STUB_TimeNs();
+   while (__atomic_load_n(&Inbound.RcvCnt, __ATOMIC_ACQUIRE) < Inbound.MsgCnt)
+   {
+      Now = BENCH_STUB_TimeNs();
+      if (Inbound.RcvCnt != LastRcvCnt)
+      {
+         LastRcvCnt = Inbound.RcvCnt;
+         LastRcvNs  = Now;
+      }
+      else if ((Now - LastRcvNs) > BENCH_STALL_NS)
+      {
+         break;
+      }
+      usleep(100);
+   }
+
+} /* End RunInbound() */
+
+
+/******************************************************************************
+** Function: RunOutbound
+**
+** Drain the SB topic pipe like the app's main task until every generated
+** message has reached the broker or the gateway stalls.
+**
+*/
+static void RunOutbound(void)
+{
+
+   uint64 Now;
+   uint32 LastRcvCnt = 0;
+   uint64 LastRcvNs;
+
+   Outbound.StartNs = BENCH_STUB_TimeNs();
+   NextDueNs = Outbound.StartNs;
+   LastRcvNs = Outbound.StartNs;
+
+   while (__atomic_load_n(&Outbound.RcvCnt, __ATOMIC_ACQUIRE) < Outbound.MsgCnt)
+   {
+
+      MQTT_MGR_ProcessSbTopicMsgs(0);
+
+      Now = BENCH_STUB_TimeNs();
+      if (Outbound.RcvCnt != LastRcvCnt)
+      {
+         LastRcvCnt = Outbound.RcvCnt;
+         LastRcvNs  = Now;
+      }
+      else if ((Now - LastRcvNs) > BENCH_STALL_NS)
+      {
+         break;
+      }
+      if (GenCnt >= Outbound.MsgCnt)
+      {
+         usleep(100);
+      }
+      else
+      {
+         sched_yield();
+      }
+
+   } /* End while messages outstanding */
+
+} /* End RunOutbound() */
+
+
+/******************************************************************************
+** Function: SbReceiveHook
+**
+** Generate the next outbound SB message when one is due.
+**
+*/
+static int32 SbReceiveHook(CFE_SB_Buffer_t **BufPtr, int32 TimeOut)
+{
+
+   uint64 Now;
+
+   if (GenCnt >= Outbound.MsgCnt)
+   {
+      return CFE_SB_NO_MESSAGE;
+   }
+
+   Now = BENCH_STUB_TimeNs();
+   if (Rate)
+   {
+      if (Now < NextDueNs)
+      {
+         return CFE_SB_NO_MESSAGE;
+      }
+      NextDueNs += 1000000000ULL / Rate;
+   }
+   else if (OutboundQueueFull())
+   {
+      return CFE_SB_NO_MESSAGE;
+   }
+
+   BuildSbMsg(&OutSbBuf, BENCH_OUT_MID, GenCnt++, Now);
+
+   *BufPtr = &OutSbBuf.SbBuf;
+
+   return CFE_SUCCESS;
+
+} /* End SbReceiveHook() */
+
+
+/******************************************************************************
+** Function: SbTransmitHook
+**
+** Record inbound messages and capture the gateway's latency telemetry.
+**
+*/
+static void SbTransmitHook(const CFE_MSG_Message_t *MsgPtr)
+{
+
+   const BENCH_SbMsg_t *SbMsg;
+
+   if (MsgPtr->MsgId == BENCH_IN_MID)
+   {
+      SbMsg = (const BENCH_SbMsg_t *)MsgPtr;
+      RecordMsg(&Inbound, SbMsg->SendNs, SbMsg->JsonLen);
+   }
+   else if (MsgPtr->MsgId == BENCH_LATENCY_TLM_MID)
+   {
+      memcpy(&GatewayLatency, &((const JMSG_MQTT_LatencyTlm_t *)MsgPtr)->Payload, sizeof(GatewayLatency));
+      GatewayLatencyValid = true;
+   }
+
+} /* End SbTransmitHook() */
+
+
+/******************************************************************************
+** Function: ShardTask
+**
+*/
+static void *ShardTask(void *Arg)
+{
+
+   MQTT_SHARD_Conn_t *Shard = (MQTT_SHARD_Conn_t *)Arg;
+
+   while (NetworkOwnerRun)
+   {
+      MQTT_SHARD_ChildTaskCallback(&Shard->ChildMgr);
+   }
+
+   return NULL;
+
+} /* End ShardTask() */
+
+
+/******************************************************************************
+** Function: SubscribeToPlugin
+**
+** Send the gateway the subscription message JMSG_LIB sends when a topic
+** plugin is enabled and wait for the network owner to process it.
+**
+*/
+static void SubscribeToPlugin(uint16 PluginId)
+{
+
+   JMSG_LIB_TopicSubscribeTlm_t SubscribeTlm;
+   uint32 SubscriptionCnt = LOOPBACK_BROKER_SubscriptionCnt();
+   int    i;
+
+   memset(&SubscribeTlm, 0, sizeof(SubscribeTlm));
+   SubscribeTlm.Payload.Id       = PluginId;
+   SubscribeTlm.Payload.Protocol = JMSG_LIB_TopicProtocol_MQTT;
+
+   MQTT_MGR_SubscribeToTopicPlugin(CFE_MSG_PTR(SubscribeTlm.TelemetryHeader));
+
+   /* Only MQTT to SB plugins subscribe with the broker */
+   if (PluginId >= BENCH_IN_PLUGIN)
+   {
+      for (i = 0; i < 2000 && LOOPBACK_BROKER_SubscriptionCnt() == SubscriptionCnt; i++)
+      {
+         usleep(1000);
+      }
+   }
+
+} /* End SubscribeToPlugin() */
+
+
+/******************************************************************************
+** Function: Usage
+**
+*/
+static void Usage(const char *Prog)
+{
+
+   fprintf(stderr,
+           "Usage: %s [-n msgs] [-s payload_bytes] [-r msgs_per_sec] [-d out|in|both]\n"
+           "          [-c coalesce_bytes] [-u coalesce_us] [-q qos] [-k conns] [-t topics]\n"
+           "          [-5] [-p] [-b] [-v]\n"
+           "  -n  Messages per direction, default %u\n"
+           "  -s  Payload length, default %u, maximum %u\n"
+           "  -r  Offered rate per direction, default 0 runs closed loop\n"
+           "  -c  Publish coalescing threshold, default 0 disables coalescing\n"
+           "  -u  Publish coalescing deadline in us, default 1000\n"
+           "  -q  Publish QoS of gateway messages, default 0\n"
+           "  -k  Broker connections used to publish, default 1, maximum %u\n"
+           "  -t  Inbound topics subscribed to, default 1, maximum %u\n"
+           "  -5  Connect with MQTT 5 instead of MQTT 3.1.1\n"
+           "  -p  Connect with a persistent session\n"
+           "  -d  Directions to run, default both\n"
+           "  -b  Bridge both topics as raw binary SB messages instead of JSON\n"
+           "  -v  Print gateway event messages\n",
+           Prog, BENCH_DEF_MSG_CNT, BENCH_DEF_PAYLOAD_LEN, BENCH_PAYLOAD_MAX_LEN, MQTT_SHARD_MAX,
+           BENCH_TOPIC_MAX);
+
+} /* End Usage() */
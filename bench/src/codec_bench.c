@@ -0,0 +1,724 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Per topic plugin CfeToJson and JsonToCfe micro-benchmark
+**
+** Notes:
+**   1. Every plugin registered in the topic table is measured through the
+**      function pointers returned by JMSG_TOPIC_TBL_GetCfeToJson() and
+**      JMSG_TOPIC_TBL_GetJsonToCfe(), the same calls MQMSG_TRANS makes.
+**   2. A plugin's corpus is <corpus dir>/<topic>.jsonl with the topic's '/'
+**      replaced by '_'. Each line is one JSON payload, lines starting with
+**      '#' are comments. The corpus is timed with JsonToCfe and the cFE
+**      messages it produces are the CfeToJson inputs, so one corpus covers
+**      both directions.
+**   3. Allocations are counted by wrapping the glibc malloc family. Only
+**      calls made inside a timed loop are counted.
+**   4. Results are written as JSON. ns_per_msg is the median of the
+**      repeats and ns_per_msg_min the fastest.
+**   5. The CBOR directions time the gateway's CBOR topic path: the plugin
+**      translation plus MQTT_CBOR's transcoding. The CBOR corpus is the
+**      JSON corpus transcoded once before timing.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "codec_plugins.h"
+#include "mqtt_cbor.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#ifndef CODEC_BENCH_CORPUS_DIR
+#define CODEC_BENCH_CORPUS_DIR  "corpus"
+#endif
+
+#define CODEC_BENCH_DEF_ITERATIONS  200000
+#define CODEC_BENCH_DEF_REPEATS     5
+#define CODEC_BENCH_MAX_REPEATS     32
+#define CODEC_BENCH_WARMUP          1000
+
+#define CODEC_BENCH_MAX_SAMPLES     1024
+#define CODEC_BENCH_LINE_MAX_LEN    8192
+#define CODEC_BENCH_CBOR_MAX_LEN    8192
+
+#define CODEC_BENCH_NS_PER_SEC      1000000000ULL
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   char    *Json;
+   uint16   JsonLen;
+   uint8   *CfeMsg;   /* NULL if JsonToCfe rejected the payload */
+   uint8   *Cbor;     /* NULL if the payload couldn't be transcoded */
+   uint32   CborLen;
+
+} CODEC_BENCH_Sample_t;
+
+typedef struct
+{
+
+   uint32   SampleCnt;
+   CODEC_BENCH_Sample_t  Sample[CODEC_BENCH_MAX_SAMPLES];
+
+} CODEC_BENCH_Corpus_t;
+
+typedef struct
+{
+
+   uint32  MsgCnt;
+   uint32  ErrCnt;
+   double  NsPerMsg;
+   double  NsPerMsgMin;
+   double  AllocsPerMsg;
+   double  AllocBytesPerMsg;
+   double  PayloadBytesPerMsg;
+
+} CODEC_BENCH_Result_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static int    CompareDouble(const void *A, const void *B);
+static void   FreeCorpus(CODEC_BENCH_Corpus_t *Corpus);
+static bool   LoadCorpus(CODEC_BENCH_Corpus_t *Corpus, const char *Path);
+static void   MeasureCfeToJson(CODEC_BENCH_Result_t *Result, JMSG_TOPIC_TBL_CfeToJson_t CfeToJson,
+                               const CODEC_BENCH_Corpus_t *Corpus, bool Cbor);
+static void   MeasureJsonToCfe(CODEC_BENCH_Result_t *Result, JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe,
+                               const CODEC_BENCH_Corpus_t *Corpus, bool Cbor);
+static uint64 NowNs(void);
+static void   SeedCbor(CODEC_BENCH_Corpus_t *Corpus);
+static void   SeedCfeMsgs(CODEC_BENCH_Corpus_t *Corpus, JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe);
+static void   Usage(const char *Prog);
+static void   WriteJsonString(FILE *Out, const char *Str);
+static void   WriteResult(FILE *Out, const char *Name, const char *BytesName,
+                          const CODEC_BENCH_Result_t *Result, bool Last);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static uint32 Iterations = CODEC_BENCH_DEF_ITERATIONS;
+static uint32 Repeats    = CODEC_BENCH_DEF_REPEATS;
+
+static CODEC_BENCH_Corpus_t Corpus;
+
+/* Allocation counters, only updated while CountAllocs is set */
+static bool   CountAllocs = false;
+static uint64 AllocCnt    = 0;
+static uint64 AllocBytes  = 0;
+
+
+/*************************/
+/** Allocation Counting **/
+/*************************/
+
+extern void *__libc_malloc(size_t Size);
+extern void *__libc_calloc(size_t Nmemb, size_t Size);
+extern void *__libc_realloc(void *Ptr, size_t Size);
+extern void  __libc_free(void *Ptr);
+
+void *malloc(size_t Size)
+{
+   if (CountAllocs)
+   {
+      AllocCnt++;
+      AllocBytes += Size;
+   }
+   return __libc_malloc(Size);
+}
+
+void *calloc(size_t Nmemb, size_t Size)
+{
+   if (CountAllocs)
+   {
+      AllocCnt++;
+      AllocBytes += Nmemb * Size;
+   }
+   return __libc_calloc(Nmemb, Size);
+}
+
+void *realloc(void *Ptr, size_t Size)
+{
+   if (CountAllocs)
+   {
+      AllocCnt++;
+      AllocBytes += Size;
+   }
+   return __libc_realloc(Ptr, Size);
+}
+
+void free(void *Ptr)
+{
+   __libc_free(Ptr);
+}
+
+
+/******************************************************************************
+** Function: main
+**
+*/
+int main(int argc, char *argv[])
+{
+
+   int   Opt;
+   int   PluginId;
+   bool  FirstPlugin = true;
+   const char *CorpusDir = CODEC_BENCH_CORPUS_DIR;
+   const char *OutFile   = NULL;
+   const char *JsonMsgTopic;
+   const JMSG_TOPIC_TBL_Topic_t *Topic;
+   JMSG_TOPIC_TBL_CfeToJson_t    CfeToJson;
+   JMSG_TOPIC_TBL_JsonToCfe_t    JsonToCfe;
+   CODEC_BENCH_Result_t          CfeToJsonResult;
+   CODEC_BENCH_Result_t          JsonToCfeResult;
+   CODEC_BENCH_Result_t          CfeToCborResult;
+   CODEC_BENCH_Result_t          CborToCfeResult;
+   FILE *Out = stdout;
+   char  CorpusPath[OS_MAX_PATH_LEN + JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   char *Ch;
+
+   while ((Opt = getopt(argc, argv, "c:n:r:o:h")) != -1)
+   {
+      switch (Opt)
+      {
+         case 'c': CorpusDir  = optarg; break;
+         case 'n': Iterations = strtoul(optarg, NULL, 0); break;
+         case 'r': Repeats    = strtoul(optarg, NULL, 0); break;
+         case 'o': OutFile    = optarg; break;
+         default:
+            Usage(argv[0]);
+            return (Opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   if (Iterations == 0 || Repeats == 0 || Repeats > CODEC_BENCH_MAX_REPEATS)
+   {
+      Usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (OutFile != NULL && (Out = fopen(OutFile, "w")) == NULL)
+   {
+      perror(OutFile);
+      return EXIT_FAILURE;
+   }
+
+   CODEC_PLUGINS_Register();
+
+   fprintf(Out, "{\n  \"benchmark\": \"jmsg_mqtt_codec\",\n  \"iterations\": %u,\n  \"repeats\": %u,\n"
+           "  \"plugins\": [", Iterations, Repeats);
+
+   for (PluginId = 0; PluginId < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; PluginId++)
+   {
+
+      Topic = JMSG_TOPIC_TBL_GetTopic(PluginId);
+      if (Topic->Name[0] == '\0')
+      {
+         continue;
+      }
+
+      CfeToJson = JMSG_TOPIC_TBL_GetCfeToJson(PluginId, &JsonMsgTopic);
+      JsonToCfe = JMSG_TOPIC_TBL_GetJsonToCfe(PluginId);
+
+      snprintf(CorpusPath, sizeof(CorpusPath), "%s/%s.jsonl", CorpusDir, Topic->Name);
+      for (Ch = &CorpusPath[strlen(CorpusDir) + 1]; *Ch != '\0'; Ch++)
+      {
+         if (*Ch == '/')
+         {
+            *Ch = '_';
+         }
+      }
+
+      memset(&CfeToJsonResult, 0, sizeof(CfeToJsonResult));
+      memset(&JsonToCfeResult, 0, sizeof(JsonToCfeResult));
+      memset(&CfeToCborResult, 0, sizeof(CfeToCborResult));
+      memset(&CborToCfeResult, 0, sizeof(CborToCfeResult));
+      if (LoadCorpus(&Corpus, CorpusPath) && JsonToCfe != NULL)
+      {
+         SeedCfeMsgs(&Corpus, JsonToCfe);
+         SeedCbor(&Corpus);
+         MeasureJsonToCfe(&JsonToCfeResult, JsonToCfe, &Corpus, false);
+         MeasureJsonToCfe(&CborToCfeResult, JsonToCfe, &Corpus, true);
+         if (CfeToJson != NULL)
+         {
+            MeasureCfeToJson(&CfeToJsonResult, CfeToJson, &Corpus, false);
+            MeasureCfeToJson(&CfeToCborResult, CfeToJson, &Corpus, true);
+         }
+      }
+      else if (Corpus.SampleCnt > 0)
+      {
+         fprintf(stderr, "%s has no JsonToCfe to build CfeToJson inputs from the corpus\n", Topic->Name);
+      }
+
+      fprintf(Out, "%s\n    {\n      \"id\": %d,\n      \"topic\": ", FirstPlugin ? "" : ",", PluginId);
+      WriteJsonString(Out, Topic->Name);
+      fprintf(Out, ",\n      \"cfe_msg_id\": %u,\n      \"corpus\": ", Topic->Cfe);
+      WriteJsonString(Out, CorpusPath);
+      fprintf(Out, ",\n      \"samples\": %u,\n", Corpus.SampleCnt);
+      WriteResult(Out, "json_to_cfe", "json_bytes_per_msg", &JsonToCfeResult, false);
+      WriteResult(Out, "cfe_to_json", "json_bytes_per_msg", &CfeToJsonResult, false);
+      WriteResult(Out, "cbor_to_cfe", "cbor_bytes_per_msg", &CborToCfeResult, false);
+      WriteResult(Out, "cfe_to_cbor", "cbor_bytes_per_msg", &CfeToCborResult, true);
+      fprintf(Out, "    }");
+
+      FirstPlugin = false;
+      FreeCorpus(&Corpus);
+
+   } /* End plugin loop */
+
+   fprintf(Out, "\n  ]\n}\n");
+
+   if (Out != stdout)
+   {
+      fclose(Out);
+   }
+
+   return EXIT_SUCCESS;
+
+} /* End main() */
+
+
+/******************************************************************************
+** Function: CompareDouble
+**
+*/
+static int CompareDouble(const void *A, const void *B)
+{
+
+   double ValA = *(const double *)A;
+   double ValB = *(const double *)B;
+
+   return (ValA > ValB) - (ValA < ValB);
+
+} /* End CompareDouble() */
+
+
+/******************************************************************************
+** Function: FreeCorpus
+**
+*/
+static void FreeCorpus(CODEC_BENCH_Corpus_t *Corpus)
+{
+
+   uint32 i;
+
+   for (i = 0; i < Corpus->SampleCnt; i++)
+   {
+      free(Corpus->Sample[i].Json);
+      free(Corpus->Sample[i].CfeMsg);
+      free(Corpus->Sample[i].Cbor);
+   }
+   memset(Corpus, 0, sizeof(CODEC_BENCH_Corpus_t));
+
+} /* End FreeCorpus() */
+
+
+/******************************************************************************
+** Function: LoadCorpus
+**
+** Returns false if the file can't be read or has no payloads.
+**
+*/
+static bool LoadCorpus(CODEC_BENCH_Corpus_t *Corpus, const char *Path)
+{
+
+   static char Line[CODEC_BENCH_LINE_MAX_LEN];
+
+   FILE  *File = fopen(Path, "r");
+   size_t Len;
+
+   memset(Corpus, 0, sizeof(CODEC_BENCH_Corpus_t));
+
+   if (File == NULL)
+   {
+      fprintf(stderr, "No corpus %s\n", Path);
+      return false;
+   }
+
+   while (fgets(Line, sizeof(Line), File) != NULL && Corpus->SampleCnt < CODEC_BENCH_MAX_SAMPLES)
+   {
+      Len = strlen(Line);
+      while (Len > 0 && (Line[Len-1] == '\n' || Line[Len-1] == '\r'))
+      {
+         Line[--Len] = '\0';
+      }
+      if (Len == 0 || Line[0] == '#')
+      {
+         continue;
+      }
+
+      /* Payloads aren't NUL terminated by MQTT_CLIENT so the copy isn't either */
+      Corpus->Sample[Corpus->SampleCnt].Json    = malloc(Len);
+      Corpus->Sample[Corpus->SampleCnt].JsonLen = Len;
+      memcpy(Corpus->Sample[Corpus->SampleCnt].Json, Line, Len);
+      Corpus->SampleCnt++;
+   }
+
+   fclose(File);
+
+   return (Corpus->SampleCnt > 0);
+
+} /* End LoadCorpus() */
+
+
+/******************************************************************************
+** Function: MeasureCfeToJson
+**
+** When Cbor is set each translation is also transcoded to CBOR.
+**
+*/
+static void MeasureCfeToJson(CODEC_BENCH_Result_t *Result, JMSG_TOPIC_TBL_CfeToJson_t CfeToJson,
+                             const CODEC_BENCH_Corpus_t *Corpus, bool Cbor)
+{
+
+   static uint8 CborBuf[CODEC_BENCH_CBOR_MAX_LEN];
+
+   const CFE_MSG_Message_t *CfeMsg[CODEC_BENCH_MAX_SAMPLES];
+   const char *JsonMsgPayload;
+   double NsPerMsg[CODEC_BENCH_MAX_REPEATS];
+   uint64 StartNs;
+   uint64 PayloadBytes = 0;
+   uint32 CborLen;
+   uint32 MsgCnt = 0;
+   uint32 i, r;
+   uint32 s = 0;
+
+   for (i = 0; i < Corpus->SampleCnt; i++)
+   {
+      if (Corpus->Sample[i].CfeMsg != NULL)
+      {
+         CfeMsg[MsgCnt++] = (const CFE_MSG_Message_t *)Corpus->Sample[i].CfeMsg;
+      }
+   }
+   if (MsgCnt == 0)
+   {
+      return;
+   }
+
+   for (i = 0; i < CODEC_BENCH_WARMUP; i++)
+   {
+      CfeToJson(&JsonMsgPayload, CfeMsg[i % MsgCnt]);
+   }
+
+   for (r = 0; r < Repeats; r++)
+   {
+      AllocCnt   = 0;
+      AllocBytes = 0;
+      Result->ErrCnt = 0;
+      PayloadBytes = 0;
+
+      CountAllocs = true;
+      StartNs = NowNs();
+      for (i = 0; i < Iterations; i++)
+      {
+         if (!CfeToJson(&JsonMsgPayload, CfeMsg[s]))
+         {
+            Result->ErrCnt++;
+         }
+         else if (!Cbor)
+         {
+            PayloadBytes += strlen(JsonMsgPayload);
+         }
+         else if (MQTT_CBOR_FromJson(CborBuf, sizeof(CborBuf), &CborLen, JsonMsgPayload, strlen(JsonMsgPayload)))
+         {
+            PayloadBytes += CborLen;
+         }
+         else
+         {
+            Result->ErrCnt++;
+         }
+         if (++s == MsgCnt)
+         {
+            s = 0;
+         }
+      }
+      NsPerMsg[r] = (double)(NowNs() - StartNs) / Iterations;
+      CountAllocs = false;
+   }
+
+   qsort(NsPerMsg, Repeats, sizeof(double), CompareDouble);
+
+   Result->MsgCnt           = Iterations;
+   Result->NsPerMsg         = NsPerMsg[Repeats / 2];
+   Result->NsPerMsgMin      = NsPerMsg[0];
+   Result->AllocsPerMsg     = (double)AllocCnt / Iterations;
+   Result->AllocBytesPerMsg = (double)AllocBytes / Iterations;
+   Result->PayloadBytesPerMsg = (double)PayloadBytes / Iterations;
+
+} /* End MeasureCfeToJson() */
+
+
+/******************************************************************************
+** Function: MeasureJsonToCfe
+**
+** When Cbor is set the input is the sample's CBOR transcoded back to JSON
+** before translation. Samples without a CBOR encoding are skipped.
+**
+*/
+static void MeasureJsonToCfe(CODEC_BENCH_Result_t *Result, JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe,
+                             const CODEC_BENCH_Corpus_t *Corpus, bool Cbor)
+{
+
+   static char JsonBuf[CODEC_BENCH_LINE_MAX_LEN];
+
+   const CODEC_BENCH_Sample_t *Sample[CODEC_BENCH_MAX_SAMPLES];
+   CFE_MSG_Message_t *CfeMsg;
+   double NsPerMsg[CODEC_BENCH_MAX_REPEATS];
+   uint64 StartNs;
+   uint64 PayloadBytes = 0;
+   uint32 JsonLen;
+   uint32 SampleCnt = 0;
+   uint32 i, r;
+   uint32 s = 0;
+
+   for (i = 0; i < Corpus->SampleCnt; i++)
+   {
+      if (!Cbor || Corpus->Sample[i].Cbor != NULL)
+      {
+         Sample[SampleCnt++] = &Corpus->Sample[i];
+      }
+   }
+   if (SampleCnt == 0)
+   {
+      return;
+   }
+
+   for (i = 0; i < CODEC_BENCH_WARMUP; i++)
+   {
+      JsonToCfe(&CfeMsg, Sample[i % SampleCnt]->Json, Sample[i % SampleCnt]->JsonLen);
+   }
+
+   for (r = 0; r < Repeats; r++)
+   {
+      AllocCnt   = 0;
+      AllocBytes = 0;
+      Result->ErrCnt = 0;
+      PayloadBytes = 0;
+
+      CountAllocs = true;
+      StartNs = NowNs();
+      for (i = 0; i < Iterations; i++)
+      {
+         if (Cbor)
+         {
+            if (!MQTT_CBOR_ToJson(JsonBuf, sizeof(JsonBuf), &JsonLen, Sample[s]->Cbor, Sample[s]->CborLen) ||
+                !JsonToCfe(&CfeMsg, JsonBuf, JsonLen))
+            {
+               Result->ErrCnt++;
+            }
+            PayloadBytes += Sample[s]->CborLen;
+         }
+         else
+         {
+            if (!JsonToCfe(&CfeMsg, Sample[s]->Json, Sample[s]->JsonLen))
+            {
+               Result->ErrCnt++;
+            }
+            PayloadBytes += Sample[s]->JsonLen;
+         }
+         if (++s == SampleCnt)
+         {
+            s = 0;
+         }
+      }
+      NsPerMsg[r] = (double)(NowNs() - StartNs) / Iterations;
+      CountAllocs = false;
+   }
+
+   qsort(NsPerMsg, Repeats, sizeof(double), CompareDouble);
+
+   Result->MsgCnt           = Iterations;
+   Result->NsPerMsg         = NsPerMsg[Repeats / 2];
+   Result->NsPerMsgMin      = NsPerMsg[0];
+   Result->AllocsPerMsg     = (double)AllocCnt / Iterations;
+   Result->AllocBytesPerMsg = (double)AllocBytes / Iterations;
+   Result->PayloadBytesPerMsg = (double)PayloadBytes / Iterations;
+
+} /* End MeasureJsonToCfe() */
+
+
+/******************************************************************************
+** Function: NowNs
+**
+*/
+static uint64 NowNs(void)
+{
+
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return (uint64)Now.tv_sec * CODEC_BENCH_NS_PER_SEC + Now.tv_nsec;
+
+} /* End NowNs() */
+
+
+/******************************************************************************
+** Function: SeedCbor
+**
+** Transcode each corpus payload to CBOR once for the CBOR to cFE direction.
+**
+*/
+static void SeedCbor(CODEC_BENCH_Corpus_t *Corpus)
+{
+
+   static uint8 CborBuf[CODEC_BENCH_CBOR_MAX_LEN];
+
+   CODEC_BENCH_Sample_t *Sample;
+   uint32 CborLen;
+   uint32 i;
+
+   for (i = 0; i < Corpus->SampleCnt; i++)
+   {
+      Sample = &Corpus->Sample[i];
+      if (MQTT_CBOR_FromJson(CborBuf, sizeof(CborBuf), &CborLen, Sample->Json, Sample->JsonLen))
+      {
+         Sample->Cbor    = malloc(CborLen);
+         Sample->CborLen = CborLen;
+         memcpy(Sample->Cbor, CborBuf, CborLen);
+      }
+      else
+      {
+         fprintf(stderr, "Corpus line %u can't be transcoded to CBOR: %.*s\n", i + 1,
+                 (int)Sample->JsonLen, Sample->Json);
+      }
+   }
+
+} /* End SeedCbor() */
+
+
+/******************************************************************************
+** Function: SeedCfeMsgs
+**
+** Translate each corpus payload once and keep a copy of the cFE message as
+** a CfeToJson input. Plugins return a pointer to their own buffer so the
+** message must be copied before the next call.
+**
+*/
+static void SeedCfeMsgs(CODEC_BENCH_Corpus_t *Corpus, JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe)
+{
+
+   CODEC_BENCH_Sample_t *Sample;
+   CFE_MSG_Message_t *CfeMsg;
+   CFE_MSG_Size_t MsgSize;
+   uint32 i;
+
+   for (i = 0; i < Corpus->SampleCnt; i++)
+   {
+      Sample = &Corpus->Sample[i];
+      if (JsonToCfe(&CfeMsg, Sample->Json, Sample->JsonLen))
+      {
+         CFE_MSG_GetSize(CfeMsg, &MsgSize);
+         Sample->CfeMsg = malloc(MsgSize);
+         memcpy(Sample->CfeMsg, CfeMsg, MsgSize);
+      }
+      else
+      {
+         fprintf(stderr, "JsonToCfe rejected corpus line %u: %.*s\n", i + 1,
+                 (int)Sample->JsonLen, Sample->Json);
+      }
+   }
+
+} /* End SeedCfeMsgs() */
+
+
+/******************************************************************************
+** Function: Usage
+**
+*/
+static void Usage(const char *Prog)
+{
+
+   fprintf(stderr,
+           "Usage: %s [-c corpus_dir] [-n iterations] [-r repeats] [-o json_file]\n"
+           "  -c  Corpus directory, default %s\n"
+           "  -n  Translations per repeat per direction, default %u\n"
+           "  -r  Timed repeats, default %u, maximum %u\n"
+           "  -o  Write the JSON results to a file instead of stdout\n",
+           Prog, CODEC_BENCH_CORPUS_DIR, CODEC_BENCH_DEF_ITERATIONS, CODEC_BENCH_DEF_REPEATS,
+           CODEC_BENCH_MAX_REPEATS);
+
+} /* End Usage() */
+
+
+/******************************************************************************
+** Function: WriteJsonString
+**
+*/
+static void WriteJsonString(FILE *Out, const char *Str)
+{
+
+   fputc('"', Out);
+   for (; *Str != '\0'; Str++)
+   {
+      if (*Str == '"' || *Str == '\\')
+      {
+         fputc('\\', Out);
+      }
+      fputc(*Str, Out);
+   }
+   fputc('"', Out);
+
+} /* End WriteJsonString() */
+
+
+/******************************************************************************
+** Function: WriteResult
+**
+** A direction that wasn't measured is written as null.
+**
+*/
+static void WriteResult(FILE *Out, const char *Name, const char *BytesName,
+                        const CODEC_BENCH_Result_t *Result, bool Last)
+{
+
+   if (Result->MsgCnt == 0)
+   {
+      fprintf(Out, "      \"%s\": null%s\n", Name, Last ? "" : ",");
+      return;
+   }
+
+   fprintf(Out, "      \"%s\": {\n"
+                "        \"msgs\": %u,\n"
+                "        \"errors\": %u,\n"
+                "        \"ns_per_msg\": %.1f,\n"
+                "        \"ns_per_msg_min\": %.1f,\n"
+                "        \"allocs_per_msg\": %.3f,\n"
+                "        \"alloc_bytes_per_msg\": %.1f,\n"
+                "        \"%s\": %.1f\n"
+                "      }%s\n",
+           Name, Result->MsgCnt, Result->ErrCnt, Result->NsPerMsg, Result->NsPerMsgMin,
+           Result->AllocsPerMsg, Result->AllocBytesPerMsg, BytesName, Result->PayloadBytesPerMsg,
+           Last ? "" : ",");
+
+} /* End WriteResult() */
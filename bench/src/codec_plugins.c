@@ -0,0 +1,386 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Reference topic plugins for the codec benchmark
+**
+** Notes:
+**   1. See codec_plugins.h for the relationship with the JMSG_LIB plugins.
+**   2. Like the JMSG_LIB plugins each translation uses a static message
+**      buffer so the returned pointer is valid until the next call.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <stdlib.h>
+
+#include "codec_plugins.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define RATE_PLUGIN      2
+#define DISCRETE_PLUGIN  3
+#define TEXT_PLUGIN      4
+
+#define RATE_MID         0x0F80
+#define DISCRETE_MID     0x0F81
+#define TEXT_MID         0x0F82
+
+#define DISCRETE_ITEM_CNT  4
+#define TEXT_MAX_LEN       128
+
+#define JSON_MAX_LEN  1024
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   CFE_MSG_TelemetryHeader_t  TelemetryHeader;
+   float  X;
+   float  Y;
+   float  Z;
+
+} RateTlm_t;
+
+typedef struct
+{
+
+   CFE_MSG_TelemetryHeader_t  TelemetryHeader;
+   int32  Item[DISCRETE_ITEM_CNT];
+
+} DiscreteTlm_t;
+
+typedef struct
+{
+
+   CFE_MSG_TelemetryHeader_t  TelemetryHeader;
+   uint32  Severity;
+   char    Text[TEXT_MAX_LEN];
+
+} TextTlm_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static bool CopyPayload(const char *JsonMsgPayload, uint16 PayloadLen);
+static bool DiscreteCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg);
+static bool DiscreteJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen);
+static const char *FindValue(const char *Key);
+static bool GetNumber(const char *Key, double *Value);
+static bool GetString(const char *Key, char *Value, uint32 ValueLen);
+static bool RateCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg);
+static bool RateJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen);
+static bool TextCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg);
+static bool TextJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+/* NUL terminated copy of the payload being parsed */
+static char JsonIn[JSON_MAX_LEN + 1];
+static char JsonOut[JSON_MAX_LEN + 1];
+
+static RateTlm_t      RateTlm;
+static DiscreteTlm_t  DiscreteTlm;
+static TextTlm_t      TextTlm;
+
+
+/******************************************************************************
+** Function: CODEC_PLUGINS_Register
+**
+*/
+void CODEC_PLUGINS_Register(void)
+{
+
+   BENCH_TOPIC_TBL_AddPlugin(RATE_PLUGIN,     "bench/rate",     RATE_MID,     true, RateCfeToJson,     RateJsonToCfe);
+   BENCH_TOPIC_TBL_AddPlugin(DISCRETE_PLUGIN, "bench/discrete", DISCRETE_MID, true, DiscreteCfeToJson, DiscreteJsonToCfe);
+   BENCH_TOPIC_TBL_AddPlugin(TEXT_PLUGIN,     "bench/text",     TEXT_MID,     true, TextCfeToJson,     TextJsonToCfe);
+
+} /* End CODEC_PLUGINS_Register() */
+
+
+/******************************************************************************
+** Function: CopyPayload
+**
+** Copy the payload to JsonIn so it can be parsed with the C string functions.
+**
+*/
+static bool CopyPayload(const char *JsonMsgPayload, uint16 PayloadLen)
+{
+
+   if (PayloadLen > JSON_MAX_LEN)
+   {
+      return false;
+   }
+
+   memcpy(JsonIn, JsonMsgPayload, PayloadLen);
+   JsonIn[PayloadLen] = '\0';
+
+   return true;
+
+} /* End CopyPayload() */
+
+
+/******************************************************************************
+** Function: DiscreteCfeToJson
+**
+*/
+static bool DiscreteCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg)
+{
+
+   const DiscreteTlm_t *Tlm = (const DiscreteTlm_t *)CfeMsg;
+
+   snprintf(JsonOut, sizeof(JsonOut),
+            "{\"discrete\":{\"item-1\":%d,\"item-2\":%d,\"item-3\":%d,\"item-4\":%d}}",
+            Tlm->Item[0], Tlm->Item[1], Tlm->Item[2], Tlm->Item[3]);
+   *JsonMsgPayload = JsonOut;
+
+   return true;
+
+} /* End DiscreteCfeToJson() */
+
+
+/******************************************************************************
+** Function: DiscreteJsonToCfe
+**
+*/
+static bool DiscreteJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen)
+{
+
+   static const char *ItemKey[DISCRETE_ITEM_CNT] = { "item-1", "item-2", "item-3", "item-4" };
+
+   double Value;
+   int    i;
+
+   if (!CopyPayload(JsonMsgPayload, PayloadLen))
+   {
+      return false;
+   }
+
+   CFE_MSG_Init(CFE_MSG_PTR(DiscreteTlm.TelemetryHeader), CFE_SB_ValueToMsgId(DISCRETE_MID), sizeof(DiscreteTlm));
+   for (i = 0; i < DISCRETE_ITEM_CNT; i++)
+   {
+      if (!GetNumber(ItemKey[i], &Value))
+      {
+         return false;
+      }
+      DiscreteTlm.Item[i] = (int32)Value;
+   }
+
+   *CfeMsg = CFE_MSG_PTR(DiscreteTlm.TelemetryHeader);
+
+   return true;
+
+} /* End DiscreteJsonToCfe() */
+
+
+/******************************************************************************
+** Function: FindValue
+**
+** Return a pointer to the first character of the value of Key in JsonIn, or
+** NULL if Key isn't present.
+**
+*/
+static const char *FindValue(const char *Key)
+{
+
+   const char *Value = JsonIn;
+   size_t KeyLen = strlen(Key);
+
+   while ((Value = strstr(Value, Key)) != NULL)
+   {
+      if (Value > JsonIn && Value[-1] == '"' && Value[KeyLen] == '"')
+      {
+         Value += KeyLen + 1;
+         while (*Value == ' ' || *Value == ':')
+         {
+            Value++;
+         }
+         return Value;
+      }
+      Value += KeyLen;
+   }
+
+   return NULL;
+
+} /* End FindValue() */
+
+
+/******************************************************************************
+** Function: GetNumber
+**
+*/
+static bool GetNumber(const char *Key, double *Value)
+{
+
+   const char *Str = FindValue(Key);
+   char *End;
+
+   if (Str == NULL)
+   {
+      return false;
+   }
+
+   *Value = strtod(Str, &End);
+
+   return (End != Str);
+
+} /* End GetNumber() */
+
+
+/******************************************************************************
+** Function: GetString
+**
+** Escape sequences are copied unchanged.
+**
+*/
+static bool GetString(const char *Key, char *Value, uint32 ValueLen)
+{
+
+   const char *Str = FindValue(Key);
+   uint32 Len = 0;
+
+   if (Str == NULL || *Str != '"')
+   {
+      return false;
+   }
+
+   for (Str++; *Str != '\0' && *Str != '"' && Len < (ValueLen - 1); Str++)
+   {
+      if (*Str == '\\' && Str[1] != '\0')
+      {
+         Value[Len++] = *Str++;
+         if (Len == (ValueLen - 1))
+         {
+            break;
+         }
+      }
+      Value[Len++] = *Str;
+   }
+   Value[Len] = '\0';
+
+   return (*Str == '"');
+
+} /* End GetString() */
+
+
+/******************************************************************************
+** Function: RateCfeToJson
+**
+*/
+static bool RateCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg)
+{
+
+   const RateTlm_t *Tlm = (const RateTlm_t *)CfeMsg;
+
+   snprintf(JsonOut, sizeof(JsonOut), "{\"rate\":{\"x\":%.6f,\"y\":%.6f,\"z\":%.6f}}",
+            Tlm->X, Tlm->Y, Tlm->Z);
+   *JsonMsgPayload = JsonOut;
+
+   return true;
+
+} /* End RateCfeToJson() */
+
+
+/******************************************************************************
+** Function: RateJsonToCfe
+**
+*/
+static bool RateJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen)
+{
+
+   double X, Y, Z;
+
+   if (!CopyPayload(JsonMsgPayload, PayloadLen))
+   {
+      return false;
+   }
+
+   if (!GetNumber("x", &X) || !GetNumber("y", &Y) || !GetNumber("z", &Z))
+   {
+      return false;
+   }
+
+   CFE_MSG_Init(CFE_MSG_PTR(RateTlm.TelemetryHeader), CFE_SB_ValueToMsgId(RATE_MID), sizeof(RateTlm));
+   RateTlm.X = X;
+   RateTlm.Y = Y;
+   RateTlm.Z = Z;
+
+   *CfeMsg = CFE_MSG_PTR(RateTlm.TelemetryHeader);
+
+   return true;
+
+} /* End RateJsonToCfe() */
+
+
+/******************************************************************************
+** Function: TextCfeToJson
+**
+** Tlm->Text is already JSON escaped.
+**
+*/
+static bool TextCfeToJson(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg)
+{
+
+   const TextTlm_t *Tlm = (const TextTlm_t *)CfeMsg;
+
+   snprintf(JsonOut, sizeof(JsonOut), "{\"text\":{\"severity\":%u,\"message\":\"%s\"}}",
+            Tlm->Severity, Tlm->Text);
+   *JsonMsgPayload = JsonOut;
+
+   return true;
+
+} /* End TextCfeToJson() */
+
+
+/******************************************************************************
+** Function: TextJsonToCfe
+**
+*/
+static bool TextJsonToCfe(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen)
+{
+
+   double Severity;
+
+   if (!CopyPayload(JsonMsgPayload, PayloadLen))
+   {
+      return false;
+   }
+
+   CFE_MSG_Init(CFE_MSG_PTR(TextTlm.TelemetryHeader), CFE_SB_ValueToMsgId(TEXT_MID), sizeof(TextTlm));
+   if (!GetNumber("severity", &Severity) || !GetString("message", TextTlm.Text, TEXT_MAX_LEN))
+   {
+      return false;
+   }
+   TextTlm.Severity = (uint32)Severity;
+
+   *CfeMsg = CFE_MSG_PTR(TextTlm.TelemetryHeader);
+
+   return true;
+
+} /* End TextJsonToCfe() */
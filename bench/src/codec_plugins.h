@@ -0,0 +1,51 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Topic plugins measured by the codec benchmark
+**
+** Notes:
+**   1. The flight plugins are defined by JMSG_LIB. The reference plugins
+**      here follow the shape of its telemetry plugins (a JSON object of
+**      named numeric or string items per cFE message) so the benchmark
+**      runs without a JMSG_LIB checkout.
+**   2. To measure other plugins, register them in CODEC_PLUGINS_Register()
+**      and add a corpus file named after the plugin's topic.
+**
+*/
+#ifndef _codec_plugins_
+#define _codec_plugins_
+
+/*
+** Includes
+*/
+
+#include "jmsg_topic_tbl.h"
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: CODEC_PLUGINS_Register
+**
+** Register the benchmarked plugins with the topic table.
+**
+*/
+void CODEC_PLUGINS_Register(void);
+
+
+#endif /* _codec_plugins_ */
@@ -0,0 +1,1139 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Minimal MQTT 3.1.1 and MQTT 5 broker stand-in on the loopback interface
+**
+** Notes:
+**   1. See loopback_broker.h
+**   2. Packets are parsed directly rather than with MQTTPacket so the
+**      broker doesn't share code with the client it's measuring.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "loopback_broker.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define BROKER_PACKET_MAX_LEN  (64*1024)
+
+/* MQTT control packet types (fixed header bits 7-4) */
+#define BROKER_CONNECT      1
+#define BROKER_CONNACK      2
+#define BROKER_PUBLISH      3
+#define BROKER_PUBACK       4
+#define BROKER_PUBREC       5
+#define BROKER_PUBREL       6
+#define BROKER_PUBCOMP      7
+#define BROKER_SUBSCRIBE    8
+#define BROKER_SUBACK       9
+#define BROKER_UNSUBSCRIBE 10
+#define BROKER_UNSUBACK    11
+#define BROKER_PINGREQ     12
+#define BROKER_PINGRESP    13
+#define BROKER_DISCONNECT  14
+
+/* MQTT 5 limits sent in the CONNACK */
+#define BROKER_TOPIC_ALIAS_MAX  16
+#define BROKER_RECEIVE_MAX      32
+
+#define BROKER_TOPIC_MAX_LEN   256
+
+/* Topic filters acknowledged in a SUBACK or UNSUBACK */
+#define BROKER_SUB_FILTER_MAX  64
+
+/* Additional client connections, e.g. the gateway's publish shards */
+#define BROKER_SHARD_CONN_MAX    8
+
+/* Time allowed for a new connection's CONNECT to arrive, in 1 ms polls */
+#define BROKER_CONNECT_WAIT_MS  100
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** MQTT 5 properties used by the broker, zero when absent
+*/
+
+typedef struct
+{
+
+   uint16  TopicAlias;
+   uint16  TopicAliasMax;
+
+} BROKER_Props_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void *AcceptThread(void *Arg);
+static bool  PeekClientId(int Fd, char *ClientId, uint32 ClientIdLen);
+static bool  ProcessPacket(uint8 Type, uint8 Flags, uint8 *Body, uint32 BodyLen);
+static bool  ProcessShardPacket(int Fd, uint8 Type, uint8 Flags, uint8 *Body, uint32 BodyLen);
+static bool  ReadFull(int Fd, uint8 *Buf, uint32 Len);
+static bool  ReadPacket(int Fd, uint8 *Header, uint8 *Body, uint32 *BodyLen);
+static bool  ReadProperties(const uint8 *Body, uint32 BodyLen, uint32 *Offset, BROKER_Props_t *Props);
+static uint32 ReadVarInt(const uint8 *Buf, uint32 Len, uint32 *Value);
+static void *ReceiveThread(void *Arg);
+static bool  SendAck(int Fd, uint8 Type, uint16 PacketId, const uint8 *Data, uint32 DataLen);
+static void *ShardThread(void *Arg);
+static bool  WriteFull(int Fd, const uint8 *Buf, uint32 Len);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static int ListenFd = -1;
+static int ClientFd = -1;
+static volatile bool Running = false;
+
+static uint32 SubscriptionCnt = 0;
+static uint32 ConnectCnt = 0;
+
+/*
+** Connection state. ProtocolLevel, PrimaryClientId and the outbound
+** aliases are protected by WriteMutex. OutAlias[i] and InAlias[i] are
+** alias i+1.
+*/
+
+static uint8  ProtocolLevel = 4;
+static char   SessionClientId[BROKER_TOPIC_MAX_LEN] = "";
+static char   PrimaryClientId[BROKER_TOPIC_MAX_LEN] = "";
+static uint16 ClientTopicAliasMax = 0;
+static uint16 OutAliasCnt = 0;
+static char   OutAlias[BROKER_TOPIC_ALIAS_MAX][BROKER_TOPIC_MAX_LEN];
+static char   InAlias[BROKER_TOPIC_ALIAS_MAX][BROKER_TOPIC_MAX_LEN];
+
+static pthread_t       ListenThread;
+static pthread_t       RxThread;
+static bool            RxThreadCreated = false;
+static pthread_mutex_t WriteMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+** Additional connections. A slot is free when its fd is negative, the
+** fds are protected by WriteMutex.
+*/
+
+static int       ShardFd[BROKER_SHARD_CONN_MAX];
+static pthread_t ShardRxThread[BROKER_SHARD_CONN_MAX];
+static bool      ShardRxThreadCreated[BROKER_SHARD_CONN_MAX];
+static uint8     ShardRxBuf[BROKER_SHARD_CONN_MAX][BROKER_PACKET_MAX_LEN];
+
+static LOOPBACK_BROKER_PublishCallback_t PublishCallback = NULL;
+
+static uint8 RxBuf[BROKER_PACKET_MAX_LEN];
+static uint8 TxBuf[BROKER_PACKET_MAX_LEN];
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Start
+**
+*/
+bool LOOPBACK_BROKER_Start(uint16 *Port, LOOPBACK_BROKER_PublishCallback_t PublishCallbackFunc)
+{
+
+   struct sockaddr_in Addr;
+   socklen_t AddrLen = sizeof(Addr);
+   int i;
+
+   PublishCallback = PublishCallbackFunc;
+   for (i = 0; i < BROKER_SHARD_CONN_MAX; i++)
+   {
+      ShardFd[i] = -1;
+   }
+
+   ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+   if (ListenFd < 0)
+   {
+      perror("loopback broker socket");
+      return false;
+   }
+
+   memset(&Addr, 0, sizeof(Addr));
+   Addr.sin_family      = AF_INET;
+   Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   Addr.sin_port        = 0;
+
+   if (bind(ListenFd, (struct sockaddr *)&Addr, sizeof(Addr)) < 0 ||
+       listen(ListenFd, BROKER_SHARD_CONN_MAX + 1) < 0 ||
+       getsockname(ListenFd, (struct sockaddr *)&Addr, &AddrLen) < 0)
+   {
+      perror("loopback broker listen");
+      close(ListenFd);
+      return false;
+   }
+
+   *Port   = ntohs(Addr.sin_port);
+   Running = true;
+
+   if (pthread_create(&ListenThread, NULL, AcceptThread, NULL) != 0)
+   {
+      perror("loopback broker thread");
+      Running = false;
+      close(ListenFd);
+      return false;
+   }
+
+   return true;
+
+} /* End LOOPBACK_BROKER_Start() */
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_ConnectCnt
+**
+*/
+uint32 LOOPBACK_BROKER_ConnectCnt(void)
+{
+
+   return __atomic_load_n(&ConnectCnt, __ATOMIC_ACQUIRE);
+
+} /* End LOOPBACK_BROKER_ConnectCnt() */
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Publish
+**
+** Notes:
+**   1. An MQTT 5 client is sent topic aliases up to the client's Topic
+**      Alias Maximum.
+**
+*/
+bool LOOPBACK_BROKER_Publish(const char *Topic, const char *Payload, uint32 PayloadLen)
+{
+
+   bool   RetStatus;
+   bool   AliasOnly = false;
+   uint8  Props[3];
+   uint16 Alias     = 0;
+   uint32 PropLen   = 0;
+   uint32 TopicLen  = strlen(Topic);
+   uint32 RemLen;
+   uint32 Len       = 0;
+   uint32 i;
+
+   if ((2 + TopicLen + 4 + PayloadLen + 5) > BROKER_PACKET_MAX_LEN)
+   {
+      return false;
+   }
+
+   pthread_mutex_lock(&WriteMutex);
+
+   if (ProtocolLevel == 5)
+   {
+      for (i = 0; i < OutAliasCnt; i++)
+      {
+         if (strcmp(OutAlias[i], Topic) == 0)
+         {
+            Alias     = i + 1;
+            AliasOnly = true;
+            break;
+         }
+      }
+      if (Alias == 0 && OutAliasCnt < ClientTopicAliasMax && TopicLen < BROKER_TOPIC_MAX_LEN)
+      {
+         strcpy(OutAlias[OutAliasCnt++], Topic);
+         Alias = OutAliasCnt;
+      }
+      if (Alias > 0)
+      {
+         Props[PropLen++] = 0x23;
+         Props[PropLen++] = (uint8)(Alias >> 8);
+         Props[PropLen++] = (uint8)Alias;
+      }
+      if (AliasOnly)
+      {
+         TopicLen = 0;
+      }
+   }
+
+   RemLen = 2 + TopicLen + PayloadLen + (ProtocolLevel == 5 ? 1 + PropLen : 0);
+
+   TxBuf[Len++] = (BROKER_PUBLISH << 4);
+   do
+   {
+      TxBuf[Len] = RemLen & 0x7F;
+      RemLen >>= 7;
+      if (RemLen > 0)
+      {
+         TxBuf[Len] |= 0x80;
+      }
+      Len++;
+   } while (RemLen > 0);
+
+   TxBuf[Len++] = (uint8)(TopicLen >> 8);
+   TxBuf[Len++] = (uint8)TopicLen;
+   memcpy(&TxBuf[Len], Topic, TopicLen);
+   Len += TopicLen;
+   if (ProtocolLevel == 5)
+   {
+      TxBuf[Len++] = (uint8)PropLen;
+      memcpy(&TxBuf[Len], Props, PropLen);
+      Len += PropLen;
+   }
+   memcpy(&TxBuf[Len], Payload, PayloadLen);
+   Len += PayloadLen;
+
+   RetStatus = WriteFull(ClientFd, TxBuf, Len);
+
+   pthread_mutex_unlock(&WriteMutex);
+
+   return RetStatus;
+
+} /* End LOOPBACK_BROKER_Publish() */
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Stop
+**
+*/
+void LOOPBACK_BROKER_Stop(void)
+{
+
+   int i;
+
+   if (Running)
+   {
+      Running = false;
+      shutdown(ListenFd, SHUT_RDWR);
+      pthread_join(ListenThread, NULL);
+
+      pthread_mutex_lock(&WriteMutex);
+      if (ClientFd >= 0)
+      {
+         shutdown(ClientFd, SHUT_RDWR);
+      }
+      for (i = 0; i < BROKER_SHARD_CONN_MAX; i++)
+      {
+         if (ShardFd[i] >= 0)
+         {
+            shutdown(ShardFd[i], SHUT_RDWR);
+         }
+      }
+      pthread_mutex_unlock(&WriteMutex);
+
+      if (RxThreadCreated)
+      {
+         pthread_join(RxThread, NULL);
+      }
+      for (i = 0; i < BROKER_SHARD_CONN_MAX; i++)
+      {
+         if (ShardRxThreadCreated[i])
+         {
+            pthread_join(ShardRxThread[i], NULL);
+         }
+      }
+      close(ListenFd);
+   }
+
+} /* End LOOPBACK_BROKER_Stop() */
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_SubscriptionCnt
+**
+*/
+uint32 LOOPBACK_BROKER_SubscriptionCnt(void)
+{
+
+   return __atomic_load_n(&SubscriptionCnt, __ATOMIC_ACQUIRE);
+
+} /* End LOOPBACK_BROKER_SubscriptionCnt() */
+
+
+/******************************************************************************
+** Function: AcceptThread
+**
+** Accept clients until LOOPBACK_BROKER_Stop() is called. A connection made
+** while no primary client is connected becomes the primary client served by
+** ReceiveThread(), others are served by a ShardThread().
+**
+** Notes:
+**   1. A connection with the primary client's client ID takes over from the
+**      primary connection like an MQTT broker does. A client that reconnects
+**      immediately can connect before the broker sees its old connection
+**      close.
+**
+*/
+static void *AcceptThread(void *Arg)
+{
+
+   int  Fd;
+   int  NoDelay = 1;
+   int  Slot;
+   bool Primary;
+   char ClientId[BROKER_TOPIC_MAX_LEN];
+
+   while (Running)
+   {
+
+      Fd = accept(ListenFd, NULL, NULL);
+      if (Fd < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+
+      pthread_mutex_lock(&WriteMutex);
+      Primary = (ClientFd < 0);
+      pthread_mutex_unlock(&WriteMutex);
+      
+      if (!Primary && PeekClientId(Fd, ClientId, sizeof(ClientId)))
+      {
+         pthread_mutex_lock(&WriteMutex);
+         Primary = (strcmp(ClientId, PrimaryClientId) == 0);
+         if (Primary && ClientFd >= 0)
+         {
+            shutdown(ClientFd, SHUT_RDWR);
+         }
+         pthread_mutex_unlock(&WriteMutex);
+      }
+
+      if (Primary)
+      {
+         /* The previous primary thread clears ClientFd when it finishes */
+         if (RxThreadCreated)
+         {
+            pthread_join(RxThread, NULL);
+         }
+         pthread_mutex_lock(&WriteMutex);
+         ClientFd = Fd;
+         pthread_mutex_unlock(&WriteMutex);
+         RxThreadCreated = (pthread_create(&RxThread, NULL, ReceiveThread, (void *)(long)Fd) == 0);
+         if (!RxThreadCreated)
+         {
+            perror("loopback broker receive thread");
+            pthread_mutex_lock(&WriteMutex);
+            ClientFd = -1;
+            pthread_mutex_unlock(&WriteMutex);
+            close(Fd);
+         }
+         continue;
+      }
+      
+      pthread_mutex_lock(&WriteMutex);
+      for (Slot = 0; Slot < BROKER_SHARD_CONN_MAX && ShardFd[Slot] >= 0; Slot++);
+      if (Slot < BROKER_SHARD_CONN_MAX)
+      {
+         ShardFd[Slot] = Fd;
+      }
+      pthread_mutex_unlock(&WriteMutex);
+
+      if (Slot < BROKER_SHARD_CONN_MAX)
+      {
+         if (ShardRxThreadCreated[Slot])
+         {
+            pthread_join(ShardRxThread[Slot], NULL);
+         }
+         ShardRxThreadCreated[Slot] = (pthread_create(&ShardRxThread[Slot], NULL, ShardThread,
+                                                      (void *)(long)Slot) == 0);
+         if (!ShardRxThreadCreated[Slot])
+         {
+            perror("loopback broker shard thread");
+            pthread_mutex_lock(&WriteMutex);
+            ShardFd[Slot] = -1;
+            pthread_mutex_unlock(&WriteMutex);
+            close(Fd);
+         }
+      }
+      else
+      {
+         fprintf(stderr, "loopback broker: more than %d additional connections\n", BROKER_SHARD_CONN_MAX);
+         close(Fd);
+      }
+
+   } /* End while running */
+
+   return NULL;
+
+} /* End AcceptThread() */
+
+
+/******************************************************************************
+** Function: PeekClientId
+**
+** Read a new connection's client ID from its CONNECT without removing the
+** packet from the socket. Returns false if the CONNECT doesn't arrive within
+** BROKER_CONNECT_WAIT_MS or is malformed.
+**
+*/
+static bool PeekClientId(int Fd, char *ClientId, uint32 ClientIdLen)
+{
+
+   uint8   Buf[BROKER_TOPIC_MAX_LEN + 32];
+   ssize_t Len;
+   uint32  RemLen;
+   uint32  PropLen;
+   uint32  BodyLen;
+   uint32  Offset;
+   uint32  VarLen;
+   uint16  IdLen;
+   uint8  *Body;
+   int     i;
+
+   for (i = 0; i < BROKER_CONNECT_WAIT_MS; i++)
+   {
+      Len = recv(Fd, Buf, sizeof(Buf), MSG_PEEK | MSG_DONTWAIT);
+      if (Len == 0 || (Len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      {
+         return false;
+      }
+      if (Len > 1 && (Buf[0] >> 4) == BROKER_CONNECT)
+      {
+         VarLen  = ReadVarInt(&Buf[1], Len - 1, &RemLen);
+         Body    = &Buf[1 + VarLen];
+         BodyLen = Len - 1 - VarLen;
+         Offset  = 10;
+         if (VarLen > 0 && BodyLen > Offset)
+         {
+            /* MQTT 5 properties follow the keepalive */
+            PropLen = 0;
+            VarLen  = (Body[6] == 5) ? ReadVarInt(&Body[Offset], BodyLen - Offset, &PropLen) : 0;
+            Offset += VarLen + PropLen;
+            if ((Body[6] != 5 || VarLen > 0) && (Offset + 2) <= BodyLen)
+            {
+               IdLen = (Body[Offset] << 8) | Body[Offset + 1];
+               if (IdLen >= ClientIdLen)
+               {
+                  return false;
+               }
+               if ((Offset + 2 + IdLen) <= BodyLen)
+               {
+                  memcpy(ClientId, &Body[Offset + 2], IdLen);
+                  ClientId[IdLen] = '\0';
+                  return true;
+               }
+            }
+         }
+      }
+      usleep(1000);
+   }
+
+   return false;
+
+} /* End PeekClientId() */
+
+
+/******************************************************************************
+** Function: ProcessPacket
+**
+** Returns false if the connection should be closed.
+**
+** Notes:
+**   1. MQTT 5 acknowledgements are sent without reason codes or properties
+**      except where they're required, which is the same as success.
+**
+*/
+static bool ProcessPacket(uint8 Type, uint8 Flags, uint8 *Body, uint32 BodyLen)
+{
+
+   uint8  ConnAccepted[2] = { 0, 0 };
+   uint8  ConnAccepted5[9] = { 0, 0, 6, 0x22, 0, BROKER_TOPIC_ALIAS_MAX,
+                               0x21, (uint8)(BROKER_RECEIVE_MAX >> 8), (uint8)BROKER_RECEIVE_MAX };
+   bool   SessionPresent;
+
+   bool   RetStatus = true;
+   uint8  Qos;
+   uint8  AckData[1 + BROKER_SUB_FILTER_MAX];   /* MQTT 5 property length and a code per filter */
+   uint16 TopicLen;
+   uint16 PacketId = 0;
+   uint32 Offset;
+   uint32 AckLen;
+   uint32 FilterCnt;
+   char   Topic[BROKER_TOPIC_MAX_LEN];
+   BROKER_Props_t Props;
+
+   switch (Type)
+   {
+
+      case BROKER_CONNECT:
+         /* Protocol name "MQTT" is followed by the level, flags and keepalive */
+         if (BodyLen < 10)
+         {
+            RetStatus = false;
+            break;
+         }
+         pthread_mutex_lock(&WriteMutex);
+         ProtocolLevel       = Body[6];
+         ClientTopicAliasMax = 0;
+         OutAliasCnt         = 0;
+         pthread_mutex_unlock(&WriteMutex);
+         memset(InAlias, 0, sizeof(InAlias));
+         Offset = 10;
+         if (ProtocolLevel == 5 && !ReadProperties(Body, BodyLen, &Offset, &Props))
+         {
+            RetStatus = false;
+            break;
+         }
+         /* Client ID is the first payload field */
+         TopicLen = (Body[Offset] << 8) | Body[Offset + 1];
+         if ((Offset + 2 + TopicLen) > BodyLen || TopicLen >= sizeof(Topic))
+         {
+            RetStatus = false;
+            break;
+         }
+         memcpy(Topic, &Body[Offset + 2], TopicLen);
+         Topic[TopicLen] = '\0';
+         pthread_mutex_lock(&WriteMutex);
+         strcpy(PrimaryClientId, Topic);
+         pthread_mutex_unlock(&WriteMutex);
+         SessionPresent = ((Body[7] & 0x02) == 0 && strcmp(Topic, SessionClientId) == 0);
+         strcpy(SessionClientId, ((Body[7] & 0x02) == 0) ? Topic : "");
+         if (!SessionPresent)
+         {
+            __atomic_store_n(&SubscriptionCnt, 0, __ATOMIC_RELEASE);
+         }
+         ConnAccepted[0]  = SessionPresent ? 1 : 0;
+         ConnAccepted5[0] = SessionPresent ? 1 : 0;
+         if (ProtocolLevel == 5)
+         {
+            pthread_mutex_lock(&WriteMutex);
+            ClientTopicAliasMax = (Props.TopicAliasMax < BROKER_TOPIC_ALIAS_MAX) ? 
+                                  Props.TopicAliasMax : BROKER_TOPIC_ALIAS_MAX;
+            pthread_mutex_unlock(&WriteMutex);
+            RetStatus = SendAck(ClientFd, BROKER_CONNACK, 0, ConnAccepted5, sizeof(ConnAccepted5));
+         }
+         else
+         {
+            RetStatus = SendAck(ClientFd, BROKER_CONNACK, 0, ConnAccepted, sizeof(ConnAccepted));
+         }
+         __atomic_fetch_add(&ConnectCnt, 1, __ATOMIC_RELEASE);
+         break;
+
+      case BROKER_PUBLISH:
+         Qos = (Flags >> 1) & 0x03;
+         if (BodyLen < 2)
+         {
+            RetStatus = false;
+            break;
+         }
+         TopicLen = (Body[0] << 8) | Body[1];
+         Offset   = 2 + TopicLen;
+         if (Qos > 0)
+         {
+            PacketId = (Body[Offset] << 8) | Body[Offset + 1];
+            Offset  += 2;
+         }
+         if (Offset > BodyLen || TopicLen >= sizeof(Topic))
+         {
+            RetStatus = false;
+            break;
+         }
+         memcpy(Topic, &Body[2], TopicLen);
+         Topic[TopicLen] = '\0';
+         if (ProtocolLevel == 5)
+         {
+            if (!ReadProperties(Body, BodyLen, &Offset, &Props) || Props.TopicAlias > BROKER_TOPIC_ALIAS_MAX)
+            {
+               RetStatus = false;
+               break;
+            }
+            if (Props.TopicAlias > 0)
+            {
+               if (TopicLen > 0)
+               {
+                  strcpy(InAlias[Props.TopicAlias - 1], Topic);
+               }
+               else
+               {
+                  strcpy(Topic, InAlias[Props.TopicAlias - 1]);
+               }
+            }
+            if (Topic[0] == '\0')
+            {
+               fprintf(stderr, "loopback broker: PUBLISH without a topic name or known alias\n");
+               RetStatus = false;
+               break;
+            }
+         }
+         if (PublishCallback != NULL)
+         {
+            PublishCallback(Topic, &Body[Offset], BodyLen - Offset);
+         }
+         if (Qos == 1)
+         {
+            RetStatus = SendAck(ClientFd, BROKER_PUBACK, PacketId, NULL, 0);
+         }
+         else if (Qos == 2)
+         {
+            RetStatus = SendAck(ClientFd, BROKER_PUBREC, PacketId, NULL, 0);
+         }
+         break;
+
+      case BROKER_PUBREL:
+         PacketId  = (Body[0] << 8) | Body[1];
+         RetStatus = SendAck(ClientFd, BROKER_PUBCOMP, PacketId, NULL, 0);
+         break;
+
+      case BROKER_SUBSCRIBE:
+      case BROKER_UNSUBSCRIBE:
+         /* Grant QoS 0 to every filter, only QoS 0 is ever sent */
+         PacketId = (Body[0] << 8) | Body[1];
+         Offset   = 2;
+         AckLen   = 0;
+         if (ProtocolLevel == 5)
+         {
+            if (!ReadProperties(Body, BodyLen, &Offset, &Props))
+            {
+               RetStatus = false;
+               break;
+            }
+            AckData[AckLen++] = 0;   /* No properties */
+         }
+         for (FilterCnt = 0; Offset + 2 < BodyLen && AckLen < sizeof(AckData); FilterCnt++)
+         {
+            Offset += 2 + ((Body[Offset] << 8) | Body[Offset + 1]) + (Type == BROKER_SUBSCRIBE ? 1 : 0);
+            AckData[AckLen++] = 0;
+         }
+         if (Type == BROKER_SUBSCRIBE)
+         {
+            RetStatus = SendAck(ClientFd, BROKER_SUBACK, PacketId, AckData, AckLen);
+            __atomic_fetch_add(&SubscriptionCnt, 1, __ATOMIC_RELEASE);
+         }
+         else
+         {
+            /* An MQTT 3.1.1 UNSUBACK only has the packet ID */
+            RetStatus = SendAck(ClientFd, BROKER_UNSUBACK, PacketId, AckData, (ProtocolLevel == 5 ? AckLen : 0));
+         }
+         break;
+
+      case BROKER_PINGREQ:
+         RetStatus = SendAck(ClientFd, BROKER_PINGRESP, 0, NULL, 0);
+         break;
+
+      case BROKER_DISCONNECT:
+         RetStatus = false;
+         break;
+
+      default:
+         /* PUBACKs for QoS 0 traffic never arrive, ignore anything else */
+         break;
+
+   } /* End packet type switch */
+
+   return RetStatus;
+
+} /* End ProcessPacket() */
+
+
+/******************************************************************************
+** Function: ProcessShardPacket
+**
+** Process a packet from an additional connection. Returns false if the
+** connection should be closed.
+**
+** Notes:
+**   1. Additional connections are publish-only MQTT 3.1.1 clean sessions.
+**      They don't count as connects in LOOPBACK_BROKER_ConnectCnt().
+**
+*/
+static bool ProcessShardPacket(int Fd, uint8 Type, uint8 Flags, uint8 *Body, uint32 BodyLen)
+{
+
+   uint8  ConnAccepted[2] = { 0, 0 };
+   bool   RetStatus = true;
+   uint16 TopicLen;
+   char   Topic[BROKER_TOPIC_MAX_LEN];
+
+   switch (Type)
+   {
+
+      case BROKER_CONNECT:
+         RetStatus = (BodyLen >= 10 && Body[6] == 4 &&
+                      SendAck(Fd, BROKER_CONNACK, 0, ConnAccepted, sizeof(ConnAccepted)));
+         break;
+
+      case BROKER_PUBLISH:
+         if (((Flags >> 1) & 0x03) != 0 || BodyLen < 2)
+         {
+            fprintf(stderr, "loopback broker: additional connection sent a QoS %d or malformed PUBLISH\n",
+                    (Flags >> 1) & 0x03);
+            RetStatus = false;
+            break;
+         }
+         TopicLen = (Body[0] << 8) | Body[1];
+         if ((2 + TopicLen) > BodyLen || TopicLen >= sizeof(Topic))
+         {
+            RetStatus = false;
+            break;
+         }
+         memcpy(Topic, &Body[2], TopicLen);
+         Topic[TopicLen] = '\0';
+         if (PublishCallback != NULL)
+         {
+            PublishCallback(Topic, &Body[2 + TopicLen], BodyLen - 2 - TopicLen);
+         }
+         break;
+
+      case BROKER_PINGREQ:
+         RetStatus = SendAck(Fd, BROKER_PINGRESP, 0, NULL, 0);
+         break;
+
+      case BROKER_DISCONNECT:
+         RetStatus = false;
+         break;
+
+      default:
+         fprintf(stderr, "loopback broker: additional connection sent unsupported packet type %d\n", Type);
+         RetStatus = false;
+         break;
+
+   } /* End packet type switch */
+
+   return RetStatus;
+
+} /* End ProcessShardPacket() */
+
+
+/******************************************************************************
+** Function: ReadFull
+**
+*/
+static bool ReadFull(int Fd, uint8 *Buf, uint32 Len)
+{
+
+   ssize_t RdLen;
+
+   while (Len > 0)
+   {
+      RdLen = read(Fd, Buf, Len);
+      if (RdLen <= 0)
+      {
+         if (RdLen < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         return false;
+      }
+      Buf += RdLen;
+      Len -= RdLen;
+   }
+
+   return true;
+
+} /* End ReadFull() */
+
+
+/******************************************************************************
+** Function: ReadPacket
+**
+*/
+static bool ReadPacket(int Fd, uint8 *Header, uint8 *Body, uint32 *BodyLen)
+{
+
+   uint8  Byte;
+   uint32 Multiplier = 1;
+   uint32 RemLen     = 0;
+   int    i;
+
+   if (!ReadFull(Fd, Header, 1))
+   {
+      return false;
+   }
+
+   for (i = 0; i < 4; i++)
+   {
+      if (!ReadFull(Fd, &Byte, 1))
+      {
+         return false;
+      }
+      RemLen += (Byte & 0x7F) * Multiplier;
+      Multiplier <<= 7;
+      if ((Byte & 0x80) == 0)
+      {
+         break;
+      }
+   }
+
+   if (RemLen > BROKER_PACKET_MAX_LEN)
+   {
+      fprintf(stderr, "loopback broker: %u byte packet exceeds the %u byte buffer\n",
+              RemLen, BROKER_PACKET_MAX_LEN);
+      return false;
+   }
+
+   *BodyLen = RemLen;
+
+   return ReadFull(Fd, Body, RemLen);
+
+} /* End ReadPacket() */
+
+
+/******************************************************************************
+** Function: ReadProperties
+**
+** Read an MQTT 5 property section starting at Offset and advance Offset
+** past it. Returns false if the section is malformed.
+**
+*/
+static bool ReadProperties(const uint8 *Body, uint32 BodyLen, uint32 *Offset, BROKER_Props_t *Props)
+{
+
+   uint32 Len;
+   uint32 PropLen;
+   uint32 PropEnd;
+   uint32 Value;
+   uint32 i;
+   uint8  Id;
+
+   memset(Props, 0, sizeof(BROKER_Props_t));
+
+   Len = ReadVarInt(&Body[*Offset], BodyLen - *Offset, &PropLen);
+   if (Len == 0 || (*Offset + Len + PropLen) > BodyLen)
+   {
+      return false;
+   }
+   i       = *Offset + Len;
+   PropEnd = i + PropLen;
+
+   while (i < PropEnd)
+   {
+      Id = Body[i++];
+      switch (Id)
+      {
+         case 0x01: case 0x17: case 0x19: case 0x24:
+         case 0x25: case 0x28: case 0x29: case 0x2A:
+            i += 1;
+            break;
+         case 0x13: case 0x21:
+            i += 2;
+            break;
+         case 0x22:
+            Props->TopicAliasMax = (Body[i] << 8) | Body[i + 1];
+            i += 2;
+            break;
+         case 0x23:
+            Props->TopicAlias = (Body[i] << 8) | Body[i + 1];
+            i += 2;
+            break;
+         case 0x02: case 0x11: case 0x18: case 0x27:
+            i += 4;
+            break;
+         case 0x0B:
+            Len = ReadVarInt(&Body[i], PropEnd - i, &Value);
+            if (Len == 0)
+            {
+               return false;
+            }
+            i += Len;
+            break;
+         case 0x26:
+            i += 2 + ((Body[i] << 8) | Body[i + 1]);
+            if (i + 2 > PropEnd)
+            {
+               return false;
+            }
+            i += 2 + ((Body[i] << 8) | Body[i + 1]);
+            break;
+         case 0x03: case 0x08: case 0x09: case 0x12: case 0x15:
+         case 0x16: case 0x1A: case 0x1C: case 0x1F:
+            i += 2 + ((Body[i] << 8) | Body[i + 1]);
+            break;
+         default:
+            return false;
+      }
+   }
+
+   *Offset = PropEnd;
+
+   return (i == PropEnd);
+
+} /* End ReadProperties() */
+
+
+/******************************************************************************
+** Function: ReadVarInt
+**
+** Return the length of a variable byte integer or zero if it's malformed.
+**
+*/
+static uint32 ReadVarInt(const uint8 *Buf, uint32 Len, uint32 *Value)
+{
+
+   uint32 i = 0;
+
+   *Value = 0;
+   do
+   {
+      if (i >= Len || i >= 4)
+      {
+         return 0;
+      }
+      *Value |= (uint32)(Buf[i] & 0x7F) << (7 * i);
+   } while ((Buf[i++] & 0x80) != 0);
+
+   return i;
+
+} /* End ReadVarInt() */
+
+
+/******************************************************************************
+** Function: ReceiveThread
+**
+** Process the primary client's packets until it disconnects.
+**
+*/
+static void *ReceiveThread(void *Arg)
+{
+
+   int    Fd = (int)(long)Arg;
+   uint8  Header;
+   uint32 BodyLen;
+
+   while (ReadPacket(Fd, &Header, RxBuf, &BodyLen))
+   {
+      if (!ProcessPacket(Header >> 4, Header & 0x0F, RxBuf, BodyLen))
+      {
+         break;
+      }
+   }
+
+   pthread_mutex_lock(&WriteMutex);
+   ClientFd = -1;
+   pthread_mutex_unlock(&WriteMutex);
+   close(Fd);
+
+   return NULL;
+
+} /* End ReceiveThread() */
+
+
+/******************************************************************************
+** Function: SendAck
+**
+** Send a packet with an optional packet ID followed by optional data. A zero
+** PacketId is omitted because it's only used by packets without one.
+**
+*/
+static bool SendAck(int Fd, uint8 Type, uint16 PacketId, const uint8 *Data, uint32 DataLen)
+{
+
+   bool  RetStatus;
+   uint8 Packet[5 + BROKER_SUB_FILTER_MAX];   /* Remaining length stays in one byte */
+   uint32 Len = 2;
+
+   if (PacketId != 0)
+   {
+      Packet[Len++] = (uint8)(PacketId >> 8);
+      Packet[Len++] = (uint8)PacketId;
+   }
+   if (DataLen > 0)
+   {
+      memcpy(&Packet[Len], Data, DataLen);
+      Len += DataLen;
+   }
+   Packet[0] = (Type << 4);
+   Packet[1] = (uint8)(Len - 2);
+
+   pthread_mutex_lock(&WriteMutex);
+   RetStatus = WriteFull(Fd, Packet, Len);
+   pthread_mutex_unlock(&WriteMutex);
+
+   return RetStatus;
+
+} /* End SendAck() */
+
+
+/******************************************************************************
+** Function: ShardThread
+**
+** Process an additional connection's packets until it disconnects.
+**
+*/
+static void *ShardThread(void *Arg)
+{
+
+   int    Slot = (int)(long)Arg;
+   int    Fd   = ShardFd[Slot];
+   uint8  Header;
+   uint32 BodyLen;
+
+   while (ReadPacket(Fd, &Header, ShardRxBuf[Slot], &BodyLen))
+   {
+      if (!ProcessShardPacket(Fd, Header >> 4, Header & 0x0F, ShardRxBuf[Slot], BodyLen))
+      {
+         break;
+      }
+   }
+
+   pthread_mutex_lock(&WriteMutex);
+   ShardFd[Slot] = -1;
+   pthread_mutex_unlock(&WriteMutex);
+   close(Fd);
+
+   return NULL;
+
+} /* End ShardThread() */
+
+
+/******************************************************************************
+** Function: WriteFull
+**
+** Notes:
+**   1. Caller must hold WriteMutex.
+**
+*/
+static bool WriteFull(int Fd, const uint8 *Buf, uint32 Len)
+{
+
+   ssize_t WrLen;
+
+   if (Fd < 0)
+   {
+      return false;
+   }
+
+   while (Len > 0)
+   {
+      WrLen = send(Fd, Buf, Len, MSG_NOSIGNAL);
+      if (WrLen < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return false;
+      }
+      Buf += WrLen;
+      Len -= WrLen;
+   }
+
+   return true;
+
+} /* End WriteFull() */
@@ -0,0 +1,125 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Minimal MQTT 3.1.1 and MQTT 5 broker stand-in on the loopback interface
+**
+** Notes:
+**   1. One primary client connection is served at a time by a receive
+**      thread. PUBLISH packets from the client are passed to the publish
+**      callback and acknowledged when sent with QoS 1. Subscriptions are
+**      recorded but not matched, LOOPBACK_BROKER_Publish() always sends to
+**      the primary client.
+**   2. QoS 1 and QoS 2 PUBLISH packets from the client are acknowledged
+**      immediately. Retained messages aren't stored.
+**   3. An MQTT 5 client is granted BROKER_TOPIC_ALIAS_MAX topic aliases and
+**      a Receive Maximum of BROKER_RECEIVE_MAX. Aliases are used in both
+**      directions. Message expiry is accepted and ignored.
+**   4. A client that connects without a clean session using the previous
+**      connection's client ID resumes its session. The CONNACK's session
+**      present flag is set and the subscriptions are kept. Messages aren't
+**      queued while the client is disconnected.
+**   5. The listening socket is created by LOOPBACK_BROKER_Start() so a
+**      client can connect as soon as it returns.
+**   6. A connection made while the primary client is connected is an
+**      additional publish-only MQTT 3.1.1 connection, like the gateway's
+**      publish shards, with its own thread, unless it connects with the
+**      primary client's client ID. That connection replaces the primary
+**      connection. It's only sent CONNACK and
+**      PINGRESP packets and its QoS 0 PUBLISH packets are passed to the
+**      publish callback, so the callback may be called by several threads
+**      at once.
+**
+*/
+#ifndef _loopback_broker_
+#define _loopback_broker_
+
+/*
+** Includes
+*/
+
+#include "app_c_fw.h"
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** Called by a receive thread for each PUBLISH received from a client.
+** Payload isn't NUL terminated.
+*/
+
+typedef void (*LOOPBACK_BROKER_PublishCallback_t)(const char *Topic, const uint8 *Payload, uint32 PayloadLen);
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Start
+**
+** Listen on an ephemeral 127.0.0.1 port and start the accept thread.
+** Returns false if the socket or thread can't be created.
+**
+*/
+bool LOOPBACK_BROKER_Start(uint16 *Port, LOOPBACK_BROKER_PublishCallback_t PublishCallback);
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_ConnectCnt
+**
+** Return the number of CONNECT packets accepted from the primary client
+** since the broker started.
+**
+*/
+uint32 LOOPBACK_BROKER_ConnectCnt(void);
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Publish
+**
+** Send a QoS 0 PUBLISH to the connected client. Returns false if no client
+** is connected or the write fails.
+**
+** Notes:
+**   1. The write blocks while the client's socket buffer is full so a
+**      publisher is paced by the client.
+**
+*/
+bool LOOPBACK_BROKER_Publish(const char *Topic, const char *Payload, uint32 PayloadLen);
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_Stop
+**
+** Close the sockets and join the receive threads.
+**
+*/
+void LOOPBACK_BROKER_Stop(void);
+
+
+/******************************************************************************
+** Function: LOOPBACK_BROKER_SubscriptionCnt
+**
+** Return the number of SUBSCRIBE packets received in the current session.
+**
+*/
+uint32 LOOPBACK_BROKER_SubscriptionCnt(void);
+
+
+#endif /* _loopback_broker_ */
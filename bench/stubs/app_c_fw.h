@@ -0,0 +1,315 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Host-native stand-in for the cFE, OSAL and app_c_fw APIs used by the
+**   JMSG_MQTT gateway objects
+**
+** Notes:
+**   1. Only the subset of each API used by the gateway objects compiled into
+**      the benchmark is declared. Types keep their cFE names but not their
+**      layouts, no message is ever exchanged with a real cFE.
+**   2. The INITBL, SB and EVS stubs in cfe_stubs.c have bench hooks declared
+**      at the end of this file.
+**
+*/
+#ifndef _app_c_fw_
+#define _app_c_fw_
+
+/*
+** Includes
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** OSAL
+*/
+
+#define OS_SUCCESS              0
+#define OS_ERROR              (-1)
+#define OS_ERR_NO_FREE_IDS   (-21)
+#define OS_MAX_PATH_LEN        64
+#define OS_MAX_API_NAME        20
+
+#define OS_FILE_FLAG_NONE       0x00
+#define OS_FILE_FLAG_CREATE     0x01
+#define OS_FILE_FLAG_TRUNCATE   0x02
+#define OS_READ_ONLY            0
+#define OS_WRITE_ONLY           1
+#define OS_READ_WRITE           2
+
+/*
+** cFE
+*/
+
+#define CFE_SUCCESS             0
+#define CFE_SB_BAD_ARGUMENT   (-1)
+#define CFE_SB_TIME_OUT       (-2)
+#define CFE_SB_NO_MESSAGE     (-3)
+#define CFE_SB_PIPE_RD_ERR    (-4)
+
+#define CFE_SB_PEND_FOREVER   (-1)
+#define CFE_SB_POLL             0
+#define CFE_SB_INVALID_MSG_ID   0
+
+#define CFE_EVS_EventType_DEBUG        1
+#define CFE_EVS_EventType_INFORMATION  2
+#define CFE_EVS_EventType_ERROR        3
+#define CFE_EVS_EventType_CRITICAL     4
+
+#define CFE_MSG_PTR(Hdr)  ((CFE_MSG_Message_t *)&(Hdr))
+
+/*
+** app_c_fw
+*/
+
+#define APP_C_FW_APP_BASE_EID  100
+
+#define CMDMGR_PAYLOAD_PTR(MsgPtr, MsgType)  (&((const MsgType *)(MsgPtr))->Payload)
+
+#define INITBL_CONFIG_ENUM(Name, Type)  Name,
+#define DECLARE_ENUM(EnumName, ConfigList) \
+   typedef enum { EnumName##_UNDEF = 0, ConfigList(INITBL_CONFIG_ENUM) EnumName##_CNT } EnumName##_Enum_t;
+#define DEFINE_ENUM(EnumName, ConfigList)
+
+/* Upper bound of the config enums declared with DECLARE_ENUM() */
+#define INITBL_BENCH_CONFIG_MAX  128
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef uint8_t   uint8;
+typedef uint16_t  uint16;
+typedef uint32_t  uint32;
+typedef uint64_t  uint64;
+typedef int8_t    int8;
+typedef int16_t   int16;
+typedef int32_t   int32;
+typedef int64_t   int64;
+
+typedef uint32  osal_id_t;
+
+typedef struct
+{
+
+   uint32  Seconds;
+   uint32  Subseconds;
+
+} CFE_TIME_SysTime_t;
+
+typedef enum
+{
+
+   CFE_TIME_A_LT_B = -1,
+   CFE_TIME_EQUAL  =  0,
+   CFE_TIME_A_GT_B =  1
+
+} CFE_TIME_Compare_t;
+
+typedef uint32  CFE_SB_MsgId_t;
+typedef uint32  CFE_SB_PipeId_t;
+typedef size_t  CFE_MSG_Size_t;
+
+typedef enum
+{
+
+   CFE_MSG_Type_Invalid = 0,
+   CFE_MSG_Type_Cmd     = 1,
+   CFE_MSG_Type_Tlm     = 2
+
+} CFE_MSG_Type_t;
+
+typedef struct
+{
+
+   uint8  Priority;
+   uint8  Reliability;
+
+} CFE_SB_Qos_t;
+
+/*
+** Message header. Commands are distinguished from telemetry by the CCSDS
+** packet type bit in the message ID.
+*/
+
+typedef struct
+{
+
+   CFE_SB_MsgId_t      MsgId;
+   uint32              Size;
+   CFE_TIME_SysTime_t  Time;
+
+} CFE_MSG_Message_t;
+
+typedef struct
+{
+
+   CFE_MSG_Message_t  Msg;
+   uint16             FunctionCode;
+   uint16             Spare;
+
+} CFE_MSG_CommandHeader_t;
+
+typedef struct
+{
+
+   CFE_MSG_Message_t  Msg;
+
+} CFE_MSG_TelemetryHeader_t;
+
+typedef union
+{
+
+   CFE_MSG_Message_t  Msg;
+   long double        LongDouble;
+
+} CFE_SB_Buffer_t;
+
+/*
+** app_c_fw
+*/
+
+typedef struct
+{
+
+   uint32       IntConfig[INITBL_BENCH_CONFIG_MAX];
+   const char  *StrConfig[INITBL_BENCH_CONFIG_MAX];
+
+} INITBL_Class_t;
+
+typedef struct
+{
+
+   uint16  ValidCmdCnt;
+   uint16  InvalidCmdCnt;
+
+} CMDMGR_Class_t;
+
+typedef struct
+{
+
+   uint16  ValidCmdCnt;
+   uint16  InvalidCmdCnt;
+
+} CHILDMGR_Class_t;
+
+typedef bool (*CMDMGR_CmdFuncPtr_t)(void *ObjDataPtr, const CFE_MSG_Message_t *MsgPtr);
+
+typedef enum
+{
+
+   APP_C_FW_BooleanUint8_FALSE = 0,
+   APP_C_FW_BooleanUint8_TRUE  = 1
+
+} APP_C_FW_BooleanUint8_Enum_t;
+
+typedef uint8  APP_C_FW_BooleanUint8_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/*
+** cFE
+*/
+
+void   CFE_ES_PerfLogEntry(uint32 Marker);
+void   CFE_ES_PerfLogExit(uint32 Marker);
+
+int32  CFE_EVS_SendEvent(uint16 EventID, uint16 EventType, const char *Spec, ...)
+          __attribute__((format(printf, 3, 4)));
+
+int32  CFE_MSG_GenerateChecksum(CFE_MSG_Message_t *MsgPtr);
+int32  CFE_MSG_GetMsgId(const CFE_MSG_Message_t *MsgPtr, CFE_SB_MsgId_t *MsgId);
+int32  CFE_MSG_GetMsgTime(const CFE_MSG_Message_t *MsgPtr, CFE_TIME_SysTime_t *Time);
+int32  CFE_MSG_GetSize(const CFE_MSG_Message_t *MsgPtr, CFE_MSG_Size_t *Size);
+int32  CFE_MSG_GetType(const CFE_MSG_Message_t *MsgPtr, CFE_MSG_Type_t *Type);
+int32  CFE_MSG_GetTypeFromMsgId(CFE_SB_MsgId_t MsgId, CFE_MSG_Type_t *Type);
+int32  CFE_MSG_Init(CFE_MSG_Message_t *MsgPtr, CFE_SB_MsgId_t MsgId, CFE_MSG_Size_t Size);
+
+void   CFE_PSP_MemSet(void *Dest, uint8 Value, uint32 Size);
+
+int32  CFE_SB_CreatePipe(CFE_SB_PipeId_t *PipeId, uint16 Depth, const char *PipeName);
+uint32 CFE_SB_MsgIdToValue(CFE_SB_MsgId_t MsgId);
+int32  CFE_SB_ReceiveBuffer(CFE_SB_Buffer_t **BufPtr, CFE_SB_PipeId_t PipeId, int32 TimeOut);
+int32  CFE_SB_Subscribe(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId);
+int32  CFE_SB_SubscribeEx(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId, CFE_SB_Qos_t Quality, uint16 MsgLim);
+void   CFE_SB_TimeStampMsg(CFE_MSG_Message_t *MsgPtr);
+int32  CFE_SB_TransmitMsg(CFE_MSG_Message_t *MsgPtr, bool IncrementSequenceCount);
+int32  CFE_SB_Unsubscribe(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId);
+CFE_SB_MsgId_t CFE_SB_ValueToMsgId(uint32 MsgIdValue);
+
+CFE_TIME_Compare_t CFE_TIME_Compare(CFE_TIME_SysTime_t TimeA, CFE_TIME_SysTime_t TimeB);
+CFE_TIME_SysTime_t CFE_TIME_GetTime(void);
+uint32             CFE_TIME_Sub2MicroSecs(uint32 SubSeconds);
+CFE_TIME_SysTime_t CFE_TIME_Subtract(CFE_TIME_SysTime_t Minuend, CFE_TIME_SysTime_t Subtrahend);
+
+/*
+** OSAL
+*/
+
+int32  OS_close(osal_id_t FileDes);
+int32  OS_MutSemCreate(osal_id_t *SemId, const char *SemName, uint32 Options);
+int32  OS_MutSemGive(osal_id_t SemId);
+int32  OS_MutSemTake(osal_id_t SemId);
+int32  OS_OpenCreate(osal_id_t *FileDes, const char *Path, int32 Flags, int32 Access);
+int32  OS_TaskDelay(uint32 Milliseconds);
+int32  OS_write(osal_id_t FileDes, const void *Buffer, size_t Nbytes);
+
+/*
+** app_c_fw
+*/
+
+uint32      INITBL_GetIntConfig(const INITBL_Class_t *IniTbl, uint16 Param);
+const char *INITBL_GetStrConfig(const INITBL_Class_t *IniTbl, uint16 Param);
+
+
+/*****************/
+/** Bench Hooks **/
+/*****************/
+
+
+/*
+** CFE_SB_ReceiveBuffer() returns the message produced by the receive hook,
+** CFE_SB_TransmitMsg() passes each message to the transmit hook.
+*/
+
+typedef int32 (*BENCH_STUB_SbReceiveHook_t)(CFE_SB_Buffer_t **BufPtr, int32 TimeOut);
+typedef void  (*BENCH_STUB_SbTransmitHook_t)(const CFE_MSG_Message_t *MsgPtr);
+
+void   BENCH_STUB_SetIntConfig(INITBL_Class_t *IniTbl, uint16 Param, uint32 Value);
+void   BENCH_STUB_SetSbHooks(BENCH_STUB_SbReceiveHook_t ReceiveHook, BENCH_STUB_SbTransmitHook_t TransmitHook);
+void   BENCH_STUB_SetStrConfig(INITBL_Class_t *IniTbl, uint16 Param, const char *Value);
+void   BENCH_STUB_SetVerbose(bool Verbose);
+uint32 BENCH_STUB_EventErrCnt(void);
+uint64 BENCH_STUB_TimeNs(void);
+
+
+#endif /* _app_c_fw_ */
@@ -0,0 +1,393 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Host-native implementation of the cFE, OSAL and app_c_fw stubs
+**
+** Notes:
+**   1. See app_c_fw.h
+**   2. cFE time is CLOCK_MONOTONIC with subseconds in units of 2^-32
+**      seconds so the gateway's latency arithmetic runs unchanged.
+**   3. SB subscriptions are accepted and ignored. The bench decides which
+**      messages are received through the SB hooks.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "app_c_fw.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define STUB_MUT_SEM_MAX  8
+
+/* Bit 12 of a CCSDS primary header identifies a command packet */
+#define STUB_MSG_ID_CMD_BIT  0x1000
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static bool   Verbose     = false;
+static uint32 EventErrCnt = 0;
+
+static BENCH_STUB_SbReceiveHook_t  SbReceiveHook  = NULL;
+static BENCH_STUB_SbTransmitHook_t SbTransmitHook = NULL;
+
+static uint32          MutSemCnt = 0;
+static pthread_mutex_t MutSem[STUB_MUT_SEM_MAX];
+
+
+/******************************************************************************
+** Bench Hooks
+*/
+
+uint32 BENCH_STUB_EventErrCnt(void)
+{
+   return __atomic_load_n(&EventErrCnt, __ATOMIC_RELAXED);
+}
+
+void BENCH_STUB_SetIntConfig(INITBL_Class_t *IniTbl, uint16 Param, uint32 Value)
+{
+   IniTbl->IntConfig[Param] = Value;
+}
+
+void BENCH_STUB_SetSbHooks(BENCH_STUB_SbReceiveHook_t ReceiveHook, BENCH_STUB_SbTransmitHook_t TransmitHook)
+{
+   SbReceiveHook  = ReceiveHook;
+   SbTransmitHook = TransmitHook;
+}
+
+void BENCH_STUB_SetStrConfig(INITBL_Class_t *IniTbl, uint16 Param, const char *Value)
+{
+   IniTbl->StrConfig[Param] = Value;
+}
+
+void BENCH_STUB_SetVerbose(bool VerboseFlag)
+{
+   Verbose = VerboseFlag;
+}
+
+uint64 BENCH_STUB_TimeNs(void)
+{
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return ((uint64)Now.tv_sec * 1000000000ULL) + (uint64)Now.tv_nsec;
+}
+
+
+/******************************************************************************
+** cFE Executive Services
+*/
+
+void CFE_ES_PerfLogEntry(uint32 Marker)
+{
+}
+
+void CFE_ES_PerfLogExit(uint32 Marker)
+{
+}
+
+
+/******************************************************************************
+** cFE Event Services
+**
+** Errors are counted and only printed in verbose mode, informational events
+** would otherwise dominate the measurement.
+*/
+
+int32 CFE_EVS_SendEvent(uint16 EventID, uint16 EventType, const char *Spec, ...)
+{
+
+   va_list Args;
+
+   if (EventType >= CFE_EVS_EventType_ERROR)
+   {
+      __atomic_fetch_add(&EventErrCnt, 1, __ATOMIC_RELAXED);
+   }
+
+   if (Verbose)
+   {
+      fprintf(stderr, "EVS %3u %s: ", EventID, (EventType >= CFE_EVS_EventType_ERROR) ? "ERR " : "INFO");
+      va_start(Args, Spec);
+      vfprintf(stderr, Spec, Args);
+      va_end(Args);
+      fputc('\n', stderr);
+   }
+
+   return CFE_SUCCESS;
+
+} /* End CFE_EVS_SendEvent() */
+
+
+/******************************************************************************
+** cFE Message Services
+*/
+
+int32 CFE_MSG_GenerateChecksum(CFE_MSG_Message_t *MsgPtr)
+{
+   return CFE_SUCCESS;
+}
+
+int32 CFE_MSG_GetMsgId(const CFE_MSG_Message_t *MsgPtr, CFE_SB_MsgId_t *MsgId)
+{
+   *MsgId = MsgPtr->MsgId;
+   return CFE_SUCCESS;
+}
+
+int32 CFE_MSG_GetMsgTime(const CFE_MSG_Message_t *MsgPtr, CFE_TIME_SysTime_t *Time)
+{
+   *Time = MsgPtr->Time;
+   return CFE_SUCCESS;
+}
+
+int32 CFE_MSG_GetSize(const CFE_MSG_Message_t *MsgPtr, CFE_MSG_Size_t *Size)
+{
+   *Size = MsgPtr->Size;
+   return CFE_SUCCESS;
+}
+
+int32 CFE_MSG_GetType(const CFE_MSG_Message_t *MsgPtr, CFE_MSG_Type_t *Type)
+{
+   return CFE_MSG_GetTypeFromMsgId(MsgPtr->MsgId, Type);
+}
+
+int32 CFE_MSG_GetTypeFromMsgId(CFE_SB_MsgId_t MsgId, CFE_MSG_Type_t *Type)
+{
+   *Type = (MsgId & STUB_MSG_ID_CMD_BIT) ? CFE_MSG_Type_Cmd : CFE_MSG_Type_Tlm;
+   return CFE_SUCCESS;
+}
+
+int32 CFE_MSG_Init(CFE_MSG_Message_t *MsgPtr, CFE_SB_MsgId_t MsgId, CFE_MSG_Size_t Size)
+{
+   memset(MsgPtr, 0, Size);
+   MsgPtr->MsgId = MsgId;
+   MsgPtr->Size  = Size;
+   return CFE_SUCCESS;
+}
+
+
+/******************************************************************************
+** cFE Platform Support Package
+*/
+
+void CFE_PSP_MemSet(void *Dest, uint8 Value, uint32 Size)
+{
+   memset(Dest, Value, Size);
+}
+
+
+/******************************************************************************
+** cFE Software Bus
+*/
+
+int32 CFE_SB_CreatePipe(CFE_SB_PipeId_t *PipeId, uint16 Depth, const char *PipeName)
+{
+   *PipeId = 1;
+   return CFE_SUCCESS;
+}
+
+uint32 CFE_SB_MsgIdToValue(CFE_SB_MsgId_t MsgId)
+{
+   return MsgId;
+}
+
+int32 CFE_SB_ReceiveBuffer(CFE_SB_Buffer_t **BufPtr, CFE_SB_PipeId_t PipeId, int32 TimeOut)
+{
+   return (SbReceiveHook == NULL) ? CFE_SB_NO_MESSAGE : SbReceiveHook(BufPtr, TimeOut);
+}
+
+int32 CFE_SB_Subscribe(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId)
+{
+   return CFE_SUCCESS;
+}
+
+int32 CFE_SB_SubscribeEx(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId, CFE_SB_Qos_t Quality, uint16 MsgLim)
+{
+   return CFE_SUCCESS;
+}
+
+void CFE_SB_TimeStampMsg(CFE_MSG_Message_t *MsgPtr)
+{
+   MsgPtr->Time = CFE_TIME_GetTime();
+}
+
+int32 CFE_SB_TransmitMsg(CFE_MSG_Message_t *MsgPtr, bool IncrementSequenceCount)
+{
+   if (SbTransmitHook != NULL)
+   {
+      SbTransmitHook(MsgPtr);
+   }
+   return CFE_SUCCESS;
+}
+
+int32 CFE_SB_Unsubscribe(CFE_SB_MsgId_t MsgId, CFE_SB_PipeId_t PipeId)
+{
+   return CFE_SUCCESS;
+}
+
+CFE_SB_MsgId_t CFE_SB_ValueToMsgId(uint32 MsgIdValue)
+{
+   return MsgIdValue;
+}
+
+
+/******************************************************************************
+** cFE Time Services
+*/
+
+CFE_TIME_Compare_t CFE_TIME_Compare(CFE_TIME_SysTime_t TimeA, CFE_TIME_SysTime_t TimeB)
+{
+
+   uint64 A = ((uint64)TimeA.Seconds << 32) | TimeA.Subseconds;
+   uint64 B = ((uint64)TimeB.Seconds << 32) | TimeB.Subseconds;
+
+   return (A > B) ? CFE_TIME_A_GT_B : ((A < B) ? CFE_TIME_A_LT_B : CFE_TIME_EQUAL);
+
+}
+
+CFE_TIME_SysTime_t CFE_TIME_GetTime(void)
+{
+
+   uint64 Ns = BENCH_STUB_TimeNs();
+   CFE_TIME_SysTime_t Time;
+
+   Time.Seconds    = (uint32)(Ns / 1000000000ULL);
+   Time.Subseconds = (uint32)(((Ns % 1000000000ULL) << 32) / 1000000000ULL);
+
+   return Time;
+
+}
+
+uint32 CFE_TIME_Sub2MicroSecs(uint32 SubSeconds)
+{
+   return (uint32)(((uint64)SubSeconds * 1000000ULL) >> 32);
+}
+
+CFE_TIME_SysTime_t CFE_TIME_Subtract(CFE_TIME_SysTime_t Minuend, CFE_TIME_SysTime_t Subtrahend)
+{
+
+   uint64 Diff = (((uint64)Minuend.Seconds << 32) | Minuend.Subseconds) -
+                 (((uint64)Subtrahend.Seconds << 32) | Subtrahend.Subseconds);
+   CFE_TIME_SysTime_t Time;
+
+   Time.Seconds    = (uint32)(Diff >> 32);
+   Time.Subseconds = (uint32)Diff;
+
+   return Time;
+
+}
+
+
+/******************************************************************************
+** OSAL
+*/
+
+int32 OS_close(osal_id_t FileDes)
+{
+   return (close((int)FileDes) == 0) ? OS_SUCCESS : OS_ERROR;
+}
+
+int32 OS_MutSemCreate(osal_id_t *SemId, const char *SemName, uint32 Options)
+{
+
+   if (MutSemCnt >= STUB_MUT_SEM_MAX)
+   {
+      return OS_ERR_NO_FREE_IDS;
+   }
+
+   pthread_mutex_init(&MutSem[MutSemCnt], NULL);
+   *SemId = MutSemCnt++;
+
+   return OS_SUCCESS;
+
+}
+
+int32 OS_MutSemGive(osal_id_t SemId)
+{
+   return (pthread_mutex_unlock(&MutSem[SemId]) == 0) ? OS_SUCCESS : OS_ERROR;
+}
+
+int32 OS_MutSemTake(osal_id_t SemId)
+{
+   return (pthread_mutex_lock(&MutSem[SemId]) == 0) ? OS_SUCCESS : OS_ERROR;
+}
+
+int32 OS_OpenCreate(osal_id_t *FileDes, const char *Path, int32 Flags, int32 Access)
+{
+
+   int OpenFlags = (Access == OS_READ_ONLY) ? O_RDONLY : ((Access == OS_WRITE_ONLY) ? O_WRONLY : O_RDWR);
+   int Fd;
+
+   if (Flags & OS_FILE_FLAG_CREATE)
+   {
+      OpenFlags |= O_CREAT;
+   }
+   if (Flags & OS_FILE_FLAG_TRUNCATE)
+   {
+      OpenFlags |= O_TRUNC;
+   }
+
+   Fd = open(Path, OpenFlags, 0644);
+   if (Fd < 0)
+   {
+      return OS_ERROR;
+   }
+
+   *FileDes = (osal_id_t)Fd;
+
+   return OS_SUCCESS;
+
+}
+
+int32 OS_TaskDelay(uint32 Milliseconds)
+{
+   usleep(Milliseconds * 1000);
+   return OS_SUCCESS;
+}
+
+int32 OS_write(osal_id_t FileDes, const void *Buffer, size_t Nbytes)
+{
+   ssize_t Len = write((int)FileDes, Buffer, Nbytes);
+   return (Len < 0) ? OS_ERROR : (int32)Len;
+}
+
+
+/******************************************************************************
+** app_c_fw Initialization Table
+*/
+
+uint32 INITBL_GetIntConfig(const INITBL_Class_t *IniTbl, uint16 Param)
+{
+   return IniTbl->IntConfig[Param];
+}
+
+const char *INITBL_GetStrConfig(const INITBL_Class_t *IniTbl, uint16 Param)
+{
+   return (IniTbl->StrConfig[Param] == NULL) ? "" : IniTbl->StrConfig[Param];
+}
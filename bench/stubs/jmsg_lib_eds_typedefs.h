@@ -0,0 +1,84 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Stand-in for the JMSG_LIB and JMSG_PLATFORM EDS definitions used by the
+**   JMSG_MQTT gateway objects
+**
+** Notes:
+**   1. Plugin IDs and sizes match the JMSG_LIB platform defaults.
+**
+*/
+#ifndef _jmsg_lib_eds_typedefs_
+#define _jmsg_lib_eds_typedefs_
+
+/*
+** Includes
+*/
+
+#include "app_c_fw.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define JMSG_PLATFORM_TOPIC_PLUGIN_MAX    32
+#define JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF  99
+#define JMSG_PLATFORM_TOPIC_NAME_MAX_LEN  64
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+enum JMSG_PLATFORM_TopicPlugin
+{
+
+   JMSG_PLATFORM_TopicPlugin_Enum_t_MIN = 0,
+   JMSG_PLATFORM_TopicPlugin_Enum_t_MAX = JMSG_PLATFORM_TOPIC_PLUGIN_MAX
+
+};
+
+typedef uint16  JMSG_PLATFORM_TopicPlugin_Enum_t;
+
+enum JMSG_LIB_TopicProtocol
+{
+
+   JMSG_LIB_TopicProtocol_MQTT = 1,
+   JMSG_LIB_TopicProtocol_UDP  = 2
+
+};
+
+typedef uint8  JMSG_LIB_TopicProtocol_Enum_t;
+
+typedef struct
+{
+
+   JMSG_PLATFORM_TopicPlugin_Enum_t  Id;
+   JMSG_LIB_TopicProtocol_Enum_t     Protocol;
+
+} JMSG_LIB_TopicSubscribeTlm_Payload_t;
+
+typedef struct
+{
+
+   CFE_MSG_TelemetryHeader_t             TelemetryHeader;
+   JMSG_LIB_TopicSubscribeTlm_Payload_t  Payload;
+
+} JMSG_LIB_TopicSubscribeTlm_t;
+
+
+#endif /* _jmsg_lib_eds_typedefs_ */
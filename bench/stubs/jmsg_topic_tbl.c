@@ -0,0 +1,251 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Stand-in for the JMSG_LIB topic table
+**
+** Notes:
+**   1. See jmsg_topic_tbl.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include "jmsg_topic_tbl.h"
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   bool  Registered;
+   bool  SbRole;
+   JMSG_TOPIC_TBL_Topic_t               Topic;
+   JMSG_TOPIC_TBL_CfeToJson_t           CfeToJson;
+   JMSG_TOPIC_TBL_JsonToCfe_t           JsonToCfe;
+   JMSG_TOPIC_TBL_ConfigSubscription_t  ConfigSubscription;
+
+} Plugin_t;
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static Plugin_t Plugin[JMSG_PLATFORM_TOPIC_PLUGIN_MAX];
+
+
+/******************************************************************************
+** Function: BENCH_TOPIC_TBL_AddPlugin
+**
+*/
+bool BENCH_TOPIC_TBL_AddPlugin(enum JMSG_PLATFORM_TopicPlugin TopicPlugin, const char *Name, uint16 Cfe,
+                               bool SbRole, JMSG_TOPIC_TBL_CfeToJson_t CfeToJson,
+                               JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe)
+{
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX)
+   {
+      return false;
+   }
+
+   memset(&Plugin[TopicPlugin], 0, sizeof(Plugin_t));
+   strncpy(Plugin[TopicPlugin].Topic.Name, Name, JMSG_PLATFORM_TOPIC_NAME_MAX_LEN - 1);
+   Plugin[TopicPlugin].Topic.Cfe  = Cfe;
+   Plugin[TopicPlugin].SbRole     = SbRole;
+   Plugin[TopicPlugin].CfeToJson  = CfeToJson;
+   Plugin[TopicPlugin].JsonToCfe  = JsonToCfe;
+   Plugin[TopicPlugin].Registered = true;
+
+   return true;
+
+} /* End BENCH_TOPIC_TBL_AddPlugin() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_GetCfeToJson
+**
+*/
+JMSG_TOPIC_TBL_CfeToJson_t JMSG_TOPIC_TBL_GetCfeToJson(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                       const char **JsonMsgTopic)
+{
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX || !Plugin[TopicPlugin].Registered)
+   {
+      return NULL;
+   }
+
+   *JsonMsgTopic = Plugin[TopicPlugin].Topic.Name;
+
+   return Plugin[TopicPlugin].CfeToJson;
+
+} /* End JMSG_TOPIC_TBL_GetCfeToJson() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_GetJsonToCfe
+**
+*/
+JMSG_TOPIC_TBL_JsonToCfe_t JMSG_TOPIC_TBL_GetJsonToCfe(enum JMSG_PLATFORM_TopicPlugin TopicPlugin)
+{
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX || !Plugin[TopicPlugin].Registered)
+   {
+      return NULL;
+   }
+
+   return Plugin[TopicPlugin].JsonToCfe;
+
+} /* End JMSG_TOPIC_TBL_GetJsonToCfe() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_GetTopic
+**
+** Unregistered plugins return an empty topic like an unused JMSG_LIB
+** topic table entry.
+**
+*/
+const JMSG_TOPIC_TBL_Topic_t *JMSG_TOPIC_TBL_GetTopic(enum JMSG_PLATFORM_TopicPlugin TopicPlugin)
+{
+
+   static const JMSG_TOPIC_TBL_Topic_t UnusedTopic = { "", 0 };
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX || !Plugin[TopicPlugin].Registered)
+   {
+      return &UnusedTopic;
+   }
+
+   return &Plugin[TopicPlugin].Topic;
+
+} /* End JMSG_TOPIC_TBL_GetTopic() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_MsgIdToTopicPlugin
+**
+*/
+int32 JMSG_TOPIC_TBL_MsgIdToTopicPlugin(CFE_SB_MsgId_t MsgId)
+{
+
+   int32 i;
+
+   for (i = 0; i < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; i++)
+   {
+      if (Plugin[i].Registered && Plugin[i].Topic.Cfe == CFE_SB_MsgIdToValue(MsgId))
+      {
+         return i;
+      }
+   }
+
+   return JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+
+} /* End JMSG_TOPIC_TBL_MsgIdToTopicPlugin() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_RegisterConfigSubscriptionCallback
+**
+*/
+bool JMSG_TOPIC_TBL_RegisterConfigSubscriptionCallback(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                        JMSG_TOPIC_TBL_ConfigSubscription_t ConfigSubscription)
+{
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX || !Plugin[TopicPlugin].Registered)
+   {
+      return false;
+   }
+
+   Plugin[TopicPlugin].ConfigSubscription = ConfigSubscription;
+
+   return true;
+
+} /* End JMSG_TOPIC_TBL_RegisterConfigSubscriptionCallback() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_SubscribeToAll
+**
+*/
+void JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SubscriptionOptEnum_t SubscriptionOpt)
+{
+
+   int32 i;
+
+   for (i = 0; i < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; i++)
+   {
+      if (Plugin[i].ConfigSubscription != NULL)
+      {
+         JMSG_TOPIC_TBL_SubscribeToTopicMsg(i, SubscriptionOpt);
+      }
+   }
+
+} /* End JMSG_TOPIC_TBL_SubscribeToAll() */
+
+
+/******************************************************************************
+** Function: JMSG_TOPIC_TBL_SubscribeToTopicMsg
+**
+** Notes:
+**   1. SB and JMSG options only apply to plugins with the matching role.
+**      The JMSG_LIB topic table behaves the same way.
+**
+*/
+JMSG_TOPIC_TBL_SubscriptionOptEnum_t JMSG_TOPIC_TBL_SubscribeToTopicMsg(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                                        JMSG_TOPIC_TBL_SubscriptionOptEnum_t SubscriptionOpt)
+{
+
+   JMSG_TOPIC_TBL_SubscriptionOptEnum_t RoleOpt;
+   Plugin_t *PluginPtr;
+
+   if (TopicPlugin >= JMSG_PLATFORM_TOPIC_PLUGIN_MAX || Plugin[TopicPlugin].ConfigSubscription == NULL)
+   {
+      return JMSG_TOPIC_TBL_SUB_ERR;
+   }
+
+   PluginPtr = &Plugin[TopicPlugin];
+
+   switch (SubscriptionOpt)
+   {
+      case JMSG_TOPIC_TBL_SUB_TO_ROLE:
+         RoleOpt = PluginPtr->SbRole ? JMSG_TOPIC_TBL_SUB_SB : JMSG_TOPIC_TBL_SUB_JMSG;
+         break;
+      case JMSG_TOPIC_TBL_SUB_SB:
+      case JMSG_TOPIC_TBL_UNSUB_SB:
+         if (!PluginPtr->SbRole)
+         {
+            return SubscriptionOpt;
+         }
+         RoleOpt = SubscriptionOpt;
+         break;
+      case JMSG_TOPIC_TBL_SUB_JMSG:
+      case JMSG_TOPIC_TBL_UNSUB_JMSG:
+         if (PluginPtr->SbRole)
+         {
+            return SubscriptionOpt;
+         }
+         RoleOpt = SubscriptionOpt;
+         break;
+      default:
+         return JMSG_TOPIC_TBL_SUB_ERR;
+   }
+
+   return PluginPtr->ConfigSubscription(&PluginPtr->Topic, RoleOpt) ? RoleOpt : JMSG_TOPIC_TBL_SUB_ERR;
+
+} /* End JMSG_TOPIC_TBL_SubscribeToTopicMsg() */
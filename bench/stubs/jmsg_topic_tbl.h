@@ -0,0 +1,96 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Stand-in for the JMSG_LIB topic table
+**
+** Notes:
+**   1. Topic plugins are registered by the benchmark with
+**      BENCH_TOPIC_TBL_AddPlugin() instead of being loaded from the JMSG_LIB
+**      topic table file.
+**   2. A plugin's role decides how JMSG_TOPIC_TBL_SUB_TO_ROLE is resolved.
+**      SB role plugins publish SB messages to MQTT and JMSG role plugins
+**      send MQTT messages on the SB.
+**
+*/
+#ifndef _jmsg_topic_tbl_
+#define _jmsg_topic_tbl_
+
+/*
+** Includes
+*/
+
+#include "app_c_fw.h"
+#include "jmsg_lib_eds_typedefs.h"
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   JMSG_TOPIC_TBL_SUB_ERR      = 0,
+   JMSG_TOPIC_TBL_SUB_SB       = 1,
+   JMSG_TOPIC_TBL_SUB_JMSG     = 2,
+   JMSG_TOPIC_TBL_UNSUB_SB     = 3,
+   JMSG_TOPIC_TBL_UNSUB_JMSG   = 4,
+   JMSG_TOPIC_TBL_SUB_TO_ROLE  = 5
+
+} JMSG_TOPIC_TBL_SubscriptionOptEnum_t;
+
+typedef struct
+{
+
+   char    Name[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   uint16  Cfe;
+
+} JMSG_TOPIC_TBL_Topic_t;
+
+typedef bool (*JMSG_TOPIC_TBL_CfeToJson_t)(const char **JsonMsgPayload, const CFE_MSG_Message_t *CfeMsg);
+typedef bool (*JMSG_TOPIC_TBL_JsonToCfe_t)(CFE_MSG_Message_t **CfeMsg, const char *JsonMsgPayload, uint16 PayloadLen);
+typedef bool (*JMSG_TOPIC_TBL_ConfigSubscription_t)(const JMSG_TOPIC_TBL_Topic_t *Topic,
+                                                    JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt);
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+JMSG_TOPIC_TBL_CfeToJson_t JMSG_TOPIC_TBL_GetCfeToJson(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                       const char **JsonMsgTopic);
+JMSG_TOPIC_TBL_JsonToCfe_t JMSG_TOPIC_TBL_GetJsonToCfe(enum JMSG_PLATFORM_TopicPlugin TopicPlugin);
+const JMSG_TOPIC_TBL_Topic_t *JMSG_TOPIC_TBL_GetTopic(enum JMSG_PLATFORM_TopicPlugin TopicPlugin);
+int32 JMSG_TOPIC_TBL_MsgIdToTopicPlugin(CFE_SB_MsgId_t MsgId);
+bool  JMSG_TOPIC_TBL_RegisterConfigSubscriptionCallback(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                        JMSG_TOPIC_TBL_ConfigSubscription_t ConfigSubscription);
+void  JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SubscriptionOptEnum_t SubscriptionOpt);
+JMSG_TOPIC_TBL_SubscriptionOptEnum_t JMSG_TOPIC_TBL_SubscribeToTopicMsg(enum JMSG_PLATFORM_TopicPlugin TopicPlugin,
+                                                                        JMSG_TOPIC_TBL_SubscriptionOptEnum_t SubscriptionOpt);
+
+
+/*****************/
+/** Bench Hooks **/
+/*****************/
+
+
+bool BENCH_TOPIC_TBL_AddPlugin(enum JMSG_PLATFORM_TopicPlugin TopicPlugin, const char *Name, uint16 Cfe,
+                               bool SbRole, JMSG_TOPIC_TBL_CfeToJson_t CfeToJson,
+                               JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe);
+
+
+#endif /* _jmsg_topic_tbl_ */
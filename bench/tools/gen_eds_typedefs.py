@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 bitValence, Inc.
+# All Rights Reserved.
+#
+# This program is free software; you can modify and/or redistribute it
+# under the terms of the GNU Affero General Public License
+# as published by the Free Software Foundation; version 3 with
+# attribution addendums as found in the LICENSE.txt
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# Purpose:
+#   Generate the jmsg_mqtt_eds_typedefs.h and jmsg_mqtt_eds_cc.h headers
+#   used by the host-native benchmarks from eds/jmsg_mqtt.xml
+#
+# Notes:
+#   1. This is not a replacement for the cFS EDS toolchain. It only handles
+#      the data type constructs used by jmsg_mqtt.xml and the generated
+#      structures are laid out for the bench stubs, not for the ground.
+#   2. Usage: gen_eds_typedefs.py <jmsg_mqtt.xml> <output dir>
+#
+
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+NS = {'seds': 'http://www.ccsds.org/schema/sois/seds'}
+
+PKG = 'JMSG_MQTT'
+
+EXTERNAL_TYPES = {
+    'BASE_TYPES/uint8':       ('uint8',  ''),
+    'BASE_TYPES/uint16':      ('uint16', ''),
+    'BASE_TYPES/uint32':      ('uint32', ''),
+    'BASE_TYPES/uint64':      ('uint64', ''),
+    'BASE_TYPES/int16':       ('int16',  ''),
+    'BASE_TYPES/int32':       ('int32',  ''),
+    'BASE_TYPES/ApiName':     ('char',   '[OS_MAX_API_NAME]'),
+    'BASE_TYPES/PathName':    ('char',   '[OS_MAX_PATH_LEN]'),
+    'APP_C_FW/BooleanUint8':  ('APP_C_FW_BooleanUint8_t', ''),
+    'CFE_TIME/SysTime':       ('CFE_TIME_SysTime_t', ''),
+    'JMSG_PLATFORM/TopicPlugin': ('JMSG_PLATFORM_TopicPlugin_Enum_t', ''),
+}
+
+HEADER_TYPES = {
+    'CFE_HDR/CommandHeader':   ('CFE_MSG_CommandHeader_t',   'CommandHeader'),
+    'CFE_HDR/TelemetryHeader': ('CFE_MSG_TelemetryHeader_t', 'TelemetryHeader'),
+}
+
+CC_SUBST = {
+    '${APP_C_FW/NOOP_CC}':     '0',
+    '${APP_C_FW/RESET_CC}':    '1',
+    '${APP_C_FW/APP_BASE_CC}': '10',
+}
+
+
+def c_type(eds_type):
+    """Return (C type, array suffix) for an EDS type reference"""
+    if eds_type in EXTERNAL_TYPES:
+        return EXTERNAL_TYPES[eds_type]
+    if '/' in eds_type:
+        sys.exit('gen_eds_typedefs: unsupported external type ' + eds_type)
+    return ('%s_%s_t' % (PKG, eds_type), '')
+
+
+def macro_name(name):
+    return re.sub(r'(?<=[a-z0-9])([A-Z])', r'_\1', name).upper()
+
+
+def resolve_base(types, base):
+    """Return the header type and member name of a container's base"""
+    while base in types and base not in HEADER_TYPES:
+        base = types[base].get('baseType')
+    return HEADER_TYPES.get(base)
+
+
+def main():
+
+    if len(sys.argv) != 3:
+        sys.exit('Usage: gen_eds_typedefs.py <jmsg_mqtt.xml> <output dir>')
+
+    root = ET.parse(sys.argv[1]).getroot()
+    out_dir = sys.argv[2]
+
+    data_types = root.find('seds:Package/seds:DataTypeSet', NS)
+    types = {dt.get('name'): dt for dt in data_types}
+
+    typedefs = []
+    cmd_codes = []
+
+    for dt in data_types:
+
+        tag = dt.tag.split('}')[1]
+        name = dt.get('name')
+
+        if tag == 'EnumeratedDataType':
+            typedefs.append('typedef uint8 %s_%s_Enum_t;\n' % (PKG, name))
+            for enum in dt.findall('seds:EnumerationList/seds:Enumeration', NS):
+                typedefs.append('#define %s_%s_%s  %s\n' % (PKG, name, enum.get('label'), enum.get('value')))
+            typedefs.append('\n')
+
+        elif tag == 'ArrayDataType':
+            size = dt.find('seds:DimensionList/seds:Dimension', NS).get('size')
+            size = re.sub(r'\$\{(\w+)/(\w+)\}', r'\1_\2', size)
+            elem_type, suffix = c_type(dt.get('dataTypeRef'))
+            typedefs.append('typedef %s %s_%s_t[%s]%s;\n\n' % (elem_type, PKG, name, size, suffix))
+
+        elif tag == 'ContainerDataType':
+            base = dt.get('baseType')
+            header = resolve_base(types, base) if base else None
+            entries = dt.findall('seds:EntryList/*', NS)
+
+            members = []
+            if header:
+                members.append('   %s  %s;\n' % header)
+            for entry in entries:
+                entry_type, suffix = c_type(entry.get('type'))
+                members.append('   %s  %s%s;\n' % (entry_type, entry.get('name'), suffix))
+            if not members:
+                members.append('   uint8  Spare;\n')
+
+            typedefs.append('typedef struct\n{\n' + ''.join(members) + '} %s_%s_t;\n\n' % (PKG, name))
+
+            constraint = dt.find('seds:ConstraintSet/seds:ValueConstraint', NS)
+            if constraint is not None and constraint.get('entry') == 'Sec.FunctionCode':
+                value = constraint.get('value')
+                for key, subst in CC_SUBST.items():
+                    value = value.replace(key, subst)
+                cmd_codes.append('#define %s_%s_CC  (%s)\n' % (PKG, macro_name(name), value))
+
+    banner = '/* Generated by bench/tools/gen_eds_typedefs.py from %s, do not edit */\n' % \
+             os.path.basename(sys.argv[1])
+
+    with open(os.path.join(out_dir, 'jmsg_mqtt_eds_typedefs.h'), 'w') as f:
+        f.write(banner)
+        f.write('#ifndef _jmsg_mqtt_eds_typedefs_\n#define _jmsg_mqtt_eds_typedefs_\n\n')
+        f.write('#include "app_c_fw.h"\n#include "jmsg_lib_eds_typedefs.h"\n\n')
+        f.write(''.join(typedefs))
+        f.write('#endif /* _jmsg_mqtt_eds_typedefs_ */\n')
+
+    with open(os.path.join(out_dir, 'jmsg_mqtt_eds_cc.h'), 'w') as f:
+        f.write(banner)
+        f.write('#ifndef _jmsg_mqtt_eds_cc_\n#define _jmsg_mqtt_eds_cc_\n\n')
+        f.write(''.join(cmd_codes))
+        f.write('\n#endif /* _jmsg_mqtt_eds_cc_ */\n')
+
+
+if __name__ == '__main__':
+    main()
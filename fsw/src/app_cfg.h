@@ -77,6 +77,8 @@
 
 #define CFG_JMSG_MQTT_CMD_TOPICID                 JMSG_MQTT_CMD_TOPICID
 #define CFG_JMSG_MQTT_STATUS_TLM_TOPICID          JMSG_MQTT_STATUS_TLM_TOPICID
+#define CFG_JMSG_MQTT_TOPIC_STATS_TLM_TOPICID     JMSG_MQTT_TOPIC_STATS_TLM_TOPICID
+#define CFG_JMSG_MQTT_LATENCY_TLM_TOPICID         JMSG_MQTT_LATENCY_TLM_TOPICID
 #define CFG_KIT_TO_PUB_WRAPPED_TLM_TOPICID        KIT_TO_PUB_WRAPPED_TLM_TOPICID
 #define CFG_SEND_STATUS_TLM_TOPICID               BC_SCH_2_SEC_TOPICID
 #define CFG_JMSG_LIB_TOPIC_SUBSCRIBE_TLM_TOPICID  JMSG_LIB_TOPIC_SUBSCRIBE_TLM_TOPICID
@@ -92,16 +94,51 @@
 #define CFG_MQTT_BROKER_ADDRESS      MQTT_BROKER_ADDRESS
 #define CFG_MQTT_BROKER_USERNAME     MQTT_BROKER_USERNAME
 #define CFG_MQTT_BROKER_PASSWORD     MQTT_BROKER_PASSWORD
+#define CFG_MQTT_BROKER_ADDR_LIST    MQTT_BROKER_ADDR_LIST
+#define CFG_MQTT_DNS_CACHE_SEC       MQTT_DNS_CACHE_SEC
+#define CFG_MQTT_BROKER_LIST         MQTT_BROKER_LIST
+#define CFG_MQTT_FAILOVER_RTT_MS     MQTT_FAILOVER_RTT_MS
 #define CFG_MQTT_ENABLE_RECONNECT    MQTT_ENABLE_RECONNECT
-#define CFG_MQTT_RECONNECT_PERIOD    MQTT_RECONNECT_PERIOD
+#define CFG_MQTT_RECONNECT_MIN_MS    MQTT_RECONNECT_MIN_MS
+#define CFG_MQTT_RECONNECT_MAX_MS    MQTT_RECONNECT_MAX_MS
 
 #define CFG_MQTT_CLIENT_NAME         MQTT_CLIENT_NAME
 #define CFG_MQTT_CLIENT_YIELD_TIME   MQTT_CLIENT_YIELD_TIME
+#define CFG_MQTT_COALESCE_BYTES      MQTT_COALESCE_BYTES
+#define CFG_MQTT_COALESCE_USEC       MQTT_COALESCE_USEC
+#define CFG_MQTT_PUB_QOS             MQTT_PUB_QOS
+#define CFG_MQTT_SUB_QOS             MQTT_SUB_QOS
+#define CFG_MQTT_QOS_WINDOW          MQTT_QOS_WINDOW
+#define CFG_MQTT_QOS_RETRY_MS        MQTT_QOS_RETRY_MS
+#define CFG_MQTT_VERSION             MQTT_VERSION
+#define CFG_MQTT_PERSISTENT_SESSION  MQTT_PERSISTENT_SESSION
+#define CFG_MQTT5_MSG_EXPIRY_SEC     MQTT5_MSG_EXPIRY_SEC
+#define CFG_MQTT5_SESSION_EXPIRY_SEC MQTT5_SESSION_EXPIRY_SEC
+#define CFG_MQTT_SHARD_CNT           MQTT_SHARD_CNT
 
 #define CFG_MQTT_CHILD_NAME          MQTT_CHILD_NAME
 #define CFG_MQTT_CHILD_STACK_SIZE    MQTT_CHILD_STACK_SIZE
 #define CFG_MQTT_CHILD_PRIORITY      MQTT_CHILD_PRIORITY
 
+#define CFG_SPOOL_BUF_LEN            SPOOL_BUF_LEN
+#define CFG_SPOOL_DROP_POLICY        SPOOL_DROP_POLICY
+#define CFG_SPOOL_REPLAY_RATE        SPOOL_REPLAY_RATE
+
+#define CFG_JOURNAL_FILE             JOURNAL_FILE
+#define CFG_JOURNAL_FILE_LEN         JOURNAL_FILE_LEN
+#define CFG_JOURNAL_SYNC_CNT         JOURNAL_SYNC_CNT
+#define CFG_JOURNAL_SYNC_TIME        JOURNAL_SYNC_TIME
+
+#define CFG_TRACE_FILE               TRACE_FILE
+
+#define CFG_TOPIC_CFG                TOPIC_CFG
+
+#define CFG_ZLIB_MIN_BYTES           ZLIB_MIN_BYTES
+#define CFG_ZLIB_LEVEL               ZLIB_LEVEL
+
+#define CFG_TOPIC_STATS_TLM_PERIOD   TOPIC_STATS_TLM_PERIOD
+#define CFG_LATENCY_TLM_PERIOD       LATENCY_TLM_PERIOD
+
 
 #define APP_CONFIG(XX) \
    XX(APP_CFE_NAME,char*) \
@@ -109,6 +146,8 @@
    XX(CHILD_TASK_PERF_ID,uint32) \
    XX(JMSG_MQTT_CMD_TOPICID,uint32) \
    XX(JMSG_MQTT_STATUS_TLM_TOPICID,uint32) \
+   XX(JMSG_MQTT_TOPIC_STATS_TLM_TOPICID,uint32) \
+   XX(JMSG_MQTT_LATENCY_TLM_TOPICID,uint32) \
    XX(KIT_TO_PUB_WRAPPED_TLM_TOPICID,uint32) \
    XX(BC_SCH_2_SEC_TOPICID,uint32) \
    XX(JMSG_LIB_TOPIC_SUBSCRIBE_TLM_TOPICID,uint32) \
@@ -121,13 +160,42 @@
    XX(MQTT_BROKER_ADDRESS,char*) \
    XX(MQTT_BROKER_USERNAME,char*) \
    XX(MQTT_BROKER_PASSWORD,char*) \
+   XX(MQTT_BROKER_ADDR_LIST,char*) \
+   XX(MQTT_DNS_CACHE_SEC,uint32) \
+   XX(MQTT_BROKER_LIST,char*) \
+   XX(MQTT_FAILOVER_RTT_MS,uint32) \
    XX(MQTT_ENABLE_RECONNECT,uint32) \
-   XX(MQTT_RECONNECT_PERIOD,uint32) \
+   XX(MQTT_RECONNECT_MIN_MS,uint32) \
+   XX(MQTT_RECONNECT_MAX_MS,uint32) \
    XX(MQTT_CLIENT_NAME,char*) \
    XX(MQTT_CLIENT_YIELD_TIME,uint32) \
+   XX(MQTT_COALESCE_BYTES,uint32) \
+   XX(MQTT_COALESCE_USEC,uint32) \
+   XX(MQTT_PUB_QOS,uint32) \
+   XX(MQTT_SUB_QOS,uint32) \
+   XX(MQTT_QOS_WINDOW,uint32) \
+   XX(MQTT_QOS_RETRY_MS,uint32) \
+   XX(MQTT_VERSION,uint32) \
+   XX(MQTT_PERSISTENT_SESSION,uint32) \
+   XX(MQTT5_MSG_EXPIRY_SEC,uint32) \
+   XX(MQTT5_SESSION_EXPIRY_SEC,uint32) \
+   XX(MQTT_SHARD_CNT,uint32) \
    XX(MQTT_CHILD_NAME,char*) \
    XX(MQTT_CHILD_STACK_SIZE,uint32) \
-   XX(MQTT_CHILD_PRIORITY,uint32)
+   XX(MQTT_CHILD_PRIORITY,uint32) \
+   XX(SPOOL_BUF_LEN,uint32) \
+   XX(SPOOL_DROP_POLICY,uint32) \
+   XX(SPOOL_REPLAY_RATE,uint32) \
+   XX(JOURNAL_FILE,char*) \
+   XX(JOURNAL_FILE_LEN,uint32) \
+   XX(JOURNAL_SYNC_CNT,uint32) \
+   XX(JOURNAL_SYNC_TIME,uint32) \
+   XX(TRACE_FILE,char*) \
+   XX(TOPIC_CFG,char*) \
+   XX(ZLIB_MIN_BYTES,uint32) \
+   XX(ZLIB_LEVEL,uint32) \
+   XX(TOPIC_STATS_TLM_PERIOD,uint32) \
+   XX(LATENCY_TLM_PERIOD,uint32)
    
 DECLARE_ENUM(Config,APP_CONFIG)
 
@@ -144,21 +212,206 @@ DECLARE_ENUM(Config,APP_CONFIG)
 #define MQTT_MGR_BASE_EID        (APP_C_FW_APP_BASE_EID + 20)
 #define MQTT_CLIENT_BASE_EID     (APP_C_FW_APP_BASE_EID + 40)
 #define MQMSG_TRANS_BASE_EID     (APP_C_FW_APP_BASE_EID + 60)
+#define MQTT_PUBQ_BASE_EID       (APP_C_FW_APP_BASE_EID + 80)
+#define MQTT_SPOOL_BASE_EID      (APP_C_FW_APP_BASE_EID + 90)
+#define MQTT_JOURNAL_BASE_EID    (APP_C_FW_APP_BASE_EID + 100)
+#define MQTT_TRACE_BASE_EID      (APP_C_FW_APP_BASE_EID + 110)
+#define MQTT_TOPIC_CFG_BASE_EID  (APP_C_FW_APP_BASE_EID + 120)
+#define MQTT_ZLIB_BASE_EID       (APP_C_FW_APP_BASE_EID + 130)
+#define MQTT_INFLIGHT_BASE_EID   (APP_C_FW_APP_BASE_EID + 140)
+#define MQTT_V5_BASE_EID         (APP_C_FW_APP_BASE_EID + 150)
+#define MQTT_RESOLVE_BASE_EID    (APP_C_FW_APP_BASE_EID + 160)
+#define MQTT_BROKER_BASE_EID     (APP_C_FW_APP_BASE_EID + 170)
+#define MQTT_SHARD_BASE_EID      (APP_C_FW_APP_BASE_EID + 180)
 
 
 /******************************************************************************
 ** MQTT Client
 **
+** The coalescing buffer holds PUBLISH packets waiting to be written
+** together. MQTT_COALESCE_BYTES in the ini file is the flush threshold and
+** can't exceed the buffer length.
+**
+** A SUBSCRIBE holds up to MQTT_CLIENT_SUB_FILTER_MAX topic filters if they
+** fit in the send buffer. The SUBACK results of MQTT_CLIENT_SUB_PENDING_MAX
+** SUBSCRIBEs can be waiting to be passed to their subscribers, further
+** subscriptions wait until one is acknowledged.
+**
+** The socket is non-blocking. Bytes the socket doesn't accept are held in
+** the output buffer until it's writable, a write only waits when the
+** output buffer is full.
+*/
+
+#define MQTT_CLIENT_READ_BUF_LEN      8192 
+#define MQTT_CLIENT_SEND_BUF_LEN      8192 
+#define MQTT_CLIENT_COALESCE_BUF_LEN  16384 
+#define MQTT_CLIENT_OUT_BUF_LEN       32768 
+#define MQTT_CLIENT_TIMEOUT_MS        2000 
+#define MQTT_CLIENT_SUB_FILTER_MAX    32
+#define MQTT_CLIENT_SUB_PENDING_MAX   8
+
+/******************************************************************************
+** MQTT Resolve
+**
+** Maximum number of broker addresses kept from a lookup or listed in
+** MQTT_BROKER_ADDR_LIST
+*/
+
+#define MQTT_RESOLVE_ADDR_MAX  4
+
+/******************************************************************************
+** MQTT Broker
+**
+** MQTT_BROKER_MAX includes MQTT_BROKER_ADDRESS and must match the
+** BrokerStatsArray size in the EDS. Each failure since a broker's last
+** successful connect adds MQTT_BROKER_FAIL_PENALTY_MS to its health score
+** and a broker must be connected for MQTT_BROKER_FAILOVER_HOLD_SEC before
+** a high round trip time fails it over. A broker that hasn't been tried, or
+** hasn't been measured for MQTT_BROKER_SCORE_STALE_SEC, scores
+** MQTT_FAILOVER_RTT_MS or MQTT_BROKER_UNTRIED_SCORE_MS when failover is
+** disabled.
+*/
+
+#define MQTT_BROKER_MAX                4
+#define MQTT_BROKER_FAIL_PENALTY_MS    1000
+#define MQTT_BROKER_FAILOVER_HOLD_SEC  60
+#define MQTT_BROKER_UNTRIED_SCORE_MS   500
+#define MQTT_BROKER_SCORE_STALE_SEC    600
+
+/******************************************************************************
+** MQTT Publish Queue
+**
+** Rings between the SB topic pipe and the network owner child task. The
+** depths must be a power of 2. Each entry holds a complete PUBLISH packet
+** image including the topic. The priority ring only holds messages from
+** topics with the TOPIC_CFG priority option.
+*/
+
+#define MQTT_PUBQ_DEPTH           32
+#define MQTT_PUBQ_PRIORITY_DEPTH   8
+#define MQTT_PUBQ_PACKET_MAX_LEN  MQTT_CLIENT_SEND_BUF_LEN
+
+/******************************************************************************
+** MQTT Shard
+**
+** MQTT_SHARD_MAX is the maximum number of broker connections used for
+** publishing including the network owner's. The EDS ShardStatsArray holds
+** the other MQTT_SHARD_MAX-1 connections. Each of them has a
+** MQTT_SHARD_DEPTH entry publish ring that must be a power of 2 and a
+** MQTT_SHARD_CTRL_BUF_LEN byte buffer for its CONNECT, PINGREQ and
+** DISCONNECT packets.
+*/
+
+#define MQTT_SHARD_MAX           4
+#define MQTT_SHARD_DEPTH        32
+#define MQTT_SHARD_CTRL_BUF_LEN 256
+
+/******************************************************************************
+** MQTT Spool
+**
+** Maximum store-and-forward buffer length. The length used at runtime is
+** defined by SPOOL_BUF_LEN in the ini file.
+*/
+
+#define MQTT_SPOOL_BUF_MAX_LEN  (256*1024)
+
+/******************************************************************************
+** MQTT Journal
+**
+** Maximum number of journaled QoS1 messages waiting for a PUBACK
+*/
+
+#define MQTT_JOURNAL_INFLIGHT_MAX  16
+
+/******************************************************************************
+** MQTT Inflight
+**
+** Maximum number of QoS1 and QoS2 messages waiting to be acknowledged. The
+** window used at runtime is defined by MQTT_QOS_WINDOW in the ini file.
+** Each slot holds a copy of its PUBLISH packet.
+*/
+
+#define MQTT_INFLIGHT_WINDOW_MAX  32
+
+/******************************************************************************
+** MQTT V5
+**
+** Limits sent in an MQTT 5 CONNECT. The topic alias maximum is also the
+** size of the outbound alias table so it caps the aliases the broker can
+** grant. The receive maximum limits the broker's unacknowledged QoS1 and
+** QoS2 messages to the gateway.
+*/
+
+#define MQTT_V5_TOPIC_ALIAS_MAX  32
+#define MQTT_V5_RECEIVE_MAX      64
+
+/******************************************************************************
+** MQTT Topic Index
+**
+** Inbound topic name hash table size. Must be a power of 2 and should be at
+** least twice the number of topic plugins.
+*/
+
+#define MQTT_TOPIC_IDX_SIZE  128
+
+/******************************************************************************
+** MQTT Topic Trie
+**
+** Number of topic level nodes available for wildcard topic filters
+*/
+
+#define MQTT_TOPIC_TRIE_NODE_MAX  256
+
+/******************************************************************************
+** MQTT Trace
+**
+** Number of per-message trace records kept in the ring. Must be a power
+** of 2.
+*/
+
+#define MQTT_TRACE_REC_MAX  1024
+
+/******************************************************************************
+** MQTT Latency
+**
+** Number of log2 histogram buckets. Bucket 0 holds samples under 1us and
+** bucket N holds samples from 2^(N-1) up to 2^N us. The last bucket also
+** holds every longer sample.
+*/
+
+#define MQTT_LATENCY_BUCKET_CNT  32
+
+/******************************************************************************
+** MQTT Topic Configuration
+**
+** Maximum number of topics with options defined by TOPIC_CFG in the ini file
+*/
+
+#define MQTT_TOPIC_CFG_ENTRY_MAX  32
+
+/******************************************************************************
+** MQTT CBOR
+**
+** Maximum nesting of JSON objects and arrays transcoded to and from CBOR
+*/
+
+#define MQTT_CBOR_MAX_DEPTH  16
+
+/******************************************************************************
+** MQTT Zlib
+**
+** Deflate stream parameters. Payloads are at most MQTT_PUBQ_PACKET_MAX_LEN
+** so an 8K window covers a whole payload. The window bits must be 13 to 15
+** so subscribers can recognize the stream header.
 */
 
-#define MQTT_CLIENT_READ_BUF_LEN  8192 
-#define MQTT_CLIENT_SEND_BUF_LEN  8192 
-#define MQTT_CLIENT_TIMEOUT_MS    2000 
+#define MQTT_ZLIB_WINDOW_BITS  13
+#define MQTT_ZLIB_MEM_LEVEL    8
 
 /******************************************************************************
 ** MQTT Topic CCSDS
 **
-** The CCSDS topic contains a CCSDS message as its payload so this length must
+** Raw topics contain a CCSDS message as their payload so this length must
 ** be large enough to accomodate the largest CCSDS packet that will be sent as
 ** a MQTT payload.
 */
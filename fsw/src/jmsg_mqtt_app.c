@@ -66,12 +66,13 @@ static CFE_EVS_BinFilter_t  EventFilters[] =
 {  
    /* Event ID                             Mask */
    {MQTT_CLIENT_CONNECT_ERR_EID,           CFE_EVS_FIRST_4_STOP},
-   {MQTT_CLIENT_YIELD_ERR_EID,             CFE_EVS_FIRST_4_STOP},
-   {MQTT_CLIENT_PUBLISH_EID,               CFE_EVS_FIRST_4_STOP},
+   {MQTT_CLIENT_INPUT_ERR_EID,             CFE_EVS_FIRST_4_STOP},
+   {MQTT_CLIENT_KEEPALIVE_ERR_EID,         CFE_EVS_FIRST_4_STOP},
    {MQTT_CLIENT_PUBLISH_ERR_EID,           CFE_EVS_FIRST_4_STOP},
-   {MQMSG_TRANS_PROCESS_MQTT_MSG_INFO_EID, CFE_EVS_FIRST_4_STOP}, // "INFO_" tag used so other MSG_TRANS_PROCESS_MQTT_MSG_EIDs are not filtered
-   {MQMSG_TRANS_PROCESS_SB_MSG_INFO_EID,   CFE_EVS_FIRST_4_STOP}, // "INFO_" tag used so other MSG_TRANS_PROCESS_SB_MSG_EIDs are not filtered 
-   {MQTT_MGR_RECONNECT_EID,                CFE_EVS_FIRST_4_STOP}
+   {MQMSG_TRANS_PROCESS_MQTT_MSG_EID,      CFE_EVS_FIRST_4_STOP}, // Every message is recorded in the trace ring
+   {MQMSG_TRANS_PROCESS_SB_MSG_EID,        CFE_EVS_FIRST_4_STOP}, // Every message is recorded in the trace ring
+   {MQTT_MGR_RECONNECT_EID,                CFE_EVS_FIRST_4_STOP},
+   {MQTT_PUBQ_PUSH_ERR_EID,                CFE_EVS_FIRST_4_STOP}
 };
 
 /*****************/
@@ -114,6 +115,8 @@ void JMSG_MQTT_AppMain(void)
           JMsgMqttApp.PollCmdCnt = 0;
           RunStatus = ProcessCommands();
           SendStatusPkt();
+          MQTT_TOPIC_STATS_ManageTlm();
+          MQTT_LATENCY_ManageTlm();
       } 
       
    } /* End CFE_ES_RunLoop */
@@ -178,6 +181,8 @@ static int32 InitApp(void)
    
    CFE_SB_Qos_t SbQos;
    CHILDMGR_TaskInit_t ChildTaskInit;
+   MQTT_SHARD_Conn_t  *ShardConn;
+   uint16 i;
 
 
    /*
@@ -209,6 +214,15 @@ static int32 InitApp(void)
       RetStatus = CHILDMGR_Constructor(CHILDMGR_OBJ, ChildMgr_TaskMainCallback,
                                        MQTT_MGR_ChildTaskCallback, &ChildTaskInit); 
 
+      /* Each additional publish connection has its own child task, see mqtt_shard.h */
+      for (i = 1; i < JMsgMqttApp.MqttMgr.MqttShard.Cnt && RetStatus == CFE_SUCCESS; i++)
+      {
+         ShardConn = &JMsgMqttApp.MqttMgr.MqttShard.Conn[i-1];
+         ChildTaskInit.TaskName = ShardConn->TaskName;
+         RetStatus = CHILDMGR_Constructor(&ShardConn->ChildMgr, ChildMgr_TaskMainCallback,
+                                          MQTT_SHARD_ChildTaskCallback, &ChildTaskInit);
+      }
+
       /*
       ** Initialize app level interfaces
       */
@@ -229,6 +243,9 @@ static int32 InitApp(void)
       CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_CONNECT_TO_MQTT_BROKER_CC,    MQTT_MGR_OBJ, MQTT_MGR_ConnectToMqttBrokerCmd,    sizeof(JMSG_MQTT_ConnectToMqttBroker_CmdPayload_t));
       CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_RECONNECT_TO_MQTT_BROKER_CC,  MQTT_MGR_OBJ, MQTT_MGR_ReconnectToMqttBrokerCmd,  0);
       CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_SEND_CONNECTION_INFO_CC,      MQTT_MGR_OBJ, MQTT_MGR_SendConnectionInfoCmd,     0);
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_DUMP_TRACE_CC,                &JMsgMqttApp.MqttMgr.MqttTrace, MQTT_TRACE_DumpCmd, sizeof(JMSG_MQTT_DumpTrace_CmdPayload_t));
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_SEND_TOPIC_STATS_CC,           &JMsgMqttApp.MqttMgr.MqttTopicStats, MQTT_TOPIC_STATS_SendTlmCmd, 0);
+      CMDMGR_RegisterFunc(CMDMGR_OBJ, JMSG_MQTT_SEND_LATENCY_CC,              &JMsgMqttApp.MqttMgr.MqttLatency, MQTT_LATENCY_SendTlmCmd, 0);
       
       CFE_MSG_Init(CFE_MSG_PTR(JMsgMqttApp.StatusTlm.TelemetryHeader), CFE_SB_ValueToMsgId(INITBL_GetIntConfig(INITBL_OBJ, CFG_JMSG_MQTT_STATUS_TLM_TOPICID)), sizeof(JMSG_MQTT_StatusTlm_t));
 
@@ -314,6 +331,9 @@ void SendStatusPkt(void)
 {
 
    JMSG_MQTT_StatusTlm_Payload_t *Payload = &JMsgMqttApp.StatusTlm.Payload;
+   const MQTT_BROKER_Endpoint_t  *Broker;
+   const MQTT_SHARD_Conn_t       *ShardConn;
+   uint16 i;
 
    /*
    ** Framework Data
@@ -334,7 +354,33 @@ void SendStatusPkt(void)
    Payload->SbPendTime        = JMsgMqttApp.MqttMgr.SbPendTime;
 
    Payload->MqttConnected     = JMsgMqttApp.MqttMgr.MqttClient.Connected;
+   Payload->ConnectState      = JMsgMqttApp.MqttMgr.MqttClient.ConnState;
    Payload->ReconnectAttempts = JMsgMqttApp.MqttMgr.Reconnect.Attempts;
+   Payload->ReconnectTime     = JMsgMqttApp.MqttMgr.Reconnect.LastTimeMs;
+   Payload->ReconnectTimeMax  = JMsgMqttApp.MqttMgr.Reconnect.MaxTimeMs;
+   Payload->ActiveBroker      = (uint8)JMsgMqttApp.MqttMgr.MqttBroker.Active;
+   Payload->BrokerFailoverCnt = JMsgMqttApp.MqttMgr.MqttBroker.FailoverCnt;
+   for (i = 0; i < MQTT_BROKER_MAX; i++)
+   {
+      Broker = &JMsgMqttApp.MqttMgr.MqttBroker.Endpoint[i];
+      Payload->Broker[i].ConnectCnt  = Broker->ConnectCnt;
+      Payload->Broker[i].FailCnt     = Broker->FailCnt;
+      Payload->Broker[i].ConnectTime = Broker->ConnectMs;
+      Payload->Broker[i].Rtt         = Broker->SrttUs;
+      Payload->Broker[i].Uptime      = MQTT_BROKER_UptimeSec(i);
+   }
+   Payload->AddrCacheHitCnt   = JMsgMqttApp.MqttMgr.MqttClient.Resolve.CacheHitCnt;
+   Payload->AddrLookupCnt     = JMsgMqttApp.MqttMgr.MqttClient.Resolve.LookupCnt;
+   Payload->AddrLookupErrCnt  = JMsgMqttApp.MqttMgr.MqttClient.Resolve.LookupErrCnt;
+   Payload->AddrFallbackCnt   = JMsgMqttApp.MqttMgr.MqttClient.Resolve.FallbackCnt;
+   Payload->SessionPresent    = JMsgMqttApp.MqttMgr.MqttClient.SessionPresent;
+   Payload->SessionResumeCnt  = JMsgMqttApp.MqttMgr.SessionResumeCnt;
+   Payload->SubscribeTime      = JMsgMqttApp.MqttMgr.SubBatch.LastTimeUs;
+   Payload->SubscribeTimeMax   = JMsgMqttApp.MqttMgr.SubBatch.MaxTimeUs;
+   Payload->SubscribeFilterCnt = JMsgMqttApp.MqttMgr.SubBatch.LastFilterCnt;
+   Payload->SubscribePacketCnt = JMsgMqttApp.MqttMgr.SubBatch.LastPacketCnt;
+   Payload->SubscribeRejectCnt = JMsgMqttApp.MqttMgr.SubBatch.RejectCnt;
+   Payload->SubscribeHoldCnt   = JMsgMqttApp.MqttMgr.SubBatch.HoldCnt;
 
    Payload->ValidMqttMsgCnt   = JMsgMqttApp.MqttMgr.MqMsgTrans.ValidMqttMsgCnt;
    Payload->InvalidMqttMsgCnt = JMsgMqttApp.MqttMgr.MqMsgTrans.InvalidMqttMsgCnt;
@@ -343,6 +389,50 @@ void SendStatusPkt(void)
 
    Payload->UnpublishedSbMsgCnt = JMsgMqttApp.MqttMgr.UnpublishedSbMsgCnt;
 
+   Payload->PubQueueCnt         = MQTT_PUBQ_Count();
+   Payload->PubQueueHighWater   = JMsgMqttApp.MqttMgr.MqttPubQ.HighWater;
+   Payload->PubQueueOverflowCnt = JMsgMqttApp.MqttMgr.MqttPubQ.OverflowCnt;
+   
+   Payload->ShardCnt = (uint8)JMsgMqttApp.MqttMgr.MqttShard.Cnt;
+   for (i = 0; i < (MQTT_SHARD_MAX-1); i++)
+   {
+      ShardConn = &JMsgMqttApp.MqttMgr.MqttShard.Conn[i];
+      Payload->Shard[i].Connected  = ShardConn->Connected;
+      Payload->Shard[i].ConnectCnt = ShardConn->ConnectCnt;
+      Payload->Shard[i].PublishCnt = ShardConn->PubCnt;
+      Payload->Shard[i].DropCnt    = ShardConn->OverflowCnt;
+   }
+
+   Payload->CoalescedWriteCnt = JMsgMqttApp.MqttMgr.MqttClient.CoalesceFlushCnt;
+   Payload->SavedWriteCnt     = JMsgMqttApp.MqttMgr.MqttClient.CoalesceSavedCnt;
+
+   Payload->QosInFlightCnt       = JMsgMqttApp.MqttMgr.MqttInflight.Cnt;
+   Payload->QosInFlightHighWater = JMsgMqttApp.MqttMgr.MqttInflight.HighWater;
+   Payload->QosAckCnt            = JMsgMqttApp.MqttMgr.MqttInflight.AckCnt;
+   Payload->QosRetransmitCnt     = JMsgMqttApp.MqttMgr.MqttInflight.RetransmitCnt;
+
+   Payload->BrokerReceiveMax     = MQTT_CLIENT_ReceiveMax();
+   Payload->TopicAliasCnt        = JMsgMqttApp.MqttMgr.MqttClient.Mqtt5.OutAliasCnt;
+   Payload->TopicAliasPubCnt     = JMsgMqttApp.MqttMgr.MqttClient.Mqtt5.AliasPubCnt;
+   Payload->TopicAliasBytesSaved = JMsgMqttApp.MqttMgr.MqttClient.Mqtt5.AliasBytesSaved;
+
+   Payload->SpoolMsgCnt    = JMsgMqttApp.MqttMgr.MqttSpool.MsgCnt;
+   Payload->SpoolBytes     = JMsgMqttApp.MqttMgr.MqttSpool.Bytes;
+   Payload->SpoolDropCnt   = JMsgMqttApp.MqttMgr.MqttSpool.DropCnt;
+   Payload->SpoolReplayCnt = JMsgMqttApp.MqttMgr.MqttSpool.ReplayCnt;
+
+   Payload->JournalMsgCnt       = JMsgMqttApp.MqttMgr.MqttJournal.MsgCnt;
+   Payload->JournalBytes        = JMsgMqttApp.MqttMgr.MqttJournal.Bytes;
+   Payload->JournalAckCnt       = JMsgMqttApp.MqttMgr.MqttJournal.AckCnt;
+   Payload->JournalRecoveredCnt = JMsgMqttApp.MqttMgr.MqttJournal.RecoveredCnt;
+   Payload->JournalRecoveryTime = JMsgMqttApp.MqttMgr.MqttJournal.RecoveryTime;
+   Payload->JournalWriteAmp     = 0;
+   if (JMsgMqttApp.MqttMgr.MqttJournal.AppendBytes > 0)
+   {
+      Payload->JournalWriteAmp = (uint32)(((uint64)JMsgMqttApp.MqttMgr.MqttJournal.SyncBytes * 100) /
+                                          JMsgMqttApp.MqttMgr.MqttJournal.AppendBytes);
+   }
+
    CFE_SB_TimeStampMsg(CFE_MSG_PTR(JMsgMqttApp.StatusTlm.TelemetryHeader));
    CFE_SB_TransmitMsg(CFE_MSG_PTR(JMsgMqttApp.StatusTlm.TelemetryHeader), true);
 
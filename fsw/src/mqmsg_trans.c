@@ -33,6 +33,17 @@
 
 #include "mqmsg_trans.h"
 
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static bool AddTopicName(const char *Name, uint16 PluginId);
+static void DeflatePayload(int32 PluginId, const char **Payload, uint32 *PayloadLen);
+static bool RawToCfe(CFE_MSG_Message_t **CfeMsg, const JMSG_TOPIC_TBL_Topic_t *Topic,
+                     const void *Payload, uint32 PayloadLen);
+static void RemoveTopicName(const char *Name);
+
+
 /**********************/
 /** Global File Data **/
 /**********************/
@@ -52,134 +63,225 @@ void MQMSG_TRANS_Constructor(MQMSG_TRANS_Class_t *MqMsgTransPtr,
 
    CFE_PSP_MemSet((void*)MqMsgTransPtr, 0, sizeof(MQMSG_TRANS_Class_t));
    
+   MQTT_TOPIC_CFG_Constructor(&MqMsgTrans->TopicCfg, IniTbl);
+   MQTT_TOPIC_IDX_Constructor(&MqMsgTrans->TopicIdx);
+   MQTT_TOPIC_TRIE_Constructor(&MqMsgTrans->TopicTrie);
+   MQTT_ZLIB_Constructor(&MqMsgTrans->Zlib, IniTbl);
+   
 } /* End MQMSG_TRANS_Constructor() */
 
 
+/******************************************************************************
+** Function: MQMSG_TRANS_AddTopic
+**
+** Notes:
+**   1. The topic's plugin ID is found by name. This only occurs when a
+**      subscription is configured so it's not on the message path.
+**      PluginId is JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF if it isn't found.
+**   2. CBOR topics are also indexed by their CBOR topic name. The index
+**      doesn't copy names so the name is kept in CborInTopic.
+**
+*/
+bool MQMSG_TRANS_AddTopic(const JMSG_TOPIC_TBL_Topic_t *Topic, int32 *PluginId)
+{
+   
+   bool RetStatus = false;
+   enum JMSG_PLATFORM_TopicPlugin Plugin;
+   const JMSG_TOPIC_TBL_Topic_t *PluginTopic;
+   
+   *PluginId = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+   for (Plugin = JMSG_PLATFORM_TopicPlugin_Enum_t_MIN; Plugin < JMSG_PLATFORM_TopicPlugin_Enum_t_MAX; Plugin++)
+   {
+      PluginTopic = JMSG_TOPIC_TBL_GetTopic(Plugin);
+      if (PluginTopic == Topic || (PluginTopic != NULL && strcmp(PluginTopic->Name, Topic->Name) == 0))
+      {
+         *PluginId = Plugin;
+         RetStatus = AddTopicName(PluginTopic->Name, Plugin);
+         if (RetStatus && (MQTT_TOPIC_CFG_GetOpts(PluginTopic->Cfe) & MQTT_TOPIC_CFG_OPT_CBOR) &&
+             MQTT_TOPIC_CFG_CborTopic(MqMsgTrans->CborInTopic[Plugin], PluginTopic->Name))
+         {
+            RetStatus = AddTopicName(MqMsgTrans->CborInTopic[Plugin], Plugin);
+         }
+         break;
+      }
+   }
+   
+   if (!RetStatus)
+   {
+      CFE_EVS_SendEvent(MQMSG_TRANS_TOPIC_IDX_EID, CFE_EVS_EventType_ERROR,
+                        "Error adding topic %s to the MQTT topic index. Index entries %d, filter trie nodes %d of %d", 
+                        Topic->Name, MqMsgTrans->TopicIdx.EntryCnt, 
+                        MqMsgTrans->TopicTrie.NodeCnt, MQTT_TOPIC_TRIE_NODE_MAX);
+   }
+   
+   return RetStatus;
+   
+} /* End MQMSG_TRANS_AddTopic() */
+
+
 /******************************************************************************
 ** Function: MQMSG_TRANS_ProcessMqttMsg
 **
 ** Notes:
 **   1. Signature must match MQTT_CLIENT_MsgCallback_t
-**   2. MQTT has no delimeter between the topic and payload
+**   2. MQTT topic names aren't NUL terminated. The topic is located using
+**      the topic index so the cost doesn't depend on the number of topic
+**      plugins. Wildcard topic filters are only searched when there isn't
+**      an exact match.
+**   3. Raw topics skip the plugin's JSON translation and the header updates
+**      so the sender's message is sent unchanged.
+**   4. CBOR payloads are identified by the CBOR topic name suffix and are
+**      transcoded to JSON for the plugin.
+**   5. Compressed payloads are decompressed before they're decoded. The
+**      statistics and trace record the received payload length.
 **
 */
 void MQMSG_TRANS_ProcessMqttMsg(MessageData *MsgData)
 {
    
    MQTTMessage* MsgPtr = MsgData->message;
+   MQTTLenString *TopicName = &MsgData->topicName->lenstring;
 
-   enum JMSG_PLATFORM_TopicPlugin topic = JMSG_PLATFORM_TopicPlugin_Enum_t_MIN;
+   int32   PluginId;
+   uint16  Opts = MQTT_TOPIC_CFG_OPT_NONE;
+   bool    Raw;
+   bool    Cbor;
+   bool    Zlib;
+   bool    Valid = true;
+   const void *Payload = MsgPtr->payload;
+   uint32  PayloadLen  = MsgPtr->payloadlen;
+   uint32  JsonLen;
    uint16  TopicLen;
    char    TopicStr[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
-   bool    MsgFound = false;
-   const JMSG_TOPIC_TBL_Topic_t *Topic;
    JMSG_TOPIC_TBL_JsonToCfe_t JsonToCfe;
+   const JMSG_TOPIC_TBL_Topic_t *Topic;
    CFE_MSG_Message_t *CfeMsg;
    CFE_SB_MsgId_t    MsgId = CFE_SB_INVALID_MSG_ID;
    CFE_MSG_Size_t    MsgSize;
    CFE_MSG_Type_t    MsgType;
+   CFE_TIME_SysTime_t RcvTime = CFE_TIME_GetTime();
+   CFE_TIME_SysTime_t InflateTime;
+   CFE_TIME_SysTime_t XlateTime;
+   CFE_TIME_SysTime_t SendTime;
+   
+   TopicLen = (TopicName->len < JMSG_PLATFORM_TOPIC_NAME_MAX_LEN) ? TopicName->len : (JMSG_PLATFORM_TOPIC_NAME_MAX_LEN - 1);
+   memcpy(TopicStr, TopicName->data, TopicLen);
+   TopicStr[TopicLen] = '\0';
    
-   CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_DEBUG,
-                     "MQMSG_TRANS_ProcessMsg: Received topic %s", MsgData->topicName->lenstring.data);
-                    
    if(MsgPtr->payloadlen)
    {
       
-      CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_DEBUG,
-                        "MsgPtr->payloadlen=%d", (int)MsgPtr->payloadlen);
-
-      while (!MsgFound && topic < JMSG_PLATFORM_TopicPlugin_Enum_t_MAX)
+      PluginId = MQTT_TOPIC_IDX_Find(TopicName->data, TopicName->len);
+      if (PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
       {
-
-         Topic = JMSG_TOPIC_TBL_GetTopic(topic);
+         PluginId = MQTT_TOPIC_TRIE_Match(TopicName->data, TopicName->len);
+      }
+      
+      if (PluginId != JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
+      {
+            
+         Topic = JMSG_TOPIC_TBL_GetTopic(PluginId);
          if (Topic != NULL)
          {
-            
-            TopicLen = strlen(Topic->Name);
-            
-            if (TopicLen < JMSG_PLATFORM_TOPIC_NAME_MAX_LEN)
-            {
-               CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_DEBUG,
-                                 "Table topic name=%s, length=%d", Topic->Name, TopicLen);
-               if (strncmp(Topic->Name, MsgData->topicName->lenstring.data, TopicLen) == 0)
-               {
-                  MsgFound = true;
-                  memcpy(TopicStr, MsgData->topicName->lenstring.data, TopicLen);
-                  TopicStr[TopicLen] = '\0';
-                  CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_INFO_EID, CFE_EVS_EventType_INFORMATION,
-                                   "MQMSG_TRANS_ProcessMqttMsg: Topic=%s, Payload=%s", 
-                                    TopicStr, &MsgData->topicName->lenstring.data[TopicLen]);
-               }
-            } /* End if valid length */
-            else
+            Opts = MQTT_TOPIC_CFG_GetOpts(Topic->Cfe);
+         }
+         Raw  = (Opts & MQTT_TOPIC_CFG_OPT_RAW);
+         Cbor = (Opts & MQTT_TOPIC_CFG_OPT_CBOR) && (TopicName->len > MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN) &&
+                (memcmp(&TopicName->data[TopicName->len - MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN],
+                        MQTT_TOPIC_CFG_CBOR_SUFFIX, MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN) == 0);
+         Zlib = (Opts & MQTT_TOPIC_CFG_OPT_ZLIB) && MQTT_ZLIB_IsDeflated(Payload, PayloadLen);
+         
+         if (Zlib)
+         {
+            InflateTime = CFE_TIME_GetTime();
+            Valid = MQTT_ZLIB_Inflate(MqMsgTrans->ZlibInPayload, sizeof(MqMsgTrans->ZlibInPayload), &PayloadLen,
+                                      MsgPtr->payload, MsgPtr->payloadlen);
+            if (Valid)
             {
-               CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_ERROR,
-                                 "Table topic name %s with length %d exceeds maximum length %d", 
-                                 Topic->Name, TopicLen, JMSG_PLATFORM_TOPIC_NAME_MAX_LEN);               
+               MQTT_TOPIC_STATS_CountInflate(PluginId, &InflateTime);
+               Payload = MqMsgTrans->ZlibInPayload;
             }
          }
-         if (!MsgFound)
+         
+         if (Valid)
          {
-            topic++;
+            if (Raw)
+            {
+               Valid = RawToCfe(&CfeMsg, Topic, Payload, PayloadLen);
+            }
+            else
+            {
+               JsonToCfe = JMSG_TOPIC_TBL_GetJsonToCfe(PluginId);    
+               if (Cbor)
+               {
+                  Valid = MQTT_CBOR_ToJson(MqMsgTrans->CborInJson, sizeof(MqMsgTrans->CborInJson), &JsonLen,
+                                           Payload, PayloadLen) &&
+                          JsonToCfe(&CfeMsg, MqMsgTrans->CborInJson, JsonLen);
+               }
+               else
+               {
+                  Valid = JsonToCfe(&CfeMsg, (const char *)Payload, PayloadLen);
+               }
+            }
          }
-      } /* End while loop */
-
-      if (MsgFound)
-      {
-            
-         CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_DEBUG,
-                           "MQMSG_TRANS_ProcessMqttMsg: Found message at index %d", topic); 
-                              
-         JsonToCfe = JMSG_TOPIC_TBL_GetJsonToCfe(topic);    
        
-         if (JsonToCfe(&CfeMsg, &MsgData->topicName->lenstring.data[TopicLen], MsgPtr->payloadlen))
+         if (Valid)
          {         
       
-            CFE_MSG_GetMsgId(CfeMsg, &MsgId);
-            CFE_MSG_GetSize(CfeMsg, &MsgSize);
-            
-            CFE_MSG_GetType(CfeMsg,&MsgType);
-            CFE_MSG_GetTypeFromMsgId(MsgId, &MsgType);
-            if (MsgType == CFE_MSG_Type_Cmd)
-            {
-               CFE_MSG_GenerateChecksum(CFE_MSG_PTR(*CfeMsg));
-            }
-            else
+            if (!Raw)
             {
-               CFE_SB_TimeStampMsg(CFE_MSG_PTR(*CfeMsg));
+               CFE_MSG_GetMsgId(CfeMsg, &MsgId);
+               CFE_MSG_GetSize(CfeMsg, &MsgSize);
+               
+               CFE_MSG_GetType(CfeMsg,&MsgType);
+               CFE_MSG_GetTypeFromMsgId(MsgId, &MsgType);
+               if (MsgType == CFE_MSG_Type_Cmd)
+               {
+                  CFE_MSG_GenerateChecksum(CFE_MSG_PTR(*CfeMsg));
+               }
+               else
+               {
+                  CFE_SB_TimeStampMsg(CFE_MSG_PTR(*CfeMsg));
+               }
             }
             
-            CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_INFO_EID, CFE_EVS_EventType_INFORMATION,
-                              "MQMSG_TRANS_ProcessMqttMsg: Sending SB message 0x%04X(%d), len %d, type %d", 
-                              CFE_SB_MsgIdToValue(MsgId), CFE_SB_MsgIdToValue(MsgId), (int)MsgSize, (int)MsgType); 
-            CFE_SB_TransmitMsg(CFE_MSG_PTR(*CfeMsg), true);               
+            XlateTime = CFE_TIME_GetTime();
+            CFE_SB_TransmitMsg(CFE_MSG_PTR(*CfeMsg), !Raw);               
+            SendTime = CFE_TIME_GetTime();
+            MQTT_LATENCY_Record(MQTT_LATENCY_MQTT_XLATE, PluginId, &RcvTime, &XlateTime);
+            MQTT_LATENCY_Record(MQTT_LATENCY_SB_SEND, PluginId, &XlateTime, &SendTime);
+            MQTT_LATENCY_Record(MQTT_LATENCY_IN_TOTAL, PluginId, &RcvTime, &SendTime);
             MqMsgTrans->ValidMqttMsgCnt++;
+            MQTT_TOPIC_STATS_CountMqttMsg(PluginId, MsgPtr->payloadlen);
+            MQTT_TRACE_Write(MQTT_TRACE_DIR_MQTT_TO_SB, MQTT_TRACE_RESULT_OK, PluginId, MsgPtr->payloadlen);
             
          }
          else
          {
             MqMsgTrans->InvalidMqttMsgCnt++;
+            MQTT_TOPIC_STATS_CountXlateErr(PluginId);
+            MQTT_TRACE_Write(MQTT_TRACE_DIR_MQTT_TO_SB, MQTT_TRACE_RESULT_XLATE_ERR, PluginId, MsgPtr->payloadlen);
             CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_ERROR,
-                              "MQMSG_TRANS_ProcessMqttMsg: Error creating SB message from JSON topic %s, Id %d",
-                               TopicStr, topic); 
+                              "MQMSG_TRANS_ProcessMqttMsg: Error creating SB message from %s%s topic %s, Id %d",
+                               Zlib ? "compressed " : "", Raw ? "raw" : (Cbor ? "CBOR" : "JSON"),
+                               TopicStr, (int)PluginId); 
          }
          
       } /* End if message found */
       else 
       {      
+         MQTT_TRACE_Write(MQTT_TRACE_DIR_MQTT_TO_SB, MQTT_TRACE_RESULT_UNKNOWN_TOPIC, MQTT_TRACE_TOPIC_UNDEF, MsgPtr->payloadlen);
          CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_ERROR, 
-                           "MQMSG_TRANS_ProcessMqttMsg: Could not find a topic match for %s", 
-                           MsgData->topicName->lenstring.data);      
+                           "MQMSG_TRANS_ProcessMqttMsg: Could not find a topic match for %s", TopicStr);      
       }
    
    } /* End null message len */
    else {
       
+      MQTT_TRACE_Write(MQTT_TRACE_DIR_MQTT_TO_SB, MQTT_TRACE_RESULT_EMPTY_MSG, MQTT_TRACE_TOPIC_UNDEF, 0);
       CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_MQTT_MSG_EID, CFE_EVS_EventType_ERROR,
-                        "Null MQTT message data length for %s", MsgData->topicName->lenstring.data);
+                        "Null MQTT message data length for %s", TopicStr);
    }
-   
-   fflush(stdout);
 
 } /* End MQMSG_TRANS_ProcessMqttMsg() */
 
@@ -188,11 +290,12 @@ void MQMSG_TRANS_ProcessMqttMsg(MessageData *MsgData)
 ** Function: MQMSG_TRANS_ProcessSbMsg
 **
 ** Notes:
-**   None
+**   1. Compression is applied after the payload is encoded so the
+**      statistics and trace record the published payload length.
 **
 */
-bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPtr,
-                              const char **Topic, const char **Payload)
+bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPtr, int32 *PluginId,
+                              const char **Topic, const char **Payload, uint32 *PayloadLen)
 {
    
    bool RetStatus = false;
@@ -200,45 +303,113 @@ bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPtr,
    int32 SbStatus;
    CFE_SB_MsgId_t  MsgId = CFE_SB_INVALID_MSG_ID;
    JMSG_TOPIC_TBL_CfeToJson_t CfeToJson;
+   const JMSG_TOPIC_TBL_Topic_t *RawTopic;
+   CFE_MSG_Size_t MsgSize;
    const char *JsonMsgTopic;
    const char *JsonMsgPayload;
+   uint32 JsonMsgLen;
+   uint32 CborLen;
+   uint16 Opts;
+   bool   Cbor;
 
+   *PluginId = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
    *Topic   = NULL; 
    *Payload = NULL;
+   *PayloadLen = 0;
    SbStatus = CFE_MSG_GetMsgId(CfeMsgPtr, &MsgId);
    if (SbStatus == CFE_SUCCESS)
    {
    
-      CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_EID, CFE_EVS_EventType_DEBUG, 
-                        "MQMSG_TRANS_ProcessSbMsg: Received SB message ID 0x%04X(%d)", 
-                        CFE_SB_MsgIdToValue(MsgId), CFE_SB_MsgIdToValue(MsgId)); 
-      
       if ((TopicIndex = JMSG_TOPIC_TBL_MsgIdToTopicPlugin(MsgId)) != JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
       {
          
-         CfeToJson = JMSG_TOPIC_TBL_GetCfeToJson(TopicIndex, &JsonMsgTopic);    
+         *PluginId = TopicIndex;
+         Opts = MQTT_TOPIC_CFG_GetOpts(CFE_SB_MsgIdToValue(MsgId));
          
-         if (CfeToJson(&JsonMsgPayload, CfeMsgPtr))
+         if (Opts & MQTT_TOPIC_CFG_OPT_RAW)
          {
-            *Topic   = JsonMsgTopic; 
-            *Payload = JsonMsgPayload;
-            RetStatus = true;
-            CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_INFO_EID, CFE_EVS_EventType_INFORMATION,
-                              "MQMSG_TRANS_ProcessMqttMsg: Created MQTT topic %s message %s",
-                              JsonMsgTopic, JsonMsgPayload);             
-            MqMsgTrans->ValidSbMsgCnt++;
-
-         }
+            
+            RawTopic = JMSG_TOPIC_TBL_GetTopic(TopicIndex);
+            CFE_MSG_GetSize(CfeMsgPtr, &MsgSize);
+            
+            if (RawTopic != NULL && MsgSize <= MQTT_TOPIC_SB_MSG_MAX_LEN)
+            {
+               *Topic   = RawTopic->Name;
+               *Payload = (const char *)CfeMsgPtr;
+               *PayloadLen = MsgSize;
+               if (Opts & MQTT_TOPIC_CFG_OPT_ZLIB)
+               {
+                  DeflatePayload(TopicIndex, Payload, PayloadLen);
+               }
+               RetStatus = true;
+               MqMsgTrans->ValidSbMsgCnt++;
+               MQTT_TOPIC_STATS_CountSbMsg(TopicIndex, *PayloadLen);
+               MQTT_TRACE_Write(MQTT_TRACE_DIR_SB_TO_MQTT, MQTT_TRACE_RESULT_OK, TopicIndex, *PayloadLen);
+            }
+            else
+            {
+               MqMsgTrans->InvalidSbMsgCnt++;
+               MQTT_TOPIC_STATS_CountXlateErr(TopicIndex);
+               MQTT_TRACE_Write(MQTT_TRACE_DIR_SB_TO_MQTT, MQTT_TRACE_RESULT_XLATE_ERR, TopicIndex, 0);
+               CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_EID, CFE_EVS_EventType_ERROR,
+                                 "MQMSG_TRANS_ProcessSbMsg: Raw message 0x%04X length %d exceeds the %d byte maximum",
+                                 CFE_SB_MsgIdToValue(MsgId), (int)MsgSize, MQTT_TOPIC_SB_MSG_MAX_LEN); 
+            }
+            
+         } /* End if raw */
          else
          {
-            MqMsgTrans->InvalidSbMsgCnt++;
-            CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_EID, CFE_EVS_EventType_ERROR,
-                              "MQMSG_TRANS_ProcessMqttMsg: Error creating JSON message from SB for topic index %d", TopicIndex); 
          
-         }        
+            CfeToJson = JMSG_TOPIC_TBL_GetCfeToJson(TopicIndex, &JsonMsgTopic);
+            Cbor = (Opts & MQTT_TOPIC_CFG_OPT_CBOR);
+         
+            if (CfeToJson(&JsonMsgPayload, CfeMsgPtr))
+            {
+               JsonMsgLen = strlen(JsonMsgPayload);
+               if (Cbor)
+               {
+                  RetStatus = MQTT_TOPIC_CFG_CborTopic(MqMsgTrans->CborOutTopic, JsonMsgTopic) &&
+                              MQTT_CBOR_FromJson(MqMsgTrans->CborOutPayload, sizeof(MqMsgTrans->CborOutPayload),
+                                                 &CborLen, JsonMsgPayload, JsonMsgLen);
+                  JsonMsgTopic   = MqMsgTrans->CborOutTopic;
+                  JsonMsgPayload = (const char *)MqMsgTrans->CborOutPayload;
+                  JsonMsgLen     = CborLen;
+               }
+               else
+               {
+                  RetStatus = true;
+               }
+            }
+            
+            if (RetStatus)
+            {
+               *Topic   = JsonMsgTopic;
+               *Payload = JsonMsgPayload;
+               *PayloadLen = JsonMsgLen;
+               if (Opts & MQTT_TOPIC_CFG_OPT_ZLIB)
+               {
+                  DeflatePayload(TopicIndex, Payload, PayloadLen);
+               }
+               MqMsgTrans->ValidSbMsgCnt++;
+               MQTT_TOPIC_STATS_CountSbMsg(TopicIndex, *PayloadLen);
+               MQTT_TRACE_Write(MQTT_TRACE_DIR_SB_TO_MQTT, MQTT_TRACE_RESULT_OK, TopicIndex, *PayloadLen);
+
+            }
+            else
+            {
+               MqMsgTrans->InvalidSbMsgCnt++;
+               MQTT_TOPIC_STATS_CountXlateErr(TopicIndex);
+               MQTT_TRACE_Write(MQTT_TRACE_DIR_SB_TO_MQTT, MQTT_TRACE_RESULT_XLATE_ERR, TopicIndex, 0);
+               CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_EID, CFE_EVS_EventType_ERROR,
+                                 "MQMSG_TRANS_ProcessMqttMsg: Error creating %s message from SB for topic index %d",
+                                 Cbor ? "CBOR" : "JSON", TopicIndex);
+         
+            }
+         } /* End if JSON */
       }
       else
       {
+         MQTT_TRACE_Write(MQTT_TRACE_DIR_SB_TO_MQTT, MQTT_TRACE_RESULT_UNKNOWN_TOPIC, MQTT_TRACE_TOPIC_UNDEF, 0);
          CFE_EVS_SendEvent(MQMSG_TRANS_PROCESS_SB_MSG_EID, CFE_EVS_EventType_ERROR, 
                            "MQMSG_TRANS_ProcessMsg: Unable to locate SB message 0x%04X(%d) in MQTT topic table", 
                            CFE_SB_MsgIdToValue(MsgId), CFE_SB_MsgIdToValue(MsgId));
@@ -256,6 +427,26 @@ bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPtr,
 } /* End MQMSG_TRANS_ProcessSbMsg() */
 
 
+/******************************************************************************
+** Function: MQMSG_TRANS_RemoveTopic
+**
+*/
+void MQMSG_TRANS_RemoveTopic(const JMSG_TOPIC_TBL_Topic_t *Topic)
+{
+   
+   char CborTopic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   
+   RemoveTopicName(Topic->Name);
+   
+   if ((MQTT_TOPIC_CFG_GetOpts(Topic->Cfe) & MQTT_TOPIC_CFG_OPT_CBOR) &&
+       MQTT_TOPIC_CFG_CborTopic(CborTopic, Topic->Name))
+   {
+      RemoveTopicName(CborTopic);
+   }
+   
+} /* End MQMSG_TRANS_RemoveTopic() */
+
+
 /******************************************************************************
 ** Function: MQMSG_TRANS_ResetStatus
 **
@@ -271,3 +462,98 @@ void MQMSG_TRANS_ResetStatus(void)
    MqMsgTrans->InvalidSbMsgCnt   = 0;
 
 } /* MQMSG_TRANS_ResetStatus() */
+
+
+/******************************************************************************
+** Function: AddTopicName
+**
+** Add a topic name to the topic index or a topic filter to the filter trie.
+**
+*/
+static bool AddTopicName(const char *Name, uint16 PluginId)
+{
+   
+   if (MQTT_TOPIC_TRIE_IsFilter(Name))
+   {
+      return MQTT_TOPIC_TRIE_Add(Name, PluginId);
+   }
+   
+   return MQTT_TOPIC_IDX_Add(Name, PluginId);
+   
+} /* End AddTopicName() */
+
+
+/******************************************************************************
+** Function: DeflatePayload
+**
+** Replace a payload with its compressed form when MQTT_ZLIB compresses it.
+** Otherwise the payload is left unchanged.
+**
+*/
+static void DeflatePayload(int32 PluginId, const char **Payload, uint32 *PayloadLen)
+{
+
+   CFE_TIME_SysTime_t StartTime = CFE_TIME_GetTime();
+   uint32 DeflateLen;
+
+   if (MQTT_ZLIB_Deflate(MqMsgTrans->ZlibOutPayload, sizeof(MqMsgTrans->ZlibOutPayload), &DeflateLen,
+                         *Payload, *PayloadLen))
+   {
+      MQTT_TOPIC_STATS_CountDeflate(PluginId, *PayloadLen, DeflateLen, &StartTime);
+      *Payload    = (const char *)MqMsgTrans->ZlibOutPayload;
+      *PayloadLen = DeflateLen;
+   }
+
+} /* End DeflatePayload() */
+
+
+/******************************************************************************
+** Function: RawToCfe
+**
+** Validate a raw topic payload and copy it to an aligned SB message.
+**
+** Notes:
+**   1. The payload must be a complete cFE message whose header length
+**      matches the payload length and whose message ID matches the topic.
+**
+*/
+static bool RawToCfe(CFE_MSG_Message_t **CfeMsg, const JMSG_TOPIC_TBL_Topic_t *Topic,
+                     const void *Payload, uint32 PayloadLen)
+{
+
+   CFE_SB_MsgId_t  MsgId = CFE_SB_INVALID_MSG_ID;
+   CFE_MSG_Size_t  MsgSize = 0;
+
+   if (PayloadLen < sizeof(CFE_MSG_Message_t) || PayloadLen > MQTT_TOPIC_SB_MSG_MAX_LEN)
+   {
+      return false;
+   }
+
+   memcpy(MqMsgTrans->RawMsg.Byte, Payload, PayloadLen);
+   *CfeMsg = &MqMsgTrans->RawMsg.SbBuf.Msg;
+
+   CFE_MSG_GetMsgId(*CfeMsg, &MsgId);
+   CFE_MSG_GetSize(*CfeMsg, &MsgSize);
+
+   return (MsgSize == PayloadLen && CFE_SB_MsgIdToValue(MsgId) == Topic->Cfe);
+
+} /* End RawToCfe() */
+
+
+/******************************************************************************
+** Function: RemoveTopicName
+**
+*/
+static void RemoveTopicName(const char *Name)
+{
+   
+   if (MQTT_TOPIC_TRIE_IsFilter(Name))
+   {
+      MQTT_TOPIC_TRIE_Remove(Name);
+   }
+   else
+   {
+      MQTT_TOPIC_IDX_Remove(Name);
+   }
+   
+} /* End RemoveTopicName() */
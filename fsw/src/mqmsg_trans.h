@@ -36,6 +36,14 @@
 
 #include "app_cfg.h"
 #include "jmsg_topic_tbl.h"
+#include "mqtt_cbor.h"
+#include "mqtt_latency.h"
+#include "mqtt_topic_cfg.h"
+#include "mqtt_topic_idx.h"
+#include "mqtt_topic_stats.h"
+#include "mqtt_topic_trie.h"
+#include "mqtt_trace.h"
+#include "mqtt_zlib.h"
 
 /***********************/
 /** Macro Definitions **/
@@ -50,6 +58,7 @@
 #define MQMSG_TRANS_PROCESS_MQTT_MSG_INFO_EID (MQMSG_TRANS_BASE_EID + 1)
 #define MQMSG_TRANS_PROCESS_SB_MSG_EID        (MQMSG_TRANS_BASE_EID + 2)
 #define MQMSG_TRANS_PROCESS_SB_MSG_INFO_EID   (MQMSG_TRANS_BASE_EID + 3)
+#define MQMSG_TRANS_TOPIC_IDX_EID             (MQMSG_TRANS_BASE_EID + 4)
 
 
 /**********************/
@@ -76,6 +85,19 @@ typedef struct
 }  JSON_MSG_Pkt_t;
 
 
+/*
+** Raw inbound messages are copied so the SB message is aligned
+*/
+
+typedef union
+{
+
+   CFE_SB_Buffer_t  SbBuf;
+   uint8            Byte[MQTT_TOPIC_SB_MSG_MAX_LEN];
+
+} MQMSG_TRANS_RawMsg_t;
+
+
 /*
 ** Class Definition
 */
@@ -93,6 +115,35 @@ typedef struct
    */
    
    JSON_MSG_Pkt_t  JsonMsgPkt;
+   
+   MQMSG_TRANS_RawMsg_t  RawMsg;
+   
+   /*
+   ** CBOR transcoding. The outbound buffers are only used by the main task
+   ** and the inbound buffers by the network owner. CborInTopic holds the
+   ** indexed CBOR topic names.
+   */
+   
+   char   CborOutTopic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   uint8  CborOutPayload[MQTT_PUBQ_PACKET_MAX_LEN];
+   char   CborInJson[MQTT_CLIENT_READ_BUF_LEN];
+   char   CborInTopic[JMSG_PLATFORM_TOPIC_PLUGIN_MAX][JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   
+   /*
+   ** Compression. Used by the same tasks as the CBOR buffers.
+   */
+   
+   uint8  ZlibOutPayload[MQTT_PUBQ_PACKET_MAX_LEN];
+   uint8  ZlibInPayload[MQTT_CLIENT_READ_BUF_LEN];
+   
+   /*
+   ** Contained Objects
+   */
+   
+   MQTT_TOPIC_CFG_Class_t   TopicCfg;
+   MQTT_TOPIC_IDX_Class_t   TopicIdx;
+   MQTT_TOPIC_TRIE_Class_t  TopicTrie;
+   MQTT_ZLIB_Class_t        Zlib;
       
 } MQMSG_TRANS_Class_t;
 
@@ -113,11 +164,30 @@ void MQMSG_TRANS_Constructor(MQMSG_TRANS_Class_t *MsgTransPtr,
                              const INITBL_Class_t *IniTbl);
 
 
+/******************************************************************************
+** Function: MQMSG_TRANS_AddTopic
+**
+** Add a topic to the inbound MQTT topic index
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**   2. Topic names containing '+' or '#' wildcards are added to the topic
+**      filter trie.
+**   3. PluginId returns the topic's plugin ID.
+**
+*/
+bool MQMSG_TRANS_AddTopic(const JMSG_TOPIC_TBL_Topic_t *Topic, int32 *PluginId);
+
+
 /******************************************************************************
 ** Function: MQMSG_TRANS_ProcessMqttMsg
 **
 ** Notes:
 **   1. Signature must mach MQTT_CLIENT_MsgCallback
+**   2. Raw topic payloads are validated and sent on the SB unchanged. The
+**      message's sequence count, time and checksum are those of the sender.
+**   3. Compressed payloads on topics with the zlib option are decompressed
+**      before they're translated.
 **
 */
 void MQMSG_TRANS_ProcessMqttMsg(MessageData *MsgData);
@@ -127,11 +197,32 @@ void MQMSG_TRANS_ProcessMqttMsg(MessageData *MsgData);
 ** Function: MQMSG_TRANS_ProcessSbMsg
 **
 ** Notes:
-**   None
+**   1. PluginId is JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF if the message ID isn't
+**      in the topic table.
+**   2. Payload is the plugin's JSON buffer that is reused on the next
+**      translation. PayloadLen excludes the NUL terminator.
+**   3. Raw topics aren't translated. Payload points to CfeMsgPtr's bytes,
+**      isn't NUL terminated and PayloadLen is the cFE message's size.
+**   4. CBOR topics return the CBOR topic name and payload. The payload
+**      isn't NUL terminated.
+**   5. Payloads of topics with the zlib option may be compressed. A
+**      compressed payload isn't NUL terminated.
+**
+*/
+bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPt, int32 *PluginId,
+                            const char **Topic, const char **Payload, uint32 *PayloadLen);
+
+
+/******************************************************************************
+** Function: MQMSG_TRANS_RemoveTopic
+**
+** Remove a topic from the inbound MQTT topic index
+**
+** Notes:
+**   1. Must only be called by the network owner task.
 **
 */
-bool MQMSG_TRANS_ProcessSbMsg(const CFE_MSG_Message_t *CfeMsgPt,
-                            const char **Topic, const char **Payload);
+void MQMSG_TRANS_RemoveTopic(const JMSG_TOPIC_TBL_Topic_t *Topic);
 
 
 /******************************************************************************
@@ -0,0 +1,502 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Track the health of the MQTT broker failover list
+**
+** Notes:
+**   None
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mqtt_broker.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+/* Longest MQTT_BROKER_LIST entry */
+#define ENTRY_STR_LEN  (MQTT_BROKER_HOST_LEN + 8)
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void   EndConnection(MQTT_BROKER_Endpoint_t *Endpoint);
+static uint64 HealthScore(const MQTT_BROKER_Endpoint_t *Endpoint, uint64 Now);
+static bool   ScoreStale(const MQTT_BROKER_Endpoint_t *Endpoint, uint64 Now);
+static uint64 MonotonicNs(void);
+static bool   ParseEndpoint(MQTT_BROKER_Endpoint_t *Endpoint, const char *EntryStr, uint32 DefPort);
+static int16  SelectIndex(void);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_BROKER_Class_t *MqttBroker = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Constructor
+**
+** Notes:
+**   1. The constructor's connect is made to endpoint 0 so it's active.
+**
+*/
+void MQTT_BROKER_Constructor(MQTT_BROKER_Class_t *MqttBrokerPtr,
+                             const INITBL_Class_t *IniTbl)
+{
+
+   const char *CfgStr;
+   char   EntryStr[ENTRY_STR_LEN];
+   uint32 EntryLen;
+   uint32 DefPort;
+
+   MqttBroker = MqttBrokerPtr;
+
+   CFE_PSP_MemSet((void*)MqttBroker, 0, sizeof(MQTT_BROKER_Class_t));
+
+   MqttBroker->FailoverRttUs = INITBL_GetIntConfig(IniTbl, CFG_MQTT_FAILOVER_RTT_MS) * 1000;
+
+   DefPort = INITBL_GetIntConfig(IniTbl, CFG_MQTT_BROKER_PORT);
+   strncpy(MqttBroker->Endpoint[0].Host, INITBL_GetStrConfig(IniTbl, CFG_MQTT_BROKER_ADDRESS), MQTT_BROKER_HOST_LEN - 1);
+   MqttBroker->Endpoint[0].Port = DefPort;
+   MqttBroker->Cnt = 1;
+
+   CfgStr = INITBL_GetStrConfig(IniTbl, CFG_MQTT_BROKER_LIST);
+   if (strcmp(CfgStr, "UNDEF") != 0)
+   {
+      while (*CfgStr != '\0')
+      {
+         EntryLen = strcspn(CfgStr, ",");
+         if (EntryLen > 0)
+         {
+            memset(EntryStr, 0, sizeof(EntryStr));
+            strncpy(EntryStr, CfgStr, (EntryLen < ENTRY_STR_LEN) ? EntryLen : (ENTRY_STR_LEN - 1));
+            if (MqttBroker->Cnt >= MQTT_BROKER_MAX)
+            {
+               CFE_EVS_SendEvent(MQTT_BROKER_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                                 "MQTT_BROKER_LIST exceeds %d brokers, ignoring %s",
+                                 (MQTT_BROKER_MAX - 1), EntryStr);
+            }
+            else if (EntryLen < ENTRY_STR_LEN && ParseEndpoint(&MqttBroker->Endpoint[MqttBroker->Cnt], EntryStr, DefPort))
+            {
+               MqttBroker->Cnt++;
+            }
+            else
+            {
+               CFE_EVS_SendEvent(MQTT_BROKER_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                                 "Invalid MQTT_BROKER_LIST entry %s, it must be host:port", EntryStr);
+            }
+         }
+         CfgStr += EntryLen;
+         if (*CfgStr == ',')
+         {
+            CfgStr++;
+         }
+      }
+   }
+
+   MqttBroker->Active     = 0;
+   MqttBroker->Attempting = true;
+   MqttBroker->AttemptTime = MonotonicNs();
+
+} /* End MQTT_BROKER_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Connected
+**
+** Notes:
+**   1. A stale round trip time is discarded so the broker is scored by its
+**      current connection.
+**
+*/
+void MQTT_BROKER_Connected(void)
+{
+
+   MQTT_BROKER_Endpoint_t *Endpoint;
+   uint64 Now = MonotonicNs();
+
+   if (MqttBroker->Active != MQTT_BROKER_NONE && MqttBroker->Attempting)
+   {
+      Endpoint = &MqttBroker->Endpoint[MqttBroker->Active];
+      if (ScoreStale(Endpoint, Now))
+      {
+         Endpoint->SrttUs = 0;
+      }
+      Endpoint->ConnectCnt++;
+      Endpoint->RecentFailCnt = 0;
+      Endpoint->ConnectMs = (uint32)((Now - MqttBroker->AttemptTime) / 1000000);
+      Endpoint->UpTime    = Now;
+      Endpoint->ScoreTime = Now;
+   }
+   MqttBroker->Attempting = false;
+
+} /* End MQTT_BROKER_Connected() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_ConnectStart
+**
+*/
+void MQTT_BROKER_ConnectStart(const char *Host, uint32 Port)
+{
+
+   uint16 i;
+
+   if (MqttBroker->Active != MQTT_BROKER_NONE)
+   {
+      EndConnection(&MqttBroker->Endpoint[MqttBroker->Active]);
+   }
+
+   MqttBroker->Active = MQTT_BROKER_NONE;
+   for (i = 0; i < MqttBroker->Cnt; i++)
+   {
+      if (MqttBroker->Endpoint[i].Port == Port && strcmp(MqttBroker->Endpoint[i].Host, Host) == 0)
+      {
+         MqttBroker->Active = i;
+         break;
+      }
+   }
+
+   MqttBroker->Attempting  = true;
+   MqttBroker->AttemptTime = MonotonicNs();
+
+} /* End MQTT_BROKER_ConnectStart() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Failed
+**
+*/
+void MQTT_BROKER_Failed(void)
+{
+
+   MQTT_BROKER_Endpoint_t *Endpoint;
+   uint64 Now = MonotonicNs();
+
+   if (MqttBroker->Active != MQTT_BROKER_NONE)
+   {
+      Endpoint = &MqttBroker->Endpoint[MqttBroker->Active];
+      if (MqttBroker->Attempting || Endpoint->UpTime != 0)
+      {
+         if (ScoreStale(Endpoint, Now))
+         {
+            Endpoint->RecentFailCnt = 0;
+         }
+         EndConnection(Endpoint);
+         Endpoint->FailCnt++;
+         Endpoint->RecentFailCnt++;
+         Endpoint->ScoreTime = Now;
+      }
+   }
+   MqttBroker->Attempting = false;
+
+} /* End MQTT_BROKER_Failed() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_RecordRtt
+**
+*/
+bool MQTT_BROKER_RecordRtt(uint32 RttUs)
+{
+
+   bool   RetStatus = false;
+   int32  Delta;
+   MQTT_BROKER_Endpoint_t *Endpoint;
+
+   if (MqttBroker->Active != MQTT_BROKER_NONE)
+   {
+      Endpoint = &MqttBroker->Endpoint[MqttBroker->Active];
+      if (Endpoint->SrttUs == 0)
+      {
+         Endpoint->SrttUs = (RttUs > 0) ? RttUs : 1;
+      }
+      else
+      {
+         Delta = ((int32)RttUs - (int32)Endpoint->SrttUs) / 8;
+         Endpoint->SrttUs = (uint32)((int32)Endpoint->SrttUs + Delta);
+      }
+      Endpoint->ScoreTime = MonotonicNs();
+
+      if (MqttBroker->FailoverRttUs > 0 && Endpoint->SrttUs > MqttBroker->FailoverRttUs &&
+          Endpoint->UpTime != 0 &&
+          (MonotonicNs() - Endpoint->UpTime) >= (uint64)MQTT_BROKER_FAILOVER_HOLD_SEC * 1000000000 &&
+          SelectIndex() != MqttBroker->Active)
+      {
+         MqttBroker->FailoverCnt++;
+         RetStatus = true;
+      }
+   }
+
+   return RetStatus;
+
+} /* End MQTT_BROKER_RecordRtt() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_ResetStatus
+**
+*/
+void MQTT_BROKER_ResetStatus(void)
+{
+
+   uint16 i;
+   uint64 Now = MonotonicNs();
+
+   MqttBroker->FailoverCnt = 0;
+
+   for (i = 0; i < MqttBroker->Cnt; i++)
+   {
+      MqttBroker->Endpoint[i].ConnectCnt = 0;
+      MqttBroker->Endpoint[i].FailCnt    = 0;
+      MqttBroker->Endpoint[i].UptimeSec  = 0;
+      if (MqttBroker->Endpoint[i].UpTime != 0)
+      {
+         MqttBroker->Endpoint[i].UpTime = Now;
+      }
+   }
+
+} /* End MQTT_BROKER_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Select
+**
+*/
+const MQTT_BROKER_Endpoint_t *MQTT_BROKER_Select(void)
+{
+
+   return &MqttBroker->Endpoint[SelectIndex()];
+
+} /* End MQTT_BROKER_Select() */
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_UptimeSec
+**
+** Notes:
+**   1. Read by the app's main task so the connection start is copied once.
+**
+*/
+uint32 MQTT_BROKER_UptimeSec(uint16 Index)
+{
+
+   uint32 UptimeSec = 0;
+   uint64 UpTime;
+
+   if (Index < MqttBroker->Cnt)
+   {
+      UptimeSec = MqttBroker->Endpoint[Index].UptimeSec;
+      UpTime    = MqttBroker->Endpoint[Index].UpTime;
+      if (UpTime != 0)
+      {
+         UptimeSec += (uint32)((MonotonicNs() - UpTime) / 1000000000);
+      }
+   }
+
+   return UptimeSec;
+
+} /* End MQTT_BROKER_UptimeSec() */
+
+
+/******************************************************************************
+** Function: EndConnection
+**
+** Add a connection's time to its broker's uptime
+**
+*/
+static void EndConnection(MQTT_BROKER_Endpoint_t *Endpoint)
+{
+
+   if (Endpoint->UpTime != 0)
+   {
+      Endpoint->UptimeSec += (uint32)((MonotonicNs() - Endpoint->UpTime) / 1000000000);
+      Endpoint->UpTime = 0;
+   }
+
+} /* End EndConnection() */
+
+
+/******************************************************************************
+** Function: HealthScore
+**
+** Return a broker's health score in microseconds, lower is healthier
+**
+** Notes:
+**   1. Untried and stale brokers get a neutral score, see the header's
+**      notes.
+**
+*/
+static uint64 HealthScore(const MQTT_BROKER_Endpoint_t *Endpoint, uint64 Now)
+{
+
+   uint64 Score;
+
+   if (ScoreStale(Endpoint, Now))
+   {
+      Score = (MqttBroker->FailoverRttUs > 0) ? MqttBroker->FailoverRttUs : 
+                                                (uint64)MQTT_BROKER_UNTRIED_SCORE_MS * 1000;
+   }
+   else
+   {
+      Score = (Endpoint->SrttUs > 0) ? Endpoint->SrttUs : (uint64)Endpoint->ConnectMs * 1000;
+      Score += (uint64)Endpoint->RecentFailCnt * MQTT_BROKER_FAIL_PENALTY_MS * 1000;
+   }
+
+   return Score;
+
+} /* End HealthScore() */
+
+
+/******************************************************************************
+** Function: MonotonicNs
+**
+*/
+static uint64 MonotonicNs(void)
+{
+
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return ((uint64)Now.tv_sec * 1000000000ULL + (uint64)Now.tv_nsec);
+
+} /* End MonotonicNs() */
+
+
+/******************************************************************************
+** Function: ParseEndpoint
+**
+** Parse a host:port, [IPv6 address]:port or host entry
+**
+*/
+static bool ParseEndpoint(MQTT_BROKER_Endpoint_t *Endpoint, const char *EntryStr, uint32 DefPort)
+{
+
+   const char *Host = EntryStr;
+   const char *HostEnd;
+   const char *PortStr = NULL;
+   char  *PortEnd;
+   uint32 HostLen;
+   unsigned long Port = DefPort;
+
+   if (*EntryStr == '[')
+   {
+      Host++;
+      HostEnd = strchr(Host, ']');
+      if (HostEnd == NULL || (HostEnd[1] != ':' && HostEnd[1] != '\0'))
+      {
+         return false;
+      }
+      if (HostEnd[1] == ':')
+      {
+         PortStr = &HostEnd[2];
+      }
+   }
+   else
+   {
+      HostEnd = strchr(Host, ':');
+      if (HostEnd == NULL)
+      {
+         HostEnd = Host + strlen(Host);
+      }
+      else
+      {
+         PortStr = &HostEnd[1];
+      }
+   }
+
+   if (PortStr != NULL)
+   {
+      Port = strtoul(PortStr, &PortEnd, 10);
+      if (PortEnd == PortStr || *PortEnd != '\0')
+      {
+         return false;
+      }
+   }
+
+   HostLen = (uint32)(HostEnd - Host);
+   if (HostLen == 0 || HostLen >= MQTT_BROKER_HOST_LEN || Port == 0 || Port > 0xFFFF)
+   {
+      return false;
+   }
+
+   memcpy(Endpoint->Host, Host, HostLen);
+   Endpoint->Host[HostLen] = '\0';
+   Endpoint->Port = (uint32)Port;
+
+   return true;
+
+} /* End ParseEndpoint() */
+
+
+/******************************************************************************
+** Function: ScoreStale
+**
+** Return true when a broker is untried or it isn't connected and hasn't
+** been scored for MQTT_BROKER_SCORE_STALE_SEC
+**
+*/
+static bool ScoreStale(const MQTT_BROKER_Endpoint_t *Endpoint, uint64 Now)
+{
+
+   return (Endpoint->ScoreTime == 0 || 
+           (Endpoint->UpTime == 0 && 
+            (Now - Endpoint->ScoreTime) >= (uint64)MQTT_BROKER_SCORE_STALE_SEC * 1000000000));
+
+} /* End ScoreStale() */
+
+
+/******************************************************************************
+** Function: SelectIndex
+**
+** Return the index of the healthiest broker
+**
+*/
+static int16 SelectIndex(void)
+{
+
+   uint64 Now = MonotonicNs();
+   int16  Best = 0;
+   uint64 BestScore = HealthScore(&MqttBroker->Endpoint[0], Now);
+   uint64 Score;
+   uint16 i;
+
+   for (i = 1; i < MqttBroker->Cnt; i++)
+   {
+      Score = HealthScore(&MqttBroker->Endpoint[i], Now);
+      if (Score < BestScore)
+      {
+         Best      = i;
+         BestScore = Score;
+      }
+   }
+
+   return Best;
+
+} /* End SelectIndex() */
@@ -0,0 +1,212 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Track the health of the MQTT broker failover list
+**
+** Notes:
+**   1. Endpoint 0 is MQTT_BROKER_ADDRESS:MQTT_BROKER_PORT and
+**      MQTT_BROKER_LIST adds alternates in failover order.
+**   2. A broker's health score is its smoothed PINGREQ round trip time,
+**      or its connect time before a round trip has been measured, plus
+**      MQTT_BROKER_FAIL_PENALTY_MS for each failure since it was last
+**      connected. Lower is healthier and ties go to the earlier endpoint.
+**   3. An untried broker scores MQTT_FAILOVER_RTT_MS, or
+**      MQTT_BROKER_UNTRIED_SCORE_MS when RTT failover is disabled, so a
+**      measured healthy broker is preferred to it and it's preferred to a
+**      degraded or failing broker. A broker that isn't connected and hasn't
+**      been scored for MQTT_BROKER_SCORE_STALE_SEC scores like an untried
+**      broker so a broker that was failed away from can be returned to.
+**   4. A commanded connect to a broker that isn't listed isn't tracked.
+**   5. Only the network owner task calls these functions except
+**      MQTT_BROKER_UptimeSec() that's used for telemetry.
+**
+*/
+#ifndef _mqtt_broker_
+#define _mqtt_broker_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_BROKER_CONSTRUCTOR_EID  (MQTT_BROKER_BASE_EID + 0)
+
+#define MQTT_BROKER_HOST_LEN   64
+#define MQTT_BROKER_NONE       (-1)
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** UpTime is the CLOCK_MONOTONIC ns time the current connection started
+** and is zero when the broker isn't connected. ScoreTime is also a
+** CLOCK_MONOTONIC ns time.
+*/
+
+typedef struct
+{
+
+   char    Host[MQTT_BROKER_HOST_LEN];
+   uint32  Port;
+
+   uint32  ConnectCnt;
+   uint32  FailCnt;          /* Connect failures and lost connections */
+   uint16  RecentFailCnt;    /* Failures since the last successful connect */
+   uint32  ConnectMs;        /* Last connect time, start to CONNACK */
+   uint32  SrttUs;           /* Smoothed round trip time, zero until measured */
+   uint32  UptimeSec;        /* Connected time before the current connection */
+   uint64  UpTime;
+   uint64  ScoreTime;        /* Last connect, failure or round trip sample, zero when untried */
+
+} MQTT_BROKER_Endpoint_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint32  FailoverRttUs;
+
+   uint16  Cnt;
+   int16   Active;           /* Endpoint being connected or connected to */
+   bool    Attempting;
+   uint64  AttemptTime;
+
+   uint32  FailoverCnt;      /* Failovers caused by a high round trip time */
+
+   MQTT_BROKER_Endpoint_t  Endpoint[MQTT_BROKER_MAX];
+
+} MQTT_BROKER_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_BROKER instance.
+**   2. Invalid MQTT_BROKER_LIST entries are reported in an event and
+**      ignored. An entry without a port uses MQTT_BROKER_PORT.
+**
+*/
+void MQTT_BROKER_Constructor(MQTT_BROKER_Class_t *MqttBrokerPtr,
+                             const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Connected
+**
+** Record a successful connect to the active broker
+**
+*/
+void MQTT_BROKER_Connected(void);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_ConnectStart
+**
+** Make the broker being connected to the active broker
+**
+** Notes:
+**   1. The previous broker's connection is closed by the connect so its
+**      uptime is accumulated without a failure.
+**
+*/
+void MQTT_BROKER_ConnectStart(const char *Host, uint32 Port);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Failed
+**
+** Record a failed connect or a lost connection to the active broker
+**
+** Notes:
+**   1. Only the first call after a connect starts or completes counts so
+**      it can be called for every error that follows a failure.
+**
+*/
+void MQTT_BROKER_Failed(void);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_RecordRtt
+**
+** Add a round trip time sample to the active broker and return true when
+** it should be failed over.
+**
+** Notes:
+**   1. The smoothed time is updated with a 1/8 gain like TCP's SRTT.
+**   2. A broker is failed over when MQTT_FAILOVER_RTT_MS is non-zero, its
+**      smoothed time exceeds it, it has been connected for
+**      MQTT_BROKER_FAILOVER_HOLD_SEC and MQTT_BROKER_Select() returns
+**      another broker. The failover is counted.
+**
+*/
+bool MQTT_BROKER_RecordRtt(uint32 RttUs);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+** Notes:
+**   1. The health scores aren't reset because they select the broker.
+**
+*/
+void MQTT_BROKER_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_Select
+**
+** Return the healthiest broker
+**
+*/
+const MQTT_BROKER_Endpoint_t *MQTT_BROKER_Select(void);
+
+
+/******************************************************************************
+** Function: MQTT_BROKER_UptimeSec
+**
+** Return a broker's total connected time including the current connection
+**
+*/
+uint32 MQTT_BROKER_UptimeSec(uint16 Index);
+
+
+#endif /* _mqtt_broker_ */
@@ -0,0 +1,1030 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Transcode topic payloads between JSON and CBOR (RFC 8949)
+**
+** Notes:
+**   1. See mqtt_cbor.h for the supported subset.
+**   2. Containers and strings are encoded with a one byte head that is
+**      widened once the item's length is known. Most field names and
+**      topic objects are short enough that the body isn't moved.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mqtt_cbor.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+/* Major types */
+#define CBOR_UINT    0
+#define CBOR_NINT    1
+#define CBOR_BYTES   2
+#define CBOR_TEXT    3
+#define CBOR_ARRAY   4
+#define CBOR_MAP     5
+#define CBOR_TAG     6
+#define CBOR_SIMPLE  7
+
+/* Additional information values */
+#define CBOR_INFO_UINT8    24
+#define CBOR_INFO_UINT16   25
+#define CBOR_INFO_UINT32   26
+#define CBOR_INFO_UINT64   27
+#define CBOR_INFO_INDEF    31
+
+#define CBOR_FALSE   0xF4
+#define CBOR_TRUE    0xF5
+#define CBOR_NULL    0xF6
+#define CBOR_UNDEF   0xF7
+#define CBOR_HALF    0xF9
+#define CBOR_FLOAT   0xFA
+#define CBOR_DOUBLE  0xFB
+#define CBOR_BREAK   0xFF
+
+#define JSON_NUMBER_MAX_LEN  64
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   const char  *Json;
+   const char  *JsonEnd;
+   uint8       *Buf;
+   uint32      BufLen;
+   uint32      Len;
+
+} Encoder_t;
+
+typedef struct
+{
+
+   const uint8  *Cbor;
+   const uint8  *CborEnd;
+   char         *Buf;
+   uint32       BufLen;
+   uint32       Len;
+
+} Decoder_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static bool   Append(Decoder_t *Dec, const char *Str, uint32 StrLen);
+static bool   DecodeArg(Decoder_t *Dec, uint8 Info, uint64 *Arg);
+static bool   DecodeFloat(Decoder_t *Dec, double Value, bool Single);
+static bool   DecodeItem(Decoder_t *Dec, uint16 Depth);
+static bool   DecodeText(Decoder_t *Dec, uint64 TextLen);
+static bool   EncodeContainer(Encoder_t *Enc, uint16 Depth, uint8 Major, char Close);
+static bool   EncodeHead(Encoder_t *Enc, uint8 Major, uint64 Arg);
+static bool   EncodeLiteral(Encoder_t *Enc, const char *Literal, uint8 Simple);
+static bool   EncodeNumber(Encoder_t *Enc);
+static bool   EncodeString(Encoder_t *Enc);
+static bool   EncodeValue(Encoder_t *Enc, uint16 Depth);
+static bool   FinishHead(Encoder_t *Enc, uint32 Start, uint8 Major, uint64 Arg);
+static double HalfToDouble(uint16 Half);
+static uint32 HeadLen(uint64 Arg);
+static bool   PutByte(Encoder_t *Enc, uint8 Byte);
+static bool   PutUtf8(Encoder_t *Enc, uint32 CodePoint);
+static int32  ReadHex4(Encoder_t *Enc);
+static void   SkipSpace(Encoder_t *Enc);
+
+
+/******************************************************************************
+** Function: MQTT_CBOR_FromJson
+**
+*/
+bool MQTT_CBOR_FromJson(uint8 *CborBuf, uint32 CborBufLen, uint32 *CborLen,
+                        const char *Json, uint32 JsonLen)
+{
+
+   bool RetStatus;
+   Encoder_t Enc;
+
+   Enc.Json    = Json;
+   Enc.JsonEnd = Json + JsonLen;
+   Enc.Buf     = CborBuf;
+   Enc.BufLen  = CborBufLen;
+   Enc.Len     = 0;
+
+   RetStatus = EncodeValue(&Enc, 0);
+   if (RetStatus)
+   {
+      SkipSpace(&Enc);
+      RetStatus = (Enc.Json == Enc.JsonEnd || *Enc.Json == '\0');
+   }
+
+   *CborLen = RetStatus ? Enc.Len : 0;
+
+   return RetStatus;
+
+} /* End MQTT_CBOR_FromJson() */
+
+
+/******************************************************************************
+** Function: MQTT_CBOR_ToJson
+**
+*/
+bool MQTT_CBOR_ToJson(char *JsonBuf, uint32 JsonBufLen, uint32 *JsonLen,
+                      const uint8 *Cbor, uint32 CborLen)
+{
+
+   bool RetStatus = false;
+   Decoder_t Dec;
+
+   Dec.Cbor    = Cbor;
+   Dec.CborEnd = Cbor + CborLen;
+   Dec.Buf     = JsonBuf;
+   Dec.BufLen  = JsonBufLen;
+   Dec.Len     = 0;
+
+   if (JsonBufLen > 0)
+   {
+      RetStatus = DecodeItem(&Dec, 0) && (Dec.Cbor == Dec.CborEnd) && (Dec.Len < JsonBufLen);
+      JsonBuf[RetStatus ? Dec.Len : 0] = '\0';
+   }
+
+   *JsonLen = RetStatus ? Dec.Len : 0;
+
+   return RetStatus;
+
+} /* End MQTT_CBOR_ToJson() */
+
+
+/******************************************************************************
+** Function: Append
+**
+** Append JSON text leaving room for the NUL terminator.
+**
+*/
+static bool Append(Decoder_t *Dec, const char *Str, uint32 StrLen)
+{
+
+   if ((Dec->Len + StrLen) >= Dec->BufLen)
+   {
+      return false;
+   }
+
+   memcpy(&Dec->Buf[Dec->Len], Str, StrLen);
+   Dec->Len += StrLen;
+
+   return true;
+
+} /* End Append() */
+
+
+/******************************************************************************
+** Function: DecodeArg
+**
+** Decode an item head's argument that follows the initial byte.
+**
+*/
+static bool DecodeArg(Decoder_t *Dec, uint8 Info, uint64 *Arg)
+{
+
+   uint32 ArgLen;
+   uint32 i;
+
+   if (Info < CBOR_INFO_UINT8)
+   {
+      *Arg = Info;
+      return true;
+   }
+   if (Info > CBOR_INFO_UINT64)
+   {
+      return false;
+   }
+
+   ArgLen = 1 << (Info - CBOR_INFO_UINT8);
+   if ((uint32)(Dec->CborEnd - Dec->Cbor) < ArgLen)
+   {
+      return false;
+   }
+
+   *Arg = 0;
+   for (i = 0; i < ArgLen; i++)
+   {
+      *Arg = (*Arg << 8) | *Dec->Cbor++;
+   }
+
+   return true;
+
+} /* End DecodeArg() */
+
+
+/******************************************************************************
+** Function: DecodeFloat
+**
+** Notes:
+**   1. JSON can't represent NaN or infinity so they're written as null.
+**   2. The shorter of the two precisions that round trips is used so a
+**      value like 0.1 isn't written with 17 digits.
+**
+*/
+static bool DecodeFloat(Decoder_t *Dec, double Value, bool Single)
+{
+
+   char   Number[JSON_NUMBER_MAX_LEN];
+   int    NumberLen;
+   double Parsed;
+
+   if (!isfinite(Value))
+   {
+      return Append(Dec, "null", 4);
+   }
+
+   NumberLen = snprintf(Number, sizeof(Number), Single ? "%.7g" : "%.15g", Value);
+   Parsed = strtod(Number, NULL);
+   if (Single ? ((float)Parsed != (float)Value) : (Parsed != Value))
+   {
+      NumberLen = snprintf(Number, sizeof(Number), Single ? "%.9g" : "%.17g", Value);
+   }
+
+   return Append(Dec, Number, NumberLen);
+
+} /* End DecodeFloat() */
+
+
+/******************************************************************************
+** Function: DecodeItem
+**
+*/
+static bool DecodeItem(Decoder_t *Dec, uint16 Depth)
+{
+
+   bool   RetStatus = false;
+   uint8  Initial;
+   uint8  Major;
+   uint8  Info;
+   uint64 Arg = 0;
+   uint64 i;
+   bool   Indefinite;
+   char   Number[JSON_NUMBER_MAX_LEN];
+   int    NumberLen;
+   union
+   {
+      uint32 U;
+      float  F;
+   } Single;
+   union
+   {
+      uint64 U;
+      double D;
+   } Double;
+
+   if (Dec->Cbor >= Dec->CborEnd || Depth > MQTT_CBOR_MAX_DEPTH)
+   {
+      return false;
+   }
+
+   Initial = *Dec->Cbor++;
+   Major   = Initial >> 5;
+   Info    = Initial & 0x1F;
+
+   Indefinite = (Info == CBOR_INFO_INDEF) && (Major == CBOR_ARRAY || Major == CBOR_MAP);
+   if (!Indefinite && Major != CBOR_SIMPLE && !DecodeArg(Dec, Info, &Arg))
+   {
+      return false;
+   }
+
+   switch (Major)
+   {
+
+      case CBOR_UINT:
+         NumberLen = snprintf(Number, sizeof(Number), "%llu", (unsigned long long)Arg);
+         RetStatus = Append(Dec, Number, NumberLen);
+         break;
+
+      case CBOR_NINT:
+         /* -1 - Arg, printed without overflowing a signed 64-bit value */
+         if (Arg == UINT64_MAX)
+         {
+            NumberLen = snprintf(Number, sizeof(Number), "-18446744073709551616");
+         }
+         else
+         {
+            NumberLen = snprintf(Number, sizeof(Number), "-%llu", (unsigned long long)(Arg + 1));
+         }
+         RetStatus = Append(Dec, Number, NumberLen);
+         break;
+
+      case CBOR_TEXT:
+         RetStatus = DecodeText(Dec, Arg);
+         break;
+
+      case CBOR_ARRAY:
+      case CBOR_MAP:
+         RetStatus = Append(Dec, (Major == CBOR_MAP) ? "{" : "[", 1);
+         for (i = 0; RetStatus && (Indefinite || i < Arg); i++)
+         {
+            if (Indefinite)
+            {
+               if (Dec->Cbor >= Dec->CborEnd)
+               {
+                  RetStatus = false;
+                  break;
+               }
+               if (*Dec->Cbor == CBOR_BREAK)
+               {
+                  Dec->Cbor++;
+                  break;
+               }
+            }
+            if (i > 0)
+            {
+               RetStatus = Append(Dec, ",", 1);
+            }
+            if (RetStatus && Major == CBOR_MAP)
+            {
+               /* JSON object member names must be strings */
+               RetStatus = (Dec->Cbor < Dec->CborEnd) && ((*Dec->Cbor >> 5) == CBOR_TEXT) &&
+                           DecodeItem(Dec, Depth + 1) && Append(Dec, ":", 1);
+            }
+            RetStatus = RetStatus && DecodeItem(Dec, Depth + 1);
+         }
+         RetStatus = RetStatus && Append(Dec, (Major == CBOR_MAP) ? "}" : "]", 1);
+         break;
+
+      case CBOR_TAG:
+         RetStatus = DecodeItem(Dec, Depth + 1);
+         break;
+
+      case CBOR_SIMPLE:
+         switch (Initial)
+         {
+            case CBOR_FALSE:
+               RetStatus = Append(Dec, "false", 5);
+               break;
+            case CBOR_TRUE:
+               RetStatus = Append(Dec, "true", 4);
+               break;
+            case CBOR_NULL:
+            case CBOR_UNDEF:
+               RetStatus = Append(Dec, "null", 4);
+               break;
+            case CBOR_HALF:
+               if (DecodeArg(Dec, Info, &Arg))
+               {
+                  RetStatus = DecodeFloat(Dec, HalfToDouble((uint16)Arg), true);
+               }
+               break;
+            case CBOR_FLOAT:
+               if (DecodeArg(Dec, Info, &Arg))
+               {
+                  Single.U  = (uint32)Arg;
+                  RetStatus = DecodeFloat(Dec, Single.F, true);
+               }
+               break;
+            case CBOR_DOUBLE:
+               if (DecodeArg(Dec, Info, &Arg))
+               {
+                  Double.U  = Arg;
+                  RetStatus = DecodeFloat(Dec, Double.D, false);
+               }
+               break;
+            default:
+               break;
+         }
+         break;
+
+      default:
+         /* Byte strings have no JSON representation */
+         break;
+
+   } /* End major type switch */
+
+   return RetStatus;
+
+} /* End DecodeItem() */
+
+
+/******************************************************************************
+** Function: DecodeText
+**
+** Write a CBOR text string as a JSON string.
+**
+*/
+static bool DecodeText(Decoder_t *Dec, uint64 TextLen)
+{
+
+   static const char Hex[] = "0123456789abcdef";
+
+   const uint8 *Text = Dec->Cbor;
+   const uint8 *TextEnd;
+   const uint8 *Run;
+   char Escape[6] = { '\\', 'u', '0', '0', 0, 0 };
+
+   if (TextLen > (uint64)(Dec->CborEnd - Dec->Cbor))
+   {
+      return false;
+   }
+   TextEnd = Text + TextLen;
+   Dec->Cbor = TextEnd;
+
+   if (!Append(Dec, "\"", 1))
+   {
+      return false;
+   }
+
+   while (Text < TextEnd)
+   {
+      /* Copy runs that don't need escaping in one call */
+      for (Run = Text; Run < TextEnd && *Run >= 0x20 && *Run != '"' && *Run != '\\'; Run++)
+      {
+      }
+      if (!Append(Dec, (const char *)Text, Run - Text))
+      {
+         return false;
+      }
+      if (Run < TextEnd)
+      {
+         if (*Run == '"' || *Run == '\\')
+         {
+            Escape[1] = *Run;
+            if (!Append(Dec, Escape, 2))
+            {
+               return false;
+            }
+            Escape[1] = 'u';
+         }
+         else
+         {
+            Escape[4] = Hex[*Run >> 4];
+            Escape[5] = Hex[*Run & 0x0F];
+            if (!Append(Dec, Escape, 6))
+            {
+               return false;
+            }
+         }
+         Run++;
+      }
+      Text = Run;
+   }
+
+   return Append(Dec, "\"", 1);
+
+} /* End DecodeText() */
+
+
+/******************************************************************************
+** Function: EncodeContainer
+**
+** Encode a JSON object as a map or a JSON array as an array.
+**
+*/
+static bool EncodeContainer(Encoder_t *Enc, uint16 Depth, uint8 Major, char Close)
+{
+
+   uint32 Start = Enc->Len;
+   uint64 ItemCnt = 0;
+
+   if (Depth >= MQTT_CBOR_MAX_DEPTH || !PutByte(Enc, 0))
+   {
+      return false;
+   }
+
+   Enc->Json++;
+   SkipSpace(Enc);
+
+   if (Enc->Json < Enc->JsonEnd && *Enc->Json == Close)
+   {
+      Enc->Json++;
+      return FinishHead(Enc, Start, Major, 0);
+   }
+
+   while (true)
+   {
+      if (Major == CBOR_MAP)
+      {
+         SkipSpace(Enc);
+         if (Enc->Json >= Enc->JsonEnd || *Enc->Json != '"' || !EncodeString(Enc))
+         {
+            return false;
+         }
+         SkipSpace(Enc);
+         if (Enc->Json >= Enc->JsonEnd || *Enc->Json != ':')
+         {
+            return false;
+         }
+         Enc->Json++;
+      }
+
+      if (!EncodeValue(Enc, Depth + 1))
+      {
+         return false;
+      }
+      ItemCnt++;
+
+      SkipSpace(Enc);
+      if (Enc->Json >= Enc->JsonEnd)
+      {
+         return false;
+      }
+      if (*Enc->Json == Close)
+      {
+         Enc->Json++;
+         break;
+      }
+      if (*Enc->Json != ',')
+      {
+         return false;
+      }
+      Enc->Json++;
+   }
+
+   return FinishHead(Enc, Start, Major, ItemCnt);
+
+} /* End EncodeContainer() */
+
+
+/******************************************************************************
+** Function: EncodeHead
+**
+** Encode an item's initial byte and argument using the shortest form.
+**
+*/
+static bool EncodeHead(Encoder_t *Enc, uint8 Major, uint64 Arg)
+{
+
+   uint32 ArgLen = HeadLen(Arg) - 1;
+   uint8  Info;
+
+   if ((Enc->Len + ArgLen + 1) > Enc->BufLen)
+   {
+      return false;
+   }
+
+   switch (ArgLen)
+   {
+      case 0:  Info = (uint8)Arg;        break;
+      case 1:  Info = CBOR_INFO_UINT8;   break;
+      case 2:  Info = CBOR_INFO_UINT16;  break;
+      case 4:  Info = CBOR_INFO_UINT32;  break;
+      default: Info = CBOR_INFO_UINT64;  break;
+   }
+
+   Enc->Buf[Enc->Len++] = (Major << 5) | Info;
+   while (ArgLen > 0)
+   {
+      ArgLen--;
+      Enc->Buf[Enc->Len++] = (uint8)(Arg >> (8 * ArgLen));
+   }
+
+   return true;
+
+} /* End EncodeHead() */
+
+
+/******************************************************************************
+** Function: EncodeLiteral
+**
+*/
+static bool EncodeLiteral(Encoder_t *Enc, const char *Literal, uint8 Simple)
+{
+
+   uint32 LiteralLen = strlen(Literal);
+
+   if ((uint32)(Enc->JsonEnd - Enc->Json) < LiteralLen || strncmp(Enc->Json, Literal, LiteralLen) != 0)
+   {
+      return false;
+   }
+   Enc->Json += LiteralLen;
+
+   return PutByte(Enc, Simple);
+
+} /* End EncodeLiteral() */
+
+
+/******************************************************************************
+** Function: EncodeNumber
+**
+** Notes:
+**   1. Numbers that don't fit in a 64-bit integer are encoded as floats.
+**
+*/
+static bool EncodeNumber(Encoder_t *Enc)
+{
+
+   char   Number[JSON_NUMBER_MAX_LEN];
+   char   *NumberEnd;
+   uint32 NumberLen = 0;
+   bool   Integer = true;
+   int64  IntValue;
+   uint64 UintValue;
+   double Value;
+   union
+   {
+      uint32 U;
+      float  F;
+   } Single;
+   union
+   {
+      uint64 U;
+      double D;
+   } Double;
+
+   while (Enc->Json < Enc->JsonEnd && NumberLen < (JSON_NUMBER_MAX_LEN - 1) &&
+          strchr("+-0123456789.eE", *Enc->Json) != NULL && *Enc->Json != '\0')
+   {
+      if (*Enc->Json == '.' || *Enc->Json == 'e' || *Enc->Json == 'E')
+      {
+         Integer = false;
+      }
+      Number[NumberLen++] = *Enc->Json++;
+   }
+   Number[NumberLen] = '\0';
+
+   if (NumberLen == 0)
+   {
+      return false;
+   }
+
+   if (Integer)
+   {
+      errno = 0;
+      if (Number[0] == '-')
+      {
+         IntValue = strtoll(Number, &NumberEnd, 10);
+         if (errno == 0 && *NumberEnd == '\0')
+         {
+            return (IntValue < 0) ? EncodeHead(Enc, CBOR_NINT, (uint64)(-1 - IntValue))
+                                  : EncodeHead(Enc, CBOR_UINT, 0);
+         }
+      }
+      else
+      {
+         UintValue = strtoull(Number, &NumberEnd, 10);
+         if (errno == 0 && *NumberEnd == '\0')
+         {
+            return EncodeHead(Enc, CBOR_UINT, UintValue);
+         }
+      }
+   }
+
+   Value = strtod(Number, &NumberEnd);
+   if (NumberEnd != &Number[NumberLen])
+   {
+      return false;
+   }
+
+   Single.F = (float)Value;
+   if ((double)Single.F == Value)
+   {
+      return PutByte(Enc, CBOR_FLOAT) &&
+             PutByte(Enc, Single.U >> 24) && PutByte(Enc, Single.U >> 16) &&
+             PutByte(Enc, Single.U >> 8)  && PutByte(Enc, Single.U);
+   }
+
+   Double.D = Value;
+   return PutByte(Enc, CBOR_DOUBLE) &&
+          PutByte(Enc, Double.U >> 56) && PutByte(Enc, Double.U >> 48) &&
+          PutByte(Enc, Double.U >> 40) && PutByte(Enc, Double.U >> 32) &&
+          PutByte(Enc, Double.U >> 24) && PutByte(Enc, Double.U >> 16) &&
+          PutByte(Enc, Double.U >> 8)  && PutByte(Enc, Double.U);
+
+} /* End EncodeNumber() */
+
+
+/******************************************************************************
+** Function: EncodeString
+**
+** Encode a JSON string as a text string decoding escape sequences.
+**
+*/
+static bool EncodeString(Encoder_t *Enc)
+{
+
+   uint32 Start = Enc->Len;
+   int32  CodePoint;
+   int32  LowSurrogate;
+   char   Escaped;
+
+   if (!PutByte(Enc, 0))
+   {
+      return false;
+   }
+   Enc->Json++;
+
+   while (Enc->Json < Enc->JsonEnd && *Enc->Json != '"')
+   {
+      if (*Enc->Json != '\\')
+      {
+         if ((uint8)*Enc->Json < 0x20 || !PutByte(Enc, *Enc->Json))
+         {
+            return false;
+         }
+         Enc->Json++;
+         continue;
+      }
+
+      if (++Enc->Json >= Enc->JsonEnd)
+      {
+         return false;
+      }
+      Escaped = *Enc->Json++;
+      switch (Escaped)
+      {
+         case '"':
+         case '\\':
+         case '/': CodePoint = Escaped; break;
+         case 'b': CodePoint = '\b';    break;
+         case 'f': CodePoint = '\f';    break;
+         case 'n': CodePoint = '\n';    break;
+         case 'r': CodePoint = '\r';    break;
+         case 't': CodePoint = '\t';    break;
+         case 'u':
+            CodePoint = ReadHex4(Enc);
+            if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF)
+            {
+               if ((Enc->JsonEnd - Enc->Json) < 2 || Enc->Json[0] != '\\' || Enc->Json[1] != 'u')
+               {
+                  return false;
+               }
+               Enc->Json += 2;
+               LowSurrogate = ReadHex4(Enc);
+               if (LowSurrogate < 0xDC00 || LowSurrogate > 0xDFFF)
+               {
+                  return false;
+               }
+               CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+            }
+            break;
+         default:
+            return false;
+      }
+      if (CodePoint < 0 || !PutUtf8(Enc, CodePoint))
+      {
+         return false;
+      }
+   }
+
+   if (Enc->Json >= Enc->JsonEnd)
+   {
+      return false;
+   }
+   Enc->Json++;
+
+   return FinishHead(Enc, Start, CBOR_TEXT, Enc->Len - Start - 1);
+
+} /* End EncodeString() */
+
+
+/******************************************************************************
+** Function: EncodeValue
+**
+*/
+static bool EncodeValue(Encoder_t *Enc, uint16 Depth)
+{
+
+   SkipSpace(Enc);
+   if (Enc->Json >= Enc->JsonEnd)
+   {
+      return false;
+   }
+
+   switch (*Enc->Json)
+   {
+      case '{': return EncodeContainer(Enc, Depth, CBOR_MAP, '}');
+      case '[': return EncodeContainer(Enc, Depth, CBOR_ARRAY, ']');
+      case '"': return EncodeString(Enc);
+      case 't': return EncodeLiteral(Enc, "true", CBOR_TRUE);
+      case 'f': return EncodeLiteral(Enc, "false", CBOR_FALSE);
+      case 'n': return EncodeLiteral(Enc, "null", CBOR_NULL);
+      default:  return EncodeNumber(Enc);
+   }
+
+} /* End EncodeValue() */
+
+
+/******************************************************************************
+** Function: FinishHead
+**
+** Write the head of an item whose body follows the one byte placeholder at
+** Start, moving the body if the head needs more than one byte.
+**
+*/
+static bool FinishHead(Encoder_t *Enc, uint32 Start, uint8 Major, uint64 Arg)
+{
+
+   uint32 Extra = HeadLen(Arg) - 1;
+   uint32 BodyLen = Enc->Len - Start - 1;
+   uint32 End = Enc->Len;
+
+   if (Extra > 0)
+   {
+      if ((Enc->Len + Extra) > Enc->BufLen)
+      {
+         return false;
+      }
+      memmove(&Enc->Buf[Start + 1 + Extra], &Enc->Buf[Start + 1], BodyLen);
+      End += Extra;
+   }
+
+   Enc->Len = Start;
+   EncodeHead(Enc, Major, Arg);
+   Enc->Len = End;
+
+   return true;
+
+} /* End FinishHead() */
+
+
+/******************************************************************************
+** Function: HalfToDouble
+**
+*/
+static double HalfToDouble(uint16 Half)
+{
+
+   int    Exp  = (Half >> 10) & 0x1F;
+   int    Mant = Half & 0x3FF;
+   double Value;
+
+   if (Exp == 0)
+   {
+      Value = ldexp(Mant, -24);
+   }
+   else if (Exp != 31)
+   {
+      Value = ldexp(Mant + 1024, Exp - 25);
+   }
+   else
+   {
+      Value = (Mant == 0) ? INFINITY : NAN;
+   }
+
+   return (Half & 0x8000) ? -Value : Value;
+
+} /* End HalfToDouble() */
+
+
+/******************************************************************************
+** Function: HeadLen
+**
+** Bytes needed to encode an item head with argument Arg
+**
+*/
+static uint32 HeadLen(uint64 Arg)
+{
+
+   if (Arg < CBOR_INFO_UINT8)
+   {
+      return 1;
+   }
+   else if (Arg <= 0xFF)
+   {
+      return 2;
+   }
+   else if (Arg <= 0xFFFF)
+   {
+      return 3;
+   }
+   else if (Arg <= 0xFFFFFFFF)
+   {
+      return 5;
+   }
+
+   return 9;
+
+} /* End HeadLen() */
+
+
+/******************************************************************************
+** Function: PutByte
+**
+*/
+static bool PutByte(Encoder_t *Enc, uint8 Byte)
+{
+
+   if (Enc->Len >= Enc->BufLen)
+   {
+      return false;
+   }
+
+   Enc->Buf[Enc->Len++] = Byte;
+
+   return true;
+
+} /* End PutByte() */
+
+
+/******************************************************************************
+** Function: PutUtf8
+**
+*/
+static bool PutUtf8(Encoder_t *Enc, uint32 CodePoint)
+{
+
+   if (CodePoint < 0x80)
+   {
+      return PutByte(Enc, CodePoint);
+   }
+   else if (CodePoint < 0x800)
+   {
+      return PutByte(Enc, 0xC0 | (CodePoint >> 6)) &&
+             PutByte(Enc, 0x80 | (CodePoint & 0x3F));
+   }
+   else if (CodePoint < 0x10000)
+   {
+      return PutByte(Enc, 0xE0 | (CodePoint >> 12)) &&
+             PutByte(Enc, 0x80 | ((CodePoint >> 6) & 0x3F)) &&
+             PutByte(Enc, 0x80 | (CodePoint & 0x3F));
+   }
+
+   return PutByte(Enc, 0xF0 | (CodePoint >> 18)) &&
+          PutByte(Enc, 0x80 | ((CodePoint >> 12) & 0x3F)) &&
+          PutByte(Enc, 0x80 | ((CodePoint >> 6) & 0x3F)) &&
+          PutByte(Enc, 0x80 | (CodePoint & 0x3F));
+
+} /* End PutUtf8() */
+
+
+/******************************************************************************
+** Function: ReadHex4
+**
+** Read the four hex digits of a \u escape. Returns -1 if they're invalid.
+**
+*/
+static int32 ReadHex4(Encoder_t *Enc)
+{
+
+   int32 Value = 0;
+   int   i;
+   char  Digit;
+
+   if ((Enc->JsonEnd - Enc->Json) < 4)
+   {
+      return -1;
+   }
+
+   for (i = 0; i < 4; i++)
+   {
+      Digit = *Enc->Json++;
+      Value <<= 4;
+      if (Digit >= '0' && Digit <= '9')
+      {
+         Value |= Digit - '0';
+      }
+      else if (Digit >= 'a' && Digit <= 'f')
+      {
+         Value |= Digit - 'a' + 10;
+      }
+      else if (Digit >= 'A' && Digit <= 'F')
+      {
+         Value |= Digit - 'A' + 10;
+      }
+      else
+      {
+         return -1;
+      }
+   }
+
+   return Value;
+
+} /* End ReadHex4() */
+
+
+/******************************************************************************
+** Function: SkipSpace
+**
+*/
+static void SkipSpace(Encoder_t *Enc)
+{
+
+   while (Enc->Json < Enc->JsonEnd &&
+          (*Enc->Json == ' ' || *Enc->Json == '\t' || *Enc->Json == '\n' || *Enc->Json == '\r'))
+   {
+      Enc->Json++;
+   }
+
+} /* End SkipSpace() */
@@ -0,0 +1,80 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Transcode topic payloads between JSON and CBOR (RFC 8949)
+**
+** Notes:
+**   1. The topic plugins define each topic's fields as JSON so CBOR
+**      payloads are transcoded from and to the plugins' JSON. This keeps
+**      the field names and structure identical in both encodings.
+**   2. JSON objects, arrays, strings, numbers, true, false and null are
+**      supported. Integers that fit in 64 bits are encoded as CBOR
+**      integers. Other numbers are encoded as a single precision float
+**      when that's exact and as a double otherwise.
+**   3. Encoded maps, arrays and strings use definite lengths. Decoding
+**      also accepts indefinite length maps and arrays, half precision
+**      floats and ignores tags. Byte strings and non-string map keys
+**      can't be represented in JSON and are rejected.
+**   4. The functions don't keep any state so they can be called by
+**      either task.
+**
+*/
+#ifndef _mqtt_cbor_
+#define _mqtt_cbor_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_CBOR_FromJson
+**
+** Encode a JSON payload as CBOR
+**
+** Notes:
+**   1. Json doesn't need to be NUL terminated.
+**   2. Returns false if the JSON is invalid, nested more than
+**      MQTT_CBOR_MAX_DEPTH levels or the encoding exceeds CborBufLen.
+**
+*/
+bool MQTT_CBOR_FromJson(uint8 *CborBuf, uint32 CborBufLen, uint32 *CborLen,
+                        const char *Json, uint32 JsonLen);
+
+
+/******************************************************************************
+** Function: MQTT_CBOR_ToJson
+**
+** Decode a CBOR payload to JSON
+**
+** Notes:
+**   1. JsonBuf is NUL terminated and JsonLen excludes the terminator.
+**   2. Returns false if the CBOR is invalid, can't be represented in JSON,
+**      is nested more than MQTT_CBOR_MAX_DEPTH levels or the JSON
+**      exceeds JsonBufLen.
+**
+*/
+bool MQTT_CBOR_ToJson(char *JsonBuf, uint32 JsonBufLen, uint32 *JsonLen,
+                      const uint8 *Cbor, uint32 CborLen);
+
+
+#endif /* _mqtt_cbor_ */
@@ -29,19 +29,54 @@
 ** Include Files:
 */
 
+#include <errno.h>
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include "mqtt_client.h"
 
 
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define CONNECT_TIMEOUT_NS  ((uint64)MQTT_CLIENT_TIMEOUT_MS * 1000000)
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void AbortConnect(void);
+static bool ConnectFallback(const char *Reason);
+static int  DecodeConnAck(int PacketLen);
+static void LostConnection(void);
+static uint64 MonotonicNs(void);
+static uint16 NextPacketId(void);
+static bool ProcessPacket(int PacketLen);
+static void ProcessSubAck(int PacketLen);
+static bool QueuePacket(const unsigned char *Buf, int Len);
+static bool QueuePublish(const unsigned char *Packet, int Len);
+static int  ReadPacket(void);
+static bool SendConnect(void);
+static int  SendBytes(const unsigned char *Buf, int Len);
+static bool SendPacket(unsigned char *Buf, int Len);
+static bool SocketReady(short Events);
+static bool StartTcpConnect(void);
+static bool WaitOutBuf(uint32 Len);
+static bool WriteBuf(const unsigned char *Buf, int Len);
+static bool WriteOutBuf(void);
+
+
 /*****************/
 /** Global Data **/
 /*****************/
 
 static MQTT_CLIENT_Class_t *MqttClient;
-static char TestPayload[] = "Test Payload";
 
 /******************************************************************************
 ** Function: MQTT_CLIENT_Constructor
@@ -60,25 +95,81 @@ void MQTT_CLIENT_Constructor(MQTT_CLIENT_Class_t *MqttClientPtr,
    srand(time(NULL));
    strncpy(MqttClient->BrokerAddress,INITBL_GetStrConfig(IniTbl, CFG_MQTT_BROKER_ADDRESS),MAX_CLIENT_PARAM_STR_LEN);
    MqttClient->BrokerPort = INITBL_GetIntConfig(IniTbl, CFG_MQTT_BROKER_PORT);
-   sprintf(MqttClient->ClientName,"%s-%d", INITBL_GetStrConfig(IniTbl, CFG_MQTT_CLIENT_NAME), (rand() % 10000));
+   MqttClient->PersistentSession = (INITBL_GetIntConfig(IniTbl, CFG_MQTT_PERSISTENT_SESSION) == 1);
+   if (MqttClient->PersistentSession)
+   {
+      strncpy(MqttClient->ClientName, INITBL_GetStrConfig(IniTbl, CFG_MQTT_CLIENT_NAME), MAX_CLIENT_PARAM_STR_LEN - 1);
+   }
+   else
+   {
+      sprintf(MqttClient->ClientName,"%s-%d", INITBL_GetStrConfig(IniTbl, CFG_MQTT_CLIENT_NAME), (rand() % 10000));
+   }
+
+   MqttClient->ProbeRtt = (INITBL_GetIntConfig(IniTbl, CFG_MQTT_FAILOVER_RTT_MS) > 0);
 
-   MqttClient->PubMsg.qos = MQTT_CLIENT_QOS0;
-   MqttClient->PubMsg.retained = 0;
-   MqttClient->PubMsg.dup = 0;
-   MqttClient->PubMsg.id = 0;
-   MqttClient->PubMsg.payload = TestPayload;
-   MqttClient->PubMsg.id = strlen(TestPayload);
+   MqttClient->CoalesceBytes = INITBL_GetIntConfig(IniTbl, CFG_MQTT_COALESCE_BYTES);
+   MqttClient->CoalesceUsec  = INITBL_GetIntConfig(IniTbl, CFG_MQTT_COALESCE_USEC);
+   if (MqttClient->CoalesceBytes > MQTT_CLIENT_COALESCE_BUF_LEN)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONSTRUCT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT coalescing threshold %d exceeds the %d byte buffer, using the buffer length",
+                        MqttClient->CoalesceBytes, MQTT_CLIENT_COALESCE_BUF_LEN);
+      MqttClient->CoalesceBytes = MQTT_CLIENT_COALESCE_BUF_LEN;
+   }
+
+   MqttClient->Version = INITBL_GetIntConfig(IniTbl, CFG_MQTT_VERSION);
+   if (MqttClient->Version < MQTT_CLIENT_VERSION_31 || MqttClient->Version > MQTT_CLIENT_VERSION_5)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONSTRUCT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "Invalid MQTT version %d, must be %d, %d or %d. Using %d",
+                        MqttClient->Version, MQTT_CLIENT_VERSION_31, MQTT_CLIENT_VERSION_311,
+                        MQTT_CLIENT_VERSION_5, MQTT_CLIENT_VERSION_31);
+      MqttClient->Version = MQTT_CLIENT_VERSION_31;
+   }
+   
+   MQTT_V5_Constructor(&MqttClient->Mqtt5, IniTbl);
+   MQTT_RESOLVE_Constructor(&MqttClient->Resolve, IniTbl);
 
+   /* The network owner completes the connect */
    MQTT_CLIENT_Connect(MqttClient->ClientName, MqttClient->BrokerAddress, MqttClient->BrokerPort);
 
 } /* End MQTT_CLIENT_Constructor() */
    
 
+/******************************************************************************
+** Function: MQTT_CLIENT_BeginPublish
+**
+*/
+uint32 MQTT_CLIENT_BeginPublish(uint8 *Buf, uint32 BufLen, const char *Topic, uint32 TopicLen)
+{
+   
+   uint32 PayloadIndex = MQTT_CLIENT_PUBLISH_HDR_MAX_LEN + 2 + TopicLen;
+   
+   if (PayloadIndex > BufLen || TopicLen > 0xFFFF)
+   {
+      return 0;
+   }
+   
+   Buf[MQTT_CLIENT_PUBLISH_HDR_MAX_LEN]     = (uint8)(TopicLen >> 8);
+   Buf[MQTT_CLIENT_PUBLISH_HDR_MAX_LEN + 1] = (uint8)(TopicLen & 0xFF);
+   memcpy(&Buf[MQTT_CLIENT_PUBLISH_HDR_MAX_LEN + 2], Topic, TopicLen);
+   
+   return PayloadIndex;
+   
+} /* End MQTT_CLIENT_BeginPublish() */
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Connect
 **
 ** Notes:
-**    None
+**    1. The MQTT library client is initialized for every version because
+**       its packet ID sequence is used by NextPacketId().
+**    2. A persistent session connects without a clean session and saves
+**       the CONNACK's session present flag.
+**    3. Numeric and cached broker addresses go straight to the TCP
+**       connect. Otherwise an address lookup is started and, if it can't
+**       be, expired or listed addresses are tried.
 **
 */
 bool MQTT_CLIENT_Connect(const char *ClientName, const char *BrokerAddress,
@@ -86,67 +177,87 @@ bool MQTT_CLIENT_Connect(const char *ClientName, const char *BrokerAddress,
 {
 
    bool RetStatus = false;
-   int  RetCode;
+   unsigned int NextId;
    
    /* Initial to a local variable to avoid a compiler error */
    MQTTPacket_connectData DefConnectOptions = MQTTPacket_connectData_initializer;
    memcpy(&MqttClient->ConnectData, &DefConnectOptions, sizeof(MQTTPacket_connectData));
 
+   if (MqttClient->Connected)
+   {
+      MQTT_CLIENT_Disconnect();
+   }
+   else
+   {
+      AbortConnect();
+   }
+   
+   strncpy(MqttClient->ConnBrokerAddress, BrokerAddress, MAX_CLIENT_PARAM_STR_LEN - 1);
+   MqttClient->ConnBrokerAddress[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+   strncpy(MqttClient->ConnClientName, ClientName, MAX_CLIENT_PARAM_STR_LEN - 1);
+   MqttClient->ConnClientName[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+   MqttClient->ConnBrokerPort = BrokerPort;
+   
    /*
-   ** Init and connect to network
+   ** Init network and MQTT client
    */
-
+   
    NetworkInit(&MqttClient->Network);
+   MqttClient->SessionPresent = false;
+   MqttClient->SubAckPending  = 0;
+   MqttClient->SubPendingCnt  = 0;
 
-   RetCode = NetworkConnect(&MqttClient->Network, (char *)BrokerAddress, BrokerPort);
-   if (RetCode == 0) 
+   /* Keep the packet ID sequence so IDs held for a resumed session aren't reused */
+   NextId = MqttClient->Client.next_packetid;
+   MQTTClientInit(&MqttClient->Client, 
+                  &MqttClient->Network, MQTT_CLIENT_TIMEOUT_MS,
+                  MqttClient->SendBuf,  MQTT_CLIENT_SEND_BUF_LEN,
+                  MqttClient->ReadBuf,  MQTT_CLIENT_READ_BUF_LEN); 
+   if (NextId != 0)
    {
+      MqttClient->Client.next_packetid = NextId;
+   }
 
-      /*
-      ** Init MQTT client
-      */
-      MQTTClientInit(&MqttClient->Client, 
-                     &MqttClient->Network, MQTT_CLIENT_TIMEOUT_MS,
-                     MqttClient->SendBuf,  MQTT_CLIENT_SEND_BUF_LEN,
-                     MqttClient->ReadBuf,  MQTT_CLIENT_READ_BUF_LEN); 
-
-      MqttClient->ConnectData.willFlag = 0;
-      MqttClient->ConnectData.MQTTVersion = 3;
-      MqttClient->ConnectData.clientID.cstring = (char *)ClientName;
-      MqttClient->ConnectData.username.cstring = NULL;
-      MqttClient->ConnectData.password.cstring = NULL;
-
-      MqttClient->ConnectData.keepAliveInterval = 10;
-      MqttClient->ConnectData.cleansession = 1;
+   MqttClient->ConnectData.willFlag = 0;
+   MqttClient->ConnectData.MQTTVersion = MqttClient->Version;
+   MqttClient->ConnectData.clientID.cstring = MqttClient->ConnClientName;
+   MqttClient->ConnectData.username.cstring = NULL;
+   MqttClient->ConnectData.password.cstring = NULL;
 
-      /*
-      ** Connect to MQTT server
-      */
-      
-      RetCode = MQTTConnect(&MqttClient->Client, &MqttClient->ConnectData);
+   MqttClient->ConnectData.keepAliveInterval = MQTT_CLIENT_KEEPALIVE_SEC;
+   MqttClient->ConnectData.cleansession = MqttClient->PersistentSession ? 0 : 1;
 
-      if (RetCode == SUCCESS)
-      {
-      
-         CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_EID, CFE_EVS_EventType_INFORMATION, 
-                           "Successfully connected to MQTT broker %s:%d as client %s", BrokerAddress, BrokerPort, ClientName);
-         MqttClient->Connected = true;
-         RetStatus = true;
-         
-      }
-      else
-      {
-         CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
-                           "Error initializing %s:%d MQTT broker client %s. Status=%d",
-                           BrokerAddress, BrokerPort, ClientName, RetCode);
-      }
-      
-   } /* End if successful NetworkConnect */
+   /*
+   ** Start the connect with the address lookup or the TCP connect
+   */
+   
+   MqttClient->ConnAddrCached = false;
+   MqttClient->ConnAddrIndex  = 0;
+   MqttClient->ConnAddrCnt    = MQTT_RESOLVE_GetAddr(MqttClient->ConnBrokerAddress, BrokerPort,
+                                                     MqttClient->ConnAddr, false);
+   if (MqttClient->ConnAddrCnt > 0)
+   {
+      MqttClient->ConnAddrCached = true;
+      RetStatus = StartTcpConnect();
+   }
+   else if (MQTT_RESOLVE_Lookup(MqttClient->ConnBrokerAddress))
+   {
+      MqttClient->ConnState    = MQTT_CLIENT_CONN_RESOLVE;
+      MqttClient->ConnDeadline = MonotonicNs() + CONNECT_TIMEOUT_NS;
+      RetStatus = true;
+   }
    else
    {
-      CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
-                        "Error creating MQTT network connection to %s:%d. Status=%d",
-                        BrokerAddress, BrokerPort, RetCode);
+      RetStatus = ConnectFallback("could not be started");
+   }
+   
+   if (!RetStatus)
+   {
+      if (MqttClient->ConnAddrCached)
+      {
+         MQTT_RESOLVE_Invalidate(MqttClient->ConnBrokerAddress);
+      }
+      AbortConnect();
    }
    
    return RetStatus;
@@ -154,159 +265,1878 @@ bool MQTT_CLIENT_Connect(const char *ClientName, const char *BrokerAddress,
 } /* End MQTT_CLIENT_Connect() */
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_ConnectTimeout
+**
+*/
+uint32 MQTT_CLIENT_ConnectTimeout(void)
+{
+   
+   uint32 TimeLeft = 0;
+   uint64 Now = MonotonicNs();
+   
+   if (MQTT_CLIENT_Connecting() && Now < MqttClient->ConnDeadline)
+   {
+      TimeLeft = (uint32)((MqttClient->ConnDeadline - Now + 999999) / 1000000);
+      if (MqttClient->ConnState == MQTT_CLIENT_CONN_RESOLVE && TimeLeft > MQTT_CLIENT_RESOLVE_POLL_MS)
+      {
+         TimeLeft = MQTT_CLIENT_RESOLVE_POLL_MS;
+      }
+   }
+   
+   return TimeLeft;
+   
+} /* End MQTT_CLIENT_ConnectTimeout() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Connecting
+**
+*/
+bool MQTT_CLIENT_Connecting(void)
+{
+   
+   return (MqttClient->ConnState == MQTT_CLIENT_CONN_RESOLVE ||
+           MqttClient->ConnState == MQTT_CLIENT_CONN_TCP     ||
+           MqttClient->ConnState == MQTT_CLIENT_CONN_CONNACK);
+   
+} /* End MQTT_CLIENT_Connecting() */
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Disconnect
 **
 ** Notes:
-**    None
+**    1. The DISCONNECT is serialized rather than sent by MQTTDisconnect()
+**       because the library's writes expect a blocking socket. Buffered
+**       output is written before the socket is closed.
 **
 */
 void MQTT_CLIENT_Disconnect(void)
 {
    
-   MQTTDisconnect(&MqttClient->Client);
-   NetworkDisconnect(&MqttClient->Network);
+   int Len;
+   
+   if (MqttClient->Connected)
+   {
+      MQTT_CLIENT_Flush();
+      Len = MQTTSerialize_disconnect(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN);
+      if (Len > 0 && WriteBuf(MqttClient->SendBuf, Len))
+      {
+         WaitOutBuf(MQTT_CLIENT_OUT_BUF_LEN);
+      }
+      NetworkDisconnect(&MqttClient->Network);
+      MqttClient->OutStart  = 0;
+      MqttClient->OutLen    = 0;
+      MqttClient->Connected = false;
+      MqttClient->ConnState = MQTT_CLIENT_CONN_IDLE;
+   }
+   else
+   {
+      AbortConnect();
+   }
 
 } /* End MQTT_CLIENT_Disconnect() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Publish
+** Function: MQTT_CLIENT_EndPublish
 **
 ** Notes:
-**    1. QOS needs to be converted to MQTT library constants
+**   1. The remaining length is encoded in as few bytes as possible and the
+**      fixed header is right aligned against the variable header.
+**
 */
-bool MQTT_CLIENT_Publish(const char *Topic, const char *Payload)
+uint32 MQTT_CLIENT_EndPublish(uint8 *Buf, uint32 PayloadIndex, uint32 PayloadLen, bool Retain)
 {
    
-   bool RetStatus = false;
+   uint8  RemLenBuf[4];
+   uint32 RemLen = (PayloadIndex - MQTT_CLIENT_PUBLISH_HDR_MAX_LEN) + PayloadLen;
+   uint32 RemLenBytes = 0;
+   uint32 Start;
+   
+   do
+   {
+      RemLenBuf[RemLenBytes] = RemLen % 128;
+      RemLen /= 128;
+      if (RemLen > 0)
+      {
+         RemLenBuf[RemLenBytes] |= 128;
+      }
+      RemLenBytes++;
+   } while (RemLen > 0 && RemLenBytes < sizeof(RemLenBuf));
+   
+   Start = MQTT_CLIENT_PUBLISH_HDR_MAX_LEN - 1 - RemLenBytes;
+   Buf[Start] = (PUBLISH << 4) | (Retain ? 0x01 : 0x00);
+   memcpy(&Buf[Start + 1], RemLenBuf, RemLenBytes);
    
+   return Start;
+   
+} /* End MQTT_CLIENT_EndPublish() */
+
 
-   MqttClient->PubMsg.payload = (void *)Payload;
-   MqttClient->PubMsg.payloadlen = strlen(Payload);
+/******************************************************************************
+** Function: MQTT_CLIENT_Flush
+**
+** Notes:
+**    1. Each coalesced packet after the first is a socket write saved.
+**
+*/
+bool MQTT_CLIENT_Flush(void)
+{
    
-   if (MQTTPublish(&MqttClient->Client, Topic, &MqttClient->PubMsg) == SUCCESS)
+   bool RetStatus = true;
+   
+   if (MqttClient->CoalesceLen > 0)
    {
-      RetStatus = true;
-      CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_EID, CFE_EVS_EventType_INFORMATION, 
-                       "Successfully published topic %s with payload %s",
-                       Topic, Payload);
+      RetStatus = WriteBuf(MqttClient->CoalesceBuf, MqttClient->CoalesceLen);
+      if (RetStatus)
+      {
+         MqttClient->CoalesceFlushCnt++;
+         MqttClient->CoalesceSavedCnt += MqttClient->CoalescePktCnt - 1;
+      }
+      MqttClient->CoalesceLen    = 0;
+      MqttClient->CoalescePktCnt = 0;
    }
-   else
+   
+   return RetStatus;
+   
+} /* End MQTT_CLIENT_Flush() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_FlushTimeout
+**
+*/
+uint32 MQTT_CLIENT_FlushTimeout(void)
+{
+   
+   uint32 TimeLeft = MQTT_CLIENT_FLUSH_IDLE;
+   uint64 Now;
+   
+   if (MqttClient->CoalesceLen > 0)
    {
-      CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR, 
-                       "Error publishing topic %s with payload %s",
-                       Topic, Payload);   
+      Now = MonotonicNs();
+      TimeLeft = (Now >= MqttClient->CoalesceDeadline) ? 0 :
+                 (uint32)((MqttClient->CoalesceDeadline - Now + 999) / 1000);
    }
+   
+   return TimeLeft;
+   
+} /* End MQTT_CLIENT_FlushTimeout() */
 
-   return RetStatus;
 
-} /* End MQTT_CLIENT_Publish() */
+/******************************************************************************
+** Function: MQTT_CLIENT_GetPingRtt
+**
+*/
+bool MQTT_CLIENT_GetPingRtt(uint32 *RttUs)
+{
+   
+   bool RetStatus = MqttClient->PingRttNew;
+   
+   *RttUs = MqttClient->PingRttUs;
+   MqttClient->PingRttNew = false;
+   
+   return RetStatus;
+   
+} /* End MQTT_CLIENT_GetPingRtt() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Reconnect
-**
-** Reconnect to an MQTT broker using current parameters
+** Function: MQTT_CLIENT_GetSocket
 **
 */
-bool MQTT_CLIENT_Reconnect(void)
+int MQTT_CLIENT_GetSocket(void)
 {
    
-   return MQTT_CLIENT_Connect(MqttClient->ClientName, MqttClient->BrokerAddress, MqttClient->BrokerPort);
+   return ((MqttClient->Connected || MqttClient->ConnState == MQTT_CLIENT_CONN_TCP ||
+            MqttClient->ConnState == MQTT_CLIENT_CONN_CONNACK) ? MqttClient->Network.my_socket : -1);
    
-} /* MQTT_CLIENT_Reconnect() */
+} /* End MQTT_CLIENT_GetSocket() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_ResetStatus
-**
-** Reset counters and status flags to a known reset state.
+** Function: MQTT_CLIENT_GetSocketEvents
 **
 */
-void MQTT_CLIENT_ResetStatus(void)
+short MQTT_CLIENT_GetSocketEvents(void)
 {
+   
+   short Events = POLLIN;
+   
+   if (MqttClient->ConnState == MQTT_CLIENT_CONN_TCP)
+   {
+      Events = POLLOUT;
+   }
+   else if (MqttClient->OutLen > 0)
+   {
+      Events = POLLIN | POLLOUT;
+   }
+   
+   return Events;
+   
+} /* End MQTT_CLIENT_GetSocketEvents() */
 
-   /* Nothing to do */
 
-} /* End MQTT_CLIENT_ResetStatus() */
+/******************************************************************************
+** Function: MQTT_CLIENT_GetVersion
+**
+*/
+uint8 MQTT_CLIENT_GetVersion(void)
+{
+   
+   return MqttClient->Version;
+   
+} /* End MQTT_CLIENT_GetVersion() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Subscribe
+** Function: MQTT_CLIENT_KeepAlive
 **
 ** Notes:
-**    1. QOS needs to be converted to MQTT library constants
+**    1. MQTT only requires a PINGREQ when no other control packet has been
+**       sent within the keepalive interval so PingTimer is restarted by
+**       every send.
+**    2. When RTT failover is enabled ProbeTimer also sends a PINGREQ each
+**       keepalive interval while publishing so the broker's round trip time
+**       is measured under load.
+**    3. The PINGREQ may wait behind coalesced and buffered output so the
+**       PINGRESP is allowed a full keepalive interval like MQTTKeepalive()
+**       and the round trip is timed from when OutBuf drains past it.
+**
 */
-
-bool MQTT_CLIENT_Subscribe(const char *Topic, int Qos, 
-                           MQTT_CLIENT_MsgCallback_t MsgCallbackFunc)
+bool MQTT_CLIENT_KeepAlive(void)
 {
    
-   bool RetStatus = false;
+   bool RetStatus = true;
+   unsigned char PingBuf[4];
+   int  PingLen;
    
    if (MqttClient->Connected)
    {
-      RetStatus = (MQTTSubscribe(&MqttClient->Client, Topic, Qos, MsgCallbackFunc) == SUCCESS);
+      if (MqttClient->PingOutstanding)
+      {
+         if (TimerIsExpired(&MqttClient->PingRespTimer))
+         {
+            CFE_EVS_SendEvent(MQTT_CLIENT_KEEPALIVE_ERR_EID, CFE_EVS_EventType_ERROR, 
+                              "MQTT broker PINGRESP not received within %d s", MQTT_CLIENT_KEEPALIVE_SEC);
+            LostConnection();
+            RetStatus = false;
+         }
+      }
+      else if (TimerIsExpired(&MqttClient->PingTimer) ||
+               (MqttClient->ProbeRtt && TimerIsExpired(&MqttClient->ProbeTimer)))
+      {
+         PingLen = MQTTSerialize_pingreq(PingBuf, sizeof(PingBuf));
+         if (SendPacket(PingBuf, PingLen))
+         {
+            MqttClient->PingOutstanding = true;
+            MqttClient->PingOutBytes    = MqttClient->OutLen;
+            if (MqttClient->PingOutBytes == 0)
+            {
+               MqttClient->PingSendTime = MonotonicNs();
+            }
+            TimerCountdown(&MqttClient->PingRespTimer, MQTT_CLIENT_KEEPALIVE_SEC);
+            TimerCountdown(&MqttClient->ProbeTimer, MQTT_CLIENT_KEEPALIVE_SEC);
+         }
+         else
+         {
+            CFE_EVS_SendEvent(MQTT_CLIENT_KEEPALIVE_ERR_EID, CFE_EVS_EventType_ERROR, 
+                              "Error sending MQTT PINGREQ");
+            LostConnection();
+            RetStatus = false;
+         }
+      }
    }
    
    return RetStatus;
    
-} /* End MQTT_CLIENT_Subscribe() */
+} /* End MQTT_CLIENT_KeepAlive() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Unsubscribe
+** Function: MQTT_CLIENT_KeepAliveTimeout
 **
 */
-bool MQTT_CLIENT_Unsubscribe(const char *Topic)
+uint32 MQTT_CLIENT_KeepAliveTimeout(void)
 {
    
-   bool RetStatus = false;
+   int TimeLeft;
    
-   RetStatus = (MQTTUnsubscribe(&MqttClient->Client, Topic) == SUCCESS);
-
-   return RetStatus;
+   if (MqttClient->PingOutstanding)
+   {
+      TimeLeft = TimerLeftMS(&MqttClient->PingRespTimer);
+   }
+   else
+   {
+      TimeLeft = TimerLeftMS(&MqttClient->PingTimer);
+      if (MqttClient->ProbeRtt && TimerLeftMS(&MqttClient->ProbeTimer) < TimeLeft)
+      {
+         TimeLeft = TimerLeftMS(&MqttClient->ProbeTimer);
+      }
+   }
    
-} /* End MQTT_CLIENT_Unsubscribe() */
+   return (TimeLeft > 0 ? (uint32)TimeLeft : 0);
+   
+} /* End MQTT_CLIENT_KeepAliveTimeout() */
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Yield
+** Function: MQTT_CLIENT_ProcessConnect
 **
 ** Notes:
-**    1. If yield fails, enforce a timeout to avoid CPU hogging
+**   1. The MQTT library's client isn't used to connect so the fields its
+**      other functions check are set here.
 **
 */
-bool MQTT_CLIENT_Yield(uint32 YieldTime)
+MQTT_CLIENT_ConnectStatus_t MQTT_CLIENT_ProcessConnect(void)
 {
    
-   bool RetStatus = false;
-
-   if (MqttClient->Connected)
+   MQTT_CLIENT_ConnectStatus_t Status = MQTT_CLIENT_CONNECT_PENDING;
+   MQTT_RESOLVE_LookupStatus_t LookupStatus;
+   int        RetCode;
+   int        PacketLen;
+   int        SockErr = 0;
+   socklen_t  SockErrLen = sizeof(SockErr);
+   
+   switch (MqttClient->ConnState)
    {
       
-      /* Return code doesn't have additional information, only returns SUCCESS/FAILURE */ 
-      if (MQTTYield(&MqttClient->Client, YieldTime) == SUCCESS)
+      case MQTT_CLIENT_CONN_RESOLVE:
+         LookupStatus = MQTT_RESOLVE_LookupStatus(MqttClient->ConnBrokerPort, MqttClient->ConnAddr,
+                                                  &MqttClient->ConnAddrCnt);
+         if (LookupStatus == MQTT_RESOLVE_LOOKUP_DONE && MqttClient->ConnAddrCnt > 0)
+         {
+            MqttClient->ConnAddrCached = false;
+            MqttClient->ConnAddrIndex  = 0;
+            if (!StartTcpConnect())
+            {
+               Status = MQTT_CLIENT_CONNECT_FAILED;
+            }
+         }
+         else if (LookupStatus != MQTT_RESOLVE_LOOKUP_PENDING || MonotonicNs() >= MqttClient->ConnDeadline)
+         {
+            /* A lookup that times out keeps running and caches its result */
+            if (!ConnectFallback(LookupStatus == MQTT_RESOLVE_LOOKUP_PENDING ? "timed out" : "failed"))
+            {
+               Status = MQTT_CLIENT_CONNECT_FAILED;
+            }
+         }
+         break;
+         
+      case MQTT_CLIENT_CONN_TCP:
+         if (SocketReady(POLLOUT))
+         {
+            /* The socket stays non-blocking, see WriteBuf() and ReadPacket() */
+            getsockopt(MqttClient->Network.my_socket, SOL_SOCKET, SO_ERROR, &SockErr, &SockErrLen);
+            if (SockErr == 0 && SendConnect())
+            {
+               MqttClient->ConnState    = MQTT_CLIENT_CONN_CONNACK;
+               MqttClient->ConnDeadline = MonotonicNs() + CONNECT_TIMEOUT_NS;
+            }
+            else if (SockErr != 0 && (MqttClient->ConnAddrIndex + 1) < MqttClient->ConnAddrCnt)
+            {
+               /* Try the broker's next address, e.g. IPv4 after IPv6 */
+               NetworkDisconnect(&MqttClient->Network);
+               MqttClient->ConnAddrIndex++;
+               if (!StartTcpConnect())
+               {
+                  Status = MQTT_CLIENT_CONNECT_FAILED;
+               }
+            }
+            else
+            {
+               CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                                 "Error creating MQTT network connection to %s:%d. Status=%d",
+                                 MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort, SockErr);
+               Status = MQTT_CLIENT_CONNECT_FAILED;
+            }
+         }
+         break;
+         
+      case MQTT_CLIENT_CONN_CONNACK:
+         PacketLen = (MqttClient->OutLen == 0 || WriteOutBuf()) ? ReadPacket() : -1;
+         if (PacketLen != 0)
+         {
+            RetCode = (PacketLen > 0) ? DecodeConnAck(PacketLen) : FAILURE;
+            if (RetCode == SUCCESS)
+            {
+               CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                                 "Successfully connected to MQTT %s broker %s:%d as client %s%s",
+                                 (MqttClient->Version == MQTT_CLIENT_VERSION_5 ? "5" : "3.1.1"),
+                                 MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort,
+                                 MqttClient->ConnClientName,
+                                 (MqttClient->SessionPresent ? ", session resumed" : ""));
+               
+               MqttClient->ConnState = MQTT_CLIENT_CONN_UP;
+               MqttClient->Connected = true;
+               MqttClient->Client.isconnected       = 1;
+               MqttClient->Client.keepAliveInterval = MQTT_CLIENT_KEEPALIVE_SEC;
+               MqttClient->Client.cleansession      = MqttClient->ConnectData.cleansession;
+               MqttClient->PingOutstanding = false;
+               MqttClient->PingOutBytes    = 0;
+               MqttClient->CoalesceLen     = 0;
+               MqttClient->CoalescePktCnt  = 0;
+               TimerInit(&MqttClient->PingTimer);
+               TimerInit(&MqttClient->PingRespTimer);
+               TimerInit(&MqttClient->ProbeTimer);
+               TimerCountdown(&MqttClient->PingTimer, MQTT_CLIENT_KEEPALIVE_SEC);
+               TimerCountdown(&MqttClient->ProbeTimer, MQTT_CLIENT_KEEPALIVE_SEC);
+               MqttClient->PingRttNew = false;
+               Status = MQTT_CLIENT_CONNECT_DONE;
+            }
+            else
+            {
+               CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                                 "Error initializing %s:%d MQTT broker client %s. Status=%d",
+                                 MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort,
+                                 MqttClient->ConnClientName, RetCode);
+               Status = MQTT_CLIENT_CONNECT_FAILED;
+            }
+         }
+         break;
+         
+      case MQTT_CLIENT_CONN_UP:
+         Status = MQTT_CLIENT_CONNECT_DONE;
+         break;
+         
+      default:
+         Status = MQTT_CLIENT_CONNECT_FAILED;
+         break;
+         
+   } /* End ConnState switch */
+   
+   if (Status == MQTT_CLIENT_CONNECT_PENDING && MonotonicNs() >= MqttClient->ConnDeadline)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT broker %s:%d connect timed out after %d ms waiting for the %s",
+                        MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort, MQTT_CLIENT_TIMEOUT_MS,
+                        (MqttClient->ConnState == MQTT_CLIENT_CONN_TCP ? "TCP connection" : "CONNACK"));
+      Status = MQTT_CLIENT_CONNECT_FAILED;
+   }
+   
+   if (Status == MQTT_CLIENT_CONNECT_FAILED)
+   {
+      if (MqttClient->ConnAddrCached)
       {
-         RetStatus = true;
+         MQTT_RESOLVE_Invalidate(MqttClient->ConnBrokerAddress);
+      }
+      AbortConnect();
+   }
+   
+   return Status;
+   
+} /* End MQTT_CLIENT_ProcessConnect() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ProcessInput
+**
+*/
+bool MQTT_CLIENT_ProcessInput(void)
+{
+   
+   bool RetStatus = true;
+   int  PacketLen;
+   
+   while (RetStatus && MqttClient->Connected)
+   {
+      PacketLen = ReadPacket();
+      if (PacketLen > 0)
+      {
+         RetStatus = ProcessPacket(PacketLen);
+      }
+      else if (PacketLen == 0)
+      {
+         break;
       }
       else
       {
-         
-         CFE_EVS_SendEvent(MQTT_CLIENT_YIELD_ERR_EID, CFE_EVS_EventType_ERROR, "MQTT client yield error");
-         OS_TaskDelay(YieldTime);
-
+         RetStatus = false;
       }
    }
-   else
+   
+   if (!RetStatus)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_INPUT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT client input error, closing broker connection");
+      LostConnection();
+   }
+   
+   return RetStatus;
+
+} /* End MQTT_CLIENT_ProcessInput() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ProcessOutput
+**
+*/
+bool MQTT_CLIENT_ProcessOutput(void)
+{
+   
+   bool RetStatus = true;
+   
+   if (MqttClient->Connected && MqttClient->OutLen > 0)
    {
-      OS_TaskDelay(YieldTime);
+      RetStatus = WriteOutBuf();
+      if (!RetStatus)
+      {
+         CFE_EVS_SendEvent(MQTT_CLIENT_OUTPUT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                           "MQTT client output error, closing broker connection");
+         LostConnection();
+      }
    }
-    
+   
    return RetStatus;
-    
-    
-} /* End MQTT_CLIENT_Yield() */
+
+} /* End MQTT_CLIENT_ProcessOutput() */
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_Publish
+**
+** Notes:
+**    1. QOS needs to be converted to MQTT library constants
+**    2. The packet is serialized here rather than by MQTTPublish() so the
+**       payload length is explicit and the packet can be coalesced.
+*/
+bool MQTT_CLIENT_Publish(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                         bool Retain)
+{
+   
+   int  PacketLen;
+   MQTTString TopicName = MQTTString_initializer;
+   
+   TopicName.cstring = (char *)Topic;
+   PacketLen = MQTTSerialize_publish(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN, 0, QOS0, Retain, 0,
+                                     TopicName, (unsigned char *)Payload, PayloadLen);
+   if (PacketLen <= 0)
+   {
+      MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_PUBLISH_ERR, PluginId, PayloadLen);
+      CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "Error serializing publish for topic %s with a %d byte payload",
+                        Topic, PayloadLen);
+      return false;
+   }
+   
+   return MQTT_CLIENT_PublishPacket(PluginId, Topic, MqttClient->SendBuf, PacketLen, PayloadLen);
+
+} /* End MQTT_CLIENT_Publish() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_PublishPacket
+**
+*/
+bool MQTT_CLIENT_PublishPacket(int32 PluginId, const char *Topic, const uint8 *Packet,
+                               uint32 PacketLen, uint32 PayloadLen)
+{
+   
+   bool RetStatus = false;
+   
+   if (MqttClient->Connected)
+   {
+      if (QueuePublish(Packet, PacketLen))
+      {
+         RetStatus = true;
+         MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_OK, PluginId, PayloadLen);
+      }
+      else
+      {
+         LostConnection();
+      }
+   }
+   
+   if (!RetStatus)
+   {
+      MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_PUBLISH_ERR, PluginId, PayloadLen);
+      CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "Error publishing topic %s with a %d byte payload", Topic, PayloadLen);   
+   }
+
+   return RetStatus;
+
+} /* End MQTT_CLIENT_PublishPacket() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_PublishQos1
+**
+** Notes:
+**    1. The packet is serialized here rather than by MQTTPublish() because
+**       MQTTPublish() blocks until the PUBACK is received.
+**    2. A resend keeps its packet ID and sets the DUP flag.
+*/
+bool MQTT_CLIENT_PublishQos1(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                             bool Retain, uint16 *PacketId)
+{
+   
+   bool RetStatus = false;
+   bool Dup = (*PacketId != 0);
+   int  PacketLen;
+   MQTTString TopicName = MQTTString_initializer;
+   
+   if (MqttClient->Connected)
+   {
+      
+      TopicName.cstring = (char *)Topic;
+      if (!Dup)
+      {
+         *PacketId = NextPacketId();
+      }
+      PacketLen = MQTTSerialize_publish(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN, Dup, QOS1, Retain,
+                                        *PacketId, TopicName, (unsigned char *)Payload, PayloadLen);
+      if (PacketLen > 0)
+      {
+         if (QueuePublish(MqttClient->SendBuf, PacketLen))
+         {
+            RetStatus = true;
+            MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_OK, PluginId, PayloadLen);
+         }
+         else
+         {
+            MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_PUBLISH_ERR, PluginId, PayloadLen);
+            CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR, 
+                              "Error sending QoS1 publish for topic %s", Topic);
+            LostConnection();
+         }
+      }
+      else
+      {
+         CFE_EVS_SendEvent(MQTT_CLIENT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR, 
+                           "Error serializing QoS1 publish for topic %s with a %d byte payload",
+                           Topic, PayloadLen);
+      }
+   }
+   
+   return RetStatus;
+
+} /* End MQTT_CLIENT_PublishQos1() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ReceiveMax
+**
+*/
+uint16 MQTT_CLIENT_ReceiveMax(void)
+{
+   
+   return (MqttClient->Version == MQTT_CLIENT_VERSION_5 ? 
+           MqttClient->Mqtt5.BrokerReceiveMax : MQTT_V5_RECEIVE_MAX_DEF);
+   
+} /* End MQTT_CLIENT_ReceiveMax() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Reconnect
+**
+** Reconnect to an MQTT broker using current parameters
+**
+*/
+bool MQTT_CLIENT_Reconnect(void)
+{
+   
+   return MQTT_CLIENT_Connect(MqttClient->ClientName, MqttClient->BrokerAddress, MqttClient->BrokerPort);
+   
+} /* MQTT_CLIENT_Reconnect() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_CLIENT_ResetStatus(void)
+{
+
+   MqttClient->CoalesceFlushCnt = 0;
+   MqttClient->CoalesceSavedCnt = 0;
+   
+   MQTT_V5_ResetStatus();
+   MQTT_RESOLVE_ResetStatus();
+
+} /* End MQTT_CLIENT_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SendPubRel
+**
+*/
+bool MQTT_CLIENT_SendPubRel(uint16 PacketId)
+{
+
+   bool RetStatus = false;
+   unsigned char AckBuf[4];
+   int  AckLen;
+
+   if (MqttClient->Connected)
+   {
+      AckLen = MQTTSerialize_ack(AckBuf, sizeof(AckBuf), PUBREL, 0, PacketId);
+      RetStatus = SendPacket(AckBuf, AckLen);
+      if (!RetStatus)
+      {
+         LostConnection();
+      }
+   }
+
+   return RetStatus;
+
+} /* End MQTT_CLIENT_SendPubRel() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SendReady
+**
+*/
+bool MQTT_CLIENT_SendReady(void)
+{
+   
+   return (MqttClient->OutLen == 0);
+   
+} /* End MQTT_CLIENT_SendReady() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SerializePublish
+**
+*/
+uint32 MQTT_CLIENT_SerializePublish(uint8 *Buf, uint32 BufLen, MQTT_CLIENT_Qos_t Qos, bool Retain,
+                                    const char *Topic, const char *Payload, uint32 PayloadLen,
+                                    uint16 *PacketId)
+{
+
+   int  PacketLen;
+   MQTTString TopicName = MQTTString_initializer;
+
+   TopicName.cstring = (char *)Topic;
+   *PacketId = (Qos == MQTT_CLIENT_QOS0) ? 0 : NextPacketId();
+
+   PacketLen = MQTTSerialize_publish(Buf, BufLen, 0, Qos, Retain, *PacketId, TopicName,
+                                     (unsigned char *)Payload, PayloadLen);
+
+   return (PacketLen > 0 ? (uint32)PacketLen : 0);
+
+} /* End MQTT_CLIENT_SerializePublish() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SessionPresent
+**
+*/
+bool MQTT_CLIENT_SessionPresent(void)
+{
+
+   return MqttClient->SessionPresent;
+
+} /* End MQTT_CLIENT_SessionPresent() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SetAckCallback
+**
+*/
+void MQTT_CLIENT_SetAckCallback(MQTT_CLIENT_AckCallback_t AckCallbackFunc)
+{
+
+   MqttClient->AckCallback = AckCallbackFunc;
+
+} /* End MQTT_CLIENT_SetAckCallback() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SetSubAckCallback
+**
+*/
+void MQTT_CLIENT_SetSubAckCallback(MQTT_CLIENT_SubAckCallback_t SubAckCallbackFunc)
+{
+
+   MqttClient->SubAckCallback = SubAckCallbackFunc;
+
+} /* End MQTT_CLIENT_SetSubAckCallback() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SubAckPending
+**
+*/
+uint16 MQTT_CLIENT_SubAckPending(void)
+{
+
+   return MqttClient->SubAckPending;
+
+} /* End MQTT_CLIENT_SubAckPending() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SubPendingFull
+**
+*/
+bool MQTT_CLIENT_SubPendingFull(void)
+{
+
+   return (MqttClient->SubPendingCnt >= MQTT_CLIENT_SUB_PENDING_MAX);
+
+} /* End MQTT_CLIENT_SubPendingFull() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Subscribe
+**
+** Notes:
+**    1. QOS needs to be converted to MQTT library constants
+**    2. The SUBSCRIBE is serialized rather than sent by MQTTSubscribe()
+**       because MQTTSubscribe() blocks until the SUBACK is received.
+*/
+
+bool MQTT_CLIENT_Subscribe(const char *Topic, int Qos, 
+                           MQTT_CLIENT_MsgCallback_t MsgCallbackFunc)
+{
+   
+   MQTT_CLIENT_SubFilter_t Filter;
+   uint16 PacketCnt;
+   
+   Filter.Topic = Topic;
+   Filter.Qos   = Qos;
+   Filter.Tag   = MQTT_CLIENT_SUB_TAG_NONE;
+   
+   return (MQTT_CLIENT_SubscribeBatch(&Filter, 1, MsgCallbackFunc, &PacketCnt) == 1);
+   
+} /* End MQTT_CLIENT_Subscribe() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SubscribeBatch
+**
+** Notes:
+**    1. A SUBSCRIBE's length is totaled as filters are added so it's never
+**       serialized with more filters than fit in SendBuf. The fixed header
+**       is assumed to be MQTT_CLIENT_PUBLISH_HDR_MAX_LEN bytes, the longest
+**       of any packet type.
+**    2. A SUBSCRIBE with a tagged filter needs a SubPending entry to map
+**       its SUBACK to the tags. The batch stops when SubPending is full so
+**       a SUBACK's results are never lost, the caller sends the rest after
+**       a SUBACK frees an entry.
+*/
+uint16 MQTT_CLIENT_SubscribeBatch(const MQTT_CLIENT_SubFilter_t *Filter, uint16 FilterCnt,
+                                  MQTT_CLIENT_MsgCallback_t MsgCallbackFunc, uint16 *PacketCnt)
+{
+   
+   uint16 SentCnt = 0;
+   uint16 PktFilterCnt;
+   uint16 PacketId;
+   uint32 RemLen;
+   uint32 FilterLen;
+   int    PacketLen;
+   bool   Tagged;
+   uint16 i;
+   const char *Topic[MQTT_CLIENT_SUB_FILTER_MAX];
+   int         Qos[MQTT_CLIENT_SUB_FILTER_MAX];
+   MQTTString  TopicFilter[MQTT_CLIENT_SUB_FILTER_MAX];
+   MQTT_CLIENT_SubPending_t *SubPending;
+   
+   *PacketCnt = 0;
+   
+   if (!MqttClient->Connected)
+   {
+      return SentCnt;
+   }
+   
+   MqttClient->MsgCallback = MsgCallbackFunc;
+   memset(TopicFilter, 0, sizeof(TopicFilter));
+   
+   while (SentCnt < FilterCnt)
+   {
+      
+      /* Packet ID and the MQTT 5 property length */
+      RemLen = 2 + 1;
+      Tagged = false;
+      for (PktFilterCnt = 0; (SentCnt + PktFilterCnt) < FilterCnt && PktFilterCnt < MQTT_CLIENT_SUB_FILTER_MAX; PktFilterCnt++)
+      {
+         i = SentCnt + PktFilterCnt;
+         FilterLen = 2 + strlen(Filter[i].Topic) + 1;
+         if ((MQTT_CLIENT_PUBLISH_HDR_MAX_LEN + RemLen + FilterLen) > MQTT_CLIENT_SEND_BUF_LEN)
+         {
+            break;
+         }
+         RemLen += FilterLen;
+         Topic[PktFilterCnt] = Filter[i].Topic;
+         Qos[PktFilterCnt]   = Filter[i].Qos;
+         TopicFilter[PktFilterCnt].cstring = (char *)Filter[i].Topic;
+         Tagged |= (Filter[i].Tag != MQTT_CLIENT_SUB_TAG_NONE);
+      }
+      if (PktFilterCnt == 0 || (Tagged && MqttClient->SubPendingCnt >= MQTT_CLIENT_SUB_PENDING_MAX))
+      {
+         break;
+      }
+      
+      PacketId = NextPacketId();
+      if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+      {
+         PacketLen = MQTT_V5_SerializeSubscribe(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN,
+                                                PacketId, PktFilterCnt, Topic, Qos);
+      }
+      else
+      {
+         PacketLen = MQTTSerialize_subscribe(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN, 0,
+                                             PacketId, PktFilterCnt, TopicFilter, Qos);
+      }
+      if (PacketLen <= 0)
+      {
+         break;
+      }
+      if (!SendPacket(MqttClient->SendBuf, PacketLen))
+      {
+         LostConnection();
+         break;
+      }
+      
+      MqttClient->SubAckPending++;
+      (*PacketCnt)++;
+      if (Tagged)
+      {
+         SubPending = &MqttClient->SubPending[MqttClient->SubPendingCnt++];
+         SubPending->PacketId  = PacketId;
+         SubPending->FilterCnt = PktFilterCnt;
+         for (i = 0; i < PktFilterCnt; i++)
+         {
+            SubPending->Tag[i] = Filter[SentCnt + i].Tag;
+         }
+      }
+      SentCnt += PktFilterCnt;
+      
+   } /* End while filters */
+   
+   return SentCnt;
+   
+} /* End MQTT_CLIENT_SubscribeBatch() */
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Unsubscribe
+**
+** Notes:
+**    1. See MQTT_CLIENT_Subscribe()
+**
+*/
+bool MQTT_CLIENT_Unsubscribe(const char *Topic)
+{
+   
+   bool   RetStatus = false;
+   int    PacketLen;
+   MQTTString TopicFilter = MQTTString_initializer;
+   
+   if (MqttClient->Connected)
+   {
+      if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+      {
+         PacketLen = MQTT_V5_SerializeUnsubscribe(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN,
+                                                  NextPacketId(), Topic);
+      }
+      else
+      {
+         TopicFilter.cstring = (char *)Topic;
+         PacketLen = MQTTSerialize_unsubscribe(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN, 0,
+                                               NextPacketId(), 1, &TopicFilter);
+      }
+      if (PacketLen > 0)
+      {
+         RetStatus = SendPacket(MqttClient->SendBuf, PacketLen);
+         if (RetStatus)
+         {
+            MqttClient->SubAckPending++;
+         }
+         else
+         {
+            LostConnection();
+         }
+      }
+   }
+
+   return RetStatus;
+   
+} /* End MQTT_CLIENT_Unsubscribe() */
+
+
+/******************************************************************************
+** Function: AbortConnect
+**
+** Abandon a connect in progress and release its resources.
+**
+** Notes:
+**   1. An address lookup isn't cancelled, MQTT_RESOLVE caches its result
+**      when it completes.
+**
+*/
+static void AbortConnect(void)
+{
+   
+   if (MqttClient->ConnState == MQTT_CLIENT_CONN_TCP ||
+       MqttClient->ConnState == MQTT_CLIENT_CONN_CONNACK)
+   {
+      NetworkDisconnect(&MqttClient->Network);
+   }
+   
+   MqttClient->ConnAddrCnt = 0;
+   
+   if (MqttClient->ConnState != MQTT_CLIENT_CONN_UP)
+   {
+      MqttClient->ConnState = MQTT_CLIENT_CONN_IDLE;
+   }
+   
+} /* End AbortConnect() */
+
+
+/******************************************************************************
+** Function: ConnectFallback
+**
+** Start a TCP connect to the broker's expired or listed addresses after its
+** address lookup didn't complete.
+**
+*/
+static bool ConnectFallback(const char *Reason)
+{
+   
+   bool RetStatus = false;
+   
+   MqttClient->ConnAddrIndex = 0;
+   MqttClient->ConnAddrCnt   = MQTT_RESOLVE_GetAddr(MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort,
+                                                    MqttClient->ConnAddr, true);
+   if (MqttClient->ConnAddrCnt > 0)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                        "MQTT broker %s address lookup %s, trying %d cached addresses",
+                        MqttClient->ConnBrokerAddress, Reason, MqttClient->ConnAddrCnt);
+      MqttClient->ConnAddrCached = true;
+      RetStatus = StartTcpConnect();
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT broker %s address lookup %s and no cached addresses are available",
+                        MqttClient->ConnBrokerAddress, Reason);
+   }
+   
+   return RetStatus;
+   
+} /* End ConnectFallback() */
+
+
+/******************************************************************************
+** Function: DecodeConnAck
+**
+** Decode the CONNACK in ReadBuf and return SUCCESS, the CONNACK's return
+** code or FAILURE if it isn't a valid CONNACK.
+**
+*/
+static int DecodeConnAck(int PacketLen)
+{
+   
+   int    RetCode = FAILURE;
+   uint8  ReasonCode;
+   unsigned char SessionPresent = 0;
+   unsigned char ConnAckRc;
+   
+   if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+   {
+      if (MQTT_V5_ConnAck(MqttClient->ReadBuf, PacketLen, &ReasonCode, &MqttClient->SessionPresent))
+      {
+         RetCode = (ReasonCode == 0) ? SUCCESS : ReasonCode;
+      }
+   }
+   else if (MQTTDeserialize_connack(&SessionPresent, &ConnAckRc, MqttClient->ReadBuf, PacketLen) == 1)
+   {
+      MqttClient->SessionPresent = (SessionPresent != 0);
+      RetCode = (ConnAckRc == 0) ? SUCCESS : ConnAckRc;
+   }
+   
+   return RetCode;
+   
+} /* End DecodeConnAck() */
+
+
+/******************************************************************************
+** Function: LostConnection
+**
+** Close the network connection after an unrecoverable I/O error.
+**
+*/
+static void LostConnection(void)
+{
+   
+   NetworkDisconnect(&MqttClient->Network);
+   MqttClient->Connected = false;
+   MqttClient->ConnState = MQTT_CLIENT_CONN_IDLE;
+   MqttClient->PingOutstanding = false;
+   MqttClient->PingOutBytes    = 0;
+   MqttClient->SubAckPending   = 0;
+   MqttClient->SubPendingCnt   = 0;
+   MqttClient->CoalesceLen     = 0;
+   MqttClient->CoalescePktCnt  = 0;
+   MqttClient->ReadLen         = 0;
+   MqttClient->OutStart        = 0;
+   MqttClient->OutLen          = 0;
+
+} /* End LostConnection() */
+
+
+/******************************************************************************
+** Function: MonotonicNs
+**
+*/
+static uint64 MonotonicNs(void)
+{
+   
+   struct timespec Now;
+   
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+   
+   return ((uint64)Now.tv_sec * 1000000000ULL + (uint64)Now.tv_nsec);
+   
+} /* End MonotonicNs() */
+
+
+/******************************************************************************
+** Function: NextPacketId
+**
+** Notes:
+**   1. Uses the MQTT library client's packet ID sequence so every packet
+**      ID comes from one sequence.
+**
+*/
+static uint16 NextPacketId(void)
+{
+   
+   MqttClient->Client.next_packetid = (MqttClient->Client.next_packetid == MAX_PACKET_ID) ? 
+                                       1 : MqttClient->Client.next_packetid + 1;
+   
+   return (uint16)MqttClient->Client.next_packetid;
+   
+} /* End NextPacketId() */
+
+
+/******************************************************************************
+** Function: ProcessPacket
+**
+** Dispatch a packet read by ReadPacket().
+**
+** Notes:
+**   1. PUBACKs, PUBRECs and PUBCOMPs are passed to the acknowledgement
+**      callback. A PUBREC is answered with a PUBREL before the callback is
+**      called.
+**   2. An MQTT 5 PUBREC with a failure reason code ends the QoS2 exchange
+**      so it's passed to the callback as a PUBCOMP without a PUBREL.
+**   3. SUBACKs and UNSUBACKs are read here because subscriptions don't
+**      wait for them. SUBACKs are decoded by ProcessSubAck().
+**
+*/
+static bool ProcessPacket(int PacketLen)
+{
+   
+   bool RetStatus = true;
+   MQTTHeader     Header;
+   MQTTString     TopicName;
+   MQTTMessage    Msg;
+   MessageData    MsgData;
+   unsigned char  AckBuf[4];
+   unsigned char  PacketType;
+   unsigned char  Dup;
+   unsigned short PacketId;
+   int            IntQos;
+   int            PayloadLen;
+   int            AckLen = 0;
+   bool           Decoded;
+   uint8          ReasonCode = 0;
+   
+   Header.byte = MqttClient->ReadBuf[0];
+   
+   switch (Header.bits.type)
+   {
+      
+      case PUBLISH:
+         if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+         {
+            Decoded = MQTT_V5_DecodePublish(&TopicName, &Msg, MqttClient->ReadBuf, PacketLen);
+         }
+         else
+         {
+            Decoded = (MQTTDeserialize_publish(&Msg.dup, &IntQos, &Msg.retained, &Msg.id, &TopicName,
+                                               (unsigned char**)&Msg.payload, &PayloadLen,
+                                               MqttClient->ReadBuf, PacketLen) == 1);
+            Msg.qos        = (enum QoS)IntQos;
+            Msg.payloadlen = PayloadLen;
+         }
+         if (Decoded)
+         {
+            if (MqttClient->MsgCallback != NULL)
+            {
+               MsgData.message   = &Msg;
+               MsgData.topicName = &TopicName;
+               MqttClient->MsgCallback(&MsgData);
+            }
+            if (Msg.qos == QOS1)
+            {
+               AckLen = MQTTSerialize_ack(AckBuf, sizeof(AckBuf), PUBACK, 0, Msg.id);
+            }
+            else if (Msg.qos == QOS2)
+            {
+               AckLen = MQTTSerialize_ack(AckBuf, sizeof(AckBuf), PUBREC, 0, Msg.id);
+            }
+         }
+         else
+         {
+            RetStatus = false;
+         }
+         break;
+         
+      case PUBREL:
+         if (MQTTDeserialize_ack(&PacketType, &Dup, &PacketId, MqttClient->ReadBuf, PacketLen) == 1)
+         {
+            AckLen = MQTTSerialize_ack(AckBuf, sizeof(AckBuf), PUBCOMP, 0, PacketId);
+         }
+         else
+         {
+            RetStatus = false;
+         }
+         break;
+         
+      case PUBACK:
+      case PUBREC:
+      case PUBCOMP:
+         if (MQTTDeserialize_ack(&PacketType, &Dup, &PacketId, MqttClient->ReadBuf, PacketLen) == 1)
+         {
+            if (PacketType == PUBREC)
+            {
+               if (MqttClient->Version == MQTT_CLIENT_VERSION_5 && 
+                   MQTT_V5_ReasonCode(MqttClient->ReadBuf, PacketLen) >= 0x80)
+               {
+                  PacketType = PUBCOMP;
+               }
+               else
+               {
+                  AckLen = MQTTSerialize_ack(AckBuf, sizeof(AckBuf), PUBREL, 0, PacketId);
+               }
+            }
+            if (MqttClient->AckCallback != NULL)
+            {
+               MqttClient->AckCallback(PacketType, PacketId);
+            }
+         }
+         else
+         {
+            RetStatus = false;
+         }
+         break;
+         
+      case PINGRESP:
+         if (MqttClient->PingOutstanding && MqttClient->PingOutBytes == 0)
+         {
+            MqttClient->PingRttUs  = (uint32)((MonotonicNs() - MqttClient->PingSendTime) / 1000);
+            MqttClient->PingRttNew = true;
+         }
+         MqttClient->PingOutstanding = false;
+         break;
+         
+      case SUBACK:
+         if (MqttClient->SubAckPending > 0)
+         {
+            MqttClient->SubAckPending--;
+         }
+         ProcessSubAck(PacketLen);
+         break;
+         
+      case UNSUBACK:
+         if (MqttClient->SubAckPending > 0)
+         {
+            MqttClient->SubAckPending--;
+         }
+         if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+         {
+            ReasonCode = MQTT_V5_ReasonCode(MqttClient->ReadBuf, PacketLen);
+         }
+         if (ReasonCode >= 0x80)
+         {
+            CFE_EVS_SendEvent(MQTT_CLIENT_SUBSCRIBE_ERR_EID, CFE_EVS_EventType_ERROR, 
+                              "MQTT broker rejected UNSUBSCRIBE with reason code 0x%02X", ReasonCode);
+         }
+         break;
+         
+      default:
+         break;
+         
+   } /* End packet type switch */
+   
+   if (AckLen > 0)
+   {
+      RetStatus = SendPacket(AckBuf, AckLen);
+   }
+   
+   return RetStatus;
+   
+} /* End ProcessPacket() */
+
+
+/******************************************************************************
+** Function: ProcessSubAck
+**
+** Pass the return code of each tagged topic filter in a SUBACK to the
+** SUBACK callback.
+**
+** Notes:
+**   1. A filter the broker didn't return a code for is passed
+**      MQTT_CLIENT_SUBACK_FAILURE.
+**   2. Rejected filters without a tag or in a SUBSCRIBE whose tags weren't
+**      kept are reported in an event.
+**
+*/
+static void ProcessSubAck(int PacketLen)
+{
+   
+   MQTT_CLIENT_SubPending_t SubPending;
+   uint8  ReturnCode[MQTT_CLIENT_SUB_FILTER_MAX];
+   int    GrantedQos[MQTT_CLIENT_SUB_FILTER_MAX];
+   int    GrantedCnt = 0;
+   uint16 ReturnCodeCnt = 0;
+   uint16 PacketId;
+   uint16 RejectCnt = 0;
+   uint8  RejectCode = 0;
+   uint8  Code;
+   bool   Decoded;
+   bool   Found = false;
+   uint16 i;
+   
+   if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+   {
+      Decoded = MQTT_V5_DecodeSubAck(MqttClient->ReadBuf, PacketLen, &PacketId, ReturnCode,
+                                     MQTT_CLIENT_SUB_FILTER_MAX, &ReturnCodeCnt);
+   }
+   else
+   {
+      Decoded = (MQTTDeserialize_suback(&PacketId, MQTT_CLIENT_SUB_FILTER_MAX, &GrantedCnt, GrantedQos,
+                                        MqttClient->ReadBuf, PacketLen) == 1);
+      for (i = 0; Decoded && i < GrantedCnt; i++)
+      {
+         ReturnCode[i] = (uint8)GrantedQos[i];
+      }
+      ReturnCodeCnt = Decoded ? GrantedCnt : 0;
+   }
+   if (!Decoded)
+   {
+      return;
+   }
+   
+   for (i = 0; i < MqttClient->SubPendingCnt; i++)
+   {
+      if (MqttClient->SubPending[i].PacketId == PacketId)
+      {
+         SubPending = MqttClient->SubPending[i];
+         MqttClient->SubPending[i] = MqttClient->SubPending[--MqttClient->SubPendingCnt];
+         Found = true;
+         break;
+      }
+   }
+   
+   if (Found)
+   {
+      for (i = 0; i < SubPending.FilterCnt; i++)
+      {
+         Code = (i < ReturnCodeCnt) ? ReturnCode[i] : MQTT_CLIENT_SUBACK_FAILURE;
+         if (SubPending.Tag[i] != MQTT_CLIENT_SUB_TAG_NONE && MqttClient->SubAckCallback != NULL)
+         {
+            MqttClient->SubAckCallback(SubPending.Tag[i], Code);
+         }
+         else if (Code >= MQTT_CLIENT_SUBACK_FAILURE)
+         {
+            RejectCnt++;
+            RejectCode = Code;
+         }
+      }
+   }
+   else
+   {
+      for (i = 0; i < ReturnCodeCnt; i++)
+      {
+         if (ReturnCode[i] >= MQTT_CLIENT_SUBACK_FAILURE)
+         {
+            RejectCnt++;
+            RejectCode = ReturnCode[i];
+         }
+      }
+   }
+   
+   if (RejectCnt > 0)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_SUBSCRIBE_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT broker rejected %d topic filter(s) in SUBSCRIBE %d with reason code 0x%02X",
+                        RejectCnt, PacketId, RejectCode);
+   }
+   
+} /* End ProcessSubAck() */
+
+
+/******************************************************************************
+** Function: QueuePacket
+**
+** Send a serialized PUBLISH, coalescing it with other PUBLISH packets when
+** coalescing is enabled.
+**
+** Notes:
+**   1. The oldest buffered packet sets the flush deadline.
+**   2. A packet longer than the coalescing buffer is written on its own
+**      after the buffer is flushed so packet order is preserved.
+**
+*/
+static bool QueuePacket(const unsigned char *Buf, int Len)
+{
+   
+   bool RetStatus = true;
+   
+   if (MqttClient->CoalesceBytes == 0)
+   {
+      return WriteBuf(Buf, Len);
+   }
+   
+   if ((MqttClient->CoalesceLen + Len) > MQTT_CLIENT_COALESCE_BUF_LEN)
+   {
+      RetStatus = MQTT_CLIENT_Flush();
+   }
+   
+   if (RetStatus)
+   {
+      if (Len > MQTT_CLIENT_COALESCE_BUF_LEN)
+      {
+         RetStatus = WriteBuf(Buf, Len);
+      }
+      else
+      {
+         if (MqttClient->CoalesceLen == 0)
+         {
+            MqttClient->CoalesceDeadline = MonotonicNs() + (uint64)MqttClient->CoalesceUsec * 1000;
+         }
+         memcpy(&MqttClient->CoalesceBuf[MqttClient->CoalesceLen], Buf, Len);
+         MqttClient->CoalesceLen += Len;
+         MqttClient->CoalescePktCnt++;
+         
+         if (MqttClient->CoalesceLen >= MqttClient->CoalesceBytes)
+         {
+            RetStatus = MQTT_CLIENT_Flush();
+         }
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End QueuePacket() */
+
+
+/******************************************************************************
+** Function: QueuePublish
+**
+** Queue a PUBLISH packet image, converting it to MQTT 5 when needed.
+**
+** Notes:
+**   1. Images are built in the MQTT 3.1.1 format by MQTT_CLIENT and the
+**      publish queue. A conversion failure is treated like a write error.
+**
+*/
+static bool QueuePublish(const unsigned char *Packet, int Len)
+{
+   
+   const uint8 *Packet5;
+   uint32 Len5;
+   
+   if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+   {
+      Packet5 = MQTT_V5_EncodePublish(Packet, Len, &Len5);
+      return (Packet5 != NULL && QueuePacket(Packet5, Len5));
+   }
+   
+   return QueuePacket(Packet, Len);
+   
+} /* End QueuePublish() */
+
+
+/******************************************************************************
+** Function: ReadPacket
+**
+** Read the available bytes of a packet into ReadBuf and return the
+** packet's total length once it's complete. Zero is returned while the
+** packet is incomplete and -1 if the connection is closed or a read error
+** occurs.
+**
+** Notes:
+**   1. Only the bytes the packet still needs are read so a following
+**      packet stays in the socket.
+**   2. A packet that doesn't fit in ReadBuf can't be resynchronized so it
+**      is treated as a read error.
+**
+*/
+static int ReadPacket(void)
+{
+   
+   unsigned char *Buf = MqttClient->ReadBuf;
+   uint32  NeedLen;
+   uint32  HdrLen;
+   uint32  RemLen;
+   uint32  Multiplier;
+   ssize_t Rc;
+   
+   while (true)
+   {
+      
+      /* Fixed header: remaining length is encoded in at most 4 bytes */
+      NeedLen = 2;
+      if (MqttClient->ReadLen >= 2)
+      {
+         HdrLen = 1;
+         RemLen = 0;
+         Multiplier = 1;
+         do
+         {
+            RemLen += (Buf[HdrLen] & 127) * Multiplier;
+            Multiplier *= 128;
+         } while ((Buf[HdrLen++] & 128) != 0 && HdrLen < MqttClient->ReadLen && HdrLen <= 4);
+         
+         if ((Buf[HdrLen - 1] & 128) != 0)
+         {
+            if (HdrLen > 4)
+            {
+               return -1;
+            }
+            NeedLen = HdrLen + 1;
+         }
+         else
+         {
+            NeedLen = HdrLen + RemLen;
+         }
+      }
+      
+      if (NeedLen > MQTT_CLIENT_READ_BUF_LEN)
+      {
+         return -1;
+      }
+      
+      if (MqttClient->ReadLen >= NeedLen)
+      {
+         MqttClient->ReadLen = 0;
+         return (int)NeedLen;
+      }
+      
+      Rc = recv(MqttClient->Network.my_socket, &Buf[MqttClient->ReadLen], NeedLen - MqttClient->ReadLen, 0);
+      if (Rc > 0)
+      {
+         MqttClient->ReadLen += Rc;
+      }
+      else if (Rc < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      else if (Rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+         return 0;
+      }
+      else
+      {
+         return -1;
+      }
+      
+   } /* End read loop */
+   
+} /* End ReadPacket() */
+
+
+/******************************************************************************
+** Function: SendConnect
+**
+** Write the CONNECT for the connect in progress.
+**
+*/
+static bool SendConnect(void)
+{
+   
+   int Len;
+   
+   if (MqttClient->Version == MQTT_CLIENT_VERSION_5)
+   {
+      Len = (int)MQTT_V5_SerializeConnect(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN,
+                                          MqttClient->ConnClientName, MQTT_CLIENT_KEEPALIVE_SEC,
+                                          !MqttClient->PersistentSession);
+   }
+   else
+   {
+      Len = MQTTSerialize_connect(MqttClient->SendBuf, MQTT_CLIENT_SEND_BUF_LEN, &MqttClient->ConnectData);
+   }
+   
+   return (Len > 0 && WriteBuf(MqttClient->SendBuf, Len));
+   
+} /* End SendConnect() */
+
+
+/******************************************************************************
+** Function: SendBytes
+**
+** Write as much of a buffer as the socket accepts without blocking. Returns
+** the number of bytes written or -1 if a write error occurs.
+**
+*/
+static int SendBytes(const unsigned char *Buf, int Len)
+{
+   
+   int     Sent = 0;
+   ssize_t Rc;
+   
+   while (Sent < Len)
+   {
+      Rc = send(MqttClient->Network.my_socket, &Buf[Sent], Len - Sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (Rc > 0)
+      {
+         Sent += Rc;
+      }
+      else if (Rc < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      else if (Rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+         break;
+      }
+      else
+      {
+         return -1;
+      }
+   }
+   
+   return Sent;
+   
+} /* End SendBytes() */
+
+
+/******************************************************************************
+** Function: SendPacket
+**
+** Write a serialized control packet.
+**
+** Notes:
+**   1. Coalesced packets are written first so packet order is preserved.
+**      When the packet fits it's appended so both go in one write.
+**
+*/
+static bool SendPacket(unsigned char *Buf, int Len)
+{
+   
+   if (MqttClient->CoalesceLen > 0)
+   {
+      if ((MqttClient->CoalesceLen + Len) <= MQTT_CLIENT_COALESCE_BUF_LEN)
+      {
+         memcpy(&MqttClient->CoalesceBuf[MqttClient->CoalesceLen], Buf, Len);
+         MqttClient->CoalesceLen += Len;
+         MqttClient->CoalescePktCnt++;
+         return MQTT_CLIENT_Flush();
+      }
+      if (!MQTT_CLIENT_Flush())
+      {
+         return false;
+      }
+   }
+   
+   return WriteBuf(Buf, Len);
+   
+} /* End SendPacket() */
+
+
+/******************************************************************************
+** Function: SocketReady
+**
+** Return true if the socket is ready for Events without blocking.
+**
+*/
+static bool SocketReady(short Events)
+{
+   
+   struct pollfd PollFd;
+   
+   PollFd.fd = MqttClient->Network.my_socket;
+   PollFd.events  = Events;
+   PollFd.revents = 0;
+   
+   return (poll(&PollFd, 1, 0) > 0);
+   
+} /* End SocketReady() */
+
+
+/******************************************************************************
+** Function: StartTcpConnect
+**
+** Start a non-blocking TCP connect to the first broker address from
+** ConnAddrIndex that accepts one.
+**
+*/
+static bool StartTcpConnect(void)
+{
+   
+   bool RetStatus = false;
+   int  Sock;
+   const MQTT_RESOLVE_Addr_t *Addr;
+   
+   for (; MqttClient->ConnAddrIndex < MqttClient->ConnAddrCnt; MqttClient->ConnAddrIndex++)
+   {
+      Addr = &MqttClient->ConnAddr[MqttClient->ConnAddrIndex];
+      Sock = socket(Addr->Addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if (Sock >= 0)
+      {
+         if (connect(Sock, (const struct sockaddr *)&Addr->Addr, Addr->AddrLen) == 0 || errno == EINPROGRESS)
+         {
+            MqttClient->Network.my_socket = Sock;
+            MqttClient->ReadLen      = 0;
+            MqttClient->OutStart     = 0;
+            MqttClient->OutLen       = 0;
+            MqttClient->ConnState    = MQTT_CLIENT_CONN_TCP;
+            MqttClient->ConnDeadline = MonotonicNs() + CONNECT_TIMEOUT_NS;
+            RetStatus = true;
+            break;
+         }
+         else
+         {
+            close(Sock);
+         }
+      }
+   }
+   
+   if (!RetStatus)
+   {
+      CFE_EVS_SendEvent(MQTT_CLIENT_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR, 
+                        "Error creating MQTT network connection to %s:%d. Status=%d",
+                        MqttClient->ConnBrokerAddress, MqttClient->ConnBrokerPort, errno);
+   }
+   
+   return RetStatus;
+   
+} /* End StartTcpConnect() */
+
+
+/******************************************************************************
+** Function: WaitOutBuf
+**
+** Wait until OutBuf has room for Len bytes. Returns false if the socket
+** isn't writable within MQTT_CLIENT_TIMEOUT_MS or a write error occurs.
+**
+** Notes:
+**   1. Only waits when the socket has stopped accepting data for longer
+**      than the output buffer can absorb, or to empty OutBuf before the
+**      socket is closed.
+**
+*/
+static bool WaitOutBuf(uint32 Len)
+{
+   
+   bool   RetStatus = (Len <= MQTT_CLIENT_OUT_BUF_LEN);
+   struct pollfd PollFd;
+   
+   while (RetStatus && (MQTT_CLIENT_OUT_BUF_LEN - MqttClient->OutLen) < Len)
+   {
+      PollFd.fd      = MqttClient->Network.my_socket;
+      PollFd.events  = POLLOUT;
+      PollFd.revents = 0;
+      RetStatus = (poll(&PollFd, 1, MQTT_CLIENT_TIMEOUT_MS) > 0 && WriteOutBuf());
+   }
+   
+   return RetStatus;
+   
+} /* End WaitOutBuf() */
+
+
+/******************************************************************************
+** Function: WriteBuf
+**
+** Write a buffer of serialized packets and restart the keepalive timer.
+**
+** Notes:
+**   1. Bytes the socket doesn't accept are copied to OutBuf. Later writes
+**      are appended to OutBuf while it holds data so packet order is
+**      preserved.
+**
+*/
+static bool WriteBuf(const unsigned char *Buf, int Len)
+{
+   
+   bool RetStatus = true;
+   int  Sent = 0;
+   
+   if (MqttClient->OutLen > 0)
+   {
+      RetStatus = WriteOutBuf();
+   }
+   
+   if (RetStatus && MqttClient->OutLen == 0)
+   {
+      Sent = SendBytes(Buf, Len);
+      RetStatus = (Sent >= 0);
+   }
+   
+   if (RetStatus && Sent < Len)
+   {
+      RetStatus = WaitOutBuf(Len - Sent);
+      if (RetStatus)
+      {
+         if ((MqttClient->OutStart + MqttClient->OutLen + (Len - Sent)) > MQTT_CLIENT_OUT_BUF_LEN)
+         {
+            memmove(MqttClient->OutBuf, &MqttClient->OutBuf[MqttClient->OutStart], MqttClient->OutLen);
+            MqttClient->OutStart = 0;
+         }
+         memcpy(&MqttClient->OutBuf[MqttClient->OutStart + MqttClient->OutLen], &Buf[Sent], Len - Sent);
+         MqttClient->OutLen += Len - Sent;
+      }
+   }
+   
+   if (RetStatus)
+   {
+      TimerCountdown(&MqttClient->PingTimer, MQTT_CLIENT_KEEPALIVE_SEC);
+   }
+   
+   return RetStatus;
+   
+} /* End WriteBuf() */
+
+
+/******************************************************************************
+** Function: WriteOutBuf
+**
+** Write as much of OutBuf as the socket accepts. Returns false if a write
+** error occurs.
+**
+** Notes:
+**   1. The PINGREQ round trip starts when the last of its bytes is written.
+**
+*/
+static bool WriteOutBuf(void)
+{
+   
+   int Sent = SendBytes(&MqttClient->OutBuf[MqttClient->OutStart], MqttClient->OutLen);
+   
+   if (Sent > 0)
+   {
+      if (MqttClient->PingOutBytes > 0)
+      {
+         if ((uint32)Sent >= MqttClient->PingOutBytes)
+         {
+            MqttClient->PingOutBytes = 0;
+            MqttClient->PingSendTime = MonotonicNs();
+         }
+         else
+         {
+            MqttClient->PingOutBytes -= Sent;
+         }
+      }
+      MqttClient->OutStart += Sent;
+      MqttClient->OutLen   -= Sent;
+      if (MqttClient->OutLen == 0)
+      {
+         MqttClient->OutStart = 0;
+      }
+   }
+   
+   return (Sent >= 0);
+   
+} /* End WriteOutBuf() */
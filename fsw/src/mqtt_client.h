@@ -16,11 +16,30 @@
 **   Manage the MQTT client interface using the MQTT Library
 **
 ** Notes:
-**   None
+**   1. MQTT_VERSION in the ini file selects the protocol version. MQTT 5
+**      packets that differ from MQTT 3.1.1 are encoded and decoded by
+**      MQTT_V5. SUBSCRIBE and UNSUBSCRIBE don't wait for their
+**      acknowledgement, a failure is reported in an event when the
+**      acknowledgement is read.
+**   2. With MQTT_PERSISTENT_SESSION the client ID is MQTT_CLIENT_NAME
+**      without a random suffix so the broker can resume the session after
+**      a reconnect. The broker keeps the subscriptions and queues QoS1 and
+**      QoS2 messages for the client while it's disconnected.
+**   3. Connecting doesn't block. MQTT_CLIENT_Connect() starts the broker
+**      address lookup and MQTT_CLIENT_ProcessConnect() advances the
+**      connection through the TCP connect and the CONNECT/CONNACK exchange
+**      as the socket becomes ready.
+**   4. MQTT_CLIENT_SubscribeBatch() sends a set of topic filters in as few
+**      SUBSCRIBE packets as the send buffer allows. Each filter's SUBACK
+**      return code is passed to the SUBACK callback with the filter's tag
+**      so the subscriber can tell which of its filters were granted.
+**   5. The socket stays non-blocking after the connect. Packets are read
+**      as their bytes arrive and bytes the socket can't accept are held in
+**      OutBuf until MQTT_CLIENT_ProcessOutput() writes them.
 **
 */
 #ifndef _mqtt_client_
-#define _mqtt_client
+#define _mqtt_client_
 
 
 /*
@@ -31,6 +50,9 @@
 #include "MQTTClient.h"
 
 #include "app_cfg.h"
+#include "mqtt_resolve.h"
+#include "mqtt_trace.h"
+#include "mqtt_v5.h"
 
 
 
@@ -49,10 +71,38 @@
 #define MQTT_CLIENT_CONNECT_ERR_EID    (MQTT_CLIENT_BASE_EID + 3)
 #define MQTT_CLIENT_PUBLISH_EID        (MQTT_CLIENT_BASE_EID + 4)
 #define MQTT_CLIENT_PUBLISH_ERR_EID    (MQTT_CLIENT_BASE_EID + 5)
-#define MQTT_CLIENT_YIELD_ERR_EID      (MQTT_CLIENT_BASE_EID + 6)
+#define MQTT_CLIENT_INPUT_ERR_EID      (MQTT_CLIENT_BASE_EID + 6)
+#define MQTT_CLIENT_KEEPALIVE_ERR_EID  (MQTT_CLIENT_BASE_EID + 7)
+#define MQTT_CLIENT_SUBSCRIBE_ERR_EID  (MQTT_CLIENT_BASE_EID + 8)
+#define MQTT_CLIENT_OUTPUT_ERR_EID     (MQTT_CLIENT_BASE_EID + 9)
 
 #define MAX_CLIENT_PARAM_STR_LEN  64
 
+#define MQTT_CLIENT_KEEPALIVE_SEC  10
+
+/* MQTT_VERSION values */
+#define MQTT_CLIENT_VERSION_31   3
+#define MQTT_CLIENT_VERSION_311  4
+#define MQTT_CLIENT_VERSION_5    5
+
+/* Longest wait between checks of an address lookup, it doesn't have a descriptor to wait on */
+#define MQTT_CLIENT_RESOLVE_POLL_MS  10
+
+/* Tag of a topic filter whose SUBACK return code isn't passed to the SUBACK callback */
+#define MQTT_CLIENT_SUB_TAG_NONE  (-1)
+
+/* SUBACK callback return code of a filter the broker didn't return a code for */
+#define MQTT_CLIENT_SUBACK_FAILURE  0x80
+
+/* MQTT_CLIENT_FlushTimeout() value when no packets are waiting to be written */
+#define MQTT_CLIENT_FLUSH_IDLE  0xFFFFFFFF
+
+/*
+** Space reserved ahead of a PUBLISH packet image's variable header for the
+** longest fixed header, a type byte plus a 4 byte remaining length.
+*/
+#define MQTT_CLIENT_PUBLISH_HDR_MAX_LEN  5
+
 /**********************/
 /** Type Definitions **/
 /**********************/
@@ -72,6 +122,37 @@ typedef enum
 } MQTT_CLIENT_Qos_t; 
 
 
+/*
+** Connection state. Each connecting state is limited to
+** MQTT_CLIENT_TIMEOUT_MS.
+*/
+
+typedef enum
+{
+
+   MQTT_CLIENT_CONN_IDLE    = 0,   /* Not connected and not connecting */
+   MQTT_CLIENT_CONN_RESOLVE = 1,   /* Waiting for the broker address lookup */
+   MQTT_CLIENT_CONN_TCP     = 2,   /* Waiting for the TCP connection */
+   MQTT_CLIENT_CONN_CONNACK = 3,   /* CONNECT sent, waiting for the CONNACK */
+   MQTT_CLIENT_CONN_UP      = 4
+
+} MQTT_CLIENT_ConnState_t;
+
+
+/*
+** MQTT_CLIENT_ProcessConnect() results
+*/
+
+typedef enum
+{
+
+   MQTT_CLIENT_CONNECT_PENDING = 0,
+   MQTT_CLIENT_CONNECT_DONE    = 1,
+   MQTT_CLIENT_CONNECT_FAILED  = 2
+
+} MQTT_CLIENT_ConnectStatus_t;
+
+
 /*
 ** Process message function callback signature 
 */
@@ -80,6 +161,48 @@ typedef MessageData MQTT_CLIENT_MsgData_t; /* Redefined tio isolate/contain mqtt
 
 typedef void (*MQTT_CLIENT_MsgCallback_t) (MQTT_CLIENT_MsgData_t *MsgData);
 
+/*
+** Acknowledgement callback signature for QoS1 and QoS2 PUBLISH packets sent
+** without waiting. AckType is PUBACK, PUBREC or PUBCOMP.
+*/
+
+typedef void (*MQTT_CLIENT_AckCallback_t) (uint8 AckType, uint16 PacketId);
+
+/*
+** A topic filter sent by MQTT_CLIENT_SubscribeBatch(). Tag identifies the
+** filter's subscriber in the SUBACK callback.
+*/
+
+typedef struct
+{
+
+   const char *Topic;
+   int    Qos;
+   int32  Tag;
+
+} MQTT_CLIENT_SubFilter_t;
+
+/*
+** SUBACK callback signature, called for each tagged filter in a SUBACK.
+** ReturnCode is the granted QoS or a failure code of 0x80 or greater.
+*/
+
+typedef void (*MQTT_CLIENT_SubAckCallback_t) (int32 Tag, uint8 ReturnCode);
+
+/*
+** A SUBSCRIBE waiting for its SUBACK. Tag[i] is the tag of the packet's
+** i'th topic filter.
+*/
+
+typedef struct
+{
+
+   uint16  PacketId;
+   uint16  FilterCnt;
+   int32   Tag[MQTT_CLIENT_SUB_FILTER_MAX];
+
+} MQTT_CLIENT_SubPending_t;
+
 /*
 ** Class Definition
 */
@@ -87,13 +210,93 @@ typedef void (*MQTT_CLIENT_MsgCallback_t) (MQTT_CLIENT_MsgData_t *MsgData);
 typedef struct
 {
 
-   bool    Connected;
+   bool    Connected;          /* ConnState is MQTT_CLIENT_CONN_UP */
+   uint8   Version;
+   bool    PersistentSession;
+   bool    SessionPresent;     /* Broker resumed the session on the last connect */
    
    char    BrokerAddress[MAX_CLIENT_PARAM_STR_LEN];
    uint32  BrokerPort;
    char    ClientName[MAX_CLIENT_PARAM_STR_LEN];
    
-   MQTTMessage PubMsg;
+   MQTT_CLIENT_MsgCallback_t    MsgCallback;
+   MQTT_CLIENT_AckCallback_t    AckCallback;
+   MQTT_CLIENT_SubAckCallback_t SubAckCallback;
+   
+   uint16  SubAckPending;   /* SUBSCRIBE and UNSUBSCRIBE packets waiting to be acknowledged */
+   
+   /*
+   ** SUBSCRIBEs with tagged filters that are waiting for their SUBACK. When
+   ** SubPending is full a SUBSCRIBE's results are only reported in events.
+   */
+   
+   uint16  SubPendingCnt;
+   MQTT_CLIENT_SubPending_t SubPending[MQTT_CLIENT_SUB_PENDING_MAX];
+   
+   /*
+   ** Connect in progress: the parameters are copied because the connect
+   ** completes after MQTT_CLIENT_Connect() returns. ConnDeadline is the
+   ** CLOCK_MONOTONIC ns time the current state times out. ConnAddr holds
+   ** the broker's addresses and ConnAddrIndex is the address being
+   ** connected to. ConnAddrCached is set when they came from the address
+   ** cache rather than a lookup.
+   */
+   
+   MQTT_CLIENT_ConnState_t  ConnState;
+   uint64  ConnDeadline;
+   char    ConnBrokerAddress[MAX_CLIENT_PARAM_STR_LEN];
+   uint32  ConnBrokerPort;
+   char    ConnClientName[MAX_CLIENT_PARAM_STR_LEN];
+   bool    ConnAddrCached;
+   uint16  ConnAddrCnt;
+   uint16  ConnAddrIndex;
+   MQTT_RESOLVE_Addr_t  ConnAddr[MQTT_RESOLVE_ADDR_MAX];
+   
+   /*
+   ** Keepalive: PingTimer is restarted whenever a packet is sent and
+   ** PingRespTimer runs while a PINGREQ is outstanding. When ProbeRtt is
+   ** set for RTT failover ProbeTimer sends a PINGREQ every keepalive
+   ** interval while other packets are being sent so the broker's round trip
+   ** time is always measured. PingOutBytes counts the OutBuf bytes up to
+   ** the end of the PINGREQ and PingSendTime is the CLOCK_MONOTONIC ns time
+   ** they were written.
+   */
+   
+   bool   ProbeRtt;
+   bool   PingOutstanding;
+   uint32 PingOutBytes;
+   Timer  PingTimer;
+   Timer  PingRespTimer;
+   Timer  ProbeTimer;
+   uint64 PingSendTime;
+   uint32 PingRttUs;
+   bool   PingRttNew;
+   
+   /*
+   ** Output coalescing: PUBLISH packets are serialized back-to-back in
+   ** CoalesceBuf and written together. CoalesceBytes is the flush
+   ** threshold and zero disables coalescing. CoalesceDeadline is the
+   ** CLOCK_MONOTONIC ns time the oldest buffered packet must be written by.
+   */
+   
+   uint32  CoalesceBytes;
+   uint32  CoalesceUsec;
+   uint32  CoalesceLen;
+   uint32  CoalescePktCnt;
+   uint64  CoalesceDeadline;
+   
+   uint32  CoalesceFlushCnt;     /* Writes of coalesced packets */
+   uint32  CoalesceSavedCnt;     /* Socket writes saved by coalescing */
+   
+   /*
+   ** Non-blocking socket: ReadLen bytes of the packet being read are in
+   ** ReadBuf. OutBuf holds OutLen bytes from OutStart that the socket
+   ** hasn't accepted yet.
+   */
+   
+   uint32  ReadLen;
+   uint32  OutStart;
+   uint32  OutLen;
    
    /*
    ** MQTT Library
@@ -104,6 +307,16 @@ typedef struct
    MQTTPacket_connectData  ConnectData;    
    unsigned char           SendBuf[MQTT_CLIENT_SEND_BUF_LEN];
    unsigned char           ReadBuf[MQTT_CLIENT_READ_BUF_LEN];
+   
+   unsigned char           CoalesceBuf[MQTT_CLIENT_COALESCE_BUF_LEN];
+   unsigned char           OutBuf[MQTT_CLIENT_OUT_BUF_LEN];
+
+   /*
+   ** Contained Objects
+   */
+   
+   MQTT_V5_Class_t       Mqtt5;
+   MQTT_RESOLVE_Class_t  Resolve;
 
 } MQTT_CLIENT_Class_t;
 
@@ -124,34 +337,283 @@ void MQTT_CLIENT_Constructor(MQTT_CLIENT_Class_t *MqttClientPtr,
                              const INITBL_Class_t *IniTbl);
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_BeginPublish
+**
+** Start a QoS0 PUBLISH packet image in Buf. The topic is written after
+** MQTT_CLIENT_PUBLISH_HDR_MAX_LEN reserved bytes and the index where the
+** payload must be written is returned. Zero is returned if the topic
+** doesn't fit in BufLen.
+**
+** Notes:
+**    1. Lets a producer write the payload directly into the buffer that is
+**       written to the socket. MQTT_CLIENT_EndPublish() completes the image
+**       once the payload length is known.
+**
+*/
+uint32 MQTT_CLIENT_BeginPublish(uint8 *Buf, uint32 BufLen, const char *Topic, uint32 TopicLen);
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Connect
 **
+** Start connecting to a broker, closing the current connection first.
+**
 ** Notes:
-**    None
+**    1. Returns false if the connect couldn't be started. Otherwise the
+**       network owner completes it with MQTT_CLIENT_ProcessConnect().
+**    2. A numeric broker address skips the address lookup.
 **
 */
 bool MQTT_CLIENT_Connect(const char *ClientName,
                          const char *BrokerAddress, uint32 BrokerPort);
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_ConnectTimeout
+**
+** Return the number of milliseconds until MQTT_CLIENT_ProcessConnect() has
+** work to do if the socket doesn't become ready first. Used to schedule the
+** network owner's wait while connecting.
+**
+** Notes:
+**    1. Limited to MQTT_CLIENT_RESOLVE_POLL_MS during the address lookup.
+**
+*/
+uint32 MQTT_CLIENT_ConnectTimeout(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Connecting
+**
+** Return true while a connect started by MQTT_CLIENT_Connect() is in
+** progress.
+**
+*/
+bool MQTT_CLIENT_Connecting(void);
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Disconnect
 **
 ** Notes:
-**    None
+**    1. A connect in progress is abandoned.
 **
 */
 void MQTT_CLIENT_Disconnect(void);
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_EndPublish
+**
+** Write the fixed header of a packet image started by
+** MQTT_CLIENT_BeginPublish() and return the index of the packet's first
+** byte. The packet ends with the payload.
+**
+** Notes:
+**    1. The packet is QoS0. Retain sets the PUBLISH retain flag.
+**
+*/
+uint32 MQTT_CLIENT_EndPublish(uint8 *Buf, uint32 PayloadIndex, uint32 PayloadLen, bool Retain);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_Flush
+**
+** Write any coalesced packets with a single write.
+**
+** Notes:
+**    1. Returns false if the connection is lost. Coalesced packets are
+**       discarded when the connection is lost.
+**
+*/
+bool MQTT_CLIENT_Flush(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_FlushTimeout
+**
+** Return the number of microseconds until coalesced packets must be
+** flushed, 0 if they're overdue or MQTT_CLIENT_FLUSH_IDLE if there aren't
+** any. Used to schedule the network owner's wait.
+**
+*/
+uint32 MQTT_CLIENT_FlushTimeout(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_GetPingRtt
+**
+** Return true with the PINGREQ round trip time once for each PINGRESP
+**
+*/
+bool MQTT_CLIENT_GetPingRtt(uint32 *RttUs);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_GetSocket
+**
+** Return the socket descriptor of the broker connection or -1 if there
+** isn't a socket. The socket is returned while connecting.
+**
+** Notes:
+**    1. Only intended to be used to wait for socket readiness. All reads and
+**       writes must be performed through MQTT_CLIENT functions.
+**
+*/
+int MQTT_CLIENT_GetSocket(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_GetSocketEvents
+**
+** Return the poll() events to wait for on MQTT_CLIENT_GetSocket(), POLLOUT
+** while the TCP connect is in progress and POLLIN otherwise. POLLOUT is
+** added while output is waiting for MQTT_CLIENT_ProcessOutput().
+**
+*/
+short MQTT_CLIENT_GetSocketEvents(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_GetVersion
+**
+** Return the MQTT protocol version, MQTT_CLIENT_VERSION_311 or
+** MQTT_CLIENT_VERSION_5. The broker accepts the version in the CONNECT or
+** refuses the connection so it's also the connection's version.
+**
+*/
+uint8 MQTT_CLIENT_GetVersion(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_KeepAlive
+**
+** Send a PINGREQ if nothing has been sent for the keepalive interval and
+** check for an overdue PINGRESP.
+**
+** Notes:
+**    1. Returns false if the connection is lost. 
+**
+*/
+bool MQTT_CLIENT_KeepAlive(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_KeepAliveTimeout
+**
+** Return the number of milliseconds until MQTT_CLIENT_KeepAlive() has work
+** to do. Used to schedule the network owner's wait.
+**
+*/
+uint32 MQTT_CLIENT_KeepAliveTimeout(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ProcessConnect
+**
+** Advance a connect started by MQTT_CLIENT_Connect() without blocking.
+**
+** Notes:
+**    1. Returns MQTT_CLIENT_CONNECT_DONE when the CONNACK accepts the
+**       connection. Failures are reported in events, the socket is closed
+**       and MQTT_CLIENT_CONNECT_FAILED is returned.
+**    2. The CONNECT is written and the CONNACK is read as the socket
+**       becomes ready, the connect times out after MQTT_CLIENT_TIMEOUT_MS.
+**
+*/
+MQTT_CLIENT_ConnectStatus_t MQTT_CLIENT_ProcessConnect(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ProcessInput
+**
+** Read and dispatch every complete packet that is available on the socket.
+**
+** Notes:
+**    1. Should only be called when the socket is readable. A partially
+**       received packet is kept and completed by a later call.
+**    2. Returns false if the connection is lost.
+**
+*/
+bool MQTT_CLIENT_ProcessInput(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ProcessOutput
+**
+** Write output the socket didn't accept when it was sent.
+**
+** Notes:
+**    1. Should be called when the socket is writable.
+**    2. Returns false if the connection is lost.
+**
+*/
+bool MQTT_CLIENT_ProcessOutput(void);
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Publish
 **
+** Serialize and send a QoS0 PUBLISH. Payload doesn't need to be NUL
+** terminated and may contain binary data.
+**
 ** Notes:
 **    1. QOS needs to be converted to MQTT library constants
+**    2. When coalescing is enabled the packet is only written when
+**       MQTT_CLIENT_Flush() is called or the coalescing threshold is
+**       reached, so a true return means the packet was accepted.
+*/
+bool MQTT_CLIENT_Publish(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                         bool Retain);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_PublishPacket
+**
+** Send a PUBLISH packet image built with MQTT_CLIENT_BeginPublish() and
+** MQTT_CLIENT_EndPublish(). PluginId, Topic and PayloadLen are only used
+** for event messages and trace records.
+**
+** Notes:
+**    1. The image is written from Packet without being copied unless it's
+**       coalesced. Coalescing is the same as MQTT_CLIENT_Publish().
+**
+*/
+bool MQTT_CLIENT_PublishPacket(int32 PluginId, const char *Topic, const uint8 *Packet,
+                               uint32 PacketLen, uint32 PayloadLen);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_PublishQos1
+**
+** Send a QoS1 PUBLISH without waiting for its PUBACK.
+**
+** Notes:
+**    1. When PacketId is zero a new packet ID is returned in it, otherwise
+**       the message is resent with that packet ID and the DUP flag set
+**       after a session is resumed. The PUBACK is reported to the
+**       callback registered with MQTT_CLIENT_SetAckCallback() when it's
+**       read by MQTT_CLIENT_ProcessInput().
+**    2. Coalesced like MQTT_CLIENT_Publish().
+**
+*/
+bool MQTT_CLIENT_PublishQos1(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                             bool Retain, uint16 *PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_ReceiveMax
+**
+** Return the number of QoS1 and QoS2 messages the broker accepts before
+** they're acknowledged
+**
+** Notes:
+**    1. Only an MQTT 5 broker sets a limit. Other versions return
+**       MQTT_V5_RECEIVE_MAX_DEF, the MQTT 5 default.
+**
 */
-bool MQTT_CLIENT_Publish(const char *Topic, const char *Payload);
+uint16 MQTT_CLIENT_ReceiveMax(void);
 
 
 /******************************************************************************
@@ -159,6 +621,9 @@ bool MQTT_CLIENT_Publish(const char *Topic, const char *Payload);
 **
 ** Reconnect to an MQTT broker using current parameters
 **
+** Notes:
+**    1. Starts the connect like MQTT_CLIENT_Connect().
+**
 */
 bool MQTT_CLIENT_Reconnect(void);
 
@@ -172,32 +637,138 @@ bool MQTT_CLIENT_Reconnect(void);
 void MQTT_CLIENT_ResetStatus(void);
 
 
+/******************************************************************************
+** Function: MQTT_CLIENT_SendPubRel
+**
+** Send the PUBREL for a QoS2 message.
+**
+** Notes:
+**    1. PUBRECs read by MQTT_CLIENT_ProcessInput() are answered
+**       automatically. This is only needed to retransmit a PUBREL.
+**    2. Returns false if the connection is lost.
+**
+*/
+bool MQTT_CLIENT_SendPubRel(uint16 PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SendReady
+**
+** Return true if there isn't output waiting for the socket.
+**
+** Notes:
+**    1. Publishers should wait while this is false so PUBLISH packets don't
+**       fill the output buffer. Control packets are always accepted.
+**
+*/
+bool MQTT_CLIENT_SendReady(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SerializePublish
+**
+** Serialize a PUBLISH packet into Buf and return its length. Zero is
+** returned if the packet doesn't fit in BufLen.
+**
+** Notes:
+**    1. QoS1 and QoS2 packets are assigned the next packet ID, which is
+**       returned in PacketId.
+**    2. Send the packet with MQTT_CLIENT_PublishPacket().
+**
+*/
+uint32 MQTT_CLIENT_SerializePublish(uint8 *Buf, uint32 BufLen, MQTT_CLIENT_Qos_t Qos, bool Retain,
+                                    const char *Topic, const char *Payload, uint32 PayloadLen,
+                                    uint16 *PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SessionPresent
+**
+** Return true if the broker resumed a persistent session on the last
+** connect so the session's subscriptions are still in place.
+**
+*/
+bool MQTT_CLIENT_SessionPresent(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SetAckCallback
+**
+** Register the function that is called for each PUBACK, PUBREC and PUBCOMP
+** read by MQTT_CLIENT_ProcessInput().
+**
+*/
+void MQTT_CLIENT_SetAckCallback(MQTT_CLIENT_AckCallback_t AckCallbackFunc);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SetSubAckCallback
+**
+** Register the function that is called with the return code of each tagged
+** topic filter in a SUBACK read by MQTT_CLIENT_ProcessInput().
+**
+*/
+void MQTT_CLIENT_SetSubAckCallback(MQTT_CLIENT_SubAckCallback_t SubAckCallbackFunc);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SubAckPending
+**
+** Return the number of SUBSCRIBE and UNSUBSCRIBE packets sent on the
+** current connection that haven't been acknowledged.
+**
+*/
+uint16 MQTT_CLIENT_SubAckPending(void);
+
+
+/******************************************************************************
+** Function: MQTT_CLIENT_SubPendingFull
+**
+** Return true when MQTT_CLIENT_SUB_PENDING_MAX SUBSCRIBEs with tagged
+** filters are waiting for their SUBACK so another can't be sent.
+**
+*/
+bool MQTT_CLIENT_SubPendingFull(void);
+
+
 /******************************************************************************
 ** Function: MQTT_CLIENT_Subscribe
 **
 ** Notes:
 **    1. QOS options are defined in mqtt_msg.h
+**    2. Returns true when the SUBSCRIBE is sent. The SUBACK is read by
+**       MQTT_CLIENT_ProcessInput().
 */
 bool MQTT_CLIENT_Subscribe(const char *Topic, int Qos, 
                            MQTT_CLIENT_MsgCallback_t MsgCallbackFunc);
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Unsubscribe
+** Function: MQTT_CLIENT_SubscribeBatch
+**
+** Subscribe to a set of topic filters and return the number of filters sent
+**
+** Notes:
+**    1. The filters are sent in order, each SUBSCRIBE holds as many as fit
+**       in the send buffer up to MQTT_CLIENT_SUB_FILTER_MAX. PacketCnt
+**       returns the number of SUBSCRIBEs sent.
+**    2. Fewer than FilterCnt filters are sent if the connection is lost,
+**       a filter is too long to be sent or MQTT_CLIENT_SubPendingFull()
+**       is true. The unsent filters can be sent after a SUBACK is read in
+**       the last case.
+**    3. The return codes of filters that aren't tagged with
+**       MQTT_CLIENT_SUB_TAG_NONE are passed to the SUBACK callback.
 **
 */
-bool MQTT_CLIENT_Unsubscribe(const char *Topic);
+uint16 MQTT_CLIENT_SubscribeBatch(const MQTT_CLIENT_SubFilter_t *Filter, uint16 FilterCnt,
+                                  MQTT_CLIENT_MsgCallback_t MsgCallbackFunc, uint16 *PacketCnt);
 
 
 /******************************************************************************
-** Function: MQTT_CLIENT_Yield
-**
-** Notes:
-**    1. A task delay will always occur regardless of MQTT interface behavior
-**       to avoid CPU hogging
+** Function: MQTT_CLIENT_Unsubscribe
 **
 */
-bool MQTT_CLIENT_Yield(uint32 YieldTime);
+bool MQTT_CLIENT_Unsubscribe(const char *Topic);
 
 
 #endif /* _mqtt_client_ */
@@ -0,0 +1,341 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage the window of QoS1 and QoS2 messages waiting to be acknowledged
+**
+** Notes:
+**   1. The window is small so slots are found with a linear search.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_inflight.h"
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void ReleaseSlot(MQTT_INFLIGHT_Slot_t *Slot);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_INFLIGHT_Class_t *MqttInflight = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Constructor
+**
+*/
+void MQTT_INFLIGHT_Constructor(MQTT_INFLIGHT_Class_t *MqttInflightPtr,
+                               const INITBL_Class_t *IniTbl)
+{
+
+   uint16 i;
+
+   MqttInflight = MqttInflightPtr;
+
+   CFE_PSP_MemSet((void*)MqttInflight, 0, sizeof(MQTT_INFLIGHT_Class_t));
+
+   MqttInflight->Window  = INITBL_GetIntConfig(IniTbl, CFG_MQTT_QOS_WINDOW);
+   MqttInflight->RetryMs = INITBL_GetIntConfig(IniTbl, CFG_MQTT_QOS_RETRY_MS);
+
+   if (MqttInflight->Window == 0 || MqttInflight->Window > MQTT_INFLIGHT_WINDOW_MAX)
+   {
+      CFE_EVS_SendEvent(MQTT_INFLIGHT_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "QoS window %d must be between 1 and %d, using %d",
+                        MqttInflight->Window, MQTT_INFLIGHT_WINDOW_MAX, MQTT_INFLIGHT_WINDOW_MAX);
+      MqttInflight->Window = MQTT_INFLIGHT_WINDOW_MAX;
+   }
+
+   for (i = 0; i < MQTT_INFLIGHT_WINDOW_MAX; i++)
+   {
+      TimerInit(&MqttInflight->Slot[i].RetryTimer);
+   }
+
+} /* End MQTT_INFLIGHT_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Ack
+**
+** Notes:
+**   1. A PUBCOMP is also accepted while waiting for a PUBREC because the
+**      client passes an MQTT 5 PUBREC with a failure reason code as a
+**      PUBCOMP, the broker has ended the QoS2 exchange.
+**
+*/
+void MQTT_INFLIGHT_Ack(uint8 AckType, uint16 PacketId)
+{
+
+   MQTT_INFLIGHT_Slot_t *Slot;
+   CFE_TIME_SysTime_t AckTime;
+   uint16 i;
+
+   for (i = 0; i < MqttInflight->Window; i++)
+   {
+
+      Slot = &MqttInflight->Slot[i];
+      if (Slot->State == MQTT_INFLIGHT_FREE || Slot->PacketId != PacketId)
+      {
+         continue;
+      }
+
+      if ((AckType == PUBACK  && Slot->State == MQTT_INFLIGHT_WAIT_PUBACK) ||
+          (AckType == PUBCOMP && Slot->State != MQTT_INFLIGHT_WAIT_PUBACK))
+      {
+         AckTime = CFE_TIME_GetTime();
+         MQTT_LATENCY_Record(MQTT_LATENCY_ACK, Slot->PluginId, &Slot->PubTime, &AckTime);
+         MqttInflight->AckCnt++;
+         ReleaseSlot(Slot);
+      }
+      else if (AckType == PUBREC && Slot->State == MQTT_INFLIGHT_WAIT_PUBREC)
+      {
+         Slot->State = MQTT_INFLIGHT_WAIT_PUBCOMP;
+         TimerCountdownMS(&Slot->RetryTimer, MqttInflight->RetryMs);
+      }
+      break;
+
+   } /* End slot loop */
+
+} /* End MQTT_INFLIGHT_Ack() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Publish
+**
+** Notes:
+**   1. The packet is serialized into the slot rather than sent from the
+**      publish queue's packet image because QoS1 and QoS2 packets carry a
+**      packet ID and the slot's copy is needed for retransmission.
+**
+*/
+bool MQTT_INFLIGHT_Publish(int32 PluginId, MQTT_CLIENT_Qos_t Qos, bool Retain, const char *Topic,
+                           const char *Payload, uint32 PayloadLen)
+{
+
+   MQTT_INFLIGHT_Slot_t *Slot = NULL;
+   uint16 i;
+
+   for (i = 0; i < MqttInflight->Window; i++)
+   {
+      if (MqttInflight->Slot[i].State == MQTT_INFLIGHT_FREE)
+      {
+         Slot = &MqttInflight->Slot[i];
+         break;
+      }
+   }
+
+   if (Slot == NULL)
+   {
+      return false;
+   }
+
+   Slot->PacketLen = MQTT_CLIENT_SerializePublish(Slot->Packet, sizeof(Slot->Packet), Qos, Retain,
+                                                  Topic, Payload, PayloadLen, &Slot->PacketId);
+   if (Slot->PacketLen == 0)
+   {
+      CFE_EVS_SendEvent(MQTT_INFLIGHT_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "Error serializing QoS%d publish for topic %s with a %d byte payload",
+                        Qos, Topic, PayloadLen);
+      return false;
+   }
+
+   if (!MQTT_CLIENT_PublishPacket(PluginId, Topic, Slot->Packet, Slot->PacketLen, PayloadLen))
+   {
+      return false;
+   }
+
+   strncpy(Slot->Topic, Topic, sizeof(Slot->Topic) - 1);
+   Slot->Topic[sizeof(Slot->Topic) - 1] = '\0';
+   Slot->State      = (Qos == MQTT_CLIENT_QOS2) ? MQTT_INFLIGHT_WAIT_PUBREC : MQTT_INFLIGHT_WAIT_PUBACK;
+   Slot->PluginId   = PluginId;
+   Slot->PayloadLen = PayloadLen;
+   Slot->PubTime    = CFE_TIME_GetTime();
+   Slot->Resend     = false;
+   TimerCountdownMS(&Slot->RetryTimer, MqttInflight->RetryMs);
+
+   MqttInflight->Cnt++;
+   if (MqttInflight->Cnt > MqttInflight->HighWater)
+   {
+      MqttInflight->HighWater = MqttInflight->Cnt;
+   }
+
+   return true;
+
+} /* End MQTT_INFLIGHT_Publish() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Ready
+**
+*/
+bool MQTT_INFLIGHT_Ready(void)
+{
+
+   return (MqttInflight->Cnt < MqttInflight->Window && MqttInflight->Cnt < MQTT_CLIENT_ReceiveMax());
+
+} /* End MQTT_INFLIGHT_Ready() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_ResetStatus
+**
+*/
+void MQTT_INFLIGHT_ResetStatus(void)
+{
+
+   MqttInflight->HighWater     = MqttInflight->Cnt;
+   MqttInflight->AckCnt        = 0;
+   MqttInflight->RetransmitCnt = 0;
+
+} /* End MQTT_INFLIGHT_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Retransmit
+**
+** Notes:
+**   1. The DUP flag is bit 3 of the PUBLISH fixed header's first byte.
+**
+*/
+bool MQTT_INFLIGHT_Retransmit(void)
+{
+
+   MQTT_INFLIGHT_Slot_t *Slot;
+   bool   RetStatus = true;
+   bool   TimerRetry = (MQTT_CLIENT_GetVersion() != MQTT_CLIENT_VERSION_5);
+   uint16 i;
+
+   for (i = 0; i < MqttInflight->Window && RetStatus; i++)
+   {
+
+      Slot = &MqttInflight->Slot[i];
+      if (Slot->State == MQTT_INFLIGHT_FREE || 
+          !(Slot->Resend || (TimerRetry && TimerIsExpired(&Slot->RetryTimer))))
+      {
+         continue;
+      }
+
+      if (Slot->State == MQTT_INFLIGHT_WAIT_PUBCOMP)
+      {
+         RetStatus = MQTT_CLIENT_SendPubRel(Slot->PacketId);
+      }
+      else
+      {
+         Slot->Packet[0] |= 0x08;
+         RetStatus = MQTT_CLIENT_PublishPacket(Slot->PluginId, Slot->Topic, Slot->Packet, Slot->PacketLen,
+                                               Slot->PayloadLen);
+      }
+
+      if (RetStatus)
+      {
+         MqttInflight->RetransmitCnt++;
+         Slot->Resend = false;
+         TimerCountdownMS(&Slot->RetryTimer, MqttInflight->RetryMs);
+      }
+
+   } /* End slot loop */
+
+   return RetStatus;
+
+} /* End MQTT_INFLIGHT_Retransmit() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_RetryTimeout
+**
+*/
+uint32 MQTT_INFLIGHT_RetryTimeout(void)
+{
+
+   uint32 TimeLeft = MQTT_INFLIGHT_NO_TIMEOUT;
+   bool   TimerRetry = (MQTT_CLIENT_GetVersion() != MQTT_CLIENT_VERSION_5);
+   int    SlotTimeLeft;
+   uint16 i;
+
+   if (MqttInflight->Cnt > 0)
+   {
+      for (i = 0; i < MqttInflight->Window; i++)
+      {
+         if (MqttInflight->Slot[i].State != MQTT_INFLIGHT_FREE && MqttInflight->Slot[i].Resend)
+         {
+            return 0;
+         }
+         if (MqttInflight->Slot[i].State != MQTT_INFLIGHT_FREE && TimerRetry)
+         {
+            SlotTimeLeft = TimerLeftMS(&MqttInflight->Slot[i].RetryTimer);
+            if (SlotTimeLeft <= 0)
+            {
+               return 0;
+            }
+            if ((uint32)SlotTimeLeft < TimeLeft)
+            {
+               TimeLeft = SlotTimeLeft;
+            }
+         }
+      }
+   }
+
+   return TimeLeft;
+
+} /* End MQTT_INFLIGHT_RetryTimeout() */
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Rewind
+**
+*/
+void MQTT_INFLIGHT_Rewind(bool SessionPresent)
+{
+
+   MQTT_INFLIGHT_Slot_t *Slot;
+   uint16 i;
+
+   for (i = 0; i < MqttInflight->Window; i++)
+   {
+      Slot = &MqttInflight->Slot[i];
+      if (Slot->State == MQTT_INFLIGHT_WAIT_PUBCOMP && !SessionPresent)
+      {
+         ReleaseSlot(Slot);
+      }
+      else if (Slot->State != MQTT_INFLIGHT_FREE)
+      {
+         Slot->Resend = true;
+      }
+   }
+
+} /* End MQTT_INFLIGHT_Rewind() */
+
+
+/******************************************************************************
+** Function: ReleaseSlot
+**
+*/
+static void ReleaseSlot(MQTT_INFLIGHT_Slot_t *Slot)
+{
+
+   Slot->State = MQTT_INFLIGHT_FREE;
+   MqttInflight->Cnt--;
+
+} /* End ReleaseSlot() */
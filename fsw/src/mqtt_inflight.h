@@ -0,0 +1,233 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage the window of QoS1 and QoS2 messages waiting to be acknowledged
+**
+** Notes:
+**   1. Messages are published without waiting for their acknowledgement
+**      so up to QOS_WINDOW messages are in flight at once. Each window slot
+**      keeps a copy of its PUBLISH packet so it can be retransmitted.
+**   2. A QoS1 slot is released by its PUBACK. A QoS2 slot waits for a
+**      PUBREC, the client answers it with a PUBREL, and the slot is
+**      released by the PUBCOMP.
+**   3. A slot that isn't acknowledged within QOS_RETRY_MS is retransmitted
+**      with the DUP flag set, or its PUBREL is resent. MQTT 5 only allows a
+**      resend after a reconnect [MQTT-4.4.0-1] so with MQTT 5 slots are
+**      only retransmitted after MQTT_INFLIGHT_Rewind().
+**   4. Only the network owner task may call inflight functions other than
+**      the constructor and MQTT_INFLIGHT_ResetStatus().
+**
+*/
+#ifndef _mqtt_inflight_
+#define _mqtt_inflight_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+#include "mqtt_client.h"
+#include "mqtt_latency.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_INFLIGHT_CONSTRUCTOR_EID  (MQTT_INFLIGHT_BASE_EID + 0)
+#define MQTT_INFLIGHT_PUBLISH_ERR_EID  (MQTT_INFLIGHT_BASE_EID + 1)
+
+#define MQTT_INFLIGHT_NO_TIMEOUT  0xFFFFFFFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_INFLIGHT_FREE         = 0,
+   MQTT_INFLIGHT_WAIT_PUBACK  = 1,
+   MQTT_INFLIGHT_WAIT_PUBREC  = 2,
+   MQTT_INFLIGHT_WAIT_PUBCOMP = 3
+
+} MQTT_INFLIGHT_State_t;
+
+
+typedef struct
+{
+
+   MQTT_INFLIGHT_State_t  State;
+   uint16  PacketId;
+   int32   PluginId;
+   uint32  PacketLen;
+   uint32  PayloadLen;
+   CFE_TIME_SysTime_t  PubTime;   /* First publish, the ack latency includes retransmits */
+   Timer   RetryTimer;
+   bool    Resend;     /* Set by MQTT_INFLIGHT_Rewind() for the new connection */
+   char    Topic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   uint8   Packet[MQTT_PUBQ_PACKET_MAX_LEN];
+
+} MQTT_INFLIGHT_Slot_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   /*
+   ** Configuration
+   */
+
+   uint16  Window;
+   uint32  RetryMs;
+
+   /*
+   ** Status
+   */
+
+   uint16  Cnt;
+   uint16  HighWater;
+   uint32  AckCnt;
+   uint32  RetransmitCnt;
+
+   MQTT_INFLIGHT_Slot_t  Slot[MQTT_INFLIGHT_WINDOW_MAX];
+
+} MQTT_INFLIGHT_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_INFLIGHT instance.
+**   2. QOS_WINDOW is limited to MQTT_INFLIGHT_WINDOW_MAX.
+**
+*/
+void MQTT_INFLIGHT_Constructor(MQTT_INFLIGHT_Class_t *MqttInflightPtr,
+                               const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Ack
+**
+** Process a PUBACK, PUBREC or PUBCOMP.
+**
+** Notes:
+**   1. Acknowledgements that don't match a slot's packet ID and state are
+**      ignored. They belong to journaled messages or are duplicates.
+**
+*/
+void MQTT_INFLIGHT_Ack(uint8 AckType, uint16 PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Publish
+**
+** Publish a message with QoS1 or QoS2 and keep it in a window slot until
+** it's acknowledged.
+**
+** Notes:
+**   1. Returns false if the window is full, the message can't be serialized
+**      or the connection is lost. The caller keeps ownership of a message
+**      that isn't published.
+**
+*/
+bool MQTT_INFLIGHT_Publish(int32 PluginId, MQTT_CLIENT_Qos_t Qos, bool Retain, const char *Topic,
+                           const char *Payload, uint32 PayloadLen);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Ready
+**
+** Return true if the window has a free slot.
+**
+** Notes:
+**   1. An MQTT 5 broker's Receive Maximum can make the window smaller than
+**      MQTT_QOS_WINDOW.
+**
+*/
+bool MQTT_INFLIGHT_Ready(void);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_INFLIGHT_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Retransmit
+**
+** Retransmit the PUBLISH or PUBREL of each slot whose retry timer expired.
+**
+** Notes:
+**   1. Returns false if the connection is lost.
+**   2. With MQTT 5 only the slots rewound for a new connection are
+**      retransmitted, the retry timer isn't used.
+**
+*/
+bool MQTT_INFLIGHT_Retransmit(void);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_RetryTimeout
+**
+** Return the number of milliseconds until MQTT_INFLIGHT_Retransmit() has
+** work to do or MQTT_INFLIGHT_NO_TIMEOUT if the window is empty or, with
+** MQTT 5, no slot has been rewound.
+**
+*/
+uint32 MQTT_INFLIGHT_RetryTimeout(void);
+
+
+/******************************************************************************
+** Function: MQTT_INFLIGHT_Rewind
+**
+** Prepare the window for a new broker connection. Must be called when a
+** new connection is established. SessionPresent is true when the broker
+** resumed the previous session.
+**
+** Notes:
+**   1. Unacknowledged PUBLISH packets are retransmitted immediately with
+**      their original packet IDs.
+**   2. A QoS2 message that already has its PUBREC has its PUBREL resent
+**      when the session was resumed [MQTT-4.4.0-1]. With a clean session
+**      the broker discarded its QoS2 state so the slot is released.
+**
+*/
+void MQTT_INFLIGHT_Rewind(bool SessionPresent);
+
+
+#endif /* _mqtt_inflight_ */
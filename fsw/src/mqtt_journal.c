@@ -0,0 +1,795 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Durable outbound message journal that survives an app restart
+**
+** Notes:
+**   1. See mqtt_journal.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mqtt_journal.h"
+#include "mqtt_client.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define JOURNAL_REC_ALIGN(Len)  (((Len) + 7) & ~((uint32)7))
+
+#define JOURNAL_REC_AREA_OFFSET  JOURNAL_REC_ALIGN(sizeof(MQTT_JOURNAL_FileHdr_t))
+
+/* Smallest record area that is useful */
+#define JOURNAL_REC_AREA_MIN_LEN  4096
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 Checksum(const MQTT_JOURNAL_RecHdr_t *RecHdr);
+static void InitFile(void);
+static void MarkDirty(uint32 Offset, uint32 Len);
+static uint32 NextOffset(uint32 Offset);
+static void Recover(void);
+static void ReleaseHead(void);
+static bool Reserve(uint32 RecLen, uint32 *Offset);
+static void SyncFile(void);
+static bool SyncPending(void);
+static void SyncRange(uint32 FileStart, uint32 FileEnd);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_JOURNAL_Class_t *MqttJournal = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Constructor
+**
+*/
+void MQTT_JOURNAL_Constructor(MQTT_JOURNAL_Class_t *MqttJournalPtr,
+                              const INITBL_Class_t *IniTbl)
+{
+
+   struct stat FileStat;
+   struct timespec StartTime;
+   struct timespec EndTime;
+
+   MqttJournal = MqttJournalPtr;
+
+   CFE_PSP_MemSet((void*)MqttJournal, 0, sizeof(MQTT_JOURNAL_Class_t));
+
+   MqttJournal->Fd       = -1;
+   MqttJournal->FileLen  = INITBL_GetIntConfig(IniTbl, CFG_JOURNAL_FILE_LEN);
+   MqttJournal->SyncCnt  = INITBL_GetIntConfig(IniTbl, CFG_JOURNAL_SYNC_CNT);
+   MqttJournal->SyncTime = INITBL_GetIntConfig(IniTbl, CFG_JOURNAL_SYNC_TIME);
+   strncpy(MqttJournal->Filename, INITBL_GetStrConfig(IniTbl, CFG_JOURNAL_FILE), OS_MAX_PATH_LEN - 1);
+
+   if (MqttJournal->FileLen == 0)
+   {
+      return;
+   }
+
+   if (MqttJournal->FileLen < (JOURNAL_REC_AREA_OFFSET + JOURNAL_REC_AREA_MIN_LEN))
+   {
+      CFE_EVS_SendEvent(MQTT_JOURNAL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Journal disabled, file length %d is less than the minimum %d",
+                        MqttJournal->FileLen, (int)(JOURNAL_REC_AREA_OFFSET + JOURNAL_REC_AREA_MIN_LEN));
+      return;
+   }
+
+   if (MqttJournal->SyncCnt == 0)
+   {
+      MqttJournal->SyncCnt = 1;
+   }
+
+   MqttJournal->Fd = open(MqttJournal->Filename, O_RDWR | O_CREAT, 0644);
+   if (MqttJournal->Fd < 0)
+   {
+      CFE_EVS_SendEvent(MQTT_JOURNAL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Journal disabled, error opening %s, errno %d", MqttJournal->Filename, errno);
+      return;
+   }
+
+   if (fstat(MqttJournal->Fd, &FileStat) < 0 || FileStat.st_size != MqttJournal->FileLen)
+   {
+      if (ftruncate(MqttJournal->Fd, MqttJournal->FileLen) < 0)
+      {
+         CFE_EVS_SendEvent(MQTT_JOURNAL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Journal disabled, error sizing %s to %d bytes, errno %d",
+                           MqttJournal->Filename, MqttJournal->FileLen, errno);
+         close(MqttJournal->Fd);
+         MqttJournal->Fd = -1;
+         return;
+      }
+   }
+
+   MqttJournal->Map = mmap(NULL, MqttJournal->FileLen, PROT_READ | PROT_WRITE, MAP_SHARED, MqttJournal->Fd, 0);
+   if (MqttJournal->Map == MAP_FAILED)
+   {
+      CFE_EVS_SendEvent(MQTT_JOURNAL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Journal disabled, error mapping %s, errno %d", MqttJournal->Filename, errno);
+      MqttJournal->Map = NULL;
+      close(MqttJournal->Fd);
+      MqttJournal->Fd = -1;
+      return;
+   }
+
+   MqttJournal->FileHdr    = (MQTT_JOURNAL_FileHdr_t *)MqttJournal->Map;
+   MqttJournal->RecArea    = &MqttJournal->Map[JOURNAL_REC_AREA_OFFSET];
+   MqttJournal->RecAreaLen = MqttJournal->FileLen - JOURNAL_REC_AREA_OFFSET;
+   MqttJournal->WrapEnd    = MqttJournal->RecAreaLen;
+   TimerInit(&MqttJournal->SyncTimer);
+
+   clock_gettime(CLOCK_MONOTONIC, &StartTime);
+
+   if (MqttJournal->FileHdr->Magic      == MQTT_JOURNAL_FILE_MAGIC &&
+       MqttJournal->FileHdr->RecAreaLen == MqttJournal->RecAreaLen &&
+       MqttJournal->FileHdr->Head       <  MqttJournal->RecAreaLen)
+   {
+      Recover();
+   }
+   else
+   {
+      InitFile();
+   }
+
+   MqttJournal->FirstSendSeq = MqttJournal->NextSeq;
+
+   clock_gettime(CLOCK_MONOTONIC, &EndTime);
+   MqttJournal->RecoveryTime = (EndTime.tv_sec - StartTime.tv_sec) * 1000 +
+                               (EndTime.tv_nsec - StartTime.tv_nsec) / 1000000;
+
+   MqttJournal->Enabled = true;
+
+   CFE_EVS_SendEvent(MQTT_JOURNAL_RECOVER_EID, CFE_EVS_EventType_INFORMATION,
+                     "Journal %s recovered %d messages, %d bytes in %d ms",
+                     MqttJournal->Filename, MqttJournal->RecoveredCnt,
+                     MqttJournal->Bytes, MqttJournal->RecoveryTime);
+
+} /* End MQTT_JOURNAL_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Ack
+**
+*/
+void MQTT_JOURNAL_Ack(uint16 PacketId)
+{
+
+   uint16 i;
+   uint16 AckCnt = 0;
+
+   for (i = 0; i < MqttJournal->InFlightCnt; i++)
+   {
+      if (MqttJournal->InFlightPacketId[(MqttJournal->InFlightHead + i) % MQTT_JOURNAL_INFLIGHT_MAX] == PacketId)
+      {
+         AckCnt = i + 1;
+         break;
+      }
+   }
+
+   if (AckCnt > 0)
+   {
+
+      MqttJournal->InFlightHead = (MqttJournal->InFlightHead + AckCnt) % MQTT_JOURNAL_INFLIGHT_MAX;
+      MqttJournal->InFlightCnt -= AckCnt;
+      MqttJournal->AckCnt += AckCnt;
+      if (MqttJournal->ResendCnt > MqttJournal->InFlightCnt)
+      {
+         MqttJournal->ResendCnt = MqttJournal->InFlightCnt;
+      }
+
+      while (AckCnt-- > 0)
+      {
+         ReleaseHead();
+      }
+
+      if (!SyncPending())
+      {
+         TimerCountdownMS(&MqttJournal->SyncTimer, MqttJournal->SyncTime);
+      }
+      MqttJournal->FileHdr->Head    = MqttJournal->Head;
+      MqttJournal->FileHdr->HeadSeq = MqttJournal->NextSeq - MqttJournal->MsgCnt;
+      MqttJournal->FileHdrDirty     = true;
+
+   }
+
+} /* End MQTT_JOURNAL_Ack() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Append
+**
+*/
+bool MQTT_JOURNAL_Append(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                         bool Retain, const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime)
+{
+
+   bool   RetStatus = false;
+   uint32 TopicLen  = strlen(Topic);
+   uint32 RecLen    = JOURNAL_REC_ALIGN(sizeof(MQTT_JOURNAL_RecHdr_t) + TopicLen + PayloadLen + 2);
+   uint32 Offset;
+   MQTT_JOURNAL_RecHdr_t *RecHdr;
+   char   *RecData;
+
+   if (MqttJournal->Enabled && TopicLen <= 0xFFFF && Reserve(RecLen, &Offset))
+   {
+
+      RecHdr  = (MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[Offset];
+      RecData = (char *)&RecHdr[1];
+
+      memcpy(RecData, Topic, TopicLen + 1);
+      memcpy(&RecData[TopicLen + 1], Payload, PayloadLen);
+      RecData[TopicLen + 1 + PayloadLen] = '\0';
+
+      RecHdr->Magic      = MQTT_JOURNAL_REC_MAGIC;
+      RecHdr->TopicLen   = TopicLen;
+      RecHdr->Seq        = MqttJournal->NextSeq++;
+      RecHdr->RecLen     = RecLen;
+      RecHdr->PayloadLen = PayloadLen;
+      RecHdr->Checksum   = Checksum(RecHdr);
+      RecHdr->PluginId   = PluginId;
+      RecHdr->Retain     = Retain;
+      RecHdr->SbTime     = *SbTime;
+      RecHdr->XlateTime  = *XlateTime;
+
+      MarkDirty(Offset, RecLen);
+
+      MqttJournal->Tail = Offset + RecLen;
+      MqttJournal->MsgCnt++;
+      MqttJournal->Bytes       += RecLen;
+      MqttJournal->AppendBytes += RecLen;
+      MqttJournal->DirtyRecCnt++;
+
+      MQTT_JOURNAL_Sync();
+      RetStatus = true;
+
+   }
+
+   return RetStatus;
+
+} /* End MQTT_JOURNAL_Append() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_MarkSent
+**
+*/
+void MQTT_JOURNAL_MarkSent(uint16 PacketId)
+{
+
+   const MQTT_JOURNAL_RecHdr_t *RecHdr = (const MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[MqttJournal->SendOffset];
+
+   if (RecHdr->Seq >= MqttJournal->FirstSendSeq)
+   {
+      MqttJournal->FirstSendSeq = RecHdr->Seq + 1;
+   }
+   if (MqttJournal->ResendCnt > 0)
+   {
+      MqttJournal->ResendCnt--;
+   }
+   else
+   {
+      MqttJournal->InFlightPacketId[(MqttJournal->InFlightHead + MqttJournal->InFlightCnt) % MQTT_JOURNAL_INFLIGHT_MAX] = PacketId;
+      MqttJournal->InFlightCnt++;
+   }
+   MqttJournal->SendOffset = NextOffset(MqttJournal->SendOffset);
+
+} /* End MQTT_JOURNAL_MarkSent() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_PeekUnsent
+**
+*/
+bool MQTT_JOURNAL_PeekUnsent(MQTT_JOURNAL_Msg_t *Msg)
+{
+
+   const MQTT_JOURNAL_RecHdr_t *RecHdr;
+
+   if (!MQTT_JOURNAL_SendReady())
+   {
+      return false;
+   }
+
+   RecHdr = (const MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[MqttJournal->SendOffset];
+
+   Msg->PluginId   = RecHdr->PluginId;
+   Msg->Topic      = (const char *)&RecHdr[1];
+   Msg->Payload    = Msg->Topic + RecHdr->TopicLen + 1;
+   Msg->PayloadLen = RecHdr->PayloadLen;
+   Msg->Retain     = (RecHdr->Retain != 0);
+   Msg->FirstSend  = (RecHdr->Seq >= MqttJournal->FirstSendSeq);
+   Msg->PacketId   = 0;
+   if (MqttJournal->ResendCnt > 0)
+   {
+      Msg->PacketId = MqttJournal->InFlightPacketId[(MqttJournal->InFlightHead + MqttJournal->InFlightCnt -
+                                                     MqttJournal->ResendCnt) % MQTT_JOURNAL_INFLIGHT_MAX];
+   }
+   Msg->SbTime     = RecHdr->SbTime;
+   Msg->XlateTime  = RecHdr->XlateTime;
+
+   return true;
+
+} /* End MQTT_JOURNAL_PeekUnsent() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+** Notes:
+**   1. MsgCnt and Bytes describe the journal contents and the recovery
+**      status describes the last startup so they're not reset.
+**
+*/
+void MQTT_JOURNAL_ResetStatus(void)
+{
+
+   MqttJournal->AckCnt      = 0;
+   MqttJournal->AppendBytes = 0;
+   MqttJournal->SyncBytes   = 0;
+
+} /* End MQTT_JOURNAL_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Rewind
+**
+*/
+void MQTT_JOURNAL_Rewind(bool SessionPresent)
+{
+
+   if (SessionPresent)
+   {
+      MqttJournal->ResendCnt = MqttJournal->InFlightCnt;
+   }
+   else
+   {
+      MqttJournal->InFlightHead = 0;
+      MqttJournal->InFlightCnt  = 0;
+      MqttJournal->ResendCnt    = 0;
+   }
+   MqttJournal->SendOffset = MqttJournal->Head;
+
+} /* End MQTT_JOURNAL_Rewind() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_SendReady
+**
+*/
+bool MQTT_JOURNAL_SendReady(void)
+{
+
+   return (MqttJournal->ResendCnt > 0 ||
+           (MqttJournal->InFlightCnt < MqttJournal->MsgCnt &&
+            MqttJournal->InFlightCnt < MQTT_JOURNAL_INFLIGHT_MAX &&
+            MqttJournal->InFlightCnt < MQTT_CLIENT_ReceiveMax()));
+
+} /* End MQTT_JOURNAL_SendReady() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Sync
+**
+*/
+void MQTT_JOURNAL_Sync(void)
+{
+
+   if (MqttJournal->DirtyRecCnt >= MqttJournal->SyncCnt ||
+       (SyncPending() && TimerIsExpired(&MqttJournal->SyncTimer)))
+   {
+      SyncFile();
+   }
+
+} /* End MQTT_JOURNAL_Sync() */
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_SyncTimeout
+**
+*/
+uint32 MQTT_JOURNAL_SyncTimeout(void)
+{
+
+   uint32 Timeout = MQTT_JOURNAL_NO_TIMEOUT;
+   int    TimeLeft;
+
+   if (SyncPending())
+   {
+      TimeLeft = TimerLeftMS(&MqttJournal->SyncTimer);
+      Timeout  = (TimeLeft > 0) ? (uint32)TimeLeft : 0;
+   }
+
+   return Timeout;
+
+} /* End MQTT_JOURNAL_SyncTimeout() */
+
+
+/******************************************************************************
+** Function: Checksum
+**
+** FNV-1a hash of a record's topic and payload
+**
+*/
+static uint32 Checksum(const MQTT_JOURNAL_RecHdr_t *RecHdr)
+{
+
+   const uint8 *Data = (const uint8 *)&RecHdr[1];
+   uint32 DataLen = RecHdr->TopicLen + RecHdr->PayloadLen + 2;
+   uint32 Hash = 2166136261u;
+   uint32 i;
+
+   for (i = 0; i < DataLen; i++)
+   {
+      Hash ^= Data[i];
+      Hash *= 16777619u;
+   }
+
+   return Hash;
+
+} /* End Checksum() */
+
+
+/******************************************************************************
+** Function: InitFile
+**
+** Initialize an empty journal file.
+**
+*/
+static void InitFile(void)
+{
+
+   MqttJournal->FileHdr->Magic      = MQTT_JOURNAL_FILE_MAGIC;
+   MqttJournal->FileHdr->RecAreaLen = MqttJournal->RecAreaLen;
+   MqttJournal->FileHdr->Head       = 0;
+   MqttJournal->FileHdr->HeadSeq    = 0;
+
+   MqttJournal->FileHdrDirty = true;
+   SyncFile();
+
+} /* End InitFile() */
+
+
+/******************************************************************************
+** Function: MarkDirty
+**
+** Add a record area range to the range waiting to be synced.
+**
+** Notes:
+**   1. Only one contiguous range is tracked so the pending range is synced
+**      when the tail wraps.
+**
+*/
+static void MarkDirty(uint32 Offset, uint32 Len)
+{
+
+   if (MqttJournal->DirtyEnd > MqttJournal->DirtyStart && Offset != MqttJournal->DirtyEnd)
+   {
+      SyncFile();
+   }
+
+   if (!SyncPending())
+   {
+      TimerCountdownMS(&MqttJournal->SyncTimer, MqttJournal->SyncTime);
+   }
+
+   if (MqttJournal->DirtyEnd == MqttJournal->DirtyStart)
+   {
+      MqttJournal->DirtyStart = Offset;
+   }
+   MqttJournal->DirtyEnd = Offset + Len;
+
+} /* End MarkDirty() */
+
+
+/******************************************************************************
+** Function: NextOffset
+**
+** Return the offset of the record following the record at Offset.
+**
+*/
+static uint32 NextOffset(uint32 Offset)
+{
+
+   const MQTT_JOURNAL_RecHdr_t *RecHdr = (const MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[Offset];
+
+   Offset += RecHdr->RecLen;
+   if (Offset >= MqttJournal->WrapEnd)
+   {
+      Offset = 0;
+   }
+
+   return Offset;
+
+} /* End NextOffset() */
+
+
+/******************************************************************************
+** Function: Recover
+**
+** Rebuild the journal state by scanning the records following the head
+** saved in the file header.
+**
+*/
+static void Recover(void)
+{
+
+   const MQTT_JOURNAL_RecHdr_t *RecHdr;
+   uint32 Offset  = MqttJournal->FileHdr->Head;
+   uint32 Seq     = MqttJournal->FileHdr->HeadSeq;
+   bool   Wrapped = false;
+   bool   Valid   = true;
+
+   MqttJournal->Head = Offset;
+
+   while (Valid)
+   {
+
+      if ((Offset + sizeof(MQTT_JOURNAL_RecHdr_t)) > MqttJournal->RecAreaLen)
+      {
+         if (Wrapped)
+         {
+            break;
+         }
+         MqttJournal->WrapEnd = Offset;
+         Offset  = 0;
+         Wrapped = true;
+         continue;
+      }
+
+      RecHdr = (const MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[Offset];
+
+      if (RecHdr->Magic != MQTT_JOURNAL_REC_MAGIC || RecHdr->Seq != Seq)
+      {
+         break;
+      }
+
+      if (RecHdr->RecLen == 0)
+      {
+         /* Wrap marker */
+         if (Wrapped)
+         {
+            break;
+         }
+         MqttJournal->WrapEnd = Offset;
+         Offset  = 0;
+         Wrapped = true;
+         continue;
+      }
+
+      Valid = (RecHdr->RecLen >= (sizeof(MQTT_JOURNAL_RecHdr_t) + RecHdr->TopicLen + RecHdr->PayloadLen + 2)) &&
+              ((Offset + RecHdr->RecLen) <= (Wrapped ? MqttJournal->Head : MqttJournal->RecAreaLen)) &&
+              (RecHdr->Checksum == Checksum(RecHdr));
+
+      if (Valid)
+      {
+         MqttJournal->MsgCnt++;
+         MqttJournal->Bytes += RecHdr->RecLen;
+         Offset += RecHdr->RecLen;
+         Seq++;
+      }
+
+   } /* End record scan */
+
+   MqttJournal->Tail         = Offset;
+   MqttJournal->NextSeq      = Seq;
+   MqttJournal->RecoveredCnt = MqttJournal->MsgCnt;
+
+   if (MqttJournal->MsgCnt == 0)
+   {
+      MqttJournal->Head    = 0;
+      MqttJournal->Tail    = 0;
+      MqttJournal->WrapEnd = MqttJournal->RecAreaLen;
+
+      MqttJournal->FileHdr->Head    = 0;
+      MqttJournal->FileHdr->HeadSeq = Seq;
+      MqttJournal->FileHdrDirty     = true;
+      SyncFile();
+   }
+   else if (!Wrapped)
+   {
+      MqttJournal->WrapEnd = MqttJournal->RecAreaLen;
+   }
+
+   MqttJournal->SendOffset = MqttJournal->Head;
+
+} /* End Recover() */
+
+
+/******************************************************************************
+** Function: ReleaseHead
+**
+** Remove the record at the head of the journal.
+**
+*/
+static void ReleaseHead(void)
+{
+
+   const MQTT_JOURNAL_RecHdr_t *RecHdr = (const MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[MqttJournal->Head];
+
+   MqttJournal->Bytes -= RecHdr->RecLen;
+   MqttJournal->MsgCnt--;
+
+   if (MqttJournal->MsgCnt == 0)
+   {
+      MqttJournal->Head       = 0;
+      MqttJournal->Tail       = 0;
+      MqttJournal->SendOffset = 0;
+      MqttJournal->WrapEnd    = MqttJournal->RecAreaLen;
+   }
+   else
+   {
+      MqttJournal->Head = NextOffset(MqttJournal->Head);
+      if (MqttJournal->Head == 0)
+      {
+         MqttJournal->WrapEnd = MqttJournal->RecAreaLen;
+      }
+   }
+
+} /* End ReleaseHead() */
+
+
+/******************************************************************************
+** Function: Reserve
+**
+** Find contiguous space for a record. Returns false if there isn't room.
+**
+** Notes:
+**   1. When the record doesn't fit between the tail and the end of the
+**      record area it is placed at the start, a wrap marker is written if
+**      there's room and WrapEnd records where the valid data ends.
+**
+*/
+static bool Reserve(uint32 RecLen, uint32 *Offset)
+{
+
+   bool RetStatus = false;
+   MQTT_JOURNAL_RecHdr_t *WrapHdr;
+
+   if (MqttJournal->MsgCnt == 0)
+   {
+      *Offset   = 0;
+      RetStatus = (RecLen <= MqttJournal->RecAreaLen);
+   }
+   else if (MqttJournal->Tail > MqttJournal->Head)
+   {
+      if ((MqttJournal->Tail + RecLen) <= MqttJournal->RecAreaLen)
+      {
+         *Offset   = MqttJournal->Tail;
+         RetStatus = true;
+      }
+      else if (RecLen < MqttJournal->Head)
+      {
+         if ((MqttJournal->Tail + sizeof(MQTT_JOURNAL_RecHdr_t)) <= MqttJournal->RecAreaLen)
+         {
+            WrapHdr = (MQTT_JOURNAL_RecHdr_t *)&MqttJournal->RecArea[MqttJournal->Tail];
+            memset(WrapHdr, 0, sizeof(MQTT_JOURNAL_RecHdr_t));
+            WrapHdr->Magic = MQTT_JOURNAL_REC_MAGIC;
+            WrapHdr->Seq   = MqttJournal->NextSeq;
+            MarkDirty(MqttJournal->Tail, sizeof(MQTT_JOURNAL_RecHdr_t));
+         }
+         MqttJournal->WrapEnd = MqttJournal->Tail;
+         *Offset   = 0;
+         RetStatus = true;
+      }
+   }
+   else
+   {
+      /* Tail has wrapped, free space is between the tail and head */
+      if ((MqttJournal->Tail + RecLen) < MqttJournal->Head)
+      {
+         *Offset   = MqttJournal->Tail;
+         RetStatus = true;
+      }
+   }
+
+   return RetStatus;
+
+} /* End Reserve() */
+
+
+/******************************************************************************
+** Function: SyncFile
+**
+** Sync the pending record range and the file header.
+**
+*/
+static void SyncFile(void)
+{
+
+   if (MqttJournal->DirtyEnd > MqttJournal->DirtyStart)
+   {
+      SyncRange(JOURNAL_REC_AREA_OFFSET + MqttJournal->DirtyStart,
+                JOURNAL_REC_AREA_OFFSET + MqttJournal->DirtyEnd);
+   }
+   if (MqttJournal->FileHdrDirty)
+   {
+      SyncRange(0, sizeof(MQTT_JOURNAL_FileHdr_t));
+   }
+
+   MqttJournal->FileHdrDirty = false;
+   MqttJournal->DirtyStart   = 0;
+   MqttJournal->DirtyEnd     = 0;
+   MqttJournal->DirtyRecCnt  = 0;
+
+} /* End SyncFile() */
+
+
+/******************************************************************************
+** Function: SyncPending
+**
+*/
+static bool SyncPending(void)
+{
+
+   return (MqttJournal->FileHdrDirty || MqttJournal->DirtyEnd > MqttJournal->DirtyStart);
+
+} /* End SyncPending() */
+
+
+/******************************************************************************
+** Function: SyncRange
+**
+** msync() the pages containing a file byte range.
+**
+** Notes:
+**   1. The synced page bytes are accumulated so write amplification can be
+**      reported relative to the appended record bytes.
+**
+*/
+static void SyncRange(uint32 FileStart, uint32 FileEnd)
+{
+
+   uint32 PageSize = (uint32)sysconf(_SC_PAGESIZE);
+   uint32 Start = FileStart & ~(PageSize - 1);
+   uint32 End   = (FileEnd + PageSize - 1) & ~(PageSize - 1);
+
+   if (End > MqttJournal->FileLen)
+   {
+      End = MqttJournal->FileLen;
+   }
+
+   if (msync(&MqttJournal->Map[Start], End - Start, MS_SYNC) == 0)
+   {
+      MqttJournal->SyncBytes += (End - Start);
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_JOURNAL_SYNC_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "Journal msync() error for file bytes %d to %d, errno %d",
+                        Start, End, errno);
+   }
+
+} /* End SyncRange() */
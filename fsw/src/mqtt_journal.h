@@ -0,0 +1,342 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Durable outbound message journal that survives an app restart
+**
+** Notes:
+**   1. The journal is a memory mapped file containing a file header
+**      followed by a circular record area. Records are appended at the tail
+**      and removed from the head when the broker acknowledges the QoS1
+**      PUBLISH that carried them. Only messages from topics published
+**      with QoS1 are journaled.
+**   2. Records are never split across the end of the record area. A wrap
+**      marker is written when the remaining space can hold a record header.
+**   3. Each record holds a sequence number and a checksum. Recovery starts
+**      at the head saved in the file header and accepts records until the
+**      sequence breaks or a checksum fails.
+**   4. msync() is batched. Unsynced records survive an app or process
+**      restart because the mapping is shared, a power loss can lose the
+**      records appended since the last sync.
+**   5. The record header holds the message's retain flag, plugin ID and
+**      timestamps so a replayed message keeps its topic options.
+**   6. Only the network owner task may call journal functions other than
+**      the constructor and MQTT_JOURNAL_ResetStatus().
+**
+*/
+#ifndef _mqtt_journal_
+#define _mqtt_journal_
+
+/*
+** Includes
+*/
+
+#include "MQTTLinux.h"
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_JOURNAL_CONSTRUCTOR_EID  (MQTT_JOURNAL_BASE_EID + 0)
+#define MQTT_JOURNAL_RECOVER_EID      (MQTT_JOURNAL_BASE_EID + 1)
+#define MQTT_JOURNAL_SYNC_ERR_EID     (MQTT_JOURNAL_BASE_EID + 2)
+
+#define MQTT_JOURNAL_NO_TIMEOUT  0xFFFFFFFF
+
+#define MQTT_JOURNAL_FILE_MAGIC  0x4A4E4C32  /* "JNL2" */
+#define MQTT_JOURNAL_REC_MAGIC   0x4A52
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** File header. Head and HeadSeq are updated when records are acknowledged.
+*/
+
+typedef struct
+{
+
+   uint32  Magic;
+   uint32  RecAreaLen;
+   uint32  Head;
+   uint32  HeadSeq;
+
+} MQTT_JOURNAL_FileHdr_t;
+
+
+/*
+** Record header. The NUL terminated topic and payload follow the header.
+** A wrap marker has a RecLen of zero.
+*/
+
+typedef struct
+{
+
+   uint16  Magic;
+   uint16  TopicLen;
+   uint32  Seq;
+   uint32  RecLen;
+   uint32  PayloadLen;
+   uint32  Checksum;
+   int32   PluginId;
+   uint32  Retain;
+   CFE_TIME_SysTime_t  SbTime;
+   CFE_TIME_SysTime_t  XlateTime;
+
+} MQTT_JOURNAL_RecHdr_t;
+
+
+/*
+** Journaled message returned by MQTT_JOURNAL_PeekUnsent(). Topic and
+** Payload point into the journal.
+*/
+
+typedef struct
+{
+
+   int32       PluginId;
+   const char *Topic;
+   const char *Payload;
+   uint32      PayloadLen;
+   bool        Retain;
+   bool        FirstSend;   /* Not published since it was appended by this app run */
+   uint16      PacketId;    /* Non-zero when resent on a resumed session */
+   CFE_TIME_SysTime_t  SbTime;
+   CFE_TIME_SysTime_t  XlateTime;
+
+} MQTT_JOURNAL_Msg_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   /*
+   ** Configuration
+   */
+
+   bool    Enabled;
+   uint32  FileLen;
+   uint32  SyncCnt;
+   uint32  SyncTime;
+   char    Filename[OS_MAX_PATH_LEN];
+
+   /*
+   ** Status
+   */
+
+   uint32  MsgCnt;
+   uint32  Bytes;
+   uint32  AckCnt;
+   uint32  RecoveredCnt;
+   uint32  RecoveryTime;     /* Milliseconds */
+   uint32  AppendBytes;      /* Record bytes appended since reset */
+   uint32  SyncBytes;        /* Page bytes written by msync() since reset */
+
+   /*
+   ** Mapped file
+   */
+
+   int      Fd;
+   uint8   *Map;
+   uint8   *RecArea;
+   uint32   RecAreaLen;
+   MQTT_JOURNAL_FileHdr_t *FileHdr;
+
+   /*
+   ** Circular record area. WrapEnd marks the end of valid data when the
+   ** tail has wrapped to the start of the area.
+   */
+
+   uint32  Head;
+   uint32  Tail;
+   uint32  WrapEnd;
+   uint32  NextSeq;
+   uint32  FirstSendSeq;     /* Oldest sequence appended this run that hasn't been published */
+
+   /*
+   ** Records from Head up to SendOffset have been published and are
+   ** waiting for their PUBACK. InFlightPacketId[] is in send order. The
+   ** last ResendCnt in-flight records are waiting to be resent with their
+   ** packet IDs after a resumed session.
+   */
+
+   uint32  SendOffset;
+   uint16  InFlightHead;
+   uint16  InFlightCnt;
+   uint16  ResendCnt;
+   uint16  InFlightPacketId[MQTT_JOURNAL_INFLIGHT_MAX];
+
+   /*
+   ** Batched msync() of the record range appended since the last sync
+   */
+
+   bool    FileHdrDirty;
+   uint32  DirtyStart;
+   uint32  DirtyEnd;
+   uint32  DirtyRecCnt;
+   Timer   SyncTimer;
+
+} MQTT_JOURNAL_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_JOURNAL instance.
+**   2. A zero JOURNAL_FILE_LEN disables the journal. An existing journal
+**      file is recovered.
+**
+*/
+void MQTT_JOURNAL_Constructor(MQTT_JOURNAL_Class_t *MqttJournalPtr,
+                              const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Ack
+**
+** Remove the records acknowledged by a PUBACK.
+**
+** Notes:
+**   1. MQTT requires QoS1 PUBACKs to be sent in the order the PUBLISH
+**      packets were received so a PUBACK also acknowledges every record
+**      sent before it. This covers PUBACKs consumed by the MQTT library
+**      while it waits for a SUBACK or UNSUBACK.
+**   2. Called by MQTT_MGR's acknowledgement callback for each PUBACK
+**
+*/
+void MQTT_JOURNAL_Ack(uint16 PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Append
+**
+** Append a message to the journal. Returns false if the journal is full
+** or disabled.
+**
+*/
+bool MQTT_JOURNAL_Append(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                         bool Retain, const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_MarkSent
+**
+** Record the packet ID of the message returned by MQTT_JOURNAL_PeekUnsent()
+** after it has been published.
+**
+** Notes:
+**   1. A resent message keeps the packet ID it was first sent with.
+**
+*/
+void MQTT_JOURNAL_MarkSent(uint16 PacketId);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_PeekUnsent
+**
+** Return the oldest message that hasn't been published on the current
+** connection. Returns false if there isn't one or the in-flight window is
+** full.
+**
+** Notes:
+**   1. FirstSend is false for recovered messages and messages replayed
+**      after a reconnect so latency is only recorded once per message.
+**   2. PacketId is non-zero for a message that must be resent with that
+**      packet ID and the DUP flag set.
+**
+*/
+bool MQTT_JOURNAL_PeekUnsent(MQTT_JOURNAL_Msg_t *Msg);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_JOURNAL_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Rewind
+**
+** Mark every journaled message as unsent. Must be called when a new broker
+** connection is established because PUBACKs from a previous connection are
+** never received. SessionPresent is true when the broker resumed the
+** previous session.
+**
+** Notes:
+**   1. On a resumed session messages waiting for their PUBACK are resent
+**      with their original packet IDs [MQTT-4.4.0-1]. On a clean session
+**      they're sent as new messages.
+**   2. Packet IDs aren't journaled so messages recovered after a restart
+**      are sent as new messages.
+**
+*/
+void MQTT_JOURNAL_Rewind(bool SessionPresent);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_SendReady
+**
+** Return true if MQTT_JOURNAL_PeekUnsent() has a message and another QoS1
+** message can be sent before a PUBACK is received.
+**
+*/
+bool MQTT_JOURNAL_SendReady(void);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_Sync
+**
+** Sync appended records and the file header to the file when the sync
+** batch count is reached or the sync timer expires.
+**
+*/
+void MQTT_JOURNAL_Sync(void);
+
+
+/******************************************************************************
+** Function: MQTT_JOURNAL_SyncTimeout
+**
+** Return the number of milliseconds until MQTT_JOURNAL_Sync() has work to
+** do or MQTT_JOURNAL_NO_TIMEOUT if nothing is waiting to be synced.
+**
+*/
+uint32 MQTT_JOURNAL_SyncTimeout(void);
+
+
+#endif /* _mqtt_journal_ */
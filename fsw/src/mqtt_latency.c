@@ -0,0 +1,304 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Measure message latency through each gateway stage
+**
+** Notes:
+**   1. See mqtt_latency.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include "mqtt_latency.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define VALID_PLUGIN_ID(Id)  ((Id) >= 0 && (Id) < JMSG_PLATFORM_TOPIC_PLUGIN_MAX)
+
+/* Largest microsecond value that fits in a uint32 */
+#define LATENCY_MAX_SEC  4294
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 BucketIndex(uint32 Usec);
+static void LoadStages(JMSG_MQTT_LatencyStages_t *Stages, const MQTT_LATENCY_Hist_t Hist[]);
+static void LoadStats(JMSG_MQTT_LatencyStats_t *Stats, const MQTT_LATENCY_Hist_t *Hist);
+static uint32 Percentile(const MQTT_LATENCY_Hist_t *Hist, uint32 Cnt, uint32 Percent);
+static void SendTlm(void);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_LATENCY_Class_t *MqttLatency = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_Constructor
+**
+*/
+void MQTT_LATENCY_Constructor(MQTT_LATENCY_Class_t *MqttLatencyPtr,
+                              const INITBL_Class_t *IniTbl)
+{
+
+   MqttLatency = MqttLatencyPtr;
+
+   CFE_PSP_MemSet((void*)MqttLatency, 0, sizeof(MQTT_LATENCY_Class_t));
+
+   MqttLatency->TlmPeriod = INITBL_GetIntConfig(IniTbl, CFG_LATENCY_TLM_PERIOD);
+
+   CFE_MSG_Init(CFE_MSG_PTR(MqttLatency->LatencyTlm.TelemetryHeader),
+                CFE_SB_ValueToMsgId(INITBL_GetIntConfig(IniTbl, CFG_JMSG_MQTT_LATENCY_TLM_TOPICID)),
+                sizeof(JMSG_MQTT_LatencyTlm_t));
+
+} /* End MQTT_LATENCY_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_ManageTlm
+**
+*/
+void MQTT_LATENCY_ManageTlm(void)
+{
+
+   if (MqttLatency->TlmPeriod > 0)
+   {
+      if (++MqttLatency->TlmCycleCnt >= MqttLatency->TlmPeriod)
+      {
+         MqttLatency->TlmCycleCnt = 0;
+         SendTlm();
+      }
+   }
+
+} /* End MQTT_LATENCY_ManageTlm() */
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_Record
+**
+*/
+void MQTT_LATENCY_Record(MQTT_LATENCY_Stage_t Stage, int32 PluginId,
+                         const CFE_TIME_SysTime_t *Start, const CFE_TIME_SysTime_t *End)
+{
+
+   MQTT_LATENCY_Hist_t *Hist;
+   CFE_TIME_SysTime_t  Delta;
+   uint32 Usec = 0;
+   uint32 Max;
+
+   if (VALID_PLUGIN_ID(PluginId) && Stage < MQTT_LATENCY_STAGE_CNT &&
+       (Start->Seconds != 0 || Start->Subseconds != 0))
+   {
+
+      if (CFE_TIME_Compare(*End, *Start) == CFE_TIME_A_GT_B)
+      {
+         Delta = CFE_TIME_Subtract(*End, *Start);
+         Usec  = (Delta.Seconds < LATENCY_MAX_SEC) ?
+                 (Delta.Seconds * 1000000 + CFE_TIME_Sub2MicroSecs(Delta.Subseconds)) : 0xFFFFFFFF;
+      }
+
+      Hist = &MqttLatency->Hist[Stage][PluginId];
+      __atomic_fetch_add(&Hist->Bucket[BucketIndex(Usec)], 1, __ATOMIC_RELAXED);
+      Max = __atomic_load_n(&Hist->Max, __ATOMIC_RELAXED);
+      while (Usec > Max &&
+             !__atomic_compare_exchange_n(&Hist->Max, &Max, Usec, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+         /* Max is reloaded by a failed exchange */
+      }
+
+   }
+
+} /* End MQTT_LATENCY_Record() */
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_ResetStatus
+**
+*/
+void MQTT_LATENCY_ResetStatus(void)
+{
+
+   CFE_PSP_MemSet((void*)MqttLatency->Hist, 0, sizeof(MqttLatency->Hist));
+
+} /* End MQTT_LATENCY_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_SendTlmCmd
+**
+*/
+bool MQTT_LATENCY_SendTlmCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   SendTlm();
+
+   return true;
+
+} /* End MQTT_LATENCY_SendTlmCmd() */
+
+
+/******************************************************************************
+** Function: BucketIndex
+**
+** Return the log2 histogram bucket for a microsecond value.
+**
+*/
+static uint32 BucketIndex(uint32 Usec)
+{
+
+   uint32 Index = (Usec == 0) ? 0 : (32 - __builtin_clz(Usec));
+
+   return (Index < MQTT_LATENCY_BUCKET_CNT) ? Index : (MQTT_LATENCY_BUCKET_CNT - 1);
+
+} /* End BucketIndex() */
+
+
+/******************************************************************************
+** Function: LoadStages
+**
+** Load the telemetry stats for each stage from a set of histograms indexed
+** by stage.
+**
+*/
+static void LoadStages(JMSG_MQTT_LatencyStages_t *Stages, const MQTT_LATENCY_Hist_t Hist[])
+{
+
+   LoadStats(&Stages->SbQueue,   &Hist[MQTT_LATENCY_SB_QUEUE]);
+   LoadStats(&Stages->SbXlate,   &Hist[MQTT_LATENCY_SB_XLATE]);
+   LoadStats(&Stages->Publish,   &Hist[MQTT_LATENCY_PUBLISH]);
+   LoadStats(&Stages->OutTotal,  &Hist[MQTT_LATENCY_OUT_TOTAL]);
+   LoadStats(&Stages->MqttXlate, &Hist[MQTT_LATENCY_MQTT_XLATE]);
+   LoadStats(&Stages->SbSend,    &Hist[MQTT_LATENCY_SB_SEND]);
+   LoadStats(&Stages->InTotal,   &Hist[MQTT_LATENCY_IN_TOTAL]);
+   LoadStats(&Stages->Ack,       &Hist[MQTT_LATENCY_ACK]);
+
+} /* End LoadStages() */
+
+
+/******************************************************************************
+** Function: LoadStats
+**
+** Load the telemetry stats for one histogram.
+**
+*/
+static void LoadStats(JMSG_MQTT_LatencyStats_t *Stats, const MQTT_LATENCY_Hist_t *Hist)
+{
+
+   uint32 i;
+
+   Stats->Cnt = 0;
+   for (i = 0; i < MQTT_LATENCY_BUCKET_CNT; i++)
+   {
+      Stats->Cnt += Hist->Bucket[i];
+   }
+
+   Stats->P50 = Percentile(Hist, Stats->Cnt, 50);
+   Stats->P99 = Percentile(Hist, Stats->Cnt, 99);
+   Stats->Max = Hist->Max;
+
+} /* End LoadStats() */
+
+
+/******************************************************************************
+** Function: Percentile
+**
+** Return the upper bound in microseconds of the bucket holding a
+** percentile sample or zero if there aren't any samples.
+**
+** Notes:
+**   1. The bound is limited to the maximum sample. The last bucket is
+**      unbounded so the maximum is always reported for it.
+**
+*/
+static uint32 Percentile(const MQTT_LATENCY_Hist_t *Hist, uint32 Cnt, uint32 Percent)
+{
+
+   uint64 Rank;
+   uint64 Sum = 0;
+   uint32 i;
+
+   if (Cnt == 0)
+   {
+      return 0;
+   }
+
+   Rank = ((uint64)Cnt * Percent + 99) / 100;
+
+   for (i = 0; i < (MQTT_LATENCY_BUCKET_CNT - 1); i++)
+   {
+      Sum += Hist->Bucket[i];
+      if (Sum >= Rank)
+      {
+         return (((uint32)1 << i) < Hist->Max) ? ((uint32)1 << i) : Hist->Max;
+      }
+   }
+
+   return Hist->Max;
+
+} /* End Percentile() */
+
+
+/******************************************************************************
+** Function: SendTlm
+**
+** Build and send the latency packet. The all topics histograms are the sum
+** of the topic histograms.
+**
+*/
+static void SendTlm(void)
+{
+
+   JMSG_MQTT_LatencyTlm_Payload_t *Payload = &MqttLatency->LatencyTlm.Payload;
+   MQTT_LATENCY_Hist_t StageHist[MQTT_LATENCY_STAGE_CNT];
+   MQTT_LATENCY_Hist_t AllHist[MQTT_LATENCY_STAGE_CNT];
+   uint32 Stage;
+   uint32 Topic;
+   uint32 i;
+
+   CFE_PSP_MemSet((void*)AllHist, 0, sizeof(AllHist));
+
+   for (Topic = 0; Topic < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; Topic++)
+   {
+      for (Stage = 0; Stage < MQTT_LATENCY_STAGE_CNT; Stage++)
+      {
+         StageHist[Stage] = MqttLatency->Hist[Stage][Topic];
+         for (i = 0; i < MQTT_LATENCY_BUCKET_CNT; i++)
+         {
+            AllHist[Stage].Bucket[i] += StageHist[Stage].Bucket[i];
+         }
+         if (StageHist[Stage].Max > AllHist[Stage].Max)
+         {
+            AllHist[Stage].Max = StageHist[Stage].Max;
+         }
+      }
+      LoadStages(&Payload->Topic[Topic], StageHist);
+   }
+
+   LoadStages(&Payload->All, AllHist);
+
+   CFE_SB_TimeStampMsg(CFE_MSG_PTR(MqttLatency->LatencyTlm.TelemetryHeader));
+   CFE_SB_TransmitMsg(CFE_MSG_PTR(MqttLatency->LatencyTlm.TelemetryHeader), true);
+
+} /* End SendTlm() */
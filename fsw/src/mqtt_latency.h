@@ -0,0 +1,161 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Measure message latency through each gateway stage
+**
+** Notes:
+**   1. Each stage has a log2 histogram for each topic plugin. Telemetry
+**      reports the sample count, p50, p99 and maximum in microseconds.
+**      Percentiles are the upper bound of the bucket holding the
+**      percentile sample.
+**   2. Timestamps come from CFE_TIME_GetTime() so they can be compared
+**      with the time in an SB message's secondary header.
+**   3. The main task records SB_QUEUE and SB_XLATE, the network owner
+**      task records the others. The MQTT_SHARD tasks also record PUBLISH
+**      and OUT_TOTAL so samples are added with atomic operations.
+**      Counters are aligned 32-bit values so telemetry never reads a torn
+**      value. A reset may lose samples recorded by the network owner and
+**      shard tasks while the reset is in progress.
+**
+*/
+#ifndef _mqtt_latency_
+#define _mqtt_latency_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_LATENCY_SB_QUEUE   = 0,   /* SB message time to SB receive                */
+   MQTT_LATENCY_SB_XLATE   = 1,   /* SB receive to JSON translation complete      */
+   MQTT_LATENCY_PUBLISH    = 2,   /* JSON translation to publish write returned   */
+   MQTT_LATENCY_OUT_TOTAL  = 3,   /* SB message time to publish write returned    */
+   MQTT_LATENCY_MQTT_XLATE = 4,   /* MQTT receive to SB translation complete      */
+   MQTT_LATENCY_SB_SEND    = 5,   /* SB translation to SB transmit returned       */
+   MQTT_LATENCY_IN_TOTAL   = 6,   /* MQTT receive to SB transmit returned         */
+   MQTT_LATENCY_ACK        = 7,   /* QoS1/QoS2 publish to PUBACK or PUBCOMP       */
+   MQTT_LATENCY_STAGE_CNT  = 8
+
+} MQTT_LATENCY_Stage_t;
+
+
+typedef struct
+{
+
+   uint32  Max;
+   uint32  Bucket[MQTT_LATENCY_BUCKET_CNT];
+
+} MQTT_LATENCY_Hist_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint32  TlmPeriod;   /* Calls to MQTT_LATENCY_ManageTlm() between packets, 0=Disabled */
+   uint32  TlmCycleCnt;
+
+   MQTT_LATENCY_Hist_t  Hist[MQTT_LATENCY_STAGE_CNT][JMSG_PLATFORM_TOPIC_PLUGIN_MAX];
+
+   /*
+   ** Telemetry Packets
+   */
+
+   JMSG_MQTT_LatencyTlm_t  LatencyTlm;
+
+} MQTT_LATENCY_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_LATENCY instance.
+**
+*/
+void MQTT_LATENCY_Constructor(MQTT_LATENCY_Class_t *MqttLatencyPtr,
+                              const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_ManageTlm
+**
+** Send the latency packet every LATENCY_TLM_PERIOD calls
+**
+*/
+void MQTT_LATENCY_ManageTlm(void);
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_Record
+**
+** Record the time from Start to End for a stage
+**
+** Notes:
+**   1. Samples with an invalid plugin ID or a zero start time are ignored.
+**      A zero start time means the message didn't have a timestamp.
+**   2. End times earlier than the start time are recorded as zero.
+**
+*/
+void MQTT_LATENCY_Record(MQTT_LATENCY_Stage_t Stage, int32 PluginId,
+                         const CFE_TIME_SysTime_t *Start, const CFE_TIME_SysTime_t *End);
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_LATENCY_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_LATENCY_SendTlmCmd
+**
+** Send the latency packet
+**
+** Notes:
+**   1. Signature must match CMDMGR_CmdFuncPtr_t
+**
+*/
+bool MQTT_LATENCY_SendTlmCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+
+#endif /* _mqtt_latency_ */
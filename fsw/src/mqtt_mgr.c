@@ -24,6 +24,17 @@
 ** Includes
 */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* ppoll() */
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
 #include "mqtt_mgr.h"
 
 /***********************/
@@ -43,8 +54,29 @@
 /** Local Function Prototypes **/
 /*******************************/
 
+static void CheckBrokerHealth(void);
 static bool ConfigSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic, JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt);
+static void ConfigMqttSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic, JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt);
+static bool ConnectToBroker(const char *ClientName, const char *BrokerAddress, uint32 BrokerPort);
+static void FlushCoalescedMsgs(void);
+static uint64 MonotonicNs(void);
 static void MqttConnectionError(void);
+static void ProcessAck(uint8 AckType, uint16 PacketId);
+static void ProcessConnection(void);
+static void ProcessRequests(void);
+static void ProcessSubAck(int32 Tag, uint8 ReturnCode);
+static void PublishJournalMsgs(void);
+static void PublishQueuedMsgs(void);
+static bool PublishReady(void);
+static void PublishSpooledMsgs(void);
+static uint32 ReconnectTimeout(void);
+static void ReportSubscribeTime(void);
+static void ResumeSession(void);
+static void SendSubscriptions(void);
+static bool SubBatchHasRoom(JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt);
+static void StoreUnpublishedMsg(const MQTT_PUBQ_Entry_t *Entry);
+static bool QueueConnectRequest(const char *ClientName, const char *BrokerAddress, uint32 BrokerPort);
+static void WakeNetworkOwner(void);
 
 /**********************/
 /** Global File Data **/
@@ -77,14 +109,87 @@ void MQTT_MGR_Constructor(MQTT_MGR_Class_t *MqttMgrPtr, const INITBL_Class_t *In
    MqttMgr->MqttYieldTime = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_CLIENT_YIELD_TIME);
    MqttMgr->SbPendTime    = INITBL_GetIntConfig(INITBL_OBJ, CFG_TOPIC_PIPE_PEND_TIME);
    
-   MqttMgr->Reconnect.Enabled  = (INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_ENABLE_RECONNECT) == 1);
-   MqttMgr->Reconnect.Period   = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_RECONNECT_PERIOD);
-   MqttMgr->Reconnect.DelayCnt = MqttMgr->Reconnect.Period;
+   MqttMgr->PubQos = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_PUB_QOS);
+   if (MqttMgr->PubQos > MQTT_CLIENT_QOS2)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR, 
+                        "Invalid MQTT publish QoS %d, using QoS0", MqttMgr->PubQos);
+      MqttMgr->PubQos = MQTT_CLIENT_QOS0;
+   }
+   
+   MqttMgr->SubQos = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_SUB_QOS);
+   if (MqttMgr->SubQos > MQTT_CLIENT_QOS2)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR, 
+                        "Invalid MQTT subscribe QoS %d, using QoS2", MqttMgr->SubQos);
+      MqttMgr->SubQos = MQTT_CLIENT_QOS2;
+   }
+   
+   MqttMgr->Reconnect.Enabled      = (INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_ENABLE_RECONNECT) == 1);
+   MqttMgr->Reconnect.BackoffMinMs = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_RECONNECT_MIN_MS);
+   MqttMgr->Reconnect.BackoffMaxMs = INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_RECONNECT_MAX_MS);
+   if (MqttMgr->Reconnect.BackoffMinMs == 0 || MqttMgr->Reconnect.BackoffMaxMs < MqttMgr->Reconnect.BackoffMinMs)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR, 
+                        "Invalid MQTT reconnect backoff range %d to %d ms, the minimum must be non-zero and not exceed the maximum",
+                        MqttMgr->Reconnect.BackoffMinMs, MqttMgr->Reconnect.BackoffMaxMs);
+      if (MqttMgr->Reconnect.BackoffMinMs == 0)
+      {
+         MqttMgr->Reconnect.BackoffMinMs = 1;
+      }
+      if (MqttMgr->Reconnect.BackoffMaxMs < MqttMgr->Reconnect.BackoffMinMs)
+      {
+         MqttMgr->Reconnect.BackoffMaxMs = MqttMgr->Reconnect.BackoffMinMs;
+      }
+   }
+   MqttMgr->Reconnect.BackoffMs = MqttMgr->Reconnect.BackoffMinMs;
    
+   MQTT_TRACE_Constructor(&MqttMgr->MqttTrace, INITBL_OBJ);
+
+   MQTT_TOPIC_STATS_Constructor(&MqttMgr->MqttTopicStats, INITBL_OBJ);
+
+   MQTT_LATENCY_Constructor(&MqttMgr->MqttLatency, INITBL_OBJ);
+
+   /* The broker list is constructed first so the client's connect is tracked */
+   MQTT_BROKER_Constructor(&MqttMgr->MqttBroker, INITBL_OBJ);
+
    MQTT_CLIENT_Constructor(&MqttMgr->MqttClient, INITBL_OBJ);
 
    MQMSG_TRANS_Constructor(&MqttMgr->MqMsgTrans, INITBL_OBJ);
 
+   MQTT_PUBQ_Constructor(&MqttMgr->MqttPubQ);
+   
+   MQTT_SHARD_Constructor(&MqttMgr->MqttShard, INITBL_OBJ);
+   
+   MQTT_SPOOL_Constructor(&MqttMgr->MqttSpool, INITBL_OBJ);
+   
+   MQTT_JOURNAL_Constructor(&MqttMgr->MqttJournal, INITBL_OBJ);
+   
+   MQTT_INFLIGHT_Constructor(&MqttMgr->MqttInflight, INITBL_OBJ);
+   MQTT_CLIENT_SetAckCallback(ProcessAck);
+   MQTT_CLIENT_SetSubAckCallback(ProcessSubAck);
+
+   MqttMgr->WakeFd = eventfd(0, EFD_NONBLOCK);
+   if (MqttMgr->WakeFd < 0)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR, 
+                        "Error creating network owner wake eventfd, errno %d", errno);      
+   }
+
+   SysStatus = OS_MutSemCreate(&MqttMgr->ReqMutexId, "MQTT_REQ_MUTEX", 0);
+   if (SysStatus != OS_SUCCESS)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR, 
+                        "Error creating network owner request mutex, return status %d", SysStatus);      
+   }
+
+   /* 
+   ** The network owner completes the client's initial connect or retries it
+   ** if it couldn't start. The child task hasn't been created yet so this
+   ** task can still schedule the retry.
+   */
+   MqttConnectionError();
+
    SysStatus = CFE_SB_CreatePipe(&MqttMgr->TopicPipe, INITBL_GetIntConfig(INITBL_OBJ, CFG_TOPIC_PIPE_DEPTH),
                                  INITBL_GetStrConfig(INITBL_OBJ, CFG_TOPIC_PIPE_NAME));
    if (SysStatus != CFE_SUCCESS)
@@ -101,18 +206,155 @@ void MQTT_MGR_Constructor(MQTT_MGR_Class_t *MqttMgrPtr, const INITBL_Class_t *In
 /******************************************************************************
 ** Function: MQTT_MGR_ChildTaskCallback
 **
+** Notes:
+**   1. The wait never exceeds MqttYieldTime. While disconnected it ends
+**      at the connect state's timeout or the next reconnect attempt, the
+**      socket is polled for writing during the TCP connect.
+**   2. Publishing is limited to one queue's worth per call so inbound
+**      packets and keepalives are serviced during sustained bursts.
+**   3. Live messages are published before spooled messages are replayed.
+**      Journaled messages are published in the order they were journaled.
+**   4. ppoll() is used so a coalesced packet flush deadline can be shorter
+**      than a millisecond.
+**   5. Queued QoS1 and QoS2 messages wait in the publish queue while the
+**      QoS window is full so they don't shorten the wait.
+**   6. Subscription filters held while the client's SUBACK pending entries
+**      were full don't wait once a SUBACK frees an entry.
+**   7. The broker socket is non-blocking. While output the socket didn't
+**      accept is waiting the socket is polled for writing and messages
+**      stay queued so publishing doesn't shorten the wait.
+**
 */
 bool MQTT_MGR_ChildTaskCallback(CHILDMGR_Class_t *ChildMgr)
 {
 
-   bool ClientYield;
+   struct pollfd   PollFd[2];
+   struct timespec PollTime;
+   int    PollStatus;
+   int    Timeout;
+   uint32 TimeoutUsec;
+   uint64 WakeCnt;
    
-   ClientYield = MQTT_CLIENT_Yield(MqttMgr->MqttYieldTime);
+   PollFd[0].fd      = MqttMgr->WakeFd;
+   PollFd[0].events  = POLLIN;
+   PollFd[0].revents = 0;
+   PollFd[1].fd      = MQTT_CLIENT_GetSocket();   /* Negative fds are ignored by poll() */
+   PollFd[1].events  = MQTT_CLIENT_GetSocketEvents();
+   PollFd[1].revents = 0;
 
-   if (!ClientYield)
+   Timeout = MqttMgr->MqttYieldTime;
+   if (MqttMgr->MqttClient.Connected)
+   {
+      if ((MQTT_CLIENT_SendReady() && (PublishReady() || MQTT_JOURNAL_SendReady())) || 
+          (MqttMgr->SubBatch.FilterCnt > 0 && !MQTT_CLIENT_SubPendingFull()))
+      {
+         Timeout = 0;
+      }
+      else
+      {
+         if (MQTT_CLIENT_KeepAliveTimeout() < Timeout)
+         {
+            Timeout = MQTT_CLIENT_KeepAliveTimeout();
+         }
+         if (MQTT_SPOOL_ReplayTimeout() < Timeout)
+         {
+            Timeout = MQTT_SPOOL_ReplayTimeout();
+         }
+         if (MQTT_INFLIGHT_RetryTimeout() < Timeout)
+         {
+            Timeout = MQTT_INFLIGHT_RetryTimeout();
+         }
+      }
+   }
+   else if (MQTT_CLIENT_Connecting())
+   {
+      if (MQTT_CLIENT_ConnectTimeout() < Timeout)
+      {
+         Timeout = MQTT_CLIENT_ConnectTimeout();
+      }
+   }
+   else if (MqttMgr->Reconnect.Scheduled)
+   {
+      if (ReconnectTimeout() < Timeout)
+      {
+         Timeout = ReconnectTimeout();
+      }
+   }
+   if (MQTT_JOURNAL_SyncTimeout() < Timeout)
+   {
+      Timeout = MQTT_JOURNAL_SyncTimeout();
+   }
+   
+   TimeoutUsec = (uint32)Timeout * 1000;
+   if (MQTT_CLIENT_FlushTimeout() < TimeoutUsec)
+   {
+      TimeoutUsec = MQTT_CLIENT_FlushTimeout();
+   }
+   PollTime.tv_sec  = TimeoutUsec / 1000000;
+   PollTime.tv_nsec = (TimeoutUsec % 1000000) * 1000;
+   
+   PollStatus = ppoll(PollFd, 2, &PollTime, NULL);
+   
+   if (PollStatus < 0)
+   {
+      if (errno != EINTR)
+      {
+         CFE_EVS_SendEvent(MQTT_MGR_EVENT_LOOP_EID, CFE_EVS_EventType_ERROR, 
+                           "Network owner ppoll() error, errno %d", errno);
+         OS_TaskDelay(MqttMgr->MqttYieldTime);
+      }
+      return true;
+   }
+   
+   if (PollFd[0].revents & POLLIN)
+   {
+      /* Reading resets the eventfd counter, the count itself isn't needed */
+      if (read(MqttMgr->WakeFd, &WakeCnt, sizeof(WakeCnt)) < 0)
+      {
+         WakeCnt = 0;
+      }
+   }
+   
+   ProcessRequests();
+   
+   if (MqttMgr->MqttClient.Connected)
    {
-      MqttConnectionError(); 
-   } 
+      if ((PollFd[1].revents & POLLOUT) != 0)
+      {
+         if (!MQTT_CLIENT_ProcessOutput())
+         {
+            MqttConnectionError();
+         }
+      }
+      if ((PollFd[1].revents & ~POLLOUT) != 0 && MqttMgr->MqttClient.Connected)
+      {
+         if (!MQTT_CLIENT_ProcessInput())
+         {
+            MqttConnectionError();
+         }
+      }
+      ReportSubscribeTime();
+      if (!MQTT_CLIENT_KeepAlive())
+      {
+         MqttConnectionError();
+      }
+      else if (!MQTT_INFLIGHT_Retransmit())
+      {
+         MqttConnectionError();
+      }
+      else
+      {
+         CheckBrokerHealth();
+      }
+   }
+   
+   ProcessConnection();
+   
+   PublishQueuedMsgs();
+   PublishJournalMsgs();
+   PublishSpooledMsgs();
+   FlushCoalescedMsgs();
+   MQTT_JOURNAL_Sync();
    
    return true;
    
@@ -127,7 +369,6 @@ bool MQTT_MGR_ConnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *
 {
    const JMSG_MQTT_ConnectToMqttBroker_CmdPayload_t *ConnectToMqttBrokerCmd = 
                                                CMDMGR_PAYLOAD_PTR(MsgPtr, JMSG_MQTT_ConnectToMqttBroker_t);
-   bool RetStatus = false;
    const char *BrokerAddress;
    uint32     BrokerPort;
    const char *ClientName;
@@ -159,14 +400,7 @@ bool MQTT_MGR_ConnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *
       ClientName = ConnectToMqttBrokerCmd->ClientName;
    }
 
-   // Connect sends event messages
-   if (MQTT_CLIENT_Connect(ClientName, BrokerAddress, BrokerPort))
-   {
-      JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SUB_JMSG);
-      RetStatus = true;
-   }
-   
-   return RetStatus;
+   return QueueConnectRequest(ClientName, BrokerAddress, BrokerPort);
    
 } /* End MQTT_MGR_ConnectToMqttBrokerCmd() */
 
@@ -175,41 +409,112 @@ bool MQTT_MGR_ConnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *
 ** Function: MQTT_MGR_ProcessSbTopicMsgs
 **
 ** Notes:
-**   1. MQMSG_TRANS_ProcessSbMsg() and MQTT_CLIENT_Publish() send error events
-**      so no need to send any events here.
+**   1. MQMSG_TRANS_ProcessSbMsg() sends error events so no need to send any
+**      events here. Publish queue overflows are counted by MQTT_PUBQ.
+**   2. The connection state is checked by the network owner so messages
+**      are always queued.
+**   3. When the client coalesces publishes the network owner is woken once
+**      the topic pipe drains or the queue is half full, rather than for
+**      every message, so a burst is written together. The pipe is polled
+**      after a push to detect the drain before pending. Priority messages
+**      always wake the network owner.
+**   4. The topic's TOPIC_CFG entry sets its publish QoS, retain flag and
+**      priority.
+**   5. QoS0 routine messages are pushed to the topic's shard connection
+**      whether or not it's connected, its ring holds them across
+**      reconnects, see mqtt_shard.h. QoS0 messages aren't journaled so the
+**      journal doesn't affect sharding. Shards are woken like the network
+**      owner.
 **
 */
 void MQTT_MGR_ProcessSbTopicMsgs(uint32 PerfId)
 {
 
+   bool   Coalesce = (MqttMgr->MqttClient.CoalesceBytes > 0);
+   bool   DrainPending = false;
    int32  SbStatus;
    CFE_SB_Buffer_t  *SbBufPtr;
+   CFE_SB_MsgId_t   MsgId;
+   const MQTT_TOPIC_CFG_Entry_t *TopicCfg;
+   MQTT_CLIENT_Qos_t Qos;
+   bool   Retain;
+   bool   Priority;
+   uint16 MsgIdValue;
+   uint16 Shard;
+   int32  PluginId;
    const char *Topic;
    const char *Payload;
+   uint32 PayloadLen;
+   CFE_TIME_SysTime_t SbTime;
+   CFE_TIME_SysTime_t RcvTime;
+   CFE_TIME_SysTime_t XlateTime;
 
    do 
    {
       CFE_ES_PerfLogExit(PerfId);
-      SbStatus = CFE_SB_ReceiveBuffer(&SbBufPtr, MqttMgr->TopicPipe, MqttMgr->SbPendTime);
+      SbStatus = CFE_SB_ReceiveBuffer(&SbBufPtr, MqttMgr->TopicPipe, 
+                                      DrainPending ? CFE_SB_POLL : MqttMgr->SbPendTime);
       CFE_ES_PerfLogEntry(PerfId);
    
       if (SbStatus == CFE_SUCCESS)
       {
-         if (MqttMgr->MqttClient.Connected)
+         RcvTime = CFE_TIME_GetTime();
+         if (CFE_MSG_GetMsgTime(&SbBufPtr->Msg, &SbTime) != CFE_SUCCESS)
+         {
+            SbTime.Seconds    = 0;
+            SbTime.Subseconds = 0;
+         }
+         if (MQMSG_TRANS_ProcessSbMsg(&SbBufPtr->Msg, &PluginId, &Topic, &Payload, &PayloadLen))
          {
-            if (MQMSG_TRANS_ProcessSbMsg(&SbBufPtr->Msg, &Topic, &Payload))
+            XlateTime = CFE_TIME_GetTime();
+            MQTT_LATENCY_Record(MQTT_LATENCY_SB_QUEUE, PluginId, &SbTime, &RcvTime);
+            MQTT_LATENCY_Record(MQTT_LATENCY_SB_XLATE, PluginId, &RcvTime, &XlateTime);
+            Qos      = MqttMgr->PubQos;
+            Retain   = false;
+            Priority = false;
+            CFE_MSG_GetMsgId(&SbBufPtr->Msg, &MsgId);
+            MsgIdValue = CFE_SB_MsgIdToValue(MsgId);
+            TopicCfg = MQTT_TOPIC_CFG_GetEntry(MsgIdValue);
+            if (TopicCfg != NULL)
             {
-               if(!MQTT_CLIENT_Publish(Topic, Payload))
+               if (TopicCfg->PubQos != MQTT_TOPIC_CFG_QOS_DEFAULT)
                {
-                  MqttConnectionError();
+                  Qos = TopicCfg->PubQos;
+               }
+               Retain   = ((TopicCfg->Opts & MQTT_TOPIC_CFG_OPT_RETAIN) != 0);
+               Priority = ((TopicCfg->Opts & MQTT_TOPIC_CFG_OPT_PRIORITY) != 0);
+            }
+            Shard = 0;
+            if (Qos == MQTT_CLIENT_QOS0 && !Priority)
+            {
+               Shard = MQTT_SHARD_Select(MsgIdValue, (TopicCfg != NULL ? TopicCfg->Shard : MQTT_TOPIC_CFG_SHARD_HASH));
+            }
+            if (Shard != 0)
+            {
+               if (MQTT_SHARD_Push(Shard, PluginId, Topic, Payload, PayloadLen, Retain, Coalesce,
+                                   &SbTime, &XlateTime))
+               {
+                  DrainPending = Coalesce;
+               }
+            }
+            else if (MQTT_PUBQ_Push(PluginId, Topic, Payload, PayloadLen, Qos, Retain, Priority, &SbTime, &XlateTime))
+            {
+               DrainPending = Coalesce;
+               if (!Coalesce || Priority || MQTT_PUBQ_Count() >= (MQTT_PUBQ_DEPTH/2))
+               {
+                  WakeNetworkOwner();
                }
             }
-         }
-         else
-         {
-            MqttMgr->UnpublishedSbMsgCnt++;
          }
       }
+      else if (DrainPending)
+      {
+         MQTT_PUBQ_MarkDrained();
+         MQTT_SHARD_WakeDeferred();
+         WakeNetworkOwner();
+         DrainPending = false;
+         SbStatus = CFE_SUCCESS;   /* Pend for the next message */
+      }
       
    } while(SbStatus == CFE_SUCCESS);
    
@@ -219,19 +524,15 @@ void MQTT_MGR_ProcessSbTopicMsgs(uint32 PerfId)
 /******************************************************************************
 ** Function: MQTT_MGR_ReconnectToMqttBrokerCmd
 **
+** Notes:
+**   1. The broker is selected from the failover list by the network owner
+**      when it performs the request, the same way a reconnect attempt is.
+**
 */
 bool MQTT_MGR_ReconnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
 {
 
-   bool RetStatus = false;
-
-   if (MQTT_CLIENT_Reconnect())
-   {
-      JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SUB_JMSG);
-      RetStatus = true;
-   }
-   
-   return RetStatus;
+   return QueueConnectRequest(MqttMgr->MqttClient.ClientName, NULL, 0);
    
 } /* End MQTT_MGR_ReconnectToMqttBrokerCmd() */
 
@@ -246,8 +547,21 @@ void MQTT_MGR_ResetStatus(void)
 {
 
    MqttMgr->UnpublishedSbMsgCnt = 0;
+   MqttMgr->SessionResumeCnt    = 0;
+   MqttMgr->Reconnect.MaxTimeMs = 0;
+   MqttMgr->SubBatch.MaxTimeUs  = 0;
+   MqttMgr->SubBatch.RejectCnt  = 0;
+   MqttMgr->SubBatch.HoldCnt    = 0;
+   MQTT_BROKER_ResetStatus();
    MQTT_CLIENT_ResetStatus();
    MQMSG_TRANS_ResetStatus();
+   MQTT_PUBQ_ResetStatus();
+   MQTT_SHARD_ResetStatus();
+   MQTT_SPOOL_ResetStatus();
+   MQTT_JOURNAL_ResetStatus();
+   MQTT_INFLIGHT_ResetStatus();
+   MQTT_TOPIC_STATS_ResetStatus();
+   MQTT_LATENCY_ResetStatus();
 
 } /* End MQTT_MGR_ResetStatus() */
 
@@ -258,10 +572,15 @@ void MQTT_MGR_ResetStatus(void)
 ** Notes:
 **   1. Signature must match CMDMGR_CmdFuncPtr_t
 **   2. DataObjPtr is not used
+**   3. The broker is the one last connected or being connected to, it's
+**      copied once because the network owner writes it.
 */
 bool MQTT_MGR_SendConnectionInfoCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
 {
    char ConnectStatus[32];
+   char BrokerAddress[MAX_CLIENT_PARAM_STR_LEN];
+   uint32 BrokerPort;
+   int16  Active;
    
    
    if (MqttMgr->MqttClient.Connected)
@@ -272,10 +591,24 @@ bool MQTT_MGR_SendConnectionInfoCmd(void* DataObjPtr, const CFE_MSG_Message_t *M
    {
       strcpy(ConnectStatus,"disconnected from");      
    }
-   CFE_EVS_SendEvent(MQTT_MGR_SEND_CONNECTION_INFO_EID, CFE_EVS_EventType_INFORMATION, 
-                     "MQTT %s broker %s:%d", ConnectStatus,
-                     INITBL_GetStrConfig(INITBL_OBJ, CFG_MQTT_BROKER_ADDRESS),
-                     INITBL_GetIntConfig(INITBL_OBJ, CFG_MQTT_BROKER_PORT));
+   
+   memcpy(BrokerAddress, MqttMgr->MqttClient.ConnBrokerAddress, MAX_CLIENT_PARAM_STR_LEN);
+   BrokerAddress[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+   BrokerPort = MqttMgr->MqttClient.ConnBrokerPort;
+   Active     = MqttMgr->MqttBroker.Active;
+   
+   if (Active == MQTT_BROKER_NONE)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_SEND_CONNECTION_INFO_EID, CFE_EVS_EventType_INFORMATION, 
+                        "MQTT %s broker %s:%d, not in the failover list", ConnectStatus,
+                        BrokerAddress, BrokerPort);
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_SEND_CONNECTION_INFO_EID, CFE_EVS_EventType_INFORMATION, 
+                        "MQTT %s broker %s:%d, failover list index %d", ConnectStatus,
+                        BrokerAddress, BrokerPort, Active);
+   }
    
    return true;
    
@@ -326,6 +659,124 @@ bool MQTT_MGR_SubscribeToTopicPlugin(const CFE_MSG_Message_t *MsgPtr)
 } /* End MQTT_MGR_SubscribeToTopicPlugin() */
 
 
+/******************************************************************************
+** Function: CheckBrokerHealth
+**
+** Pass the broker's round trip time to MQTT_BROKER and fail over to the
+** healthiest broker when the active broker has degraded.
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**   2. The failover is a reconnect so the time to restore the session is
+**      reported.
+**
+*/
+static void CheckBrokerHealth(void)
+{
+   
+   const MQTT_BROKER_Endpoint_t *Broker;
+   uint32 RttUs;
+   
+   if (MQTT_CLIENT_GetPingRtt(&RttUs) && MQTT_BROKER_RecordRtt(RttUs))
+   {
+      Broker = MQTT_BROKER_Select();
+      CFE_EVS_SendEvent(MQTT_MGR_FAILOVER_EID, CFE_EVS_EventType_INFORMATION, 
+                        "MQTT broker %s:%d round trip time exceeds %d ms, failing over to %s:%d",
+                        MqttMgr->MqttClient.ConnBrokerAddress, MqttMgr->MqttClient.ConnBrokerPort,
+                        MqttMgr->MqttBroker.FailoverRttUs/1000, Broker->Host, Broker->Port);
+      
+      MqttMgr->Reconnect.LostTime  = MonotonicNs();
+      MqttMgr->Reconnect.Scheduled = false;
+      MqttMgr->Reconnect.Restoring = false;
+      if (!ConnectToBroker(MqttMgr->MqttClient.ClientName, Broker->Host, Broker->Port))
+      {
+         MqttConnectionError();
+      }
+   }
+   
+} /* End CheckBrokerHealth() */
+
+
+/******************************************************************************
+** Function: ConfigMqttSubscription
+**
+** Perform a queued MQTT subscription request.
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**   2. The inbound topic index is updated here rather than in
+**      ConfigSubscription() so it's only accessed by the network owner.
+**      A topic is indexed before subscribing so messages that arrive with
+**      the SUBACK can be routed.
+**   3. CBOR topics are also subscribed to with their CBOR topic name.
+**   4. The topic's TOPIC_CFG subscribe QoS overrides MQTT_SUB_QOS.
+**   5. Subscriptions are added to the subscription batch that's sent by
+**      SendSubscriptions(). ProcessRequests() only passes a subscription
+**      when the batch has room for it and an unsubscribe once the batch is
+**      empty, so requests for the same topic reach the broker in order.
+**
+*/
+static void ConfigMqttSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic, 
+                                   JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt)
+{
+   
+   MQTT_MGR_SubBatch_t *SubBatch = &MqttMgr->SubBatch;
+   MQTT_CLIENT_SubFilter_t *Filter;
+   char   CborTopic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   const char *Name[2];
+   uint16 NameCnt = 0;
+   uint16 i;
+   int32  PluginId;
+   MQTT_CLIENT_Qos_t Qos = MQTT_TOPIC_CFG_GetSubQos(Topic->Cfe, MqttMgr->SubQos);
+   
+   if (ConfigOpt == JMSG_TOPIC_TBL_SUB_JMSG)
+   {
+      MQMSG_TRANS_AddTopic(Topic, &PluginId);
+      MQTT_TOPIC_STATS_ClearSubAck(PluginId);
+      
+      Name[NameCnt++] = Topic->Name;
+      if ((MQTT_TOPIC_CFG_GetOpts(Topic->Cfe) & MQTT_TOPIC_CFG_OPT_CBOR) &&
+          MQTT_TOPIC_CFG_CborTopic(SubBatch->CborTopic[SubBatch->CborCnt], Topic->Name))
+      {
+         Name[NameCnt++] = SubBatch->CborTopic[SubBatch->CborCnt++];
+      }
+      for (i = 0; i < NameCnt; i++)
+      {
+         Filter = &SubBatch->Filter[SubBatch->FilterCnt++];
+         Filter->Topic = Name[i];
+         Filter->Qos   = Qos;
+         Filter->Tag   = PluginId;
+      }
+   }
+   else
+   {
+      Name[NameCnt++] = Topic->Name;
+      if ((MQTT_TOPIC_CFG_GetOpts(Topic->Cfe) & MQTT_TOPIC_CFG_OPT_CBOR) &&
+          MQTT_TOPIC_CFG_CborTopic(CborTopic, Topic->Name))
+      {
+         Name[NameCnt++] = CborTopic;
+      }
+      
+      MQMSG_TRANS_RemoveTopic(Topic);
+      for (i = 0; i < NameCnt; i++)
+      {
+         if (MQTT_CLIENT_Unsubscribe(Name[i]))
+         {
+            CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
+                              "Unsubscribed from MQTT client for topic %s", Name[i]);
+         }
+         else
+         {
+            MqttMgr->SessionStale = true;
+            CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
+                              "Error unsubscribing from MQTT client for topic %s", Name[i]);
+         }
+      }
+   }
+   
+} /* End ConfigMqttSubscription() */
+
+
 /******************************************************************************
 ** Function: ConfigSubscription
 **
@@ -336,6 +787,8 @@ bool MQTT_MGR_SubscribeToTopicPlugin(const CFE_MSG_Message_t *MsgPtr)
 **   1. A SB duplicate subscription event message will be sent if two 
 **      subscription requests are made without an unsubscribe requests
 **      between them.
+**   2. MQTT subscription changes are queued for the network owner task and
+**      their results are reported in events by ConfigMqttSubscription().
 **
 */
 static bool ConfigSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic, 
@@ -367,16 +820,26 @@ static bool ConfigSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic,
          break;
          
       case JMSG_TOPIC_TBL_SUB_JMSG:
-         if (MQTT_CLIENT_Subscribe(Topic->Name, MQTT_CLIENT_QOS2, MQMSG_TRANS_ProcessMqttMsg))
+      case JMSG_TOPIC_TBL_UNSUB_JMSG:
+         OS_MutSemTake(MqttMgr->ReqMutexId);
+         if (MqttMgr->Request.SubReqCnt < MQTT_MGR_SUB_REQ_MAX)
          {
+            MQTT_MGR_SubReq_t *SubReq = &MqttMgr->Request.SubReq[(MqttMgr->Request.SubReqHead + 
+                                         MqttMgr->Request.SubReqCnt) % MQTT_MGR_SUB_REQ_MAX];
+            SubReq->Topic     = Topic;
+            SubReq->ConfigOpt = ConfigOpt;
+            MqttMgr->Request.SubReqCnt++;
             RetStatus = true;
-            CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
-                              "Subscribed to MQTT client for topic %s", Topic->Name);
+         }
+         OS_MutSemGive(MqttMgr->ReqMutexId);
+         if (RetStatus)
+         {
+            WakeNetworkOwner();
          }
          else
          {
             CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_ERROR, 
-                    "Error subscribing to MQTT client for topic %s", Topic->Name);
+                              "MQTT subscription request queue full, dropped request for topic %s", Topic->Name);
          }
          break;
          
@@ -395,20 +858,6 @@ static bool ConfigSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic,
          }
          break;
       
-      case JMSG_TOPIC_TBL_UNSUB_JMSG:
-         if (MQTT_CLIENT_Unsubscribe(Topic->Name))
-         {
-            RetStatus = true;
-            CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
-                              "Unsubscribed from MQTT client for topic %s", Topic->Name);
-         }
-         else
-         {
-            CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
-                              "Error unsubscribing from MQTT client for topic %s", Topic->Name);
-         }
-         break;
-      
       default:
          CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_ERROR, 
                            "Invalid subscription configuration option for topic %s", Topic->Name);
@@ -421,33 +870,818 @@ static bool ConfigSubscription(const JMSG_TOPIC_TBL_Topic_t *Topic,
 } /* End ConfigSubscription() */
 
 
+/******************************************************************************
+** Function: ConnectToBroker
+**
+** Start a connect and make the broker the failover list's active broker
+**
+*/
+static bool ConnectToBroker(const char *ClientName, const char *BrokerAddress, uint32 BrokerPort)
+{
+   
+   MQTT_BROKER_ConnectStart(BrokerAddress, BrokerPort);
+   
+   return MQTT_CLIENT_Connect(ClientName, BrokerAddress, BrokerPort);
+   
+} /* End ConnectToBroker() */
+
+
+/******************************************************************************
+** Function: FlushCoalescedMsgs
+**
+** Write coalesced packets when their deadline expires or the queue holds
+** the last message of a burst.
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**
+*/
+static void FlushCoalescedMsgs(void)
+{
+   
+   if (MqttMgr->MqttClient.Connected && MqttMgr->MqttClient.CoalesceLen > 0)
+   {
+      if (MQTT_PUBQ_Drained() || MQTT_CLIENT_FlushTimeout() == 0)
+      {
+         if (!MQTT_CLIENT_Flush())
+         {
+            CFE_EVS_SendEvent(MQTT_MGR_EVENT_LOOP_EID, CFE_EVS_EventType_ERROR, 
+                              "Error writing coalesced MQTT publish packets");
+            MqttConnectionError();
+         }
+      }
+   }
+   
+} /* End FlushCoalescedMsgs() */
+
+
+/******************************************************************************
+** Function: MonotonicNs
+**
+*/
+static uint64 MonotonicNs(void)
+{
+   
+   struct timespec Now;
+   
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+   
+   return ((uint64)Now.tv_sec * 1000000000ULL + (uint64)Now.tv_nsec);
+   
+} /* End MonotonicNs() */
+
+
 /******************************************************************************
 ** Function: MqttConnectionError
 **
-** Report an error using the MQTT connection
+** Schedule a reconnect attempt after the connection is lost or a connect
+** fails
 **
 ** Notes:
-**   1. Other than the constructor this should be the only function that
-**      modifies the reconnect data structure.
+**   1. Other than the constructor, ProcessConnection() and
+**      ProcessRequests() this should be the only function that modifies
+**      the reconnect data structure.
+**   2. Must only be called by the network owner task. The constructor
+**      also calls it, that's safe because the app creates the network
+**      owner's child task after MQTT_MGR_Constructor() returns.
+**   3. Every publish failure calls this so it's ignored while connected or
+**      connecting and an attempt that's already scheduled isn't moved.
+**   4. The delay is BackoffMs with equal jitter, half of BackoffMs plus a
+**      random part of the other half.
 */
 static void MqttConnectionError(void)
 {
    
-   if (MqttMgr->Reconnect.Enabled)
+   MQTT_MGR_Reconnect_t *Reconnect = &MqttMgr->Reconnect;
+   uint64 Now;
+   uint32 DelayMs;
+   
+   if (!MqttMgr->MqttClient.Connected && !MQTT_CLIENT_Connecting())
    {
-      MqttMgr->Reconnect.DelayCnt++;
-      if (MqttMgr->Reconnect.DelayCnt >= MqttMgr->Reconnect.Period)
+      MQTT_BROKER_Failed();
+      
+      Now = MonotonicNs();
+      if (Reconnect->LostTime == 0)
       {
-         CFE_EVS_SendEvent(MQTT_MGR_RECONNECT_EID, CFE_EVS_EventType_INFORMATION, 
-                           "Attempting MQTT broker reconnect");
+         Reconnect->LostTime = Now;
+      }
+      Reconnect->Restoring = false;
+      MqttMgr->SubBatch.StartTime = 0;
+      
+      if (Reconnect->Enabled && !Reconnect->Scheduled)
+      {
+         DelayMs = Reconnect->BackoffMs/2 + (uint32)(rand() % (Reconnect->BackoffMs/2 + 1));
+         Reconnect->AttemptTime = Now + (uint64)DelayMs * 1000000;
+         Reconnect->Scheduled   = true;
+         Reconnect->BackoffMs   = (Reconnect->BackoffMs > Reconnect->BackoffMaxMs/2) ? 
+                                  Reconnect->BackoffMaxMs : (Reconnect->BackoffMs * 2);
          
-         if (MQTT_CLIENT_Reconnect())
-         {
-            JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SUB_JMSG);
-         }
-         MqttMgr->Reconnect.Attempts++; 
-         MqttMgr->Reconnect.DelayCnt = 0;
+         CFE_EVS_SendEvent(MQTT_MGR_RECONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                           "MQTT broker reconnect attempt in %d ms", DelayMs);
       }
    }
    
 } /* MqttConnectionError() */
+
+
+/******************************************************************************
+** Function: ProcessAck
+**
+** Pass a PUBLISH acknowledgement to the object that sent the PUBLISH.
+**
+** Notes:
+**   1. Signature must match MQTT_CLIENT_AckCallback_t
+**   2. Journaled and QoS window messages share the client's packet ID
+**      sequence so each object ignores the other's packet IDs.
+**
+*/
+static void ProcessAck(uint8 AckType, uint16 PacketId)
+{
+
+   if (AckType == PUBACK)
+   {
+      MQTT_JOURNAL_Ack(PacketId);
+   }
+   MQTT_INFLIGHT_Ack(AckType, PacketId);
+
+} /* End ProcessAck() */
+
+
+/******************************************************************************
+** Function: ProcessConnection
+**
+** Advance a connect in progress, start a scheduled reconnect attempt and
+** report the time to reconnect once the session is restored.
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**   2. Reconnect attempts are made to the healthiest broker in the
+**      failover list.
+**   3. The session isn't restored after the constructor's connect because
+**      topics are subscribed to as their plugins are registered.
+**   4. A reconnect is complete when the queued subscription requests have
+**      been sent and acknowledged.
+**
+*/
+static void ProcessConnection(void)
+{
+   
+   MQTT_MGR_Reconnect_t *Reconnect = &MqttMgr->Reconnect;
+   const MQTT_BROKER_Endpoint_t *Broker;
+   uint16 SubReqCnt;
+   
+   if (MQTT_CLIENT_Connecting())
+   {
+      switch (MQTT_CLIENT_ProcessConnect())
+      {
+         case MQTT_CLIENT_CONNECT_DONE:
+            MQTT_BROKER_Connected();
+            MQTT_SHARD_SetBroker(MqttMgr->MqttClient.ConnClientName, MqttMgr->MqttClient.ConnBrokerAddress,
+                                 MqttMgr->MqttClient.ConnBrokerPort,
+                                 &MqttMgr->MqttClient.ConnAddr[MqttMgr->MqttClient.ConnAddrIndex]);
+            Reconnect->Scheduled = false;
+            Reconnect->BackoffMs = Reconnect->BackoffMinMs;
+            if (Reconnect->LostTime != 0)
+            {
+               ResumeSession();
+               Reconnect->Restoring = true;
+            }
+            break;
+         case MQTT_CLIENT_CONNECT_FAILED:
+            MqttConnectionError();
+            break;
+         default:
+            break;
+      }
+   }
+   else if (!MqttMgr->MqttClient.Connected && Reconnect->Scheduled && ReconnectTimeout() == 0)
+   {
+      Broker = MQTT_BROKER_Select();
+      CFE_EVS_SendEvent(MQTT_MGR_RECONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                        "Attempting MQTT broker reconnect to %s:%d", Broker->Host, Broker->Port);
+      Reconnect->Scheduled = false;
+      Reconnect->Attempts++;
+      if (!ConnectToBroker(MqttMgr->MqttClient.ClientName, Broker->Host, Broker->Port))
+      {
+         MqttConnectionError();
+      }
+   }
+   
+   if (Reconnect->Restoring && MqttMgr->MqttClient.Connected)
+   {
+      OS_MutSemTake(MqttMgr->ReqMutexId);
+      SubReqCnt = MqttMgr->Request.SubReqCnt;
+      OS_MutSemGive(MqttMgr->ReqMutexId);
+      
+      if (SubReqCnt == 0 && MqttMgr->SubBatch.FilterCnt == 0 && MQTT_CLIENT_SubAckPending() == 0)
+      {
+         Reconnect->LastTimeMs = (uint32)((MonotonicNs() - Reconnect->LostTime) / 1000000);
+         if (Reconnect->LastTimeMs > Reconnect->MaxTimeMs)
+         {
+            Reconnect->MaxTimeMs = Reconnect->LastTimeMs;
+         }
+         Reconnect->LostTime  = 0;
+         Reconnect->Restoring = false;
+         CFE_EVS_SendEvent(MQTT_MGR_RECONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                           "MQTT broker connection restored in %d ms", Reconnect->LastTimeMs);
+      }
+   }
+   
+} /* End ProcessConnection() */
+
+
+/******************************************************************************
+** Function: ProcessRequests
+**
+** Perform connect and subscription requests queued by other tasks.
+**
+** Notes:
+**   1. Requests are copied out of the queue so the mutex isn't held while
+**      waiting for the broker.
+**   2. The subscriptions of all the queued requests are sent together
+**      after the queue is emptied. Only this task removes requests so one
+**      is read before it's removed and it's left queued while the
+**      subscription batch has no room for it. The batch has no room while
+**      its SUBSCRIBEs wait for a SUBACK to free a pending entry.
+**
+*/
+static void ProcessRequests(void)
+{
+
+   bool  ConnectPending;
+   bool  SelectBroker = false;
+   const MQTT_BROKER_Endpoint_t *Broker;
+   char  BrokerAddress[MAX_CLIENT_PARAM_STR_LEN];
+   char  ClientName[MAX_CLIENT_PARAM_STR_LEN];
+   uint32 BrokerPort = 0;
+   MQTT_MGR_SubReq_t SubReq;
+   bool  SubReqPending;
+   
+   OS_MutSemTake(MqttMgr->ReqMutexId);
+   ConnectPending = MqttMgr->Request.ConnectPending;
+   if (ConnectPending)
+   {
+      SelectBroker = MqttMgr->Request.SelectBroker;
+      memcpy(BrokerAddress, MqttMgr->Request.BrokerAddress, MAX_CLIENT_PARAM_STR_LEN);
+      memcpy(ClientName, MqttMgr->Request.ClientName, MAX_CLIENT_PARAM_STR_LEN);
+      BrokerPort = MqttMgr->Request.BrokerPort;
+      MqttMgr->Request.ConnectPending = false;
+   }
+   OS_MutSemGive(MqttMgr->ReqMutexId);
+   
+   /* Connect sends event messages, ProcessConnection() completes it */
+   if (ConnectPending)
+   {
+      if (SelectBroker)
+      {
+         Broker = MQTT_BROKER_Select();
+         strncpy(BrokerAddress, Broker->Host, MAX_CLIENT_PARAM_STR_LEN - 1);
+         BrokerAddress[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+         BrokerPort = Broker->Port;
+         CFE_EVS_SendEvent(MQTT_MGR_RECONNECT_EID, CFE_EVS_EventType_INFORMATION, 
+                           "Reconnecting to the healthiest MQTT broker %s:%d", Broker->Host, Broker->Port);
+      }
+      if (MqttMgr->Reconnect.LostTime == 0)
+      {
+         MqttMgr->Reconnect.LostTime = MonotonicNs();
+      }
+      MqttMgr->Reconnect.Scheduled = false;
+      MqttMgr->Reconnect.Restoring = false;
+      if (!ConnectToBroker(ClientName, BrokerAddress, BrokerPort))
+      {
+         MqttConnectionError();
+      }
+   }
+   
+   do
+   {
+      OS_MutSemTake(MqttMgr->ReqMutexId);
+      SubReqPending = (MqttMgr->Request.SubReqCnt > 0);
+      if (SubReqPending)
+      {
+         SubReq = MqttMgr->Request.SubReq[MqttMgr->Request.SubReqHead];
+      }
+      OS_MutSemGive(MqttMgr->ReqMutexId);
+      
+      if (SubReqPending && !SubBatchHasRoom(SubReq.ConfigOpt))
+      {
+         SendSubscriptions();
+         SubReqPending = SubBatchHasRoom(SubReq.ConfigOpt);
+      }
+      
+      if (SubReqPending)
+      {
+         OS_MutSemTake(MqttMgr->ReqMutexId);
+         MqttMgr->Request.SubReqHead = (MqttMgr->Request.SubReqHead + 1) % MQTT_MGR_SUB_REQ_MAX;
+         MqttMgr->Request.SubReqCnt--;
+         OS_MutSemGive(MqttMgr->ReqMutexId);
+         
+         ConfigMqttSubscription(SubReq.Topic, SubReq.ConfigOpt);
+      }
+      
+   } while (SubReqPending);
+   
+   SendSubscriptions();
+   
+} /* End ProcessRequests() */
+
+
+/******************************************************************************
+** Function: ProcessSubAck
+**
+** Record a topic filter's SUBACK return code in its plugin's topic
+** statistics.
+**
+** Notes:
+**   1. Signature must match MQTT_CLIENT_SubAckCallback_t
+**   2. Tag is the plugin ID of the filter's topic.
+**
+*/
+static void ProcessSubAck(int32 Tag, uint8 ReturnCode)
+{
+
+   const JMSG_TOPIC_TBL_Topic_t *Topic;
+   
+   MQTT_TOPIC_STATS_SetSubAck(Tag, ReturnCode);
+   
+   if (ReturnCode >= MQTT_CLIENT_SUBACK_FAILURE)
+   {
+      MqttMgr->SubBatch.RejectCnt++;
+      Topic = JMSG_TOPIC_TBL_GetTopic(Tag);
+      CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_ERROR, 
+                        "MQTT broker rejected subscription to topic %s with return code 0x%02X",
+                        (Topic != NULL) ? Topic->Name : "unknown", ReturnCode);
+   }
+
+} /* End ProcessSubAck() */
+
+
+/******************************************************************************
+** Function: PublishJournalMsgs
+**
+** Publish journaled messages with QoS1 until the in-flight window is full.
+**
+** Notes:
+**   1. Journaled messages are removed when their PUBACK is received.
+**   2. Latency is recorded the first time a message appended by this app
+**      run is published. Replays after a reconnect or restart aren't
+**      recorded.
+**
+*/
+static void PublishJournalMsgs(void)
+{
+
+   MQTT_JOURNAL_Msg_t JournalMsg;
+   uint16 PacketId;
+   CFE_TIME_SysTime_t PubTime;
+
+   if (MqttMgr->MqttClient.Connected)
+   {
+      while (MQTT_CLIENT_SendReady() && MQTT_JOURNAL_PeekUnsent(&JournalMsg))
+      {
+         PacketId = JournalMsg.PacketId;
+         if (MQTT_CLIENT_PublishQos1(JournalMsg.PluginId, JournalMsg.Topic, JournalMsg.Payload,
+                                     JournalMsg.PayloadLen, JournalMsg.Retain, &PacketId))
+         {
+            if (JournalMsg.FirstSend)
+            {
+               PubTime = CFE_TIME_GetTime();
+               MQTT_LATENCY_Record(MQTT_LATENCY_PUBLISH, JournalMsg.PluginId, &JournalMsg.XlateTime, &PubTime);
+               MQTT_LATENCY_Record(MQTT_LATENCY_OUT_TOTAL, JournalMsg.PluginId, &JournalMsg.SbTime, &PubTime);
+            }
+            MQTT_JOURNAL_MarkSent(PacketId);
+         }
+         else
+         {
+            MQTT_TOPIC_STATS_CountPublishErr(JournalMsg.PluginId);
+            MqttConnectionError();
+            break;
+         }
+      }
+   }
+   
+} /* End PublishJournalMsgs() */
+
+
+/******************************************************************************
+** Function: PublishQueuedMsgs
+**
+** Notes:
+**   1. MQTT_CLIENT_PublishPacket() sends error events so no need to send
+**      any events here.
+**   2. Messages that can't be published are spooled.
+**   3. When the journal is enabled QoS1 messages are journaled and
+**      published by PublishJournalMsgs() with their retain flag. They're
+**      only spooled if the journal is full. QoS0 and QoS2 messages aren't
+**      journaled.
+**   4. QoS1 and QoS2 messages are published through the QoS window. They
+**      stay in the queue while the window is full.
+**   5. Messages stay in the queue while MQTT_CLIENT_SendReady() is false.
+**
+*/
+static void PublishQueuedMsgs(void)
+{
+
+   const MQTT_PUBQ_Entry_t *Entry;
+   const char *Payload;
+   uint32 PubCnt = 0;
+   bool   Published;
+   CFE_TIME_SysTime_t PubTime;
+
+   while (PubCnt < MQTT_PUBQ_DEPTH && MQTT_CLIENT_SendReady() && (Entry = MQTT_PUBQ_Peek()) != NULL)
+   {
+      Payload = (const char *)&Entry->Packet[Entry->PayloadIndex];
+      if (MqttMgr->MqttJournal.Enabled && Entry->Qos == MQTT_CLIENT_QOS1)
+      {
+         if (!MQTT_JOURNAL_Append(Entry->PluginId, Entry->Topic, Payload, Entry->PayloadLen,
+                                  Entry->Retain, &Entry->SbTime, &Entry->XlateTime))
+         {
+            StoreUnpublishedMsg(Entry);
+         }
+      }
+      else if (MqttMgr->MqttClient.Connected)
+      {
+         if (Entry->Qos == MQTT_CLIENT_QOS0)
+         {
+            Published = MQTT_CLIENT_PublishPacket(Entry->PluginId, Entry->Topic,
+                                                  &Entry->Packet[Entry->PacketIndex],
+                                                  Entry->PacketLen, Entry->PayloadLen);
+         }
+         else if (MQTT_INFLIGHT_Ready())
+         {
+            Published = MQTT_INFLIGHT_Publish(Entry->PluginId, Entry->Qos, Entry->Retain, Entry->Topic,
+                                              Payload, Entry->PayloadLen);
+         }
+         else
+         {
+            break;
+         }
+         if (Published)
+         {
+            PubTime = CFE_TIME_GetTime();
+            MQTT_LATENCY_Record(MQTT_LATENCY_PUBLISH, Entry->PluginId, &Entry->XlateTime, &PubTime);
+            MQTT_LATENCY_Record(MQTT_LATENCY_OUT_TOTAL, Entry->PluginId, &Entry->SbTime, &PubTime);
+         }
+         else
+         {
+            MQTT_TOPIC_STATS_CountPublishErr(Entry->PluginId);
+            StoreUnpublishedMsg(Entry);
+            MqttConnectionError();
+         }
+      }
+      else
+      {
+         StoreUnpublishedMsg(Entry);
+      }
+      MQTT_PUBQ_Pop();
+      PubCnt++;
+   }
+   
+} /* End PublishQueuedMsgs() */
+
+
+/******************************************************************************
+** Function: PublishReady
+**
+** Return true if the oldest queued message can be published now.
+**
+** Notes:
+**   1. A QoS1 or QoS2 message isn't ready while the QoS window is full
+**      unless it's a QoS1 message going to the journal.
+**
+*/
+static bool PublishReady(void)
+{
+
+   const MQTT_PUBQ_Entry_t *Entry = MQTT_PUBQ_Peek();
+
+   return (Entry != NULL && (Entry->Qos == MQTT_CLIENT_QOS0 || MQTT_INFLIGHT_Ready() ||
+                             (MqttMgr->MqttJournal.Enabled && Entry->Qos == MQTT_CLIENT_QOS1)));
+
+} /* End PublishReady() */
+
+
+/******************************************************************************
+** Function: PublishSpooledMsgs
+**
+** Replay spooled messages within the spool's replay rate limit.
+**
+** Notes:
+**   1. A message remains in the spool if it can't be published.
+**   2. Messages are replayed with the QoS and retain flag they were
+**      spooled with. QoS1 and QoS2 messages go through the QoS window like
+**      PublishQueuedMsgs() and replay stops while the window is full.
+**
+*/
+static void PublishSpooledMsgs(void)
+{
+
+   MQTT_SPOOL_Msg_t SpoolMsg;
+   uint32 ReplayCredit;
+   bool   Published;
+
+   if (MqttMgr->MqttClient.Connected)
+   {
+      ReplayCredit = MQTT_SPOOL_ReplayCredit();
+      while (ReplayCredit > 0 && MQTT_CLIENT_SendReady() && MQTT_SPOOL_Peek(&SpoolMsg))
+      {
+         if (SpoolMsg.Qos == MQTT_CLIENT_QOS0)
+         {
+            Published = MQTT_CLIENT_Publish(SpoolMsg.PluginId, SpoolMsg.Topic, SpoolMsg.Payload,
+                                            SpoolMsg.PayloadLen, SpoolMsg.Retain);
+         }
+         else if (MQTT_INFLIGHT_Ready())
+         {
+            Published = MQTT_INFLIGHT_Publish(SpoolMsg.PluginId, SpoolMsg.Qos, SpoolMsg.Retain, SpoolMsg.Topic,
+                                              SpoolMsg.Payload, SpoolMsg.PayloadLen);
+         }
+         else
+         {
+            break;
+         }
+         if (Published)
+         {
+            MQTT_SPOOL_Pop();
+            ReplayCredit--;
+         }
+         else
+         {
+            MQTT_TOPIC_STATS_CountPublishErr(SpoolMsg.PluginId);
+            MqttConnectionError();
+            break;
+         }
+      }
+   }
+   
+} /* End PublishSpooledMsgs() */
+
+
+/******************************************************************************
+** Function: QueueConnectRequest
+**
+** Queue a broker connection request for the network owner task.
+**
+** Notes:
+**   1. A NULL BrokerAddress connects to the broker returned by
+**      MQTT_BROKER_Select() when the request is performed.
+**
+*/
+static bool QueueConnectRequest(const char *ClientName, const char *BrokerAddress, uint32 BrokerPort)
+{
+   
+   bool RetStatus = false;
+   
+   OS_MutSemTake(MqttMgr->ReqMutexId);
+   
+   if (MqttMgr->Request.ConnectPending)
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONNECT_TO_BROKER_EID, CFE_EVS_EventType_ERROR, 
+                        "Connect to MQTT broker command rejected, a previous connect request is pending");
+   }
+   else
+   {
+      MqttMgr->Request.SelectBroker = (BrokerAddress == NULL);
+      if (BrokerAddress != NULL)
+      {
+         strncpy(MqttMgr->Request.BrokerAddress, BrokerAddress, MAX_CLIENT_PARAM_STR_LEN - 1);
+         MqttMgr->Request.BrokerAddress[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+      }
+      MqttMgr->Request.BrokerPort = BrokerPort;
+      strncpy(MqttMgr->Request.ClientName, ClientName, MAX_CLIENT_PARAM_STR_LEN - 1);
+      MqttMgr->Request.ClientName[MAX_CLIENT_PARAM_STR_LEN - 1] = '\0';
+      MqttMgr->Request.ConnectPending = true;
+      RetStatus = true;
+   }
+   
+   OS_MutSemGive(MqttMgr->ReqMutexId);
+   
+   if (RetStatus)
+   {
+      WakeNetworkOwner();
+   }
+   
+   return RetStatus;
+   
+} /* End QueueConnectRequest() */
+
+
+/******************************************************************************
+** Function: ReconnectTimeout
+**
+** Return the number of milliseconds until the scheduled reconnect attempt.
+**
+*/
+static uint32 ReconnectTimeout(void)
+{
+   
+   uint64 Now = MonotonicNs();
+   
+   return (Now >= MqttMgr->Reconnect.AttemptTime) ? 0 :
+          (uint32)((MqttMgr->Reconnect.AttemptTime - Now + 999999) / 1000000);
+   
+} /* End ReconnectTimeout() */
+
+
+/******************************************************************************
+** Function: ReportSubscribeTime
+**
+** Report the time to subscribe once every SUBSCRIBE sent since
+** SubBatch.StartTime has been acknowledged.
+**
+** Notes:
+**   1. Must only be called by the network owner task after the input
+**      packets have been read.
+**
+*/
+static void ReportSubscribeTime(void)
+{
+   
+   MQTT_MGR_SubBatch_t *SubBatch = &MqttMgr->SubBatch;
+   
+   if (SubBatch->StartTime != 0 && SubBatch->FilterCnt == 0 && MQTT_CLIENT_SubAckPending() == 0)
+   {
+      SubBatch->LastTimeUs    = (uint32)((MonotonicNs() - SubBatch->StartTime) / 1000);
+      SubBatch->LastFilterCnt = SubBatch->SentFilterCnt;
+      SubBatch->LastPacketCnt = SubBatch->SentPacketCnt;
+      if (SubBatch->LastTimeUs > SubBatch->MaxTimeUs)
+      {
+         SubBatch->MaxTimeUs = SubBatch->LastTimeUs;
+      }
+      SubBatch->StartTime = 0;
+      CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
+                        "Subscribed to %d MQTT topic filters in %d SUBSCRIBE packet(s) in %d us",
+                        SubBatch->LastFilterCnt, SubBatch->LastPacketCnt, SubBatch->LastTimeUs);
+   }
+   
+} /* End ReportSubscribeTime() */
+
+
+/******************************************************************************
+** Function: ResumeSession
+**
+** Restore the gateway's broker state after a connect.
+**
+** Notes:
+**   1. Journaled and QoS window messages are always resent. When the broker
+**      resumed a persistent session they keep their packet IDs and
+**      released QoS2 messages have their PUBREL resent, with a clean
+**      session the QoS state is discarded. The topics aren't re-subscribed
+**      on a resumed session, the broker kept the subscriptions and delivers
+**      the QoS1 and QoS2 messages it queued once the connect completes.
+**   2. A stale session is re-subscribed to bring the broker up to date.
+**
+*/
+static void ResumeSession(void)
+{
+
+   MQTT_JOURNAL_Rewind(MQTT_CLIENT_SessionPresent());
+   MQTT_INFLIGHT_Rewind(MQTT_CLIENT_SessionPresent());
+
+   if (MQTT_CLIENT_SessionPresent() && !MqttMgr->SessionStale)
+   {
+      MqttMgr->SessionResumeCnt++;
+      CFE_EVS_SendEvent(MQTT_MGR_SESSION_EID, CFE_EVS_EventType_INFORMATION,
+                        "Resumed MQTT session, topic subscriptions kept by the broker");
+   }
+   else
+   {
+      MqttMgr->SessionStale = false;
+      JMSG_TOPIC_TBL_SubscribeToAll(JMSG_TOPIC_TBL_SUB_JMSG);
+   }
+
+} /* End ResumeSession() */
+
+
+/******************************************************************************
+** Function: SendSubscriptions
+**
+** Send the subscription batch's topic filters and empty the batch.
+**
+** Notes:
+**   1. Must only be called by the network owner task.
+**   2. A batch that can't be sent marks the session stale and is dropped,
+**      the topics are subscribed to again when the session is restored.
+**   3. Filters that wait for a SUBACK to free a pending entry are kept in
+**      the batch and sent by a later call.
+**
+*/
+static void SendSubscriptions(void)
+{
+   
+   MQTT_MGR_SubBatch_t *SubBatch = &MqttMgr->SubBatch;
+   uint16 SentCnt;
+   uint16 PacketCnt = 0;
+   
+   if (SubBatch->FilterCnt == 0)
+   {
+      return;
+   }
+   
+   if (SubBatch->StartTime == 0)
+   {
+      SubBatch->StartTime     = MonotonicNs();
+      SubBatch->SentFilterCnt = 0;
+      SubBatch->SentPacketCnt = 0;
+   }
+   
+   SentCnt = MQTT_CLIENT_SubscribeBatch(SubBatch->Filter, SubBatch->FilterCnt, 
+                                        MQMSG_TRANS_ProcessMqttMsg, &PacketCnt);
+   SubBatch->SentFilterCnt += SentCnt;
+   SubBatch->SentPacketCnt += PacketCnt;
+   
+   if (SentCnt < SubBatch->FilterCnt && MqttMgr->MqttClient.Connected && MQTT_CLIENT_SubPendingFull())
+   {
+      /* The CBOR names are kept because the held filters may use them */
+      memmove(&SubBatch->Filter[0], &SubBatch->Filter[SentCnt], 
+              (SubBatch->FilterCnt - SentCnt) * sizeof(MQTT_CLIENT_SubFilter_t));
+      SubBatch->FilterCnt -= SentCnt;
+      SubBatch->HoldCnt++;
+      return;
+   }
+   else if (SentCnt < SubBatch->FilterCnt)
+   {
+      MqttMgr->SessionStale = true;
+      CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_ERROR, 
+                        "Error subscribing to MQTT client, sent %d of %d topic filters starting with topic %s",
+                        SentCnt, SubBatch->FilterCnt, SubBatch->Filter[SentCnt].Topic);
+      MqttConnectionError();
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_MGR_CONFIG_SUBSCRIPTIONS_EID, CFE_EVS_EventType_INFORMATION, 
+                        "Subscribed to MQTT client for %d topic filters in %d SUBSCRIBE packet(s)",
+                        SentCnt, PacketCnt);
+   }
+   
+   SubBatch->FilterCnt = 0;
+   SubBatch->CborCnt   = 0;
+   
+} /* End SendSubscriptions() */
+
+
+/******************************************************************************
+** Function: StoreUnpublishedMsg
+**
+** Spool a queued message that could not be published. Messages that can't
+** be spooled are counted as unpublished and as drops in the plugin's topic
+** statistics.
+**
+*/
+static void StoreUnpublishedMsg(const MQTT_PUBQ_Entry_t *Entry)
+{
+
+   if (MqttMgr->MqttSpool.BufLen == 0 ||
+       !MQTT_SPOOL_Store(Entry->PluginId, Entry->Qos, Entry->Retain, Entry->Topic,
+                         (const char *)&Entry->Packet[Entry->PayloadIndex], Entry->PayloadLen))
+   {
+      MqttMgr->UnpublishedSbMsgCnt++;
+      MQTT_TOPIC_STATS_CountDrop(Entry->PluginId);
+   }
+   
+} /* End StoreUnpublishedMsg() */
+
+
+/******************************************************************************
+** Function: SubBatchHasRoom
+**
+** Return true when a subscription request can be added to the
+** subscription batch
+**
+** Notes:
+**   1. A subscribe needs room for its topic and CBOR topic. An unsubscribe
+**      needs an empty batch so it's sent after the subscriptions before it.
+**
+*/
+static bool SubBatchHasRoom(JMSG_TOPIC_TBL_SubscriptionOptEnum_t ConfigOpt)
+{
+   
+   const MQTT_MGR_SubBatch_t *SubBatch = &MqttMgr->SubBatch;
+   
+   if (ConfigOpt == JMSG_TOPIC_TBL_SUB_JMSG)
+   {
+      return ((SubBatch->FilterCnt + 2) <= MQTT_MGR_SUB_FILTER_MAX && 
+              SubBatch->CborCnt < MQTT_MGR_SUB_REQ_MAX);
+   }
+   
+   return (SubBatch->FilterCnt == 0);
+   
+} /* End SubBatchHasRoom() */
+
+
+/******************************************************************************
+** Function: WakeNetworkOwner
+**
+** Wake the network owner task from its poll() wait.
+**
+*/
+static void WakeNetworkOwner(void)
+{
+   
+   uint64  WakeCnt = 1;
+   ssize_t WriteLen;
+   
+   /* A failed write means the counter is saturated so the owner is already awake */
+   WriteLen = write(MqttMgr->WakeFd, &WakeCnt, sizeof(WakeCnt));
+   (void)WriteLen;
+   
+} /* End WakeNetworkOwner() */
@@ -34,7 +34,16 @@
 
 #include "app_cfg.h"
 #include "mqmsg_trans.h"
+#include "mqtt_broker.h"
 #include "mqtt_client.h"
+#include "mqtt_inflight.h"
+#include "mqtt_journal.h"
+#include "mqtt_latency.h"
+#include "mqtt_pubq.h"
+#include "mqtt_shard.h"
+#include "mqtt_spool.h"
+#include "mqtt_topic_stats.h"
+#include "mqtt_trace.h"
 
 
 /***********************/
@@ -51,23 +60,123 @@
 #define MQTT_MGR_RECONNECT_EID              (MQTT_MGR_BASE_EID + 2)
 #define MQTT_MGR_SEND_CONNECTION_INFO_EID   (MQTT_MGR_BASE_EID + 3)
 #define MQTT_MGR_SUBSCRIBE_TOPIC_PLUGIN_EID (MQTT_MGR_BASE_EID + 4)
+#define MQTT_MGR_CONNECT_TO_BROKER_EID      (MQTT_MGR_BASE_EID + 5)
+#define MQTT_MGR_EVENT_LOOP_EID             (MQTT_MGR_BASE_EID + 6)
+#define MQTT_MGR_SESSION_EID                (MQTT_MGR_BASE_EID + 7)
+#define MQTT_MGR_FAILOVER_EID               (MQTT_MGR_BASE_EID + 8)
+
+/*
+** Subscription requests that are waiting to be performed by the network
+** owner task. Sized so a complete re-subscription can be queued while
+** command driven requests are pending.
+*/
+
+#define MQTT_MGR_SUB_REQ_MAX  (2*JMSG_PLATFORM_TOPIC_PLUGIN_MAX)
+
+/*
+** Topic filters in a subscription batch, each request subscribes to a
+** topic and its CBOR topic
+*/
+
+#define MQTT_MGR_SUB_FILTER_MAX  (2*MQTT_MGR_SUB_REQ_MAX)
 
 /**********************/
 /** Type Definitions **/
 /**********************/
 
 
+/*
+** Reconnect with exponential backoff. BackoffMs doubles after each failed
+** attempt from BackoffMinMs to BackoffMaxMs and the delay before an attempt is a random
+** value between half and all of BackoffMs so clients that lose a broker
+** together don't reconnect together. Times are CLOCK_MONOTONIC ns.
+*/
+
 typedef struct
 {
    
    bool    Enabled;
-   uint32  Period;
-   uint32  DelayCnt;
+   uint32  BackoffMinMs;
+   uint32  BackoffMaxMs;
+   uint32  BackoffMs;
+   bool    Scheduled;        /* An attempt is scheduled for AttemptTime */
+   uint64  AttemptTime;
+   uint64  LostTime;         /* Connection lost, zero while connected */
+   bool    Restoring;        /* Connected and waiting for subscriptions to be restored */
    uint32  Attempts;
-
+   uint32  LastTimeMs;       /* Time to reconnect, from losing the connection to restoring subscriptions */
+   uint32  MaxTimeMs;
+   
 } MQTT_MGR_Reconnect_t;
 
 
+/*
+** Requests from other tasks that must be performed by the network owner.
+** Protected by ReqMutexId.
+*/
+
+typedef struct
+{
+   
+   const JMSG_TOPIC_TBL_Topic_t          *Topic;
+   JMSG_TOPIC_TBL_SubscriptionOptEnum_t  ConfigOpt;
+
+} MQTT_MGR_SubReq_t;
+
+/*
+** Subscription batch: the topic filters of the queued subscription requests
+** are collected in Filter and sent together. CborTopic holds the CBOR topic
+** names that Filter points to. Only accessed by the network owner. Filters
+** stay in the batch while the client can't track another SUBACK.
+**
+** The time to subscribe runs from the first SUBSCRIBE sent while none were
+** waiting to be acknowledged until they have all been acknowledged.
+** StartTime is a CLOCK_MONOTONIC ns time, zero when no SUBSCRIBEs are
+** being timed.
+*/
+
+typedef struct
+{
+   
+   uint16  FilterCnt;
+   uint16  CborCnt;
+   MQTT_CLIENT_SubFilter_t  Filter[MQTT_MGR_SUB_FILTER_MAX];
+   char    CborTopic[MQTT_MGR_SUB_REQ_MAX][JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   
+   uint64  StartTime;
+   uint16  SentFilterCnt;     /* Filters sent since StartTime */
+   uint16  SentPacketCnt;
+   
+   /*
+   ** Status
+   */
+   
+   uint16  LastFilterCnt;     /* Filters and SUBSCRIBEs in the last timed subscription */
+   uint16  LastPacketCnt;
+   uint32  LastTimeUs;
+   uint32  MaxTimeUs;
+   uint32  RejectCnt;         /* Topic filters rejected by the broker */
+   uint32  HoldCnt;           /* Sends held until a SUBACK freed a pending entry */
+   
+} MQTT_MGR_SubBatch_t;
+
+
+typedef struct
+{
+   
+   bool    ConnectPending;
+   bool    SelectBroker;     /* Connect to the healthiest failover broker */
+   char    BrokerAddress[MAX_CLIENT_PARAM_STR_LEN];
+   uint32  BrokerPort;
+   char    ClientName[MAX_CLIENT_PARAM_STR_LEN];
+   
+   uint16  SubReqHead;
+   uint16  SubReqCnt;
+   MQTT_MGR_SubReq_t SubReq[MQTT_MGR_SUB_REQ_MAX];
+
+} MQTT_MGR_Request_t;
+
+
 typedef struct
 {
 
@@ -77,16 +186,47 @@ typedef struct
    uint32  SbPendTime;
    uint32  UnpublishedSbMsgCnt;
    
+   MQTT_CLIENT_Qos_t  PubQos;   /* Default QoS of messages that aren't journaled */
+   MQTT_CLIENT_Qos_t  SubQos;   /* Default subscription QoS */
+   
    MQTT_MGR_Reconnect_t Reconnect;
+   MQTT_MGR_SubBatch_t  SubBatch;
+   
+   /*
+   ** Persistent session: SessionStale is set when a subscription change
+   ** couldn't be sent to the broker so a resumed session's subscriptions
+   ** are out of date. Only accessed by the network owner.
+   */
+   
+   bool    SessionStale;
+   uint32  SessionResumeCnt;   /* Reconnects that skipped re-subscribing */
    
    CFE_SB_PipeId_t TopicPipe;
    
+   /*
+   ** The child task owns the broker connection. WakeFd is an eventfd used
+   ** to wake it when outbound work or a request is queued.
+   */
+   
+   int                 WakeFd;
+   osal_id_t           ReqMutexId;
+   MQTT_MGR_Request_t  Request;
+   
    /*
    ** Contained Objects
    */
    
+   MQTT_TRACE_Class_t   MqttTrace;
+   MQTT_TOPIC_STATS_Class_t MqttTopicStats;
+   MQTT_LATENCY_Class_t MqttLatency;
+   MQTT_BROKER_Class_t  MqttBroker;
    MQTT_CLIENT_Class_t  MqttClient;
    MQMSG_TRANS_Class_t  MqMsgTrans;  
+   MQTT_PUBQ_Class_t    MqttPubQ;
+   MQTT_SHARD_Class_t   MqttShard;
+   MQTT_SPOOL_Class_t   MqttSpool;
+   MQTT_JOURNAL_Class_t MqttJournal;
+   MQTT_INFLIGHT_Class_t MqttInflight;
    
 } MQTT_MGR_Class_t;
 
@@ -103,6 +243,8 @@ typedef struct
 **
 ** Notes:
 **   1. This must be classed prior to any other member functions.
+**   2. The network owner's child task must be created after this returns,
+**      the constructor starts the initial connect as the network owner.
 **
 */
 void MQTT_MGR_Constructor(MQTT_MGR_Class_t *MqttMgrPtr, const INITBL_Class_t *IniTbl);
@@ -111,6 +253,14 @@ void MQTT_MGR_Constructor(MQTT_MGR_Class_t *MqttMgrPtr, const INITBL_Class_t *In
 /******************************************************************************
 ** Function: MQTT_MGR_ChildTaskCallback
 **
+** Network owner event loop. 
+**
+** Notes:
+**   1. This is the only task that reads or writes the broker connection.
+**      Each call waits for socket readiness, queued outbound messages, a
+**      queued request or the next keepalive deadline, whichever is first.
+**   2. This is the only consumer of the publish queue.
+**
 */
 bool MQTT_MGR_ChildTaskCallback(CHILDMGR_Class_t *ChildMgr);
 
@@ -118,10 +268,12 @@ bool MQTT_MGR_ChildTaskCallback(CHILDMGR_Class_t *ChildMgr);
 /******************************************************************************
 ** Function: MQTT_MGR_ConnectToMqttBrokerCmd
 **
-** Start/stop a topic test. 
+** Connect to an MQTT broker
 **
 ** Notes:
 **   1. Signature must match CMDMGR_CmdFuncPtr_t
+**   2. The connection is performed by the network owner task. Connection
+**      results are reported in events.
 **
 */
 bool MQTT_MGR_ConnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
@@ -136,7 +288,8 @@ bool MQTT_MGR_ConnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *
 **   1. This function is designed to be continuously called from the app's main
 **      loop so it pends with a timeout on the SB
 **   2. In normal operations it receives topic messages from the SB and 
-**      creates/sends corresponding MQTT JSON messages to the MQTT_CLIENT.
+**      queues corresponding MQTT JSON messages for the network owner task
+**      so broker round trips never delay draining the topic pipe.
 **
 */
 void MQTT_MGR_ProcessSbTopicMsgs(uint32 PerfId);
@@ -145,6 +298,10 @@ void MQTT_MGR_ProcessSbTopicMsgs(uint32 PerfId);
 /******************************************************************************
 ** Function: MQTT_MGR_ReconnectToMqttBrokerCmd
 **
+** Notes:
+**   1. Signature must match CMDMGR_CmdFuncPtr_t
+**   2. See MQTT_MGR_ConnectToMqttBrokerCmd()
+**
 */
 bool MQTT_MGR_ReconnectToMqttBrokerCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
 
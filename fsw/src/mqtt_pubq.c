@@ -0,0 +1,296 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage the queue of translated MQTT messages waiting to be published
+**
+** Notes:
+**   1. The acquire/release orderings guarantee an entry's contents are
+**      visible to the consumer before the producer's Tail update and that
+**      the consumer is done with an entry before the Head update.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_pubq.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#if (MQTT_PUBQ_DEPTH & (MQTT_PUBQ_DEPTH - 1)) != 0
+   #error MQTT_PUBQ_DEPTH must be a power of 2
+#endif
+
+#if (MQTT_PUBQ_PRIORITY_DEPTH & (MQTT_PUBQ_PRIORITY_DEPTH - 1)) != 0
+   #error MQTT_PUBQ_PRIORITY_DEPTH must be a power of 2
+#endif
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 RingCount(const MQTT_PUBQ_Ring_t *Ring);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_PUBQ_Class_t *MqttPubQ = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Constructor
+**
+*/
+void MQTT_PUBQ_Constructor(MQTT_PUBQ_Class_t *MqttPubQPtr)
+{
+
+   MqttPubQ = MqttPubQPtr;
+
+   CFE_PSP_MemSet((void*)MqttPubQ, 0, sizeof(MQTT_PUBQ_Class_t));
+
+   MqttPubQ->Ring[MQTT_PUBQ_RING_PRIORITY].Mask  = MQTT_PUBQ_PRIORITY_DEPTH - 1;
+   MqttPubQ->Ring[MQTT_PUBQ_RING_PRIORITY].Entry = MqttPubQ->PriorityEntry;
+   MqttPubQ->Ring[MQTT_PUBQ_RING_ROUTINE].Mask   = MQTT_PUBQ_DEPTH - 1;
+   MqttPubQ->Ring[MQTT_PUBQ_RING_ROUTINE].Entry  = MqttPubQ->RoutineEntry;
+
+} /* End MQTT_PUBQ_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_BuildEntry
+**
+*/
+bool MQTT_PUBQ_BuildEntry(MQTT_PUBQ_Entry_t *Entry, int32 PluginId, const char *Topic,
+                          const char *Payload, uint32 PayloadLen, MQTT_CLIENT_Qos_t Qos, bool Retain,
+                          const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime)
+{
+
+   uint32 PayloadIndex = 0;
+   size_t TopicLen = strlen(Topic);
+
+   if (TopicLen < JMSG_PLATFORM_TOPIC_NAME_MAX_LEN)
+   {
+      PayloadIndex = MQTT_CLIENT_BeginPublish(Entry->Packet, MQTT_PUBQ_PACKET_MAX_LEN, Topic, TopicLen);
+   }
+
+   if (PayloadIndex == 0 || PayloadLen > (MQTT_PUBQ_PACKET_MAX_LEN - PayloadIndex))
+   {
+      CFE_EVS_SendEvent(MQTT_PUBQ_PUSH_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "Publish queue rejected topic %s, topic length %d or payload length %d exceeds maximum",
+                        Topic, (int)TopicLen, PayloadLen);
+      return false;
+   }
+
+   memcpy(Entry->Topic, Topic, TopicLen + 1);
+   memcpy(&Entry->Packet[PayloadIndex], Payload, PayloadLen);
+   Entry->PacketIndex  = MQTT_CLIENT_EndPublish(Entry->Packet, PayloadIndex, PayloadLen, Retain);
+   Entry->PacketLen    = PayloadIndex + PayloadLen - Entry->PacketIndex;
+   Entry->PayloadIndex = PayloadIndex;
+   Entry->PayloadLen   = PayloadLen;
+   Entry->PluginId     = PluginId;
+   Entry->Qos          = Qos;
+   Entry->Retain       = Retain;
+   Entry->SbTime       = *SbTime;
+   Entry->XlateTime    = *XlateTime;
+
+   return true;
+
+} /* End MQTT_PUBQ_BuildEntry() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Count
+**
+*/
+uint32 MQTT_PUBQ_Count(void)
+{
+
+   return (RingCount(&MqttPubQ->Ring[MQTT_PUBQ_RING_PRIORITY]) +
+           RingCount(&MqttPubQ->Ring[MQTT_PUBQ_RING_ROUTINE]));
+
+} /* End MQTT_PUBQ_Count() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Drained
+**
+** Notes:
+**   1. DrainMark is read before Tail so a push after the mark is seen as
+**      an undrained queue.
+**
+*/
+bool MQTT_PUBQ_Drained(void)
+{
+
+   bool   RetStatus = true;
+   uint32 DrainMark;
+   uint32 Tail;
+   uint16 i;
+
+   for (i = 0; i < MQTT_PUBQ_RING_CNT && RetStatus; i++)
+   {
+      DrainMark = __atomic_load_n(&MqttPubQ->Ring[i].DrainMark, __ATOMIC_ACQUIRE);
+      Tail      = __atomic_load_n(&MqttPubQ->Ring[i].Tail, __ATOMIC_ACQUIRE);
+      RetStatus = (DrainMark == Tail && MqttPubQ->Ring[i].Head == Tail);
+   }
+
+   return RetStatus;
+
+} /* End MQTT_PUBQ_Drained() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_MarkDrained
+**
+*/
+void MQTT_PUBQ_MarkDrained(void)
+{
+
+   uint16 i;
+
+   for (i = 0; i < MQTT_PUBQ_RING_CNT; i++)
+   {
+      __atomic_store_n(&MqttPubQ->Ring[i].DrainMark, MqttPubQ->Ring[i].Tail, __ATOMIC_RELEASE);
+   }
+
+} /* End MQTT_PUBQ_MarkDrained() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Peek
+**
+*/
+const MQTT_PUBQ_Entry_t *MQTT_PUBQ_Peek(void)
+{
+
+   const MQTT_PUBQ_Entry_t *Entry = NULL;
+   MQTT_PUBQ_Ring_t *Ring;
+   uint16 i;
+
+   for (i = 0; i < MQTT_PUBQ_RING_CNT && Entry == NULL; i++)
+   {
+      Ring = &MqttPubQ->Ring[i];
+      if (Ring->Head != __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE))
+      {
+         Entry = &Ring->Entry[Ring->Head & Ring->Mask];
+         MqttPubQ->PeekRing = i;
+      }
+   }
+
+   return Entry;
+
+} /* End MQTT_PUBQ_Peek() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Pop
+**
+*/
+void MQTT_PUBQ_Pop(void)
+{
+
+   MQTT_PUBQ_Ring_t *Ring = &MqttPubQ->Ring[MqttPubQ->PeekRing];
+   uint32 Head = Ring->Head;
+
+   if (Head != __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE))
+   {
+      __atomic_store_n(&Ring->Head, Head + 1, __ATOMIC_RELEASE);
+   }
+
+} /* End MQTT_PUBQ_Pop() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Push
+**
+*/
+bool MQTT_PUBQ_Push(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                    MQTT_CLIENT_Qos_t Qos, bool Retain, bool Priority,
+                    const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime)
+{
+
+   bool   RetStatus = false;
+   MQTT_PUBQ_Ring_t *Ring = &MqttPubQ->Ring[Priority ? MQTT_PUBQ_RING_PRIORITY : MQTT_PUBQ_RING_ROUTINE];
+   uint32 Tail = Ring->Tail;
+   uint32 Count;
+
+   if (RingCount(Ring) <= Ring->Mask)
+   {
+
+      if (MQTT_PUBQ_BuildEntry(&Ring->Entry[Tail & Ring->Mask], PluginId, Topic, Payload, PayloadLen,
+                               Qos, Retain, SbTime, XlateTime))
+      {
+
+         __atomic_store_n(&Ring->Tail, Tail + 1, __ATOMIC_RELEASE);
+
+         Count = MQTT_PUBQ_Count();
+         if (Count > MqttPubQ->HighWater)
+         {
+            MqttPubQ->HighWater = Count;
+         }
+         RetStatus = true;
+
+      }
+   }
+   else
+   {
+      MqttPubQ->OverflowCnt++;
+   }
+
+   if (!RetStatus)
+   {
+      MQTT_TOPIC_STATS_CountDrop(PluginId);
+   }
+
+   return RetStatus;
+
+} /* End MQTT_PUBQ_Push() */
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_PUBQ_ResetStatus(void)
+{
+
+   MqttPubQ->HighWater   = MQTT_PUBQ_Count();
+   MqttPubQ->OverflowCnt = 0;
+
+} /* End MQTT_PUBQ_ResetStatus() */
+
+
+/******************************************************************************
+** Function: RingCount
+**
+*/
+static uint32 RingCount(const MQTT_PUBQ_Ring_t *Ring)
+{
+
+   return (__atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE));
+
+} /* End RingCount() */
@@ -0,0 +1,268 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage the queue of translated MQTT messages waiting to be published
+**
+** Notes:
+**   1. The queue is a bounded single-producer/single-consumer ring. The
+**      main task that drains the SB topic pipe is the only producer and the
+**      network owner child task is the only consumer. No locks are used, each
+**      side only writes its own index.
+**   2. Entries are copied into the ring because the topic plugin JSON
+**      buffers are reused on the next translation. The payload is copied
+**      directly into a PUBLISH packet image so the network owner writes
+**      the entry to the socket without serializing or copying it again.
+**   3. Priority topics are pushed to their own ring. The consumer always
+**      takes the oldest priority entry first so they aren't delayed behind
+**      a burst of routine messages. Messages are only in order within a
+**      ring.
+**
+*/
+#ifndef _mqtt_pubq_
+#define _mqtt_pubq_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+#include "jmsg_topic_tbl.h"
+#include "mqtt_client.h"
+#include "mqtt_latency.h"
+#include "mqtt_topic_stats.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_PUBQ_PUSH_ERR_EID  (MQTT_PUBQ_BASE_EID + 0)
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_PUBQ_RING_PRIORITY = 0,
+   MQTT_PUBQ_RING_ROUTINE  = 1,
+   MQTT_PUBQ_RING_CNT      = 2
+
+} MQTT_PUBQ_Ring_Enum_t;
+
+
+typedef struct
+{
+
+   int32   PluginId;
+   MQTT_CLIENT_Qos_t   Qos;
+   bool    Retain;
+   CFE_TIME_SysTime_t  SbTime;      /* SB message time, zero if the message doesn't have one */
+   CFE_TIME_SysTime_t  XlateTime;   /* Time the JSON translation completed */
+   uint32  PayloadLen;
+   uint32  PayloadIndex;    /* Payload's index in Packet[], it isn't NUL terminated */
+   uint32  PacketIndex;     /* Index of the packet's first byte in Packet[] */
+   uint32  PacketLen;
+   char    Topic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+   uint8   Packet[MQTT_PUBQ_PACKET_MAX_LEN];
+
+} MQTT_PUBQ_Entry_t;
+
+
+typedef struct
+{
+
+   /*
+   ** Head is only written by the consumer and Tail is only written by the
+   ** producer. Both are free running and masked with Mask when indexing
+   ** Entry[].
+   */
+
+   volatile uint32  Head;
+   volatile uint32  Tail;
+
+   /*
+   ** Tail when the producer last found the SB topic pipe empty. Only
+   ** written by the producer.
+   */
+
+   volatile uint32  DrainMark;
+
+   uint32  Mask;
+   MQTT_PUBQ_Entry_t *Entry;
+
+} MQTT_PUBQ_Ring_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   MQTT_PUBQ_Ring_t  Ring[MQTT_PUBQ_RING_CNT];
+
+   /*
+   ** Ring of the entry returned by MQTT_PUBQ_Peek(). Only written by the
+   ** consumer.
+   */
+
+   MQTT_PUBQ_Ring_Enum_t  PeekRing;
+
+   /*
+   ** Status maintained by the producer
+   */
+
+   uint32  HighWater;
+   uint32  OverflowCnt;
+
+   MQTT_PUBQ_Entry_t PriorityEntry[MQTT_PUBQ_PRIORITY_DEPTH];
+   MQTT_PUBQ_Entry_t RoutineEntry[MQTT_PUBQ_DEPTH];
+
+} MQTT_PUBQ_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_PUBQ instance.
+**
+*/
+void MQTT_PUBQ_Constructor(MQTT_PUBQ_Class_t *MqttPubQPtr);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_BuildEntry
+**
+** Build a PUBLISH packet image for a topic and payload in Entry.
+**
+** Notes:
+**   1. The packet image is QoS0 with the retain flag set from Retain. See
+**      MQTT_PUBQ_Push().
+**   2. Returns false and sends an event if the topic or payload is too
+**      long. Used by MQTT_PUBQ_Push() and by MQTT_SHARD for its rings.
+**
+*/
+bool MQTT_PUBQ_BuildEntry(MQTT_PUBQ_Entry_t *Entry, int32 PluginId, const char *Topic,
+                          const char *Payload, uint32 PayloadLen, MQTT_CLIENT_Qos_t Qos, bool Retain,
+                          const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Count
+**
+** Return the number of entries currently in both rings
+**
+*/
+uint32 MQTT_PUBQ_Count(void);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Drained
+**
+** Return true if both rings are empty and the producer found the SB topic
+** pipe empty after its last push.
+**
+** Notes:
+**   1. Consumer only. Used to flush coalesced packets at the end of a burst.
+**
+*/
+bool MQTT_PUBQ_Drained(void);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_MarkDrained
+**
+** Record that the SB topic pipe is empty.
+**
+** Notes:
+**   1. Producer only.
+**
+*/
+void MQTT_PUBQ_MarkDrained(void);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Peek
+**
+** Return a pointer to the oldest priority entry, or the oldest routine entry
+** if there aren't any, or NULL if the queue is empty.
+**
+** Notes:
+**   1. Consumer only. The entry remains valid until MQTT_PUBQ_Pop() is called.
+**
+*/
+const MQTT_PUBQ_Entry_t *MQTT_PUBQ_Peek(void);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Pop
+**
+** Release the entry returned by MQTT_PUBQ_Peek()
+**
+** Notes:
+**   1. Consumer only.
+**
+*/
+void MQTT_PUBQ_Pop(void);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_Push
+**
+** Build a PUBLISH packet image for a topic and payload in the queue.
+**
+** Notes:
+**   1. Producer only.
+**   2. The packet image is QoS0 with the retain flag set from Retain. Qos
+**      is saved in the entry so the consumer can publish QoS1 and QoS2
+**      messages with a packet ID.
+**   3. Priority messages are pushed to the priority ring.
+**   4. Returns false if the ring is full or the message is too long. A full
+**      ring drops the newest message and increments OverflowCnt. Rejected
+**      messages are counted as drops in the plugin's topic statistics.
+**
+*/
+bool MQTT_PUBQ_Push(int32 PluginId, const char *Topic, const char *Payload, uint32 PayloadLen,
+                    MQTT_CLIENT_Qos_t Qos, bool Retain, bool Priority,
+                    const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime);
+
+
+/******************************************************************************
+** Function: MQTT_PUBQ_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_PUBQ_ResetStatus(void);
+
+
+#endif /* _mqtt_pubq_ */
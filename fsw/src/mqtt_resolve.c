@@ -0,0 +1,494 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Resolve and cache MQTT broker addresses
+**
+** Notes:
+**   1. Lookups use glibc's getaddrinfo_a() so they don't block the
+**      network owner.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* getaddrinfo_a() */
+#endif
+
+#include <netdb.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "mqtt_resolve.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+/* Longest MQTT_BROKER_ADDR_LIST entry, an IPv6 address */
+#define ADDR_STR_LEN  46
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static MQTT_RESOLVE_Entry_t *CacheEntry(const char *Host, bool Add);
+static uint16 CopyAddr(const MQTT_RESOLVE_Entry_t *Entry, uint32 Port, MQTT_RESOLVE_Addr_t *Addr);
+static uint64 MonotonicNs(void);
+static MQTT_RESOLVE_LookupStatus_t PollLookup(void);
+static void   StoreAddr(MQTT_RESOLVE_Entry_t *Entry, const char *Host, const struct addrinfo *AddrList);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_RESOLVE_Class_t *MqttResolve = NULL;
+
+/*
+** Lookup request. Kept out of the class structure because the glibc
+** asynchronous lookup types are only declared with _GNU_SOURCE.
+*/
+
+static struct gaicb    LookupReq;
+static struct addrinfo LookupHints;
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Constructor
+**
+** Notes:
+**   1. An empty string or "UNDEF" MQTT_BROKER_ADDR_LIST defines no
+**      addresses.
+**
+*/
+void MQTT_RESOLVE_Constructor(MQTT_RESOLVE_Class_t *MqttResolvePtr,
+                              const INITBL_Class_t *IniTbl)
+{
+
+   const char *CfgStr;
+   char   AddrStr[ADDR_STR_LEN];
+   uint32 EntryLen;
+   struct addrinfo  Hints;
+   struct addrinfo *AddrList;
+   MQTT_RESOLVE_Entry_t *Static;
+
+   MqttResolve = MqttResolvePtr;
+
+   CFE_PSP_MemSet((void*)MqttResolve, 0, sizeof(MQTT_RESOLVE_Class_t));
+
+   MqttResolve->CacheSec = INITBL_GetIntConfig(IniTbl, CFG_MQTT_DNS_CACHE_SEC);
+
+   CfgStr = INITBL_GetStrConfig(IniTbl, CFG_MQTT_BROKER_ADDR_LIST);
+   if (strcmp(CfgStr, "UNDEF") == 0)
+   {
+      return;
+   }
+
+   Static = &MqttResolve->Static;
+   strncpy(Static->Host, INITBL_GetStrConfig(IniTbl, CFG_MQTT_BROKER_ADDRESS), MQTT_RESOLVE_HOST_LEN - 1);
+
+   memset(&Hints, 0, sizeof(Hints));
+   Hints.ai_family   = AF_UNSPEC;
+   Hints.ai_socktype = SOCK_STREAM;
+   Hints.ai_flags    = AI_NUMERICHOST;
+
+   while (*CfgStr != '\0')
+   {
+      EntryLen = strcspn(CfgStr, ",");
+      if (EntryLen > 0)
+      {
+         memset(AddrStr, 0, sizeof(AddrStr));
+         strncpy(AddrStr, CfgStr, (EntryLen < ADDR_STR_LEN) ? EntryLen : (ADDR_STR_LEN - 1));
+         if (Static->AddrCnt >= MQTT_RESOLVE_ADDR_MAX)
+         {
+            CFE_EVS_SendEvent(MQTT_RESOLVE_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                              "MQTT_BROKER_ADDR_LIST exceeds %d addresses, ignoring %s",
+                              MQTT_RESOLVE_ADDR_MAX, AddrStr);
+         }
+         else if (EntryLen < ADDR_STR_LEN && getaddrinfo(AddrStr, NULL, &Hints, &AddrList) == 0)
+         {
+            memcpy(&Static->Addr[Static->AddrCnt].Addr, AddrList->ai_addr, AddrList->ai_addrlen);
+            Static->Addr[Static->AddrCnt].AddrLen = AddrList->ai_addrlen;
+            Static->AddrCnt++;
+            freeaddrinfo(AddrList);
+         }
+         else
+         {
+            CFE_EVS_SendEvent(MQTT_RESOLVE_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                              "Invalid MQTT_BROKER_ADDR_LIST entry %s, it must be a numeric address",
+                              AddrStr);
+         }
+      }
+      CfgStr += EntryLen;
+      if (*CfgStr == ',')
+      {
+         CfgStr++;
+      }
+   }
+
+   if (Static->AddrCnt > 0)
+   {
+      memcpy(&MqttResolve->Cache[0], Static, sizeof(MQTT_RESOLVE_Entry_t));
+      MqttResolve->Cache[0].ExpireTime = MonotonicNs() + (uint64)MqttResolve->CacheSec * 1000000000;
+   }
+
+} /* End MQTT_RESOLVE_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_GetAddr
+**
+** Notes:
+**   1. A completed lookup is cached first so an abandoned lookup's result
+**      can be used.
+**
+*/
+uint16 MQTT_RESOLVE_GetAddr(const char *Host, uint32 Port, MQTT_RESOLVE_Addr_t *Addr, bool AllowExpired)
+{
+
+   uint16 AddrCnt = 0;
+   struct addrinfo  Hints;
+   struct addrinfo *AddrList;
+   MQTT_RESOLVE_Entry_t  Numeric;
+   MQTT_RESOLVE_Entry_t *Cached;
+
+   memset(&Hints, 0, sizeof(Hints));
+   Hints.ai_family   = AF_UNSPEC;
+   Hints.ai_socktype = SOCK_STREAM;
+   Hints.ai_flags    = AI_NUMERICHOST;
+
+   /* getaddrinfo() with AI_NUMERICHOST never blocks */
+   if (getaddrinfo(Host, NULL, &Hints, &AddrList) == 0)
+   {
+      StoreAddr(&Numeric, Host, AddrList);
+      freeaddrinfo(AddrList);
+      return CopyAddr(&Numeric, Port, Addr);
+   }
+
+   if (MqttResolve->LookupActive)
+   {
+      PollLookup();
+   }
+
+   Cached = CacheEntry(Host, false);
+   if (Cached != NULL && (AllowExpired || MonotonicNs() < Cached->ExpireTime))
+   {
+      AddrCnt = CopyAddr(Cached, Port, Addr);
+   }
+   else if (AllowExpired && strcmp(MqttResolve->Static.Host, Host) == 0)
+   {
+      AddrCnt = CopyAddr(&MqttResolve->Static, Port, Addr);
+   }
+
+   if (AddrCnt > 0)
+   {
+      if (AllowExpired)
+      {
+         MqttResolve->FallbackCnt++;
+      }
+      else
+      {
+         MqttResolve->CacheHitCnt++;
+      }
+   }
+
+   return AddrCnt;
+
+} /* End MQTT_RESOLVE_GetAddr() */
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Invalidate
+**
+*/
+void MQTT_RESOLVE_Invalidate(const char *Host)
+{
+
+   MQTT_RESOLVE_Entry_t *Cached = CacheEntry(Host, false);
+
+   if (Cached != NULL)
+   {
+      Cached->ExpireTime = 0;
+   }
+
+} /* End MQTT_RESOLVE_Invalidate() */
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Lookup
+**
+*/
+bool MQTT_RESOLVE_Lookup(const char *Host)
+{
+
+   bool RetStatus = false;
+   int  RetCode;
+   struct gaicb *LookupList[1];
+
+   if (MqttResolve->LookupActive)
+   {
+      PollLookup();
+   }
+
+   if (MqttResolve->LookupActive)
+   {
+      RetStatus = (strcmp(MqttResolve->LookupHost, Host) == 0);
+   }
+   else
+   {
+      strncpy(MqttResolve->LookupHost, Host, MQTT_RESOLVE_HOST_LEN - 1);
+      MqttResolve->LookupHost[MQTT_RESOLVE_HOST_LEN - 1] = '\0';
+
+      memset(&LookupHints, 0, sizeof(LookupHints));
+      LookupHints.ai_family   = AF_UNSPEC;
+      LookupHints.ai_socktype = SOCK_STREAM;
+      LookupHints.ai_flags    = AI_ADDRCONFIG;
+      memset(&LookupReq, 0, sizeof(LookupReq));
+      LookupReq.ar_name    = MqttResolve->LookupHost;
+      LookupReq.ar_request = &LookupHints;
+      LookupList[0] = &LookupReq;
+
+      RetCode = getaddrinfo_a(GAI_NOWAIT, LookupList, 1, NULL);
+      if (RetCode == 0)
+      {
+         MqttResolve->LookupActive = true;
+         MqttResolve->LookupCnt++;
+         RetStatus = true;
+      }
+      else
+      {
+         MqttResolve->LookupErrCnt++;
+         CFE_EVS_SendEvent(MQTT_RESOLVE_LOOKUP_ERR_EID, CFE_EVS_EventType_ERROR,
+                           "Error starting address lookup for MQTT broker %s: %s",
+                           Host, gai_strerror(RetCode));
+      }
+   }
+
+   return RetStatus;
+
+} /* End MQTT_RESOLVE_Lookup() */
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_LookupStatus
+**
+*/
+MQTT_RESOLVE_LookupStatus_t MQTT_RESOLVE_LookupStatus(uint32 Port, MQTT_RESOLVE_Addr_t *Addr,
+                                                      uint16 *AddrCnt)
+{
+
+   MQTT_RESOLVE_LookupStatus_t Status = PollLookup();
+
+   *AddrCnt = 0;
+   if (Status == MQTT_RESOLVE_LOOKUP_DONE)
+   {
+      *AddrCnt = CopyAddr(CacheEntry(MqttResolve->LookupHost, false), Port, Addr);
+   }
+
+   return Status;
+
+} /* End MQTT_RESOLVE_LookupStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_ResetStatus
+**
+*/
+void MQTT_RESOLVE_ResetStatus(void)
+{
+
+   MqttResolve->CacheHitCnt  = 0;
+   MqttResolve->LookupCnt    = 0;
+   MqttResolve->LookupErrCnt = 0;
+   MqttResolve->FallbackCnt  = 0;
+
+} /* End MQTT_RESOLVE_ResetStatus() */
+
+
+/******************************************************************************
+** Function: CacheEntry
+**
+** Return a host's cache entry or NULL if it isn't cached. When Add is true
+** a missing host is given an empty entry or the entry that expires first.
+**
+*/
+static MQTT_RESOLVE_Entry_t *CacheEntry(const char *Host, bool Add)
+{
+
+   MQTT_RESOLVE_Entry_t *Entry = NULL;
+   MQTT_RESOLVE_Entry_t *Oldest = &MqttResolve->Cache[0];
+   uint16 i;
+
+   for (i = 0; i < MQTT_BROKER_MAX && Entry == NULL; i++)
+   {
+      if (MqttResolve->Cache[i].AddrCnt > 0)
+      {
+         if (strcmp(MqttResolve->Cache[i].Host, Host) == 0)
+         {
+            Entry = &MqttResolve->Cache[i];
+         }
+         else if (Oldest->AddrCnt > 0 && MqttResolve->Cache[i].ExpireTime < Oldest->ExpireTime)
+         {
+            Oldest = &MqttResolve->Cache[i];
+         }
+      }
+      else if (Oldest->AddrCnt > 0)
+      {
+         Oldest = &MqttResolve->Cache[i];
+      }
+   }
+
+   if (Entry == NULL && Add)
+   {
+      Entry = Oldest;
+   }
+
+   return Entry;
+
+} /* End CacheEntry() */
+
+
+/******************************************************************************
+** Function: CopyAddr
+**
+** Copy an entry's addresses with their port set and return the number
+** copied.
+**
+*/
+static uint16 CopyAddr(const MQTT_RESOLVE_Entry_t *Entry, uint32 Port, MQTT_RESOLVE_Addr_t *Addr)
+{
+
+   uint16 i;
+
+   for (i = 0; i < Entry->AddrCnt; i++)
+   {
+      Addr[i] = Entry->Addr[i];
+      if (Addr[i].Addr.ss_family == AF_INET6)
+      {
+         ((struct sockaddr_in6 *)&Addr[i].Addr)->sin6_port = htons((uint16)Port);
+      }
+      else
+      {
+         ((struct sockaddr_in *)&Addr[i].Addr)->sin_port = htons((uint16)Port);
+      }
+   }
+
+   return Entry->AddrCnt;
+
+} /* End CopyAddr() */
+
+
+/******************************************************************************
+** Function: MonotonicNs
+**
+*/
+static uint64 MonotonicNs(void)
+{
+
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return ((uint64)Now.tv_sec * 1000000000ULL + (uint64)Now.tv_nsec);
+
+} /* End MonotonicNs() */
+
+
+/******************************************************************************
+** Function: PollLookup
+**
+** Check the active lookup and cache its addresses when it succeeds
+**
+*/
+static MQTT_RESOLVE_LookupStatus_t PollLookup(void)
+{
+
+   MQTT_RESOLVE_LookupStatus_t Status = MQTT_RESOLVE_LOOKUP_FAILED;
+   MQTT_RESOLVE_Entry_t *Cached;
+   int RetCode;
+
+   if (MqttResolve->LookupActive)
+   {
+      RetCode = gai_error(&LookupReq);
+      if (RetCode == EAI_INPROGRESS)
+      {
+         Status = MQTT_RESOLVE_LOOKUP_PENDING;
+      }
+      else
+      {
+         MqttResolve->LookupActive = false;
+         if (RetCode == 0)
+         {
+            Cached = CacheEntry(MqttResolve->LookupHost, true);
+            StoreAddr(Cached, MqttResolve->LookupHost, LookupReq.ar_result);
+            Cached->ExpireTime = MonotonicNs() + (uint64)MqttResolve->CacheSec * 1000000000;
+            Status = (Cached->AddrCnt > 0) ? MQTT_RESOLVE_LOOKUP_DONE : MQTT_RESOLVE_LOOKUP_FAILED;
+            CFE_EVS_SendEvent(MQTT_RESOLVE_LOOKUP_EID, CFE_EVS_EventType_INFORMATION,
+                              "Resolved MQTT broker %s to %d addresses, cached for %d seconds",
+                              MqttResolve->LookupHost, Cached->AddrCnt, MqttResolve->CacheSec);
+         }
+         else
+         {
+            MqttResolve->LookupErrCnt++;
+            CFE_EVS_SendEvent(MQTT_RESOLVE_LOOKUP_ERR_EID, CFE_EVS_EventType_ERROR,
+                              "Error resolving MQTT broker address %s: %s",
+                              MqttResolve->LookupHost, gai_strerror(RetCode));
+         }
+         if (LookupReq.ar_result != NULL)
+         {
+            freeaddrinfo(LookupReq.ar_result);
+            LookupReq.ar_result = NULL;
+         }
+      }
+   }
+
+   return Status;
+
+} /* End PollLookup() */
+
+
+/******************************************************************************
+** Function: StoreAddr
+**
+** Replace an entry's addresses with up to MQTT_RESOLVE_ADDR_MAX addresses
+** from a getaddrinfo() result.
+**
+*/
+static void StoreAddr(MQTT_RESOLVE_Entry_t *Entry, const char *Host, const struct addrinfo *AddrList)
+{
+
+   const struct addrinfo *Addr;
+
+   strncpy(Entry->Host, Host, MQTT_RESOLVE_HOST_LEN - 1);
+   Entry->Host[MQTT_RESOLVE_HOST_LEN - 1] = '\0';
+   Entry->AddrCnt = 0;
+
+   for (Addr = AddrList; Addr != NULL && Entry->AddrCnt < MQTT_RESOLVE_ADDR_MAX; Addr = Addr->ai_next)
+   {
+      if (Addr->ai_addrlen <= sizeof(struct sockaddr_storage))
+      {
+         memcpy(&Entry->Addr[Entry->AddrCnt].Addr, Addr->ai_addr, Addr->ai_addrlen);
+         Entry->Addr[Entry->AddrCnt].AddrLen = Addr->ai_addrlen;
+         Entry->AddrCnt++;
+      }
+   }
+
+} /* End StoreAddr() */
@@ -0,0 +1,220 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Resolve and cache MQTT broker addresses
+**
+** Notes:
+**   1. Addresses from a successful lookup are cached for MQTT_DNS_CACHE_SEC
+**      so a reconnect within that time only costs a TCP handshake. The
+**      resolver doesn't report record TTLs so the ini value is used for
+**      every lookup.
+**   2. Expired addresses are kept and returned when a lookup fails or times
+**      out, DNS is often unavailable during the outages that cause a
+**      reconnect.
+**   3. MQTT_BROKER_ADDR_LIST holds pre-resolved numeric addresses for
+**      MQTT_BROKER_ADDRESS. They're loaded into the cache by the
+**      constructor so the first connect doesn't need a lookup, and they're
+**      the fallback when a lookup fails and the cache holds another host.
+**   4. One lookup runs at a time. A lookup that's abandoned because its
+**      connect timed out keeps running and its result is cached when it
+**      completes, the request can't be reused until then.
+**   5. The cache holds a host for each broker in the failover list. When
+**      it's full a lookup replaces the host that expires first.
+**   6. Only the network owner task calls these functions.
+**
+*/
+#ifndef _mqtt_resolve_
+#define _mqtt_resolve_
+
+/*
+** Includes
+*/
+
+#include <sys/socket.h>
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_RESOLVE_CONSTRUCTOR_EID  (MQTT_RESOLVE_BASE_EID + 0)
+#define MQTT_RESOLVE_LOOKUP_EID       (MQTT_RESOLVE_BASE_EID + 1)
+#define MQTT_RESOLVE_LOOKUP_ERR_EID   (MQTT_RESOLVE_BASE_EID + 2)
+
+#define MQTT_RESOLVE_HOST_LEN  64
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_RESOLVE_LOOKUP_PENDING = 0,
+   MQTT_RESOLVE_LOOKUP_DONE    = 1,
+   MQTT_RESOLVE_LOOKUP_FAILED  = 2
+
+} MQTT_RESOLVE_LookupStatus_t;
+
+
+typedef struct
+{
+
+   struct sockaddr_storage  Addr;
+   socklen_t  AddrLen;
+
+} MQTT_RESOLVE_Addr_t;
+
+
+/*
+** A host's addresses. Ports aren't stored, they're set when addresses are
+** returned. ExpireTime is a CLOCK_MONOTONIC ns time.
+*/
+
+typedef struct
+{
+
+   char    Host[MQTT_RESOLVE_HOST_LEN];
+   uint64  ExpireTime;
+   uint16  AddrCnt;
+   MQTT_RESOLVE_Addr_t  Addr[MQTT_RESOLVE_ADDR_MAX];
+
+} MQTT_RESOLVE_Entry_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint32  CacheSec;
+
+   MQTT_RESOLVE_Entry_t  Cache[MQTT_BROKER_MAX];   /* A host for each failover broker */
+   MQTT_RESOLVE_Entry_t  Static;    /* MQTT_BROKER_ADDR_LIST */
+
+   bool    LookupActive;
+   char    LookupHost[MQTT_RESOLVE_HOST_LEN];
+
+   /*
+   ** Status
+   */
+
+   uint32  CacheHitCnt;     /* Connects that used cached addresses without a lookup */
+   uint32  LookupCnt;
+   uint32  LookupErrCnt;
+   uint32  FallbackCnt;     /* Connects that used expired or listed addresses after a failed lookup */
+
+} MQTT_RESOLVE_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_RESOLVE instance.
+**   2. Invalid MQTT_BROKER_ADDR_LIST entries are reported in an event and
+**      ignored.
+**
+*/
+void MQTT_RESOLVE_Constructor(MQTT_RESOLVE_Class_t *MqttResolvePtr,
+                              const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_GetAddr
+**
+** Copy a host's addresses with Port set to Addr and return the number
+** copied. Addr must hold MQTT_RESOLVE_ADDR_MAX addresses.
+**
+** Notes:
+**   1. A numeric host is converted without a lookup.
+**   2. Cached addresses are only returned before they expire unless
+**      AllowExpired is true. With AllowExpired the MQTT_BROKER_ADDR_LIST
+**      addresses are returned when the cache doesn't hold the host.
+**   3. Zero is returned when the host needs a lookup.
+**
+*/
+uint16 MQTT_RESOLVE_GetAddr(const char *Host, uint32 Port, MQTT_RESOLVE_Addr_t *Addr, bool AllowExpired);
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Invalidate
+**
+** Expire a host's cached addresses so the next connect looks it up again
+**
+** Notes:
+**   1. Called when a connect to cached addresses fails. The addresses are
+**      kept as a fallback.
+**
+*/
+void MQTT_RESOLVE_Invalidate(const char *Host);
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_Lookup
+**
+** Start an asynchronous lookup of Host
+**
+** Notes:
+**   1. Returns false if the lookup can't be started, including while an
+**      abandoned lookup of another host is still running.
+**   2. A lookup of the same host that's still running is continued.
+**
+*/
+bool MQTT_RESOLVE_Lookup(const char *Host);
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_LookupStatus
+**
+** Return the status of the lookup started by MQTT_RESOLVE_Lookup()
+**
+** Notes:
+**   1. When the lookup is done the host's addresses are cached and copied
+**      to Addr with Port set like MQTT_RESOLVE_GetAddr().
+**   2. Failures are reported in an event.
+**
+*/
+MQTT_RESOLVE_LookupStatus_t MQTT_RESOLVE_LookupStatus(uint32 Port, MQTT_RESOLVE_Addr_t *Addr,
+                                                      uint16 *AddrCnt);
+
+
+/******************************************************************************
+** Function: MQTT_RESOLVE_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_RESOLVE_ResetStatus(void);
+
+
+#endif /* _mqtt_resolve_ */
@@ -0,0 +1,864 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Publish QoS0 messages over additional broker connections
+**
+** Notes:
+**   1. The ring orderings match MQTT_PUBQ. The producer pushes whether or
+**      not the shard is connected and the ring is held across reconnects,
+**      so Connected is only used by the shard's own task.
+**   2. A shard connects with blocking CONNECT/CONNACK reads and writes
+**      bounded by MQTT_CLIENT_TIMEOUT_MS, only the shard's own messages wait
+**      for them.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "mqtt_shard.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#if (MQTT_SHARD_DEPTH & (MQTT_SHARD_DEPTH - 1)) != 0
+   #error MQTT_SHARD_DEPTH must be a power of 2
+#endif
+
+#if MQTT_SHARD_MAX < 2
+   #error MQTT_SHARD_MAX must allow at least one shard connection
+#endif
+
+#define SHARD_MASK    (MQTT_SHARD_DEPTH - 1)
+#define KEEPALIVE_NS  ((uint64)MQTT_CLIENT_KEEPALIVE_SEC * 1000000000ULL)
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void Connect(MQTT_SHARD_Conn_t *Conn, uint16 Index);
+static void Disconnect(MQTT_SHARD_Conn_t *Conn);
+static bool KeepAlive(MQTT_SHARD_Conn_t *Conn);
+static void LostConnection(MQTT_SHARD_Conn_t *Conn, uint16 Index, const char *Reason);
+static uint64 MonotonicNs(void);
+static int  PollTimeout(const MQTT_SHARD_Conn_t *Conn);
+static bool PublishQueuedMsgs(MQTT_SHARD_Conn_t *Conn);
+static bool ReadInput(MQTT_SHARD_Conn_t *Conn);
+static void ScheduleRetry(MQTT_SHARD_Conn_t *Conn);
+static void WakeShard(MQTT_SHARD_Conn_t *Conn);
+static bool WritePacket(MQTT_SHARD_Conn_t *Conn, int Len);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_SHARD_Class_t *MqttShard = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Constructor
+**
+** Notes:
+**   1. The reconnect backoff range is validated by MQTT_MGR, only values
+**      that would stall the shards are corrected here.
+**
+*/
+void MQTT_SHARD_Constructor(MQTT_SHARD_Class_t *MqttShardPtr, const INITBL_Class_t *IniTbl)
+{
+
+   MQTT_SHARD_Conn_t *Conn;
+   int32  SysStatus;
+   uint16 i;
+
+   MqttShard = MqttShardPtr;
+
+   CFE_PSP_MemSet((void*)MqttShard, 0, sizeof(MQTT_SHARD_Class_t));
+
+   MqttShard->Cnt = INITBL_GetIntConfig(IniTbl, CFG_MQTT_SHARD_CNT);
+   if (MqttShard->Cnt < 1 || MqttShard->Cnt > MQTT_SHARD_MAX)
+   {
+      CFE_EVS_SendEvent(MQTT_SHARD_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Invalid MQTT shard count %d, must be 1 to %d. Using 1",
+                        MqttShard->Cnt, MQTT_SHARD_MAX);
+      MqttShard->Cnt = 1;
+   }
+
+   MqttShard->YieldTime  = INITBL_GetIntConfig(IniTbl, CFG_MQTT_CLIENT_YIELD_TIME);
+   MqttShard->RetryMinMs = INITBL_GetIntConfig(IniTbl, CFG_MQTT_RECONNECT_MIN_MS);
+   MqttShard->RetryMaxMs = INITBL_GetIntConfig(IniTbl, CFG_MQTT_RECONNECT_MAX_MS);
+   if (MqttShard->RetryMinMs == 0)
+   {
+      MqttShard->RetryMinMs = 1;
+   }
+   if (MqttShard->RetryMaxMs < MqttShard->RetryMinMs)
+   {
+      MqttShard->RetryMaxMs = MqttShard->RetryMinMs;
+   }
+
+   SysStatus = OS_MutSemCreate(&MqttShard->MutexId, "MQTT_SHARD_MUTEX", 0);
+   if (SysStatus != OS_SUCCESS)
+   {
+      CFE_EVS_SendEvent(MQTT_SHARD_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Error creating MQTT shard broker mutex, return status %d", SysStatus);
+   }
+
+   for (i = 0; i < (MqttShard->Cnt - 1); i++)
+   {
+      Conn = &MqttShard->Conn[i];
+      NetworkInit(&Conn->Network);
+      Conn->RetryMs = MqttShard->RetryMinMs;
+      snprintf(Conn->TaskName, OS_MAX_API_NAME, "%s_%d",
+               INITBL_GetStrConfig(IniTbl, CFG_MQTT_CHILD_NAME), i + 1);
+      Conn->WakeFd = eventfd(0, EFD_NONBLOCK);
+      if (Conn->WakeFd < 0)
+      {
+         CFE_EVS_SendEvent(MQTT_SHARD_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Error creating MQTT shard %d wake eventfd, errno %d", i + 1, errno);
+      }
+   }
+
+} /* End MQTT_SHARD_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_ChildTaskCallback
+**
+** Notes:
+**   1. The wait never exceeds YieldTime. It ends immediately while the
+**      ring holds messages, at the keepalive deadline while connected and
+**      at the next connect attempt while disconnected.
+**   2. A shard connected to a previous broker disconnects and reconnects
+**      to the current one without a retry delay.
+**   3. The ring is held while the shard is disconnected and published
+**      when it reconnects.
+**
+*/
+bool MQTT_SHARD_ChildTaskCallback(CHILDMGR_Class_t *ChildMgr)
+{
+
+   MQTT_SHARD_Conn_t *Conn = NULL;
+   struct pollfd PollFd[2];
+   int    PollStatus;
+   uint64 WakeCnt;
+   uint16 Index = 0;
+   uint16 i;
+
+   for (i = 0; i < (MqttShard->Cnt - 1) && Conn == NULL; i++)
+   {
+      if (ChildMgr == &MqttShard->Conn[i].ChildMgr)
+      {
+         Conn  = &MqttShard->Conn[i];
+         Index = i + 1;
+      }
+   }
+   if (Conn == NULL)
+   {
+      CFE_EVS_SendEvent(MQTT_SHARD_TASK_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "MQTT shard child task callback called without a shard connection");
+      return false;
+   }
+
+   PollFd[0].fd      = Conn->WakeFd;
+   PollFd[0].events  = POLLIN;
+   PollFd[0].revents = 0;
+   PollFd[1].fd      = Conn->Connected ? Conn->Network.my_socket : -1;   /* Negative fds are ignored by poll() */
+   PollFd[1].events  = POLLIN;
+   PollFd[1].revents = 0;
+
+   PollStatus = poll(PollFd, 2, PollTimeout(Conn));
+
+   if (PollStatus < 0)
+   {
+      if (errno != EINTR)
+      {
+         CFE_EVS_SendEvent(MQTT_SHARD_TASK_ERR_EID, CFE_EVS_EventType_ERROR,
+                           "MQTT shard %d poll() error, errno %d", Index, errno);
+         OS_TaskDelay(MqttShard->YieldTime);
+      }
+      return true;
+   }
+
+   if (PollFd[0].revents & POLLIN)
+   {
+      /* Reading resets the eventfd counter, the count itself isn't needed */
+      if (read(Conn->WakeFd, &WakeCnt, sizeof(WakeCnt)) < 0)
+      {
+         WakeCnt = 0;
+      }
+   }
+
+   if (Conn->Connected && Conn->BrokerGen != __atomic_load_n(&MqttShard->BrokerGen, __ATOMIC_ACQUIRE))
+   {
+      Disconnect(Conn);
+   }
+
+   if (Conn->Connected && PollFd[1].revents != 0)
+   {
+      if (!ReadInput(Conn))
+      {
+         LostConnection(Conn, Index, "closed by the broker");
+      }
+   }
+
+   if (Conn->Connected)
+   {
+      if (!PublishQueuedMsgs(Conn))
+      {
+         LostConnection(Conn, Index, "lost writing messages");
+      }
+      else if (!KeepAlive(Conn))
+      {
+         LostConnection(Conn, Index, "keepalive timed out");
+      }
+   }
+
+   if (!Conn->Connected)
+   {
+      if (__atomic_load_n(&MqttShard->BrokerGen, __ATOMIC_ACQUIRE) != 0 && MonotonicNs() >= Conn->RetryTime)
+      {
+         Connect(Conn, Index);
+      }
+   }
+
+   return true;
+
+} /* End MQTT_SHARD_ChildTaskCallback() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Push
+**
+*/
+bool MQTT_SHARD_Push(uint16 Conn, int32 PluginId, const char *Topic, const char *Payload,
+                     uint32 PayloadLen, bool Retain, bool Defer,
+                     const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime)
+{
+
+   bool   RetStatus = false;
+   MQTT_SHARD_Conn_t *Shard = &MqttShard->Conn[Conn-1];
+   uint32 Tail = Shard->Tail;
+   uint32 Count = Tail - __atomic_load_n(&Shard->Head, __ATOMIC_ACQUIRE);
+
+   if (Count < MQTT_SHARD_DEPTH)
+   {
+
+      if (MQTT_PUBQ_BuildEntry(&Shard->Entry[Tail & SHARD_MASK], PluginId, Topic, Payload, PayloadLen,
+                               MQTT_CLIENT_QOS0, Retain, SbTime, XlateTime))
+      {
+
+         __atomic_store_n(&Shard->Tail, Tail + 1, __ATOMIC_RELEASE);
+
+         if (!Defer || (Count + 1) >= (MQTT_SHARD_DEPTH/2))
+         {
+            WakeShard(Shard);
+            Shard->WakePending = false;
+         }
+         else
+         {
+            Shard->WakePending = true;
+         }
+         RetStatus = true;
+
+      }
+   }
+   else
+   {
+      Shard->OverflowCnt++;
+   }
+
+   if (!RetStatus)
+   {
+      MQTT_TOPIC_STATS_CountDrop(PluginId);
+   }
+
+   return RetStatus;
+
+} /* End MQTT_SHARD_Push() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_SHARD_ResetStatus(void)
+{
+
+   MQTT_SHARD_Conn_t *Conn;
+   uint16 i;
+
+   for (i = 0; i < (MqttShard->Cnt - 1); i++)
+   {
+      Conn = &MqttShard->Conn[i];
+      Conn->ConnectCnt  = 0;
+      Conn->PubCnt      = 0;
+      Conn->OverflowCnt = 0;
+   }
+
+} /* End MQTT_SHARD_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Select
+**
+** Notes:
+**   1. The hash is Fibonacci hashing, it spreads consecutive message IDs
+**      across the connections.
+**
+*/
+uint16 MQTT_SHARD_Select(uint16 MsgId, uint8 CfgShard)
+{
+
+   uint16 Conn = CfgShard;
+
+   if (CfgShard == MQTT_TOPIC_CFG_SHARD_HASH)
+   {
+      Conn = (uint16)((((uint32)MsgId * 2654435761u) >> 16) % MqttShard->Cnt);
+   }
+
+   if (Conn >= MqttShard->Cnt)
+   {
+      Conn = 0;
+   }
+
+   return Conn;
+
+} /* End MQTT_SHARD_Select() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_SetBroker
+**
+*/
+void MQTT_SHARD_SetBroker(const char *ClientName, const char *Host, uint32 Port,
+                          const MQTT_RESOLVE_Addr_t *Addr)
+{
+
+   bool   Changed;
+   uint32 BrokerGen;
+   uint16 i;
+
+   if (MqttShard->Cnt < 2)
+   {
+      return;
+   }
+
+   OS_MutSemTake(MqttShard->MutexId);
+
+   Changed = (MqttShard->BrokerGen == 0 || MqttShard->BrokerPort != Port ||
+              strcmp(MqttShard->BrokerHost, Host) != 0 ||
+              strcmp(MqttShard->ClientName, ClientName) != 0 ||
+              MqttShard->BrokerAddr.AddrLen != Addr->AddrLen ||
+              memcmp(&MqttShard->BrokerAddr.Addr, &Addr->Addr, Addr->AddrLen) != 0);
+   if (Changed)
+   {
+      strncpy(MqttShard->BrokerHost, Host, MAX_CLIENT_PARAM_STR_LEN - 1);
+      strncpy(MqttShard->ClientName, ClientName, MAX_CLIENT_PARAM_STR_LEN - 1);
+      MqttShard->BrokerPort = Port;
+      MqttShard->BrokerAddr = *Addr;
+      BrokerGen = MqttShard->BrokerGen + 1;
+      if (BrokerGen == 0)
+      {
+         BrokerGen = 1;
+      }
+      __atomic_store_n(&MqttShard->BrokerGen, BrokerGen, __ATOMIC_RELEASE);
+   }
+
+   OS_MutSemGive(MqttShard->MutexId);
+
+   if (Changed)
+   {
+      for (i = 0; i < (MqttShard->Cnt - 1); i++)
+      {
+         WakeShard(&MqttShard->Conn[i]);
+      }
+   }
+
+} /* End MQTT_SHARD_SetBroker() */
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_WakeDeferred
+**
+*/
+void MQTT_SHARD_WakeDeferred(void)
+{
+
+   uint16 i;
+
+   for (i = 0; i < (MqttShard->Cnt - 1); i++)
+   {
+      if (MqttShard->Conn[i].WakePending)
+      {
+         WakeShard(&MqttShard->Conn[i]);
+         MqttShard->Conn[i].WakePending = false;
+      }
+   }
+
+} /* End MQTT_SHARD_WakeDeferred() */
+
+
+/******************************************************************************
+** Function: Connect
+**
+** Connect a shard to the broker set by MQTT_SHARD_SetBroker()
+**
+** Notes:
+**   1. The TCP connect is non-blocking so it can be bounded by
+**      MQTT_CLIENT_TIMEOUT_MS, the socket is then made blocking with a send
+**      timeout for the CONNECT/CONNACK exchange and publishing.
+**   2. A failed attempt is retried after an exponential backoff with
+**      jitter.
+**
+*/
+static void Connect(MQTT_SHARD_Conn_t *Conn, uint16 Index)
+{
+
+   MQTTPacket_connectData ConnectData = MQTTPacket_connectData_initializer;
+   MQTT_RESOLVE_Addr_t Addr;
+   char   Host[MAX_CLIENT_PARAM_STR_LEN];
+   uint32 Port;
+   bool   Connected = false;
+   int    Sock;
+   int    SockErr = -1;
+   socklen_t SockErrLen = sizeof(SockErr);
+   int    SockFlags;
+   int    Len;
+   struct pollfd  PollFd;
+   struct timeval SendTimeout;
+   unsigned char  SessionPresent;
+   unsigned char  ConnAckRc = 0;
+
+   OS_MutSemTake(MqttShard->MutexId);
+   Conn->BrokerGen = MqttShard->BrokerGen;
+   Addr = MqttShard->BrokerAddr;
+   Port = MqttShard->BrokerPort;
+   strcpy(Host, MqttShard->BrokerHost);
+   /* The base name is shortened to leave room for the "-sN" suffix, N is at most 5 digits */
+   snprintf(Conn->ClientName, MAX_CLIENT_PARAM_STR_LEN, "%.*s-s%u",
+            MAX_CLIENT_PARAM_STR_LEN - 8, MqttShard->ClientName, (unsigned)Index);
+   OS_MutSemGive(MqttShard->MutexId);
+
+   NetworkInit(&Conn->Network);
+   Sock = socket(Addr.Addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+   if (Sock >= 0)
+   {
+      Conn->Network.my_socket = Sock;
+      if (connect(Sock, (const struct sockaddr *)&Addr.Addr, Addr.AddrLen) == 0 || errno == EINPROGRESS)
+      {
+         PollFd.fd      = Sock;
+         PollFd.events  = POLLOUT;
+         PollFd.revents = 0;
+         if (poll(&PollFd, 1, MQTT_CLIENT_TIMEOUT_MS) > 0)
+         {
+            getsockopt(Sock, SOL_SOCKET, SO_ERROR, &SockErr, &SockErrLen);
+         }
+      }
+   }
+
+   if (SockErr == 0)
+   {
+      SockFlags = fcntl(Sock, F_GETFL, 0);
+      SendTimeout.tv_sec  = MQTT_CLIENT_TIMEOUT_MS / 1000;
+      SendTimeout.tv_usec = (MQTT_CLIENT_TIMEOUT_MS % 1000) * 1000;
+      if (SockFlags >= 0 && fcntl(Sock, F_SETFL, SockFlags & ~O_NONBLOCK) == 0 &&
+          setsockopt(Sock, SOL_SOCKET, SO_SNDTIMEO, &SendTimeout, sizeof(SendTimeout)) == 0)
+      {
+         ConnectData.MQTTVersion = MQTT_CLIENT_VERSION_311;
+         ConnectData.clientID.cstring  = Conn->ClientName;
+         ConnectData.keepAliveInterval = MQTT_CLIENT_KEEPALIVE_SEC;
+         ConnectData.cleansession      = 1;
+         Len = MQTTSerialize_connect(Conn->CtrlBuf, MQTT_SHARD_CTRL_BUF_LEN, &ConnectData);
+
+         /* A 3.1.1 CONNACK is always 4 bytes */
+         if (Len > 0 && WritePacket(Conn, Len) &&
+             Conn->Network.mqttread(&Conn->Network, Conn->CtrlBuf, 4, MQTT_CLIENT_TIMEOUT_MS) == 4 &&
+             MQTTDeserialize_connack(&SessionPresent, &ConnAckRc, Conn->CtrlBuf, 4) == 1)
+         {
+            Connected = (ConnAckRc == 0);
+         }
+      }
+   }
+
+   if (Connected)
+   {
+      CFE_EVS_SendEvent(MQTT_SHARD_CONNECT_EID, CFE_EVS_EventType_INFORMATION,
+                        "MQTT shard %d connected to broker %s:%d as client %s",
+                        Index, Host, Port, Conn->ClientName);
+      Conn->ConnectCnt++;
+      Conn->PingTime = 0;
+      Conn->RetryMs  = MqttShard->RetryMinMs;
+      __atomic_store_n(&Conn->Connected, true, __ATOMIC_RELEASE);
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_SHARD_CONNECT_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "MQTT shard %d connect to broker %s:%d failed, socket error %d, CONNACK code %d",
+                        Index, Host, Port, (SockErr == -1 ? errno : SockErr), ConnAckRc);
+      NetworkDisconnect(&Conn->Network);
+      ScheduleRetry(Conn);
+   }
+
+} /* End Connect() */
+
+
+/******************************************************************************
+** Function: Disconnect
+**
+** Disconnect from a previous broker so the shard connects to the current one
+**
+*/
+static void Disconnect(MQTT_SHARD_Conn_t *Conn)
+{
+
+   int Len;
+
+   __atomic_store_n(&Conn->Connected, false, __ATOMIC_RELEASE);
+
+   Len = MQTTSerialize_disconnect(Conn->CtrlBuf, MQTT_SHARD_CTRL_BUF_LEN);
+   if (Len > 0)
+   {
+      WritePacket(Conn, Len);
+   }
+   NetworkDisconnect(&Conn->Network);
+
+   Conn->RetryTime = 0;
+   Conn->RetryMs   = MqttShard->RetryMinMs;
+
+} /* End Disconnect() */
+
+
+/******************************************************************************
+** Function: KeepAlive
+**
+** Send a PINGREQ when the connection has been idle for the keepalive
+** interval. Returns false if the broker didn't answer the last one in time.
+**
+*/
+static bool KeepAlive(MQTT_SHARD_Conn_t *Conn)
+{
+
+   bool   RetStatus = true;
+   uint64 Now = MonotonicNs();
+   int    Len;
+
+   if (Conn->PingTime != 0)
+   {
+      RetStatus = ((Now - Conn->PingTime) < KEEPALIVE_NS);
+   }
+   else if ((Now - Conn->SendTime) >= KEEPALIVE_NS)
+   {
+      Len = MQTTSerialize_pingreq(Conn->CtrlBuf, MQTT_SHARD_CTRL_BUF_LEN);
+      RetStatus = (Len > 0 && WritePacket(Conn, Len));
+      Conn->PingTime = Now;
+   }
+
+   return RetStatus;
+
+} /* End KeepAlive() */
+
+
+/******************************************************************************
+** Function: LostConnection
+**
+** Close a shard's connection after an I/O error and schedule a reconnect
+**
+*/
+static void LostConnection(MQTT_SHARD_Conn_t *Conn, uint16 Index, const char *Reason)
+{
+
+   __atomic_store_n(&Conn->Connected, false, __ATOMIC_RELEASE);
+   NetworkDisconnect(&Conn->Network);
+
+   CFE_EVS_SendEvent(MQTT_SHARD_PUBLISH_ERR_EID, CFE_EVS_EventType_ERROR,
+                     "MQTT shard %d connection %s, its topics are held until it reconnects",
+                     Index, Reason);
+
+   Conn->PingTime = 0;
+   ScheduleRetry(Conn);
+
+} /* End LostConnection() */
+
+
+/******************************************************************************
+** Function: MonotonicNs
+**
+*/
+static uint64 MonotonicNs(void)
+{
+
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return ((uint64)Now.tv_sec * 1000000000ULL + (uint64)Now.tv_nsec);
+
+} /* End MonotonicNs() */
+
+
+/******************************************************************************
+** Function: PollTimeout
+**
+** Return the number of milliseconds a shard's task can wait.
+**
+*/
+static int PollTimeout(const MQTT_SHARD_Conn_t *Conn)
+{
+
+   uint32 Timeout = MqttShard->YieldTime;
+   uint64 Now = MonotonicNs();
+   uint64 Deadline = 0;
+
+   if (Conn->Connected)
+   {
+      if (Conn->Head != __atomic_load_n(&Conn->Tail, __ATOMIC_ACQUIRE))
+      {
+         Timeout = 0;
+      }
+      else
+      {
+         Deadline = (Conn->PingTime != 0 ? Conn->PingTime : Conn->SendTime) + KEEPALIVE_NS;
+      }
+   }
+   else if (__atomic_load_n(&MqttShard->BrokerGen, __ATOMIC_ACQUIRE) != 0)
+   {
+      Deadline = Conn->RetryTime;
+   }
+
+   if (Deadline != 0)
+   {
+      if (Now >= Deadline)
+      {
+         Timeout = 0;
+      }
+      else if (((Deadline - Now + 999999) / 1000000) < Timeout)
+      {
+         Timeout = (uint32)((Deadline - Now + 999999) / 1000000);
+      }
+   }
+
+   return (int)Timeout;
+
+} /* End PollTimeout() */
+
+
+/******************************************************************************
+** Function: PublishQueuedMsgs
+**
+** Write every queued message with one sendmsg() call
+**
+** Notes:
+**   1. The packet images are written in place, a partial write resumes
+**      from the first unwritten byte.
+**   2. Returns false if the connection is lost. Messages that were
+**      completely written are removed from the ring, the rest stay queued
+**      for the next connection.
+**
+*/
+static bool PublishQueuedMsgs(MQTT_SHARD_Conn_t *Conn)
+{
+
+   bool   RetStatus = true;
+   uint32 Head = Conn->Head;
+   uint32 Tail = __atomic_load_n(&Conn->Tail, __ATOMIC_ACQUIRE);
+   uint32 Cnt  = Tail - Head;
+   uint32 i;
+   ssize_t Sent;
+   struct iovec  Iov[MQTT_SHARD_DEPTH];
+   struct msghdr Msg;
+   const MQTT_PUBQ_Entry_t *Entry;
+   CFE_TIME_SysTime_t PubTime;
+
+   if (Cnt == 0)
+   {
+      return true;
+   }
+
+   for (i = 0; i < Cnt; i++)
+   {
+      Entry = &Conn->Entry[(Head + i) & SHARD_MASK];
+      Iov[i].iov_base = (void *)&Entry->Packet[Entry->PacketIndex];
+      Iov[i].iov_len  = Entry->PacketLen;
+   }
+
+   memset(&Msg, 0, sizeof(Msg));
+   Msg.msg_iov    = Iov;
+   Msg.msg_iovlen = Cnt;
+
+   while (Msg.msg_iovlen > 0)
+   {
+      Sent = sendmsg(Conn->Network.my_socket, &Msg, MSG_NOSIGNAL);
+      if (Sent <= 0)
+      {
+         if (Sent < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         RetStatus = false;
+         break;
+      }
+      while (Msg.msg_iovlen > 0 && (size_t)Sent >= Msg.msg_iov->iov_len)
+      {
+         Sent -= Msg.msg_iov->iov_len;
+         Msg.msg_iov++;
+         Msg.msg_iovlen--;
+      }
+      if (Msg.msg_iovlen > 0)
+      {
+         Msg.msg_iov->iov_base = (uint8 *)Msg.msg_iov->iov_base + Sent;
+         Msg.msg_iov->iov_len -= Sent;
+      }
+   }
+
+   Cnt -= Msg.msg_iovlen;
+   if (Cnt > 0)
+   {
+      PubTime = CFE_TIME_GetTime();
+      for (i = 0; i < Cnt; i++)
+      {
+         Entry = &Conn->Entry[(Head + i) & SHARD_MASK];
+         MQTT_LATENCY_Record(MQTT_LATENCY_PUBLISH, Entry->PluginId, &Entry->XlateTime, &PubTime);
+         MQTT_LATENCY_Record(MQTT_LATENCY_OUT_TOTAL, Entry->PluginId, &Entry->SbTime, &PubTime);
+         MQTT_TRACE_Write(MQTT_TRACE_DIR_PUBLISH, MQTT_TRACE_RESULT_OK, Entry->PluginId, Entry->PayloadLen);
+      }
+      Conn->PubCnt  += Cnt;
+      Conn->SendTime = MonotonicNs();
+      __atomic_store_n(&Conn->Head, Head + Cnt, __ATOMIC_RELEASE);
+   }
+
+   return RetStatus;
+
+} /* End PublishQueuedMsgs() */
+
+
+/******************************************************************************
+** Function: ReadInput
+**
+** Read the packets the broker sent without blocking. Returns false if the
+** connection was closed.
+**
+** Notes:
+**   1. The broker only sends PINGRESPs to a shard so any input answers the
+**      outstanding PINGREQ.
+**
+*/
+static bool ReadInput(MQTT_SHARD_Conn_t *Conn)
+{
+
+   ssize_t Len = recv(Conn->Network.my_socket, Conn->CtrlBuf, MQTT_SHARD_CTRL_BUF_LEN, MSG_DONTWAIT);
+
+   if (Len > 0)
+   {
+      Conn->PingTime = 0;
+      return true;
+   }
+
+   return (Len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+
+} /* End ReadInput() */
+
+
+/******************************************************************************
+** Function: ScheduleRetry
+**
+** Schedule a shard's next connect attempt
+**
+** Notes:
+**   1. The delay is RetryMs with equal jitter like the network owner's
+**      reconnects so the shards don't retry in lockstep.
+**
+*/
+static void ScheduleRetry(MQTT_SHARD_Conn_t *Conn)
+{
+
+   uint32 DelayMs = Conn->RetryMs/2 + (uint32)(rand() % (Conn->RetryMs/2 + 1));
+
+   Conn->RetryTime = MonotonicNs() + (uint64)DelayMs * 1000000;
+
+   Conn->RetryMs = (Conn->RetryMs > MqttShard->RetryMaxMs/2) ? MqttShard->RetryMaxMs : Conn->RetryMs * 2;
+
+} /* End ScheduleRetry() */
+
+
+/******************************************************************************
+** Function: WakeShard
+**
+** Wake a shard's task from its poll() wait.
+**
+*/
+static void WakeShard(MQTT_SHARD_Conn_t *Conn)
+{
+
+   uint64  WakeCnt = 1;
+   ssize_t WriteLen;
+
+   /* A failed write means the counter is saturated so the task is already awake */
+   WriteLen = write(Conn->WakeFd, &WakeCnt, sizeof(WakeCnt));
+   (void)WriteLen;
+
+} /* End WakeShard() */
+
+
+/******************************************************************************
+** Function: WritePacket
+**
+** Write a control packet from CtrlBuf
+**
+*/
+static bool WritePacket(MQTT_SHARD_Conn_t *Conn, int Len)
+{
+
+   int Sent = 0;
+   int Rc;
+
+   while (Sent < Len)
+   {
+      Rc = send(Conn->Network.my_socket, &Conn->CtrlBuf[Sent], Len - Sent, MSG_NOSIGNAL);
+      if (Rc <= 0)
+      {
+         if (Rc < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      Sent += Rc;
+   }
+
+   if (Sent == Len)
+   {
+      Conn->SendTime = MonotonicNs();
+   }
+
+   return (Sent == Len);
+
+} /* End WritePacket() */
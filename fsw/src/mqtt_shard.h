@@ -0,0 +1,256 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Publish QoS0 messages over additional broker connections
+**
+** Notes:
+**   1. MQTT_SHARD_CNT in the ini file sets the number of broker connections
+**      used for publishing. Connection 0 is the network owner's session,
+**      connections 1 to MQTT_SHARD_CNT-1 are publish-only MQTT 3.1.1 clean
+**      sessions, each with its own child task, socket and publish ring.
+**      A single connection is limited by one task's writes and one TCP
+**      stream's congestion window, spreading topics over several lets them
+**      be written in parallel.
+**   2. A topic's connection is set by its TOPIC_CFG shardN option or by a
+**      hash of its message ID. A topic always uses the same connection so
+**      its messages stay in order.
+**   3. Only QoS0 messages without the priority option are sharded. QoS1,
+**      QoS2 and priority messages always use connection 0 and its session.
+**   4. The shards connect to the broker and address connection 0 last
+**      connected to with the client ID MQTT_CLIENT_NAME-sN. While a shard is
+**      disconnected its ring holds its topics' messages and they're
+**      published when it reconnects. Messages are only dropped when the
+**      ring is full. A message partially written when the connection is
+**      lost is written again on the next connection.
+**   5. Each ring is single-producer/single-consumer like MQTT_PUBQ. The
+**      main task pushes and the shard's child task publishes. Shard
+**      publishes are recorded in the PUBLISH and OUT_TOTAL latency stages.
+**   6. A shard only reads packets to detect a closed connection and to
+**      answer its keepalive PINGREQ, it never subscribes so a PINGRESP is
+**      the only packet the broker sends.
+**
+*/
+#ifndef _mqtt_shard_
+#define _mqtt_shard_
+
+/*
+** Includes
+*/
+
+#include "MQTTLinux.h"  /* Must be included prior to "MQTTPacket.h" */
+#include "MQTTPacket.h"
+
+#include "app_cfg.h"
+#include "mqtt_client.h"
+#include "mqtt_pubq.h"
+#include "mqtt_resolve.h"
+#include "mqtt_topic_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_SHARD_CONSTRUCTOR_EID  (MQTT_SHARD_BASE_EID + 0)
+#define MQTT_SHARD_CONNECT_EID      (MQTT_SHARD_BASE_EID + 1)
+#define MQTT_SHARD_CONNECT_ERR_EID  (MQTT_SHARD_BASE_EID + 2)
+#define MQTT_SHARD_PUBLISH_ERR_EID  (MQTT_SHARD_BASE_EID + 3)
+#define MQTT_SHARD_TASK_ERR_EID     (MQTT_SHARD_BASE_EID + 4)
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** A shard's broker connection. Fields are only written by the shard's
+** child task unless they're noted as producer fields.
+*/
+
+typedef struct
+{
+
+   /*
+   ** Head is only written by the consumer and Tail is only written by the
+   ** producer like MQTT_PUBQ's rings.
+   */
+
+   volatile uint32  Head;
+   volatile uint32  Tail;
+   bool     WakePending;   /* Producer, a deferred push hasn't woken the task */
+
+   volatile bool  Connected;
+
+   int      WakeFd;
+   uint32   BrokerGen;     /* MQTT_SHARD_Class_t BrokerGen of the connection */
+   uint64   RetryTime;     /* CLOCK_MONOTONIC ns time of the next connect attempt */
+   uint32   RetryMs;
+   uint64   SendTime;      /* Last write, CLOCK_MONOTONIC ns */
+   uint64   PingTime;      /* Outstanding PINGREQ, zero if there isn't one */
+
+   char     ClientName[MAX_CLIENT_PARAM_STR_LEN];
+   char     TaskName[OS_MAX_API_NAME];
+
+   /*
+   ** Status
+   */
+
+   uint32   ConnectCnt;
+   uint32   PubCnt;
+   uint32   OverflowCnt;   /* Producer, pushes to a full ring */
+
+   CHILDMGR_Class_t  ChildMgr;
+   Network           Network;
+
+   unsigned char     CtrlBuf[MQTT_SHARD_CTRL_BUF_LEN];
+   MQTT_PUBQ_Entry_t Entry[MQTT_SHARD_DEPTH];
+
+} MQTT_SHARD_Conn_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint16  Cnt;            /* Connections including the network owner's */
+   uint32  YieldTime;
+   uint32  RetryMinMs;
+   uint32  RetryMaxMs;
+
+   /*
+   ** Broker set by the network owner, protected by MutexId. BrokerGen
+   ** changes when the broker does so the shards reconnect.
+   */
+
+   osal_id_t  MutexId;
+   uint32  BrokerGen;
+   char    BrokerHost[MAX_CLIENT_PARAM_STR_LEN];
+   uint32  BrokerPort;
+   char    ClientName[MAX_CLIENT_PARAM_STR_LEN];
+   MQTT_RESOLVE_Addr_t  BrokerAddr;
+
+   MQTT_SHARD_Conn_t Conn[MQTT_SHARD_MAX-1];
+
+} MQTT_SHARD_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_SHARD instance.
+**   2. The child tasks are created by the app after the constructor using
+**      each connection's ChildMgr and TaskName.
+**
+*/
+void MQTT_SHARD_Constructor(MQTT_SHARD_Class_t *MqttShardPtr, const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_ChildTaskCallback
+**
+** Service a shard connection, the connection is the one that owns ChildMgr
+**
+*/
+bool MQTT_SHARD_ChildTaskCallback(CHILDMGR_Class_t *ChildMgr);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Push
+**
+** Build a PUBLISH packet image in a shard connection's ring
+**
+** Notes:
+**   1. Producer only. Conn is a connection returned by MQTT_SHARD_Select().
+**   2. The shard's task is woken unless Defer is true. A deferred push only
+**      wakes it when the ring is half full, MQTT_SHARD_WakeDeferred() wakes
+**      it at the end of a burst.
+**   3. Returns false if the ring is full or the message is too long. A full
+**      ring drops the newest message and increments OverflowCnt. Rejected
+**      messages are counted as drops in the plugin's topic statistics.
+**
+*/
+bool MQTT_SHARD_Push(uint16 Conn, int32 PluginId, const char *Topic, const char *Payload,
+                     uint32 PayloadLen, bool Retain, bool Defer,
+                     const CFE_TIME_SysTime_t *SbTime, const CFE_TIME_SysTime_t *XlateTime);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_SHARD_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_Select
+**
+** Return the connection a message is published on, zero is the network
+** owner's connection.
+**
+** Notes:
+**   1. CfgShard is the topic's TOPIC_CFG shard, MQTT_TOPIC_CFG_SHARD_HASH
+**      selects a connection from a hash of MsgId.
+**   2. The selected shard is returned whether or not it's connected so a
+**      topic's messages aren't reordered when its shard reconnects.
+**
+*/
+uint16 MQTT_SHARD_Select(uint16 MsgId, uint8 CfgShard);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_SetBroker
+**
+** Set the broker and address the shards connect to
+**
+** Notes:
+**   1. Network owner only, called when connection 0 connects. The shards
+**      reconnect when the broker, address or client name changes.
+**
+*/
+void MQTT_SHARD_SetBroker(const char *ClientName, const char *Host, uint32 Port,
+                          const MQTT_RESOLVE_Addr_t *Addr);
+
+
+/******************************************************************************
+** Function: MQTT_SHARD_WakeDeferred
+**
+** Wake the shard tasks with deferred pushes
+**
+** Notes:
+**   1. Producer only, called when the SB topic pipe is empty.
+**
+*/
+void MQTT_SHARD_WakeDeferred(void);
+
+
+#endif /* _mqtt_shard_ */
@@ -0,0 +1,388 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Store translated MQTT messages while the broker is unavailable and
+**   forward them after a reconnect
+**
+** Notes:
+**   1. See mqtt_spool.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "mqtt_spool.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define SPOOL_REC_ALIGN(Len)  (((Len) + 3) & ~((uint32)3))
+
+/* Replay credit is granted at most this often */
+#define SPOOL_MIN_REPLAY_TICK_MS  10
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void DropOldest(void);
+static uint64 MonotonicMs(void);
+static bool Reserve(uint32 RecLen, uint32 *Offset);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_SPOOL_Class_t *MqttSpool = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Constructor
+**
+*/
+void MQTT_SPOOL_Constructor(MQTT_SPOOL_Class_t *MqttSpoolPtr,
+                            const INITBL_Class_t *IniTbl)
+{
+
+   MqttSpool = MqttSpoolPtr;
+
+   CFE_PSP_MemSet((void*)MqttSpool, 0, sizeof(MQTT_SPOOL_Class_t));
+
+   MqttSpool->BufLen     = INITBL_GetIntConfig(IniTbl, CFG_SPOOL_BUF_LEN);
+   MqttSpool->DropPolicy = (MQTT_SPOOL_DropPolicy_t)INITBL_GetIntConfig(IniTbl, CFG_SPOOL_DROP_POLICY);
+   MqttSpool->ReplayRate = INITBL_GetIntConfig(IniTbl, CFG_SPOOL_REPLAY_RATE);
+
+   if (MqttSpool->BufLen > MQTT_SPOOL_BUF_MAX_LEN)
+   {
+      CFE_EVS_SendEvent(MQTT_SPOOL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Spool buffer length %d exceeds maximum %d, using the maximum",
+                        MqttSpool->BufLen, MQTT_SPOOL_BUF_MAX_LEN);
+      MqttSpool->BufLen = MQTT_SPOOL_BUF_MAX_LEN;
+   }
+
+   if (MqttSpool->DropPolicy != MQTT_SPOOL_DROP_OLDEST && MqttSpool->DropPolicy != MQTT_SPOOL_DROP_NEWEST)
+   {
+      CFE_EVS_SendEvent(MQTT_SPOOL_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Invalid spool drop policy %d, using drop oldest", MqttSpool->DropPolicy);
+      MqttSpool->DropPolicy = MQTT_SPOOL_DROP_OLDEST;
+   }
+
+   if (MqttSpool->ReplayRate == 0)
+   {
+      MqttSpool->ReplayRate = 1;
+   }
+   MqttSpool->ReplayTick = 1000 / MqttSpool->ReplayRate;
+   if (MqttSpool->ReplayTick < SPOOL_MIN_REPLAY_TICK_MS)
+   {
+      MqttSpool->ReplayTick = SPOOL_MIN_REPLAY_TICK_MS;
+   }
+
+   MqttSpool->WrapEnd = MqttSpool->BufLen;
+   TimerInit(&MqttSpool->ReplayTimer);
+
+} /* End MQTT_SPOOL_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Peek
+**
+*/
+bool MQTT_SPOOL_Peek(MQTT_SPOOL_Msg_t *Msg)
+{
+
+   const MQTT_SPOOL_RecHdr_t *RecHdr;
+
+   if (MqttSpool->MsgCnt == 0)
+   {
+      return false;
+   }
+
+   RecHdr = (const MQTT_SPOOL_RecHdr_t *)&MqttSpool->Buf[MqttSpool->Head];
+
+   Msg->PluginId   = RecHdr->PluginId;
+   Msg->Qos        = (MQTT_CLIENT_Qos_t)RecHdr->Qos;
+   Msg->Retain     = (RecHdr->Retain != 0);
+   Msg->Topic      = (const char *)&RecHdr[1];
+   Msg->Payload    = Msg->Topic + RecHdr->TopicLen + 1;
+   Msg->PayloadLen = RecHdr->PayloadLen;
+
+   return true;
+
+} /* End MQTT_SPOOL_Peek() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Pop
+**
+*/
+void MQTT_SPOOL_Pop(void)
+{
+
+   if (MqttSpool->MsgCnt > 0)
+   {
+      DropOldest();
+      MqttSpool->ReplayCnt++;
+      if (MqttSpool->ReplayCredit > 0)
+      {
+         MqttSpool->ReplayCredit--;
+      }
+   }
+
+} /* End MQTT_SPOOL_Pop() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ReplayCredit
+**
+** Notes:
+**   1. Credit accrues as ReplayRate messages per second of elapsed time so
+**      rates that don't divide 1000 aren't truncated. The elapsed time is
+**      limited to two ticks so a spool that was idle doesn't get a burst.
+**
+*/
+uint32 MQTT_SPOOL_ReplayCredit(void)
+{
+
+   uint64 Now;
+   uint64 Elapsed;
+
+   if (MqttSpool->MsgCnt > 0 && TimerIsExpired(&MqttSpool->ReplayTimer))
+   {
+      Now     = MonotonicMs();
+      Elapsed = Now - MqttSpool->ReplayTime;
+      if (Elapsed > (2 * MqttSpool->ReplayTick))
+      {
+         Elapsed = MqttSpool->ReplayTick;
+      }
+      MqttSpool->ReplayCreditMs += (uint64)MqttSpool->ReplayRate * Elapsed;
+      MqttSpool->ReplayCredit    = (uint32)(MqttSpool->ReplayCreditMs / 1000);
+      MqttSpool->ReplayCreditMs %= 1000;
+      MqttSpool->ReplayTime      = Now;
+      TimerCountdownMS(&MqttSpool->ReplayTimer, MqttSpool->ReplayTick);
+   }
+
+   return MqttSpool->ReplayCredit;
+
+} /* End MQTT_SPOOL_ReplayCredit() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ReplayTimeout
+**
+*/
+uint32 MQTT_SPOOL_ReplayTimeout(void)
+{
+
+   uint32 Timeout = MQTT_SPOOL_NO_TIMEOUT;
+   int    TimeLeft;
+
+   if (MqttSpool->MsgCnt > 0)
+   {
+      TimeLeft = TimerLeftMS(&MqttSpool->ReplayTimer);
+      Timeout  = (TimeLeft > 0) ? (uint32)TimeLeft : 0;
+   }
+
+   return Timeout;
+
+} /* End MQTT_SPOOL_ReplayTimeout() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+** Notes:
+**   1. MsgCnt and Bytes describe the spool contents so they're not reset.
+**
+*/
+void MQTT_SPOOL_ResetStatus(void)
+{
+
+   MqttSpool->DropCnt   = 0;
+   MqttSpool->ReplayCnt = 0;
+
+} /* End MQTT_SPOOL_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Store
+**
+*/
+bool MQTT_SPOOL_Store(int32 PluginId, MQTT_CLIENT_Qos_t Qos, bool Retain, const char *Topic,
+                      const char *Payload, uint32 PayloadLen)
+{
+
+   bool   RetStatus = false;
+   uint32 TopicLen  = strlen(Topic);
+   uint32 RecLen    = SPOOL_REC_ALIGN(sizeof(MQTT_SPOOL_RecHdr_t) + TopicLen + PayloadLen + 2);
+   uint32 Offset;
+   MQTT_SPOOL_RecHdr_t *RecHdr;
+   char   *RecData;
+
+   if (RecLen <= MqttSpool->BufLen)
+   {
+
+      RetStatus = Reserve(RecLen, &Offset);
+
+      if (MqttSpool->DropPolicy == MQTT_SPOOL_DROP_OLDEST)
+      {
+         while (!RetStatus)
+         {
+            RecHdr = (MQTT_SPOOL_RecHdr_t *)&MqttSpool->Buf[MqttSpool->Head];
+            MQTT_TOPIC_STATS_CountDrop(RecHdr->PluginId);
+            DropOldest();
+            MqttSpool->DropCnt++;
+            RetStatus = Reserve(RecLen, &Offset);
+         }
+      }
+
+      if (RetStatus)
+      {
+
+         RecHdr  = (MQTT_SPOOL_RecHdr_t *)&MqttSpool->Buf[Offset];
+         RecData = (char *)&RecHdr[1];
+
+         RecHdr->RecLen     = RecLen;
+         RecHdr->TopicLen   = TopicLen;
+         RecHdr->PayloadLen = PayloadLen;
+         RecHdr->PluginId   = PluginId;
+         RecHdr->Qos        = (uint16)Qos;
+         RecHdr->Retain     = Retain ? 1 : 0;
+         memcpy(RecData, Topic, TopicLen + 1);
+         memcpy(&RecData[TopicLen + 1], Payload, PayloadLen);
+         RecData[TopicLen + 1 + PayloadLen] = '\0';
+
+         MqttSpool->Tail = Offset + RecLen;
+         MqttSpool->MsgCnt++;
+         MqttSpool->Bytes += RecLen;
+
+      }
+   } /* End if record fits */
+
+   if (!RetStatus)
+   {
+      MqttSpool->DropCnt++;
+   }
+
+   return RetStatus;
+
+} /* End MQTT_SPOOL_Store() */
+
+
+/******************************************************************************
+** Function: DropOldest
+**
+** Remove the record at the head of the spool.
+**
+*/
+static void DropOldest(void)
+{
+
+   const MQTT_SPOOL_RecHdr_t *RecHdr = (const MQTT_SPOOL_RecHdr_t *)&MqttSpool->Buf[MqttSpool->Head];
+
+   MqttSpool->Head  += RecHdr->RecLen;
+   MqttSpool->Bytes -= RecHdr->RecLen;
+   MqttSpool->MsgCnt--;
+
+   if (MqttSpool->MsgCnt == 0)
+   {
+      MqttSpool->Head    = 0;
+      MqttSpool->Tail    = 0;
+      MqttSpool->WrapEnd = MqttSpool->BufLen;
+   }
+   else if (MqttSpool->Head >= MqttSpool->WrapEnd)
+   {
+      MqttSpool->Head    = 0;
+      MqttSpool->WrapEnd = MqttSpool->BufLen;
+   }
+
+} /* End DropOldest() */
+
+
+/******************************************************************************
+** Function: MonotonicMs
+**
+*/
+static uint64 MonotonicMs(void)
+{
+
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+
+   return ((uint64)Now.tv_sec * 1000ULL + (uint64)Now.tv_nsec / 1000000);
+
+} /* End MonotonicMs() */
+
+
+/******************************************************************************
+** Function: Reserve
+**
+** Find contiguous space for a record without modifying the spool. Returns
+** false if there isn't room.
+**
+** Notes:
+**   1. When the record doesn't fit between the tail and the end of the
+**      buffer it is placed at the start and WrapEnd records where the
+**      valid data ends.
+**
+*/
+static bool Reserve(uint32 RecLen, uint32 *Offset)
+{
+
+   bool RetStatus = false;
+
+   if (MqttSpool->MsgCnt == 0)
+   {
+      *Offset   = 0;
+      RetStatus = (RecLen <= MqttSpool->BufLen);
+   }
+   else if (MqttSpool->Tail > MqttSpool->Head)
+   {
+      if ((MqttSpool->Tail + RecLen) <= MqttSpool->BufLen)
+      {
+         *Offset   = MqttSpool->Tail;
+         RetStatus = true;
+      }
+      else if (RecLen < MqttSpool->Head)
+      {
+         MqttSpool->WrapEnd = MqttSpool->Tail;
+         *Offset   = 0;
+         RetStatus = true;
+      }
+   }
+   else
+   {
+      /* Tail has wrapped, free space is between the tail and head */
+      if ((MqttSpool->Tail + RecLen) < MqttSpool->Head)
+      {
+         *Offset   = MqttSpool->Tail;
+         RetStatus = true;
+      }
+   }
+
+   return RetStatus;
+
+} /* End Reserve() */
@@ -0,0 +1,238 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Store translated MQTT messages while the broker is unavailable and
+**   forward them after a reconnect
+**
+** Notes:
+**   1. Messages are stored as variable length records in a circular byte
+**      buffer. A record is never split across the end of the buffer.
+**   2. Only the network owner task may call spool functions other than
+**      the constructor and MQTT_SPOOL_ResetStatus().
+**   3. Replay is rate limited so spooled messages don't starve the live
+**      message stream after a reconnect.
+**
+*/
+#ifndef _mqtt_spool_
+#define _mqtt_spool_
+
+/*
+** Includes
+*/
+
+#include "MQTTLinux.h"
+
+#include "app_cfg.h"
+#include "mqtt_client.h"
+#include "mqtt_topic_stats.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_SPOOL_CONSTRUCTOR_EID  (MQTT_SPOOL_BASE_EID + 0)
+
+#define MQTT_SPOOL_NO_TIMEOUT  0xFFFFFFFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_SPOOL_DROP_OLDEST = 0,
+   MQTT_SPOOL_DROP_NEWEST = 1
+
+} MQTT_SPOOL_DropPolicy_t;
+
+
+/*
+** Record header. The NUL terminated topic and payload follow the header
+** and RecLen is rounded up to keep headers aligned.
+*/
+
+typedef struct
+{
+
+   uint32  RecLen;
+   uint32  TopicLen;
+   uint32  PayloadLen;
+   int32   PluginId;
+   uint16  Qos;
+   uint16  Retain;
+
+} MQTT_SPOOL_RecHdr_t;
+
+
+/*
+** A spooled message returned by MQTT_SPOOL_Peek(). Topic and Payload point
+** into the spool and are valid until the message is popped.
+*/
+
+typedef struct
+{
+
+   int32              PluginId;
+   MQTT_CLIENT_Qos_t  Qos;
+   bool               Retain;
+   const char        *Topic;
+   const char        *Payload;
+   uint32             PayloadLen;
+
+} MQTT_SPOOL_Msg_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   /*
+   ** Configuration
+   */
+
+   uint32  BufLen;
+   uint32  ReplayRate;
+   uint32  ReplayTick;
+   MQTT_SPOOL_DropPolicy_t  DropPolicy;
+
+   /*
+   ** Status
+   */
+
+   uint32  MsgCnt;
+   uint32  Bytes;
+   uint32  DropCnt;
+   uint32  ReplayCnt;
+
+   /*
+   ** Circular buffer. WrapEnd marks the end of valid data when the tail
+   ** has wrapped to the start of the buffer.
+   */
+
+   uint32  Head;
+   uint32  Tail;
+   uint32  WrapEnd;
+
+   uint32  ReplayCredit;
+   uint64  ReplayCreditMs;   /* Fractional credit carried between ticks, msg*ms */
+   uint64  ReplayTime;       /* Monotonic ms when credit was last granted */
+   Timer   ReplayTimer;
+
+   uint8   Buf[MQTT_SPOOL_BUF_MAX_LEN];
+
+} MQTT_SPOOL_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_SPOOL instance.
+**   2. A zero length spool disables store-and-forward.
+**
+*/
+void MQTT_SPOOL_Constructor(MQTT_SPOOL_Class_t *MqttSpoolPtr,
+                            const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Peek
+**
+** Return the oldest spooled message. Returns false if the spool is empty.
+**
+*/
+bool MQTT_SPOOL_Peek(MQTT_SPOOL_Msg_t *Msg);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Pop
+**
+** Remove the message returned by MQTT_SPOOL_Peek() after it has been
+** replayed.
+**
+*/
+void MQTT_SPOOL_Pop(void);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ReplayCredit
+**
+** Return the number of messages that may be replayed now.
+**
+** Notes:
+**   1. Credit is granted every ReplayTick ms in proportion to the elapsed
+**      time. A fraction of a message is carried over to the next tick but
+**      unused whole messages are not.
+**
+*/
+uint32 MQTT_SPOOL_ReplayCredit(void);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ReplayTimeout
+**
+** Return the number of milliseconds until more replay credit is granted
+** or MQTT_SPOOL_NO_TIMEOUT if the spool is empty.
+**
+*/
+uint32 MQTT_SPOOL_ReplayTimeout(void);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_SPOOL_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_SPOOL_Store
+**
+** Store a message. Returns false if the message could not be stored.
+**
+** Notes:
+**   1. When the spool is full the drop policy either discards the oldest
+**      messages to make room or rejects the new message. Both are counted
+**      in DropCnt and discarded messages are also counted as drops in
+**      their plugin's topic statistics.
+**   2. The QoS and retain flag are stored so the message is replayed the
+**      way it would have been published.
+**
+*/
+bool MQTT_SPOOL_Store(int32 PluginId, MQTT_CLIENT_Qos_t Qos, bool Retain, const char *Topic,
+                      const char *Payload, uint32 PayloadLen);
+
+
+#endif /* _mqtt_spool_ */
@@ -0,0 +1,334 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage per topic translation options
+**
+** Notes:
+**   1. See mqtt_topic_cfg.h for the TOPIC_CFG format.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mqtt_topic_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define TOPIC_CFG_ENTRY_STR_LEN  64
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+typedef struct
+{
+
+   const char  *Name;
+   uint16      Flag;
+   uint8       PubQos;
+   uint8       SubQos;
+
+} TopicOpt_t;
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static void ParseEntry(const char *EntryStr, uint32 EntryLen);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_TOPIC_CFG_Class_t *MqttTopicCfg = NULL;
+
+static const TopicOpt_t TopicOpt[] =
+{
+   { "raw",      MQTT_TOPIC_CFG_OPT_RAW,      MQTT_TOPIC_CFG_QOS_DEFAULT, MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "cbor",     MQTT_TOPIC_CFG_OPT_CBOR,     MQTT_TOPIC_CFG_QOS_DEFAULT, MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "zlib",     MQTT_TOPIC_CFG_OPT_ZLIB,     MQTT_TOPIC_CFG_QOS_DEFAULT, MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "retain",   MQTT_TOPIC_CFG_OPT_RETAIN,   MQTT_TOPIC_CFG_QOS_DEFAULT, MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "priority", MQTT_TOPIC_CFG_OPT_PRIORITY, MQTT_TOPIC_CFG_QOS_DEFAULT, MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "pub0",     MQTT_TOPIC_CFG_OPT_NONE,     0,                          MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "pub1",     MQTT_TOPIC_CFG_OPT_NONE,     1,                          MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "pub2",     MQTT_TOPIC_CFG_OPT_NONE,     2,                          MQTT_TOPIC_CFG_QOS_DEFAULT },
+   { "sub0",     MQTT_TOPIC_CFG_OPT_NONE,     MQTT_TOPIC_CFG_QOS_DEFAULT, 0                          },
+   { "sub1",     MQTT_TOPIC_CFG_OPT_NONE,     MQTT_TOPIC_CFG_QOS_DEFAULT, 1                          },
+   { "sub2",     MQTT_TOPIC_CFG_OPT_NONE,     MQTT_TOPIC_CFG_QOS_DEFAULT, 2                          }
+};
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_Constructor
+**
+** Notes:
+**   1. An empty string or "UNDEF" defines no entries.
+**
+*/
+void MQTT_TOPIC_CFG_Constructor(MQTT_TOPIC_CFG_Class_t *MqttTopicCfgPtr,
+                                const INITBL_Class_t *IniTbl)
+{
+
+   const char *CfgStr;
+   uint32 EntryLen;
+
+   MqttTopicCfg = MqttTopicCfgPtr;
+
+   CFE_PSP_MemSet((void*)MqttTopicCfg, 0, sizeof(MQTT_TOPIC_CFG_Class_t));
+
+   CfgStr = INITBL_GetStrConfig(IniTbl, CFG_TOPIC_CFG);
+   if (strcmp(CfgStr, "UNDEF") == 0)
+   {
+      return;
+   }
+
+   while (*CfgStr != '\0')
+   {
+      EntryLen = strcspn(CfgStr, ",");
+      if (EntryLen > 0)
+      {
+         ParseEntry(CfgStr, EntryLen);
+      }
+      CfgStr += EntryLen;
+      if (*CfgStr == ',')
+      {
+         CfgStr++;
+      }
+   }
+
+} /* End MQTT_TOPIC_CFG_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_CborTopic
+**
+*/
+bool MQTT_TOPIC_CFG_CborTopic(char *CborTopic, const char *Topic)
+{
+
+   uint32 TopicLen = strlen(Topic);
+
+   if (TopicLen > 0 && Topic[TopicLen - 1] == '#')
+   {
+      return false;
+   }
+   if ((TopicLen + MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN) >= JMSG_PLATFORM_TOPIC_NAME_MAX_LEN)
+   {
+      return false;
+   }
+
+   memcpy(CborTopic, Topic, TopicLen);
+   memcpy(&CborTopic[TopicLen], MQTT_TOPIC_CFG_CBOR_SUFFIX, MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN + 1);
+
+   return true;
+
+} /* End MQTT_TOPIC_CFG_CborTopic() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetEntry
+**
+** Notes:
+**   1. The table is searched linearly. It only holds topics with non-default
+**      options so it's short and fits in a couple of cache lines.
+**
+*/
+const MQTT_TOPIC_CFG_Entry_t *MQTT_TOPIC_CFG_GetEntry(uint16 MsgId)
+{
+
+   uint16 i;
+
+   for (i = 0; i < MqttTopicCfg->EntryCnt; i++)
+   {
+      if (MqttTopicCfg->Entry[i].MsgId == MsgId)
+      {
+         return &MqttTopicCfg->Entry[i];
+      }
+   }
+
+   return NULL;
+
+} /* End MQTT_TOPIC_CFG_GetEntry() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetOpts
+**
+*/
+uint16 MQTT_TOPIC_CFG_GetOpts(uint16 MsgId)
+{
+
+   const MQTT_TOPIC_CFG_Entry_t *Entry = MQTT_TOPIC_CFG_GetEntry(MsgId);
+
+   return (Entry != NULL ? Entry->Opts : MQTT_TOPIC_CFG_OPT_NONE);
+
+} /* End MQTT_TOPIC_CFG_GetOpts() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetSubQos
+**
+*/
+uint8 MQTT_TOPIC_CFG_GetSubQos(uint16 MsgId, uint8 DefQos)
+{
+
+   const MQTT_TOPIC_CFG_Entry_t *Entry = MQTT_TOPIC_CFG_GetEntry(MsgId);
+
+   return ((Entry != NULL && Entry->SubQos != MQTT_TOPIC_CFG_QOS_DEFAULT) ? Entry->SubQos : DefQos);
+
+} /* End MQTT_TOPIC_CFG_GetSubQos() */
+
+
+/******************************************************************************
+** Function: ParseEntry
+**
+** Parse one "msgid:opt+opt" entry and add it to the table.
+**
+*/
+static void ParseEntry(const char *EntryStr, uint32 EntryLen)
+{
+
+   char   Entry[TOPIC_CFG_ENTRY_STR_LEN];
+   char   *OptStr;
+   char   *SavePtr;
+   char   *Opt;
+   uint32 MsgId;
+   uint16 Opts = MQTT_TOPIC_CFG_OPT_NONE;
+   uint8  PubQos = MQTT_TOPIC_CFG_QOS_DEFAULT;
+   uint8  SubQos = MQTT_TOPIC_CFG_QOS_DEFAULT;
+   uint8  Shard  = MQTT_TOPIC_CFG_SHARD_HASH;
+   uint32 ShardNum;
+   char   *ShardEnd;
+   uint16 i;
+   bool   Valid;
+
+   if (EntryLen >= TOPIC_CFG_ENTRY_STR_LEN)
+   {
+      CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Topic configuration entry %.*s... exceeds %d characters",
+                        16, EntryStr, TOPIC_CFG_ENTRY_STR_LEN - 1);
+      return;
+   }
+
+   memcpy(Entry, EntryStr, EntryLen);
+   Entry[EntryLen] = '\0';
+
+   MsgId = strtoul(Entry, &OptStr, 0);
+   if (OptStr == Entry || *OptStr != ':' || MsgId > 0xFFFF)
+   {
+      CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Topic configuration entry '%s' doesn't start with a message ID and a ':'", Entry);
+      return;
+   }
+
+   for (Opt = strtok_r(OptStr + 1, "+ ", &SavePtr); Opt != NULL; Opt = strtok_r(NULL, "+ ", &SavePtr))
+   {
+      if (strncmp(Opt, MQTT_TOPIC_CFG_SHARD_OPT, MQTT_TOPIC_CFG_SHARD_OPT_LEN) == 0)
+      {
+         ShardNum = strtoul(&Opt[MQTT_TOPIC_CFG_SHARD_OPT_LEN], &ShardEnd, 10);
+         if (ShardEnd == &Opt[MQTT_TOPIC_CFG_SHARD_OPT_LEN] || *ShardEnd != '\0' ||
+             ShardNum >= MQTT_SHARD_MAX || Shard != MQTT_TOPIC_CFG_SHARD_HASH)
+         {
+            CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                              "Topic configuration for message ID 0x%04X has an invalid or repeated option '%s', connections are shard0 to shard%d",
+                              (unsigned int)MsgId, Opt, MQTT_SHARD_MAX - 1);
+            return;
+         }
+         Shard = (uint8)ShardNum;
+         continue;
+      }
+      Valid = false;
+      for (i = 0; i < (sizeof(TopicOpt)/sizeof(TopicOpt[0])); i++)
+      {
+         if (strcmp(Opt, TopicOpt[i].Name) == 0)
+         {
+            Valid = ((TopicOpt[i].PubQos == MQTT_TOPIC_CFG_QOS_DEFAULT || PubQos == MQTT_TOPIC_CFG_QOS_DEFAULT) &&
+                     (TopicOpt[i].SubQos == MQTT_TOPIC_CFG_QOS_DEFAULT || SubQos == MQTT_TOPIC_CFG_QOS_DEFAULT));
+            if (!Valid)
+            {
+               CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                                 "Topic configuration for message ID 0x%04X has more than one %s QoS",
+                                 (unsigned int)MsgId,
+                                 (TopicOpt[i].PubQos != MQTT_TOPIC_CFG_QOS_DEFAULT) ? "publish" : "subscribe");
+               return;
+            }
+            Opts |= TopicOpt[i].Flag;
+            if (TopicOpt[i].PubQos != MQTT_TOPIC_CFG_QOS_DEFAULT)
+            {
+               PubQos = TopicOpt[i].PubQos;
+            }
+            if (TopicOpt[i].SubQos != MQTT_TOPIC_CFG_QOS_DEFAULT)
+            {
+               SubQos = TopicOpt[i].SubQos;
+            }
+            break;
+         }
+      }
+      if (!Valid)
+      {
+         CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Topic configuration for message ID 0x%04X has an unknown option '%s'",
+                           (unsigned int)MsgId, Opt);
+         return;
+      }
+   }
+
+   if ((Opts & MQTT_TOPIC_CFG_OPT_ENCODING) & ((Opts & MQTT_TOPIC_CFG_OPT_ENCODING) - 1))
+   {
+      CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Topic configuration for message ID 0x%04X has more than one payload encoding",
+                        (unsigned int)MsgId);
+      return;
+   }
+
+   for (i = 0; i < MqttTopicCfg->EntryCnt; i++)
+   {
+      if (MqttTopicCfg->Entry[i].MsgId == MsgId)
+      {
+         CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                           "Topic configuration for message ID 0x%04X is defined more than once",
+                           (unsigned int)MsgId);
+         return;
+      }
+   }
+
+   if (MqttTopicCfg->EntryCnt < MQTT_TOPIC_CFG_ENTRY_MAX)
+   {
+      MqttTopicCfg->Entry[MqttTopicCfg->EntryCnt].MsgId  = MsgId;
+      MqttTopicCfg->Entry[MqttTopicCfg->EntryCnt].Opts   = Opts;
+      MqttTopicCfg->Entry[MqttTopicCfg->EntryCnt].PubQos = PubQos;
+      MqttTopicCfg->Entry[MqttTopicCfg->EntryCnt].SubQos = SubQos;
+      MqttTopicCfg->Entry[MqttTopicCfg->EntryCnt].Shard  = Shard;
+      MqttTopicCfg->EntryCnt++;
+   }
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_TOPIC_CFG_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "Topic configuration for message ID 0x%04X exceeds the %d entry table",
+                        (unsigned int)MsgId, MQTT_TOPIC_CFG_ENTRY_MAX);
+   }
+
+} /* End ParseEntry() */
@@ -0,0 +1,182 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Manage per topic translation options
+**
+** Notes:
+**   1. Options are defined by the TOPIC_CFG ini string. Each entry is a
+**      topic plugin's cFE message ID followed by its options, for example
+**      "0x0F70:raw,0x0F71:raw". Options are separated by '+'.
+**   2. Topics without an entry use the topic plugin's JSON translation.
+**      A topic can only have one payload encoding option. Compression
+**      options apply to any encoding.
+**   3. Delivery options set a topic's publish and subscribe QoS, the
+**      retain flag and publish priority. Topics without a QoS option use
+**      the MQTT_PUB_QOS and MQTT_SUB_QOS ini values.
+**   4. The shardN option publishes a topic on broker connection N, see
+**      mqtt_shard.h. Topics without one are assigned a connection by a
+**      hash of their message ID.
+**   5. The options are only written by the constructor so both tasks can
+**      read them without a lock.
+**
+*/
+#ifndef _mqtt_topic_cfg_
+#define _mqtt_topic_cfg_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_TOPIC_CFG_CONSTRUCTOR_EID  (MQTT_TOPIC_CFG_BASE_EID + 0)
+
+/*
+** Option flags
+**
+** RAW:  The payload is the cFE message's bytes without any translation
+** CBOR: The plugin's JSON is transcoded to CBOR. CBOR payloads use the
+**       plugin's topic name followed by MQTT_TOPIC_CFG_CBOR_SUFFIX. Inbound
+**       JSON payloads are still accepted on the plugin's topic name.
+** ZLIB: Encoded payloads are compressed by MQTT_ZLIB
+** RETAIN:   Published messages have the PUBLISH retain flag set
+** PRIORITY: Published messages are queued ahead of other topics' messages
+*/
+
+#define MQTT_TOPIC_CFG_OPT_NONE  0x00
+#define MQTT_TOPIC_CFG_OPT_RAW   0x01
+#define MQTT_TOPIC_CFG_OPT_CBOR  0x02
+#define MQTT_TOPIC_CFG_OPT_ZLIB  0x04
+#define MQTT_TOPIC_CFG_OPT_RETAIN    0x08
+#define MQTT_TOPIC_CFG_OPT_PRIORITY  0x10
+
+#define MQTT_TOPIC_CFG_OPT_ENCODING  (MQTT_TOPIC_CFG_OPT_RAW | MQTT_TOPIC_CFG_OPT_CBOR)
+
+#define MQTT_TOPIC_CFG_CBOR_SUFFIX      "/cbor"
+#define MQTT_TOPIC_CFG_CBOR_SUFFIX_LEN  (sizeof(MQTT_TOPIC_CFG_CBOR_SUFFIX) - 1)
+
+/* QoS of a topic without a pub or sub option */
+#define MQTT_TOPIC_CFG_QOS_DEFAULT  0xFF
+
+/* Publish connection option, followed by the connection number */
+#define MQTT_TOPIC_CFG_SHARD_OPT      "shard"
+#define MQTT_TOPIC_CFG_SHARD_OPT_LEN  (sizeof(MQTT_TOPIC_CFG_SHARD_OPT) - 1)
+
+/* Shard of a topic without a shard option */
+#define MQTT_TOPIC_CFG_SHARD_HASH  0xFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef struct
+{
+
+   uint16  MsgId;
+   uint16  Opts;
+   uint8   PubQos;
+   uint8   SubQos;
+   uint8   Shard;
+
+} MQTT_TOPIC_CFG_Entry_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint16  EntryCnt;
+   MQTT_TOPIC_CFG_Entry_t  Entry[MQTT_TOPIC_CFG_ENTRY_MAX];
+
+} MQTT_TOPIC_CFG_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_TOPIC_CFG instance.
+**   2. Invalid entries are reported in an event and ignored.
+**
+*/
+void MQTT_TOPIC_CFG_Constructor(MQTT_TOPIC_CFG_Class_t *MqttTopicCfgPtr,
+                                const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_CborTopic
+**
+** Write a topic's CBOR topic name to CborTopic
+**
+** Notes:
+**   1. CborTopic must be JMSG_PLATFORM_TOPIC_NAME_MAX_LEN bytes. Returns
+**      false if the name doesn't fit.
+**   2. Wildcard filters ending in '#' already match the CBOR topic names
+**      so no name is written and false is returned.
+**
+*/
+bool MQTT_TOPIC_CFG_CborTopic(char *CborTopic, const char *Topic);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetEntry
+**
+** Return a topic plugin's entry or NULL if its cFE message ID doesn't
+** have one
+**
+*/
+const MQTT_TOPIC_CFG_Entry_t *MQTT_TOPIC_CFG_GetEntry(uint16 MsgId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetOpts
+**
+** Return the option flags for a topic plugin's cFE message ID
+**
+*/
+uint16 MQTT_TOPIC_CFG_GetOpts(uint16 MsgId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_CFG_GetSubQos
+**
+** Return a topic plugin's subscribe QoS or DefQos if it isn't configured
+**
+*/
+uint8 MQTT_TOPIC_CFG_GetSubQos(uint16 MsgId, uint8 DefQos);
+
+
+#endif /* _mqtt_topic_cfg_ */
@@ -0,0 +1,205 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Index subscribed MQTT topic names to their topic plugin
+**
+** Notes:
+**   1. Removed entries are marked deleted so probe sequences for other
+**      names aren't broken. Deleted slots are reused by MQTT_TOPIC_IDX_Add().
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_topic_idx.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define TOPIC_IDX_MASK  (MQTT_TOPIC_IDX_SIZE - 1)
+
+#if (MQTT_TOPIC_IDX_SIZE & TOPIC_IDX_MASK) != 0
+   #error MQTT_TOPIC_IDX_SIZE must be a power of 2
+#endif
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 HashName(const char *Name, uint16 NameLen);
+static MQTT_TOPIC_IDX_Entry_t *Lookup(const char *Name, uint16 NameLen, uint32 Hash);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_TOPIC_IDX_Class_t *MqttTopicIdx = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Constructor
+**
+*/
+void MQTT_TOPIC_IDX_Constructor(MQTT_TOPIC_IDX_Class_t *MqttTopicIdxPtr)
+{
+
+   MqttTopicIdx = MqttTopicIdxPtr;
+
+   CFE_PSP_MemSet((void*)MqttTopicIdx, 0, sizeof(MQTT_TOPIC_IDX_Class_t));
+
+} /* End MQTT_TOPIC_IDX_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Add
+**
+*/
+bool MQTT_TOPIC_IDX_Add(const char *Name, uint16 PluginId)
+{
+
+   bool   RetStatus = false;
+   uint16 NameLen = strlen(Name);
+   uint32 Hash    = HashName(Name, NameLen);
+   uint32 i;
+   MQTT_TOPIC_IDX_Entry_t *Entry = Lookup(Name, NameLen, Hash);
+
+   if (Entry != NULL)
+   {
+      Entry->PluginId = PluginId;
+      RetStatus = true;
+   }
+   else if (MqttTopicIdx->EntryCnt < (MQTT_TOPIC_IDX_SIZE - 1))
+   {
+      /* A free slot always exists so the search terminates */
+      for (i = Hash & TOPIC_IDX_MASK; MqttTopicIdx->Entry[i].State == MQTT_TOPIC_IDX_SLOT_USED; i = (i + 1) & TOPIC_IDX_MASK);
+
+      Entry = &MqttTopicIdx->Entry[i];
+      Entry->State    = MQTT_TOPIC_IDX_SLOT_USED;
+      Entry->PluginId = PluginId;
+      Entry->NameLen  = NameLen;
+      Entry->Hash     = Hash;
+      Entry->Name     = Name;
+      MqttTopicIdx->EntryCnt++;
+      RetStatus = true;
+   }
+
+   return RetStatus;
+
+} /* End MQTT_TOPIC_IDX_Add() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Find
+**
+*/
+int32 MQTT_TOPIC_IDX_Find(const char *Name, uint16 NameLen)
+{
+
+   const MQTT_TOPIC_IDX_Entry_t *Entry = Lookup(Name, NameLen, HashName(Name, NameLen));
+
+   return (Entry != NULL) ? Entry->PluginId : JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+
+} /* End MQTT_TOPIC_IDX_Find() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Remove
+**
+*/
+bool MQTT_TOPIC_IDX_Remove(const char *Name)
+{
+
+   uint16 NameLen = strlen(Name);
+   MQTT_TOPIC_IDX_Entry_t *Entry = Lookup(Name, NameLen, HashName(Name, NameLen));
+
+   if (Entry != NULL)
+   {
+      Entry->State = MQTT_TOPIC_IDX_SLOT_DELETED;
+      Entry->Name  = NULL;
+      MqttTopicIdx->EntryCnt--;
+      if (MqttTopicIdx->EntryCnt == 0)
+      {
+         /* Clear deleted slots so misses stop at the first probe */
+         memset(MqttTopicIdx->Entry, 0, sizeof(MqttTopicIdx->Entry));
+      }
+   }
+
+   return (Entry != NULL);
+
+} /* End MQTT_TOPIC_IDX_Remove() */
+
+
+/******************************************************************************
+** Function: HashName
+**
+** FNV-1a hash
+**
+*/
+static uint32 HashName(const char *Name, uint16 NameLen)
+{
+
+   uint32 Hash = 2166136261u;
+   uint16 i;
+
+   for (i = 0; i < NameLen; i++)
+   {
+      Hash ^= (uint8)Name[i];
+      Hash *= 16777619u;
+   }
+
+   return Hash;
+
+} /* End HashName() */
+
+
+/******************************************************************************
+** Function: Lookup
+**
+** Return the entry for a name or NULL if the name isn't indexed.
+**
+*/
+static MQTT_TOPIC_IDX_Entry_t *Lookup(const char *Name, uint16 NameLen, uint32 Hash)
+{
+
+   MQTT_TOPIC_IDX_Entry_t *Entry;
+   uint32 i = Hash & TOPIC_IDX_MASK;
+   uint32 Probes;
+
+   for (Probes = 0; Probes < MQTT_TOPIC_IDX_SIZE; Probes++)
+   {
+      Entry = &MqttTopicIdx->Entry[i];
+      if (Entry->State == MQTT_TOPIC_IDX_SLOT_EMPTY)
+      {
+         break;
+      }
+      if (Entry->State == MQTT_TOPIC_IDX_SLOT_USED && Entry->Hash == Hash &&
+          Entry->NameLen == NameLen && memcmp(Entry->Name, Name, NameLen) == 0)
+      {
+         return Entry;
+      }
+      i = (i + 1) & TOPIC_IDX_MASK;
+   }
+
+   return NULL;
+
+} /* End Lookup() */
@@ -0,0 +1,132 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Index subscribed MQTT topic names to their topic plugin
+**
+** Notes:
+**   1. An open addressing hash table with linear probing. Each entry
+**      holds the name's hash and length so most mismatches are rejected
+**      without comparing the names.
+**   2. Entries point at the topic table's names rather than copying them.
+**   3. Only the network owner task may modify or search the index.
+**
+*/
+#ifndef _mqtt_topic_idx_
+#define _mqtt_topic_idx_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_TOPIC_IDX_SLOT_EMPTY   = 0,
+   MQTT_TOPIC_IDX_SLOT_USED    = 1,
+   MQTT_TOPIC_IDX_SLOT_DELETED = 2
+
+} MQTT_TOPIC_IDX_SlotState_t;
+
+
+typedef struct
+{
+
+   uint8   State;
+   uint16  PluginId;
+   uint16  NameLen;
+   uint32  Hash;
+   const char *Name;
+
+} MQTT_TOPIC_IDX_Entry_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint16  EntryCnt;
+   MQTT_TOPIC_IDX_Entry_t Entry[MQTT_TOPIC_IDX_SIZE];
+
+} MQTT_TOPIC_IDX_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_TOPIC_IDX instance.
+**
+*/
+void MQTT_TOPIC_IDX_Constructor(MQTT_TOPIC_IDX_Class_t *MqttTopicIdxPtr);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Add
+**
+** Add a topic name. Returns false if the index is full.
+**
+** Notes:
+**   1. Adding a name that is already indexed updates its plugin ID.
+**   2. Name must remain valid until it is removed.
+**
+*/
+bool MQTT_TOPIC_IDX_Add(const char *Name, uint16 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Find
+**
+** Return the plugin ID of a topic name or JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF
+** if the name isn't indexed.
+**
+** Notes:
+**   1. Name doesn't need to be NUL terminated.
+**
+*/
+int32 MQTT_TOPIC_IDX_Find(const char *Name, uint16 NameLen);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_IDX_Remove
+**
+** Remove a topic name. Returns false if the name isn't indexed.
+**
+*/
+bool MQTT_TOPIC_IDX_Remove(const char *Name);
+
+
+#endif /* _mqtt_topic_idx_ */
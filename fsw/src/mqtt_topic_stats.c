@@ -0,0 +1,368 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Maintain message counters for each topic plugin
+**
+** Notes:
+**   1. See mqtt_topic_stats.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include "mqtt_topic_stats.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define VALID_PLUGIN_ID(Id)  ((Id) >= 0 && (Id) < JMSG_PLATFORM_TOPIC_PLUGIN_MAX)
+
+#define COUNT(Counter, Value)  __atomic_fetch_add(&(Counter), (Value), __ATOMIC_RELAXED)
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 ElapsedUsec(const CFE_TIME_SysTime_t *StartTime);
+static void   SendTlm(void);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_TOPIC_STATS_Class_t *MqttTopicStats = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_Constructor
+**
+*/
+void MQTT_TOPIC_STATS_Constructor(MQTT_TOPIC_STATS_Class_t *MqttTopicStatsPtr,
+                                  const INITBL_Class_t *IniTbl)
+{
+
+   uint32 i;
+
+   MqttTopicStats = MqttTopicStatsPtr;
+
+   CFE_PSP_MemSet((void*)MqttTopicStats, 0, sizeof(MQTT_TOPIC_STATS_Class_t));
+
+   MqttTopicStats->TlmPeriod = INITBL_GetIntConfig(IniTbl, CFG_TOPIC_STATS_TLM_PERIOD);
+   for (i = 0; i < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; i++)
+   {
+      MqttTopicStats->Topic[i].SubAckCode = MQTT_TOPIC_STATS_SUBACK_NONE;
+   }
+
+   CFE_MSG_Init(CFE_MSG_PTR(MqttTopicStats->TopicStatsTlm.TelemetryHeader),
+                CFE_SB_ValueToMsgId(INITBL_GetIntConfig(IniTbl, CFG_JMSG_MQTT_TOPIC_STATS_TLM_TOPICID)),
+                sizeof(JMSG_MQTT_TopicStatsTlm_t));
+
+} /* End MQTT_TOPIC_STATS_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ClearSubAck
+**
+*/
+void MQTT_TOPIC_STATS_ClearSubAck(int32 PluginId)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      __atomic_store_n(&MqttTopicStats->Topic[PluginId].SubAckCode, MQTT_TOPIC_STATS_SUBACK_NONE, __ATOMIC_RELAXED);
+   }
+
+} /* End MQTT_TOPIC_STATS_ClearSubAck() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountDeflate
+**
+*/
+void MQTT_TOPIC_STATS_CountDeflate(int32 PluginId, uint32 InBytes, uint32 OutBytes,
+                                   const CFE_TIME_SysTime_t *StartTime)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].DeflateMsgCnt, 1);
+      COUNT(MqttTopicStats->Topic[PluginId].DeflateInBytes, InBytes);
+      COUNT(MqttTopicStats->Topic[PluginId].DeflateOutBytes, OutBytes);
+      COUNT(MqttTopicStats->Topic[PluginId].DeflateTime, ElapsedUsec(StartTime));
+   }
+
+} /* End MQTT_TOPIC_STATS_CountDeflate() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountDrop
+**
+*/
+void MQTT_TOPIC_STATS_CountDrop(int32 PluginId)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].DropCnt, 1);
+   }
+
+} /* End MQTT_TOPIC_STATS_CountDrop() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountInflate
+**
+*/
+void MQTT_TOPIC_STATS_CountInflate(int32 PluginId, const CFE_TIME_SysTime_t *StartTime)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].InflateMsgCnt, 1);
+      COUNT(MqttTopicStats->Topic[PluginId].InflateTime, ElapsedUsec(StartTime));
+   }
+
+} /* End MQTT_TOPIC_STATS_CountInflate() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountMqttMsg
+**
+*/
+void MQTT_TOPIC_STATS_CountMqttMsg(int32 PluginId, uint32 Bytes)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].MqttMsgCnt, 1);
+      COUNT(MqttTopicStats->Topic[PluginId].MqttBytes, Bytes);
+   }
+
+} /* End MQTT_TOPIC_STATS_CountMqttMsg() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountPublishErr
+**
+*/
+void MQTT_TOPIC_STATS_CountPublishErr(int32 PluginId)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].PublishErrCnt, 1);
+   }
+
+} /* End MQTT_TOPIC_STATS_CountPublishErr() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountSbMsg
+**
+*/
+void MQTT_TOPIC_STATS_CountSbMsg(int32 PluginId, uint32 Bytes)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].SbMsgCnt, 1);
+      COUNT(MqttTopicStats->Topic[PluginId].SbBytes, Bytes);
+   }
+
+} /* End MQTT_TOPIC_STATS_CountSbMsg() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountXlateErr
+**
+*/
+void MQTT_TOPIC_STATS_CountXlateErr(int32 PluginId)
+{
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      COUNT(MqttTopicStats->Topic[PluginId].XlateErrCnt, 1);
+   }
+
+} /* End MQTT_TOPIC_STATS_CountXlateErr() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ManageTlm
+**
+*/
+void MQTT_TOPIC_STATS_ManageTlm(void)
+{
+
+   if (MqttTopicStats->TlmPeriod > 0)
+   {
+      if (++MqttTopicStats->TlmCycleCnt >= MqttTopicStats->TlmPeriod)
+      {
+         MqttTopicStats->TlmCycleCnt = 0;
+         SendTlm();
+      }
+   }
+
+} /* End MQTT_TOPIC_STATS_ManageTlm() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ResetStatus
+**
+** Notes:
+**   1. A count made by the other task while the counters are being reset
+**      may be lost.
+**
+*/
+void MQTT_TOPIC_STATS_ResetStatus(void)
+{
+
+   JMSG_MQTT_TopicStats_t *Stats;
+   uint32 i;
+
+   for (i = 0; i < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; i++)
+   {
+      Stats = &MqttTopicStats->Topic[i];
+      __atomic_store_n(&Stats->SbMsgCnt,      0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->SbBytes,       0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->MqttMsgCnt,    0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->MqttBytes,     0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->XlateErrCnt,   0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->PublishErrCnt, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->DropCnt,       0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->DeflateMsgCnt,   0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->DeflateInBytes,  0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->DeflateOutBytes, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->DeflateTime,     0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->InflateMsgCnt,   0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->InflateTime,     0, __ATOMIC_RELAXED);
+      __atomic_store_n(&Stats->SubRejectCnt,    0, __ATOMIC_RELAXED);
+   }
+
+} /* End MQTT_TOPIC_STATS_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_SendTlmCmd
+**
+*/
+bool MQTT_TOPIC_STATS_SendTlmCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   SendTlm();
+
+   return true;
+
+} /* End MQTT_TOPIC_STATS_SendTlmCmd() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_SetSubAck
+**
+** Notes:
+**   1. Only the network owner writes SubAckCode so it can be read and
+**      updated without an atomic compare.
+**
+*/
+void MQTT_TOPIC_STATS_SetSubAck(int32 PluginId, uint8 ReturnCode)
+{
+
+   JMSG_MQTT_TopicStats_t *Stats;
+
+   if (VALID_PLUGIN_ID(PluginId))
+   {
+      Stats = &MqttTopicStats->Topic[PluginId];
+      if (Stats->SubAckCode == MQTT_TOPIC_STATS_SUBACK_NONE || ReturnCode > Stats->SubAckCode)
+      {
+         __atomic_store_n(&Stats->SubAckCode, ReturnCode, __ATOMIC_RELAXED);
+      }
+      if (ReturnCode >= 0x80)
+      {
+         COUNT(Stats->SubRejectCnt, 1);
+      }
+   }
+
+} /* End MQTT_TOPIC_STATS_SetSubAck() */
+
+
+/******************************************************************************
+** Function: ElapsedUsec
+**
+** Return the microseconds from StartTime to now.
+**
+*/
+static uint32 ElapsedUsec(const CFE_TIME_SysTime_t *StartTime)
+{
+
+   CFE_TIME_SysTime_t EndTime = CFE_TIME_GetTime();
+   CFE_TIME_SysTime_t Delta;
+
+   if (CFE_TIME_Compare(EndTime, *StartTime) != CFE_TIME_A_GT_B)
+   {
+      return 0;
+   }
+
+   Delta = CFE_TIME_Subtract(EndTime, *StartTime);
+
+   return Delta.Seconds * 1000000 + CFE_TIME_Sub2MicroSecs(Delta.Subseconds);
+
+} /* End ElapsedUsec() */
+
+
+/******************************************************************************
+** Function: SendTlm
+**
+** Copy the counters into the telemetry packet and send it.
+**
+*/
+static void SendTlm(void)
+{
+
+   const JMSG_MQTT_TopicStats_t *Stats;
+   JMSG_MQTT_TopicStats_t *Tlm;
+   uint32 i;
+
+   for (i = 0; i < JMSG_PLATFORM_TOPIC_PLUGIN_MAX; i++)
+   {
+      Stats = &MqttTopicStats->Topic[i];
+      Tlm   = &MqttTopicStats->TopicStatsTlm.Payload.Topic[i];
+
+      Tlm->SbMsgCnt      = __atomic_load_n(&Stats->SbMsgCnt,      __ATOMIC_RELAXED);
+      Tlm->SbBytes       = __atomic_load_n(&Stats->SbBytes,       __ATOMIC_RELAXED);
+      Tlm->MqttMsgCnt    = __atomic_load_n(&Stats->MqttMsgCnt,    __ATOMIC_RELAXED);
+      Tlm->MqttBytes     = __atomic_load_n(&Stats->MqttBytes,     __ATOMIC_RELAXED);
+      Tlm->XlateErrCnt   = __atomic_load_n(&Stats->XlateErrCnt,   __ATOMIC_RELAXED);
+      Tlm->PublishErrCnt = __atomic_load_n(&Stats->PublishErrCnt, __ATOMIC_RELAXED);
+      Tlm->DropCnt       = __atomic_load_n(&Stats->DropCnt,       __ATOMIC_RELAXED);
+      Tlm->DeflateMsgCnt   = __atomic_load_n(&Stats->DeflateMsgCnt,   __ATOMIC_RELAXED);
+      Tlm->DeflateInBytes  = __atomic_load_n(&Stats->DeflateInBytes,  __ATOMIC_RELAXED);
+      Tlm->DeflateOutBytes = __atomic_load_n(&Stats->DeflateOutBytes, __ATOMIC_RELAXED);
+      Tlm->DeflateTime     = __atomic_load_n(&Stats->DeflateTime,     __ATOMIC_RELAXED);
+      Tlm->InflateMsgCnt   = __atomic_load_n(&Stats->InflateMsgCnt,   __ATOMIC_RELAXED);
+      Tlm->InflateTime     = __atomic_load_n(&Stats->InflateTime,     __ATOMIC_RELAXED);
+      Tlm->SubAckCode      = __atomic_load_n(&Stats->SubAckCode,      __ATOMIC_RELAXED);
+      Tlm->SubRejectCnt    = __atomic_load_n(&Stats->SubRejectCnt,    __ATOMIC_RELAXED);
+   }
+
+   CFE_SB_TimeStampMsg(CFE_MSG_PTR(MqttTopicStats->TopicStatsTlm.TelemetryHeader));
+   CFE_SB_TransmitMsg(CFE_MSG_PTR(MqttTopicStats->TopicStatsTlm.TelemetryHeader), true);
+
+} /* End SendTlm() */
@@ -0,0 +1,220 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Maintain message counters for each topic plugin
+**
+** Notes:
+**   1. Counters are updated by the main task and the network owner task.
+**      Each counter is a 32-bit value updated with an atomic add and read
+**      with an atomic load so a telemetry packet never contains a torn
+**      value. Counters in the same packet may be sampled at slightly
+**      different times.
+**   2. Counters wrap at 2^32.
+**   3. SubAckCode is a plugin's subscription status rather than a counter,
+**      it isn't cleared by MQTT_TOPIC_STATS_ResetStatus().
+**
+*/
+#ifndef _mqtt_topic_stats_
+#define _mqtt_topic_stats_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+/* SubAckCode of a topic without a SUBACK since it was subscribed to */
+#define MQTT_TOPIC_STATS_SUBACK_NONE  0xFFFFFFFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   /*
+   ** Configuration
+   */
+
+   uint32  TlmPeriod;   /* Calls to MQTT_TOPIC_STATS_ManageTlm() between packets, 0=Disabled */
+   uint32  TlmCycleCnt;
+
+   /*
+   ** Counters indexed by plugin ID
+   */
+
+   JMSG_MQTT_TopicStats_t  Topic[JMSG_PLATFORM_TOPIC_PLUGIN_MAX];
+
+   /*
+   ** Telemetry Packets
+   */
+
+   JMSG_MQTT_TopicStatsTlm_t  TopicStatsTlm;
+
+} MQTT_TOPIC_STATS_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_TOPIC_STATS instance.
+**
+*/
+void MQTT_TOPIC_STATS_Constructor(MQTT_TOPIC_STATS_Class_t *MqttTopicStatsPtr,
+                                  const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ClearSubAck
+**
+** Set a plugin's SubAckCode to MQTT_TOPIC_STATS_SUBACK_NONE when its topic
+** is subscribed to
+**
+*/
+void MQTT_TOPIC_STATS_ClearSubAck(int32 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountDeflate
+**
+** Count a compressed payload and the time since StartTime
+**
+*/
+void MQTT_TOPIC_STATS_CountDeflate(int32 PluginId, uint32 InBytes, uint32 OutBytes,
+                                   const CFE_TIME_SysTime_t *StartTime);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountDrop
+**
+** Count a message that was neither published nor spooled or that was
+** discarded from the spool to make room for a newer message
+**
+** Notes:
+**   1. Invalid plugin IDs are ignored by all of the count functions
+**
+*/
+void MQTT_TOPIC_STATS_CountDrop(int32 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountInflate
+**
+** Count a decompressed payload and the time since StartTime
+**
+*/
+void MQTT_TOPIC_STATS_CountInflate(int32 PluginId, const CFE_TIME_SysTime_t *StartTime);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountMqttMsg
+**
+** Count an MQTT message translated to an SB message
+**
+*/
+void MQTT_TOPIC_STATS_CountMqttMsg(int32 PluginId, uint32 Bytes);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountPublishErr
+**
+** Count a failed MQTT publish
+**
+*/
+void MQTT_TOPIC_STATS_CountPublishErr(int32 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountSbMsg
+**
+** Count an SB message translated to an MQTT message
+**
+*/
+void MQTT_TOPIC_STATS_CountSbMsg(int32 PluginId, uint32 Bytes);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_CountXlateErr
+**
+** Count a translation failure in either direction
+**
+*/
+void MQTT_TOPIC_STATS_CountXlateErr(int32 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ManageTlm
+**
+** Send the topic statistics packet every TOPIC_STATS_TLM_PERIOD calls
+**
+*/
+void MQTT_TOPIC_STATS_ManageTlm(void);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_TOPIC_STATS_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_SendTlmCmd
+**
+** Send the topic statistics packet
+**
+** Notes:
+**   1. Signature must match CMDMGR_CmdFuncPtr_t
+**
+*/
+bool MQTT_TOPIC_STATS_SendTlmCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_STATS_SetSubAck
+**
+** Record a SUBACK return code for one of a plugin's topic filters
+**
+** Notes:
+**   1. The highest code since MQTT_TOPIC_STATS_ClearSubAck() is kept so a
+**      rejection of either a topic or its CBOR topic is reported. Codes of
+**      0x80 and greater are counted as rejections.
+**
+*/
+void MQTT_TOPIC_STATS_SetSubAck(int32 PluginId, uint8 ReturnCode);
+
+
+#endif /* _mqtt_topic_stats_ */
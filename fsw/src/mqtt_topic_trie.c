@@ -0,0 +1,449 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Match inbound MQTT topic names against wildcard topic filters
+**
+** Notes:
+**   1. See mqtt_topic_trie.h
+**   2. Level positions are uint32 so the position following the last
+**      level, NameLen + 1, can't overflow.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_topic_trie.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+/* A filter can't have more levels than characters plus one */
+#define TRIE_LEVEL_MAX  (JMSG_PLATFORM_TOPIC_NAME_MAX_LEN + 1)
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint16 AllocNode(const char *Level, uint16 LevelLen);
+static uint16 FindChild(uint16 Parent, const char *Level, uint32 LevelLen);
+static void FreeNode(uint16 Parent, uint16 Child);
+static uint32 LevelEnd(const char *Name, uint32 NameLen, uint32 Start);
+static uint16 MatchNode(uint16 NodeIdx, const char *Name, uint32 NameLen, uint32 Start);
+static bool ValidFilter(const char *Filter, uint32 FilterLen, uint16 *LevelCnt);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_TOPIC_TRIE_Class_t *MqttTopicTrie = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Constructor
+**
+*/
+void MQTT_TOPIC_TRIE_Constructor(MQTT_TOPIC_TRIE_Class_t *MqttTopicTriePtr)
+{
+
+   uint16 i;
+
+   MqttTopicTrie = MqttTopicTriePtr;
+
+   CFE_PSP_MemSet((void*)MqttTopicTrie, 0, sizeof(MQTT_TOPIC_TRIE_Class_t));
+
+   MqttTopicTrie->Node[0].PluginId    = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+   MqttTopicTrie->Node[0].FirstChild  = MQTT_TOPIC_TRIE_NULL_NODE;
+   MqttTopicTrie->Node[0].NextSibling = MQTT_TOPIC_TRIE_NULL_NODE;
+   MqttTopicTrie->NodeCnt = 1;
+
+   /* Free nodes are linked through NextSibling */
+   for (i = 1; i < MQTT_TOPIC_TRIE_NODE_MAX; i++)
+   {
+      MqttTopicTrie->Node[i].NextSibling = (i + 1 < MQTT_TOPIC_TRIE_NODE_MAX) ? (i + 1) : MQTT_TOPIC_TRIE_NULL_NODE;
+   }
+   MqttTopicTrie->FreeNode = (MQTT_TOPIC_TRIE_NODE_MAX > 1) ? 1 : MQTT_TOPIC_TRIE_NULL_NODE;
+
+} /* End MQTT_TOPIC_TRIE_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Add
+**
+** Notes:
+**   1. The number of missing nodes is checked before any are allocated so
+**      a failed add doesn't leave a partial path.
+**
+*/
+bool MQTT_TOPIC_TRIE_Add(const char *Filter, uint16 PluginId)
+{
+
+   uint32 FilterLen = strlen(Filter);
+   uint32 Start = 0;
+   uint32 End;
+   uint16 LevelCnt;
+   uint16 Level = 0;
+   uint16 NodeIdx = 0;
+   uint16 Child;
+   MQTT_TOPIC_TRIE_Node_t *Node;
+
+   if (!ValidFilter(Filter, FilterLen, &LevelCnt))
+   {
+      return false;
+   }
+
+   /* Descend through the existing nodes */
+   while (Level < LevelCnt)
+   {
+      End   = LevelEnd(Filter, FilterLen, Start);
+      Child = FindChild(NodeIdx, &Filter[Start], End - Start);
+      if (Child == MQTT_TOPIC_TRIE_NULL_NODE)
+      {
+         break;
+      }
+      NodeIdx = Child;
+      Start   = End + 1;
+      Level++;
+   }
+
+   if ((LevelCnt - Level) > (MQTT_TOPIC_TRIE_NODE_MAX - MqttTopicTrie->NodeCnt))
+   {
+      return false;
+   }
+
+   /* Create the remaining levels */
+   while (Level < LevelCnt)
+   {
+      End   = LevelEnd(Filter, FilterLen, Start);
+      Child = AllocNode(&Filter[Start], End - Start);
+      MqttTopicTrie->Node[Child].NextSibling = MqttTopicTrie->Node[NodeIdx].FirstChild;
+      MqttTopicTrie->Node[NodeIdx].FirstChild = Child;
+      NodeIdx = Child;
+      Start   = End + 1;
+      Level++;
+   }
+
+   Node = &MqttTopicTrie->Node[NodeIdx];
+   if (Node->PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
+   {
+      MqttTopicTrie->FilterCnt++;
+   }
+   Node->PluginId = PluginId;
+
+   return true;
+
+} /* End MQTT_TOPIC_TRIE_Add() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_IsFilter
+**
+*/
+bool MQTT_TOPIC_TRIE_IsFilter(const char *Name)
+{
+
+   return (strpbrk(Name, "+#") != NULL);
+
+} /* End MQTT_TOPIC_TRIE_IsFilter() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Match
+**
+*/
+int32 MQTT_TOPIC_TRIE_Match(const char *Name, uint16 NameLen)
+{
+
+   int32 PluginId = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+
+   if (MqttTopicTrie->FilterCnt > 0)
+   {
+      PluginId = MatchNode(0, Name, NameLen, 0);
+   }
+
+   return PluginId;
+
+} /* End MQTT_TOPIC_TRIE_Match() */
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Remove
+**
+** Notes:
+**   1. Nodes on the filter's path that no longer end a filter or lead to
+**      one are returned to the pool.
+**
+*/
+bool MQTT_TOPIC_TRIE_Remove(const char *Filter)
+{
+
+   uint32 FilterLen = strlen(Filter);
+   uint32 Start = 0;
+   uint32 End;
+   uint16 LevelCnt;
+   uint16 Level;
+   uint16 Path[TRIE_LEVEL_MAX + 1];
+   MQTT_TOPIC_TRIE_Node_t *Node;
+
+   if (!ValidFilter(Filter, FilterLen, &LevelCnt))
+   {
+      return false;
+   }
+
+   Path[0] = 0;
+   for (Level = 1; Level <= LevelCnt; Level++)
+   {
+      End = LevelEnd(Filter, FilterLen, Start);
+      Path[Level] = FindChild(Path[Level-1], &Filter[Start], End - Start);
+      if (Path[Level] == MQTT_TOPIC_TRIE_NULL_NODE)
+      {
+         return false;
+      }
+      Start = End + 1;
+   }
+
+   Node = &MqttTopicTrie->Node[Path[LevelCnt]];
+   if (Node->PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
+   {
+      return false;
+   }
+   Node->PluginId = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+   MqttTopicTrie->FilterCnt--;
+
+   for (Level = LevelCnt; Level > 0; Level--)
+   {
+      Node = &MqttTopicTrie->Node[Path[Level]];
+      if (Node->PluginId != JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF || Node->FirstChild != MQTT_TOPIC_TRIE_NULL_NODE)
+      {
+         break;
+      }
+      FreeNode(Path[Level-1], Path[Level]);
+   }
+
+   return true;
+
+} /* End MQTT_TOPIC_TRIE_Remove() */
+
+
+/******************************************************************************
+** Function: AllocNode
+**
+** Notes:
+**   1. The caller must verify a node is available.
+**
+*/
+static uint16 AllocNode(const char *Level, uint16 LevelLen)
+{
+
+   uint16 NodeIdx = MqttTopicTrie->FreeNode;
+   MQTT_TOPIC_TRIE_Node_t *Node = &MqttTopicTrie->Node[NodeIdx];
+
+   MqttTopicTrie->FreeNode = Node->NextSibling;
+   MqttTopicTrie->NodeCnt++;
+
+   Node->Level       = Level;
+   Node->LevelLen    = LevelLen;
+   Node->PluginId    = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+   Node->FirstChild  = MQTT_TOPIC_TRIE_NULL_NODE;
+   Node->NextSibling = MQTT_TOPIC_TRIE_NULL_NODE;
+
+   return NodeIdx;
+
+} /* End AllocNode() */
+
+
+/******************************************************************************
+** Function: FindChild
+**
+** Return the child of Parent with an identical level or
+** MQTT_TOPIC_TRIE_NULL_NODE.
+**
+*/
+static uint16 FindChild(uint16 Parent, const char *Level, uint32 LevelLen)
+{
+
+   uint16 Child = MqttTopicTrie->Node[Parent].FirstChild;
+   const MQTT_TOPIC_TRIE_Node_t *Node;
+
+   while (Child != MQTT_TOPIC_TRIE_NULL_NODE)
+   {
+      Node = &MqttTopicTrie->Node[Child];
+      if (Node->LevelLen == LevelLen && memcmp(Node->Level, Level, LevelLen) == 0)
+      {
+         break;
+      }
+      Child = Node->NextSibling;
+   }
+
+   return Child;
+
+} /* End FindChild() */
+
+
+/******************************************************************************
+** Function: FreeNode
+**
+** Unlink a childless node from its parent and return it to the pool.
+**
+*/
+static void FreeNode(uint16 Parent, uint16 Child)
+{
+
+   uint16 *Link = &MqttTopicTrie->Node[Parent].FirstChild;
+
+   while (*Link != Child)
+   {
+      Link = &MqttTopicTrie->Node[*Link].NextSibling;
+   }
+   *Link = MqttTopicTrie->Node[Child].NextSibling;
+
+   MqttTopicTrie->Node[Child].Level       = NULL;
+   MqttTopicTrie->Node[Child].NextSibling = MqttTopicTrie->FreeNode;
+   MqttTopicTrie->FreeNode = Child;
+   MqttTopicTrie->NodeCnt--;
+
+} /* End FreeNode() */
+
+
+/******************************************************************************
+** Function: LevelEnd
+**
+** Return the position of the '/' ending the level that begins at Start or
+** NameLen for the last level.
+**
+*/
+static uint32 LevelEnd(const char *Name, uint32 NameLen, uint32 Start)
+{
+
+   const char *Separator = memchr(&Name[Start], '/', NameLen - Start);
+
+   return (Separator != NULL) ? (uint32)(Separator - Name) : NameLen;
+
+} /* End LevelEnd() */
+
+
+/******************************************************************************
+** Function: MatchNode
+**
+** Match the levels of Name beginning at Start against the children of
+** NodeIdx. Start is NameLen + 1 when every level has been matched.
+**
+** Notes:
+**   1. A '#' child also matches when no levels remain so "a/#" matches "a".
+**   2. Recursion depth is limited by the number of levels in Name.
+**
+*/
+static uint16 MatchNode(uint16 NodeIdx, const char *Name, uint32 NameLen, uint32 Start)
+{
+
+   uint16 PluginId = JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF;
+   uint16 Child;
+   uint32 End;
+   bool   WildcardOk;
+
+   if (Start > NameLen)
+   {
+      PluginId = MqttTopicTrie->Node[NodeIdx].PluginId;
+      if (PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
+      {
+         Child = FindChild(NodeIdx, "#", 1);
+         if (Child != MQTT_TOPIC_TRIE_NULL_NODE)
+         {
+            PluginId = MqttTopicTrie->Node[Child].PluginId;
+         }
+      }
+      return PluginId;
+   }
+
+   End = LevelEnd(Name, NameLen, Start);
+   WildcardOk = !(NodeIdx == 0 && NameLen > 0 && Name[0] == '$');
+
+   Child = FindChild(NodeIdx, &Name[Start], End - Start);
+   if (Child != MQTT_TOPIC_TRIE_NULL_NODE)
+   {
+      PluginId = MatchNode(Child, Name, NameLen, End + 1);
+   }
+
+   if (PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF && WildcardOk)
+   {
+      Child = FindChild(NodeIdx, "+", 1);
+      if (Child != MQTT_TOPIC_TRIE_NULL_NODE)
+      {
+         PluginId = MatchNode(Child, Name, NameLen, End + 1);
+      }
+      if (PluginId == JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF)
+      {
+         Child = FindChild(NodeIdx, "#", 1);
+         if (Child != MQTT_TOPIC_TRIE_NULL_NODE)
+         {
+            PluginId = MqttTopicTrie->Node[Child].PluginId;
+         }
+      }
+   }
+
+   return PluginId;
+
+} /* End MatchNode() */
+
+
+/******************************************************************************
+** Function: ValidFilter
+**
+** Verify wildcards occupy an entire level and '#' is the last level.
+** Returns the number of levels in LevelCnt.
+**
+*/
+static bool ValidFilter(const char *Filter, uint32 FilterLen, uint16 *LevelCnt)
+{
+
+   bool   RetStatus = true;
+   uint32 Start = 0;
+   uint32 End;
+   uint32 i;
+
+   *LevelCnt = 0;
+
+   while (RetStatus)
+   {
+      End = LevelEnd(Filter, FilterLen, Start);
+      for (i = Start; i < End; i++)
+      {
+         if ((Filter[i] == '+' || Filter[i] == '#') && (End - Start) != 1)
+         {
+            RetStatus = false;
+         }
+      }
+      if (Filter[Start] == '#' && End != FilterLen)
+      {
+         RetStatus = false;
+      }
+      (*LevelCnt)++;
+      if (End == FilterLen)
+      {
+         break;
+      }
+      Start = End + 1;
+   }
+
+   return RetStatus;
+
+} /* End ValidFilter() */
@@ -0,0 +1,144 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Match inbound MQTT topic names against wildcard topic filters
+**
+** Notes:
+**   1. Each trie node is one topic level. A filter's plugin ID is stored
+**      in the node of its last level. The single level wildcard '+' and
+**      the multi-level wildcard '#' are stored as ordinary levels and
+**      handled by MQTT_TOPIC_TRIE_Match().
+**   2. Nodes are allocated from a fixed pool and returned to it when a
+**      removed filter leaves them unused.
+**   3. Node levels point at the topic table's names rather than copying
+**      them.
+**   4. Only the network owner task may modify or search the trie.
+**
+*/
+#ifndef _mqtt_topic_trie_
+#define _mqtt_topic_trie_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define MQTT_TOPIC_TRIE_NULL_NODE  0xFFFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef struct
+{
+
+   const char *Level;
+   uint16  LevelLen;
+   uint16  PluginId;      /* JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF if no filter ends here */
+   uint16  FirstChild;
+   uint16  NextSibling;
+
+} MQTT_TOPIC_TRIE_Node_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint16  FilterCnt;
+   uint16  NodeCnt;
+   uint16  FreeNode;
+   MQTT_TOPIC_TRIE_Node_t Node[MQTT_TOPIC_TRIE_NODE_MAX];   /* Node[0] is the root */
+
+} MQTT_TOPIC_TRIE_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_TOPIC_TRIE instance.
+**
+*/
+void MQTT_TOPIC_TRIE_Constructor(MQTT_TOPIC_TRIE_Class_t *MqttTopicTriePtr);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Add
+**
+** Add a topic filter. Returns false if the filter is invalid or the node
+** pool is exhausted.
+**
+** Notes:
+**   1. Adding a filter that already exists updates its plugin ID.
+**   2. Filter must remain valid until it is removed.
+**
+*/
+bool MQTT_TOPIC_TRIE_Add(const char *Filter, uint16 PluginId);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_IsFilter
+**
+** Return true if a topic name contains a wildcard.
+**
+*/
+bool MQTT_TOPIC_TRIE_IsFilter(const char *Name);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Match
+**
+** Return the plugin ID of the filter that matches a topic name or
+** JMSG_PLATFORM_TOPIC_PLUGIN_UNDEF if no filter matches.
+**
+** Notes:
+**   1. Name doesn't need to be NUL terminated.
+**   2. When more than one filter matches, an exact level is preferred over
+**      '+' and '+' over '#' at each level.
+**   3. Names beginning with '$' aren't matched by a wildcard in the first
+**      level as required by the MQTT specification.
+**
+*/
+int32 MQTT_TOPIC_TRIE_Match(const char *Name, uint16 NameLen);
+
+
+/******************************************************************************
+** Function: MQTT_TOPIC_TRIE_Remove
+**
+** Remove a topic filter. Returns false if the filter isn't in the trie.
+**
+*/
+bool MQTT_TOPIC_TRIE_Remove(const char *Filter);
+
+
+#endif /* _mqtt_topic_trie_ */
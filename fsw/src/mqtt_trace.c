@@ -0,0 +1,151 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Record per-message trace records in a binary ring buffer
+**
+** Notes:
+**   1. See mqtt_trace.h
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_trace.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define TRACE_INDEX_MASK  (MQTT_TRACE_REC_MAX - 1)
+
+#if (MQTT_TRACE_REC_MAX & TRACE_INDEX_MASK) != 0
+   #error MQTT_TRACE_REC_MAX must be a power of 2
+#endif
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_TRACE_Class_t *MqttTrace = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_Constructor
+**
+*/
+void MQTT_TRACE_Constructor(MQTT_TRACE_Class_t *MqttTracePtr,
+                            const INITBL_Class_t *IniTbl)
+{
+
+   MqttTrace = MqttTracePtr;
+
+   CFE_PSP_MemSet((void*)MqttTrace, 0, sizeof(MQTT_TRACE_Class_t));
+
+   strncpy(MqttTrace->DefaultFilename, INITBL_GetStrConfig(IniTbl, CFG_TRACE_FILE), OS_MAX_PATH_LEN - 1);
+
+} /* End MQTT_TRACE_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_DumpCmd
+**
+*/
+bool MQTT_TRACE_DumpCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr)
+{
+
+   const JMSG_MQTT_DumpTrace_CmdPayload_t *DumpTraceCmd = CMDMGR_PAYLOAD_PTR(MsgPtr, JMSG_MQTT_DumpTrace_t);
+
+   bool       RetStatus = false;
+   int32      SysStatus;
+   osal_id_t  FileHandle;
+   const char *Filename;
+   MQTT_TRACE_FileHdr_t FileHdr;
+   uint32     Next;
+   uint32     First;
+   uint32     i;
+
+   Filename = (DumpTraceCmd->Filename[0] == '\0') ? MqttTrace->DefaultFilename : DumpTraceCmd->Filename;
+
+   SysStatus = OS_OpenCreate(&FileHandle, Filename, OS_FILE_FLAG_CREATE | OS_FILE_FLAG_TRUNCATE, OS_WRITE_ONLY);
+
+   if (SysStatus == OS_SUCCESS)
+   {
+
+      Next  = __atomic_load_n(&MqttTrace->Next, __ATOMIC_ACQUIRE);
+      First = (Next > MQTT_TRACE_REC_MAX) ? (Next - MQTT_TRACE_REC_MAX) : 0;
+
+      FileHdr.Magic       = MQTT_TRACE_FILE_MAGIC;
+      FileHdr.RecLen      = sizeof(MQTT_TRACE_Rec_t);
+      FileHdr.RecCnt      = Next - First;
+      FileHdr.TotalRecCnt = Next;
+
+      RetStatus = (OS_write(FileHandle, &FileHdr, sizeof(FileHdr)) == sizeof(FileHdr));
+
+      for (i = First; RetStatus && i < Next; i++)
+      {
+         RetStatus = (OS_write(FileHandle, &MqttTrace->Rec[i & TRACE_INDEX_MASK], sizeof(MQTT_TRACE_Rec_t)) ==
+                      sizeof(MQTT_TRACE_Rec_t));
+      }
+
+      OS_close(FileHandle);
+
+      if (RetStatus)
+      {
+         CFE_EVS_SendEvent(MQTT_TRACE_DUMP_EID, CFE_EVS_EventType_INFORMATION,
+                           "Wrote %d trace records to %s", FileHdr.RecCnt, Filename);
+      }
+      else
+      {
+         CFE_EVS_SendEvent(MQTT_TRACE_DUMP_ERR_EID, CFE_EVS_EventType_ERROR,
+                           "Error writing trace records to %s", Filename);
+      }
+
+   } /* End if file created */
+   else
+   {
+      CFE_EVS_SendEvent(MQTT_TRACE_DUMP_ERR_EID, CFE_EVS_EventType_ERROR,
+                        "Error creating trace dump file %s, status %d", Filename, SysStatus);
+   }
+
+   return RetStatus;
+
+} /* End MQTT_TRACE_DumpCmd() */
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_Write
+**
+*/
+void MQTT_TRACE_Write(MQTT_TRACE_Dir_t Dir, MQTT_TRACE_Result_t Result,
+                      uint16 TopicId, uint32 Len)
+{
+
+   CFE_TIME_SysTime_t Time = CFE_TIME_GetTime();
+   MQTT_TRACE_Rec_t  *Rec  = &MqttTrace->Rec[__atomic_fetch_add(&MqttTrace->Next, 1, __ATOMIC_RELAXED) & TRACE_INDEX_MASK];
+
+   Rec->Seconds    = Time.Seconds;
+   Rec->Subseconds = Time.Subseconds;
+   Rec->Dir        = Dir;
+   Rec->Result     = Result;
+   Rec->TopicId    = TopicId;
+   Rec->Len        = Len;
+
+} /* End MQTT_TRACE_Write() */
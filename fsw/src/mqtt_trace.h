@@ -0,0 +1,166 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Record per-message trace records in a binary ring buffer
+**
+** Notes:
+**   1. Replaces per-message event messages on the translation and publish
+**      paths. The ring can be written to a file by command.
+**   2. Records are written by the main task and the network owner task so
+**      a slot is claimed with an atomic increment. The newest record
+**      overwrites the oldest.
+**   3. A dump doesn't stop writers so a record being written during a dump
+**      may be incomplete in the file.
+**
+*/
+#ifndef _mqtt_trace_
+#define _mqtt_trace_
+
+/*
+** Includes
+*/
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_TRACE_DUMP_EID      (MQTT_TRACE_BASE_EID + 0)
+#define MQTT_TRACE_DUMP_ERR_EID  (MQTT_TRACE_BASE_EID + 1)
+
+#define MQTT_TRACE_FILE_MAGIC   0x4D545243   /* "MTRC" */
+#define MQTT_TRACE_TOPIC_UNDEF  0xFFFF
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef enum
+{
+
+   MQTT_TRACE_DIR_SB_TO_MQTT = 1,   /* SB message translated to JSON  */
+   MQTT_TRACE_DIR_PUBLISH    = 2,   /* MQTT message sent to the broker */
+   MQTT_TRACE_DIR_MQTT_TO_SB = 3    /* MQTT message translated to SB  */
+
+} MQTT_TRACE_Dir_t;
+
+
+typedef enum
+{
+
+   MQTT_TRACE_RESULT_OK            = 0,
+   MQTT_TRACE_RESULT_UNKNOWN_TOPIC = 1,
+   MQTT_TRACE_RESULT_XLATE_ERR     = 2,
+   MQTT_TRACE_RESULT_PUBLISH_ERR   = 3,
+   MQTT_TRACE_RESULT_EMPTY_MSG     = 4
+
+} MQTT_TRACE_Result_t;
+
+
+typedef struct
+{
+
+   uint32  Seconds;
+   uint32  Subseconds;
+   uint8   Dir;
+   uint8   Result;
+   uint16  TopicId;
+   uint32  Len;
+
+} MQTT_TRACE_Rec_t;
+
+
+/*
+** Dump file header. RecCnt records follow the header, oldest first.
+*/
+
+typedef struct
+{
+
+   uint32  Magic;
+   uint32  RecLen;
+   uint32  RecCnt;
+   uint32  TotalRecCnt;   /* Records written since the app started */
+
+} MQTT_TRACE_FileHdr_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   char    DefaultFilename[OS_MAX_PATH_LEN];
+
+   /* Free running, masked when indexing Rec[] */
+   volatile uint32  Next;
+
+   MQTT_TRACE_Rec_t Rec[MQTT_TRACE_REC_MAX];
+
+} MQTT_TRACE_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_TRACE instance.
+**
+*/
+void MQTT_TRACE_Constructor(MQTT_TRACE_Class_t *MqttTracePtr,
+                            const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_DumpCmd
+**
+** Write the trace ring to a file
+**
+** Notes:
+**   1. Signature must match CMDMGR_CmdFuncPtr_t
+**   2. An empty filename uses the ini file's TRACE_FILE
+**
+*/
+bool MQTT_TRACE_DumpCmd(void* DataObjPtr, const CFE_MSG_Message_t *MsgPtr);
+
+
+/******************************************************************************
+** Function: MQTT_TRACE_Write
+**
+** Add a trace record
+**
+*/
+void MQTT_TRACE_Write(MQTT_TRACE_Dir_t Dir, MQTT_TRACE_Result_t Result,
+                      uint16 TopicId, uint32 Len);
+
+
+#endif /* _mqtt_trace_ */
@@ -0,0 +1,898 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Encode and decode the MQTT 5 packets used by MQTT_CLIENT
+**
+** Notes:
+**   1. See mqtt_v5.h. Property identifiers and packet layouts are from the
+**      OASIS MQTT Version 5.0 standard.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include <string.h>
+
+#include "mqtt_v5.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define MQTT_V5_PROTOCOL_LEVEL  5
+
+/* Property identifiers */
+#define PROP_PAYLOAD_FORMAT      0x01
+#define PROP_MSG_EXPIRY          0x02
+#define PROP_CONTENT_TYPE        0x03
+#define PROP_RESPONSE_TOPIC      0x08
+#define PROP_CORRELATION_DATA    0x09
+#define PROP_SUBSCRIPTION_ID     0x0B
+#define PROP_SESSION_EXPIRY      0x11
+#define PROP_ASSIGNED_CLIENT_ID  0x12
+#define PROP_SERVER_KEEP_ALIVE   0x13
+#define PROP_AUTH_METHOD         0x15
+#define PROP_AUTH_DATA           0x16
+#define PROP_REQ_PROBLEM_INFO    0x17
+#define PROP_WILL_DELAY          0x18
+#define PROP_REQ_RESPONSE_INFO   0x19
+#define PROP_RESPONSE_INFO       0x1A
+#define PROP_SERVER_REFERENCE    0x1C
+#define PROP_REASON_STRING       0x1F
+#define PROP_RECEIVE_MAX         0x21
+#define PROP_TOPIC_ALIAS_MAX     0x22
+#define PROP_TOPIC_ALIAS         0x23
+#define PROP_MAX_QOS             0x24
+#define PROP_RETAIN_AVAILABLE    0x25
+#define PROP_USER_PROPERTY       0x26
+#define PROP_MAX_PACKET_SIZE     0x27
+#define PROP_WILDCARD_SUB_AVAIL  0x28
+#define PROP_SUB_ID_AVAIL        0x29
+#define PROP_SHARED_SUB_AVAIL    0x2A
+
+
+/*******************************/
+/** Local Function Prototypes **/
+/*******************************/
+
+static uint32 DecodeFixedHeader(const uint8 *Packet, uint32 PacketLen, uint32 *RemLen);
+static uint32 DecodeProperty(const uint8 *Buf, uint32 Len, uint8 *Id, uint32 *Value);
+static uint32 DecodeVarInt(const uint8 *Buf, uint32 Len, uint32 *Value);
+static uint32 EncodeVarInt(uint8 *Buf, uint32 Value);
+static uint32 HashTopic(const char *Topic, uint16 TopicLen);
+static uint16 OutboundAlias(const char *Topic, uint16 TopicLen, bool *AliasOnly);
+static uint32 WriteFixedHeader(uint8 *Buf, uint32 BufLen, uint8 Byte0, uint32 RemLen);
+static uint32 WriteString(uint8 *Buf, const char *Str, uint16 StrLen);
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_V5_Class_t *MqttV5 = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_V5_Constructor
+**
+*/
+void MQTT_V5_Constructor(MQTT_V5_Class_t *MqttV5Ptr, const INITBL_Class_t *IniTbl)
+{
+
+   MqttV5 = MqttV5Ptr;
+
+   CFE_PSP_MemSet((void*)MqttV5, 0, sizeof(MQTT_V5_Class_t));
+
+   MqttV5->MsgExpirySec     = INITBL_GetIntConfig(IniTbl, CFG_MQTT5_MSG_EXPIRY_SEC);
+   MqttV5->SessionExpirySec = INITBL_GetIntConfig(IniTbl, CFG_MQTT5_SESSION_EXPIRY_SEC);
+   MqttV5->BrokerReceiveMax = MQTT_V5_RECEIVE_MAX_DEF;
+
+} /* End MQTT_V5_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_ConnAck
+**
+** Notes:
+**   1. The broker's Topic Alias Maximum is limited to the size of the
+**      outbound alias table. A broker that doesn't send one doesn't
+**      accept aliases.
+**
+*/
+bool MQTT_V5_ConnAck(const uint8 *Packet, uint32 PacketLen, uint8 *ReasonCode, bool *SessionPresent)
+{
+
+   uint32 RemLen;
+   uint32 Offset = DecodeFixedHeader(Packet, PacketLen, &RemLen);
+   uint32 PropLen;
+   uint32 PropEnd;
+   uint32 Len;
+   uint32 Value;
+   uint8  Id;
+   uint16 i;
+
+   if (Offset == 0 || (Packet[0] >> 4) != CONNACK || RemLen < 3)
+   {
+      return false;
+   }
+
+   *SessionPresent = ((Packet[Offset] & 0x01) != 0);
+   *ReasonCode     = Packet[Offset + 1];
+   Offset += 2;
+
+   MqttV5->BrokerReceiveMax    = MQTT_V5_RECEIVE_MAX_DEF;
+   MqttV5->BrokerTopicAliasMax = 0;
+   MqttV5->OutAliasCnt         = 0;
+   for (i = 0; i < MQTT_V5_TOPIC_ALIAS_MAX; i++)
+   {
+      MqttV5->InAlias[i].TopicLen = 0;
+   }
+
+   Len = DecodeVarInt(&Packet[Offset], PacketLen - Offset, &PropLen);
+   if (Len == 0 || (Offset + Len + PropLen) > PacketLen)
+   {
+      return false;
+   }
+   Offset += Len;
+   PropEnd = Offset + PropLen;
+
+   while (Offset < PropEnd)
+   {
+      Len = DecodeProperty(&Packet[Offset], PropEnd - Offset, &Id, &Value);
+      if (Len == 0)
+      {
+         return false;
+      }
+      if (Id == PROP_RECEIVE_MAX && Value > 0)
+      {
+         MqttV5->BrokerReceiveMax = Value;
+      }
+      else if (Id == PROP_TOPIC_ALIAS_MAX)
+      {
+         MqttV5->BrokerTopicAliasMax = (Value < MQTT_V5_TOPIC_ALIAS_MAX) ? Value : MQTT_V5_TOPIC_ALIAS_MAX;
+      }
+      Offset += Len;
+   }
+
+   if (*ReasonCode == 0)
+   {
+      CFE_EVS_SendEvent(MQTT_V5_CONNACK_EID, CFE_EVS_EventType_INFORMATION,
+                        "MQTT 5 broker receive maximum %d, %d topic aliases available",
+                        MqttV5->BrokerReceiveMax, MqttV5->BrokerTopicAliasMax);
+   }
+
+   return true;
+
+} /* End MQTT_V5_ConnAck() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_DecodePublish
+**
+*/
+bool MQTT_V5_DecodePublish(MQTTString *Topic, MQTTMessage *Msg, uint8 *Packet, uint32 PacketLen)
+{
+
+   uint32 RemLen;
+   uint32 Offset = DecodeFixedHeader(Packet, PacketLen, &RemLen);
+   uint32 PropLen;
+   uint32 PropEnd;
+   uint32 Len;
+   uint32 Value;
+   uint32 Alias = 0;
+   uint16 TopicLen;
+   uint8  Id;
+   char   *TopicName;
+   MQTT_V5_TopicAlias_t *InAlias;
+
+   if (Offset == 0 || (Offset + 2) > PacketLen)
+   {
+      return false;
+   }
+
+   Msg->dup      = (Packet[0] >> 3) & 0x01;
+   Msg->qos      = (enum QoS)((Packet[0] >> 1) & 0x03);
+   Msg->retained = Packet[0] & 0x01;
+   Msg->id       = 0;
+
+   TopicLen  = (Packet[Offset] << 8) | Packet[Offset + 1];
+   TopicName = (char *)&Packet[Offset + 2];
+   Offset   += 2 + TopicLen;
+
+   if (Msg->qos != QOS0)
+   {
+      if ((Offset + 2) > PacketLen)
+      {
+         return false;
+      }
+      Msg->id = (Packet[Offset] << 8) | Packet[Offset + 1];
+      Offset += 2;
+   }
+
+   if (Offset >= PacketLen)
+   {
+      return false;
+   }
+   Len = DecodeVarInt(&Packet[Offset], PacketLen - Offset, &PropLen);
+   if (Len == 0 || (Offset + Len + PropLen) > PacketLen)
+   {
+      return false;
+   }
+   Offset += Len;
+   PropEnd = Offset + PropLen;
+
+   while (Offset < PropEnd)
+   {
+      Len = DecodeProperty(&Packet[Offset], PropEnd - Offset, &Id, &Value);
+      if (Len == 0)
+      {
+         return false;
+      }
+      if (Id == PROP_TOPIC_ALIAS)
+      {
+         Alias = Value;
+      }
+      Offset += Len;
+   }
+
+   if (Alias > 0)
+   {
+      if (Alias > MQTT_V5_TOPIC_ALIAS_MAX || TopicLen >= JMSG_PLATFORM_TOPIC_NAME_MAX_LEN)
+      {
+         CFE_EVS_SendEvent(MQTT_V5_DECODE_ERR_EID, CFE_EVS_EventType_ERROR,
+                           "Received PUBLISH with invalid topic alias %d", (int)Alias);
+         return false;
+      }
+      InAlias = &MqttV5->InAlias[Alias - 1];
+      if (TopicLen > 0)
+      {
+         memcpy(InAlias->Topic, TopicName, TopicLen);
+         InAlias->TopicLen = TopicLen;
+      }
+      else if (InAlias->TopicLen > 0)
+      {
+         TopicName = InAlias->Topic;
+         TopicLen  = InAlias->TopicLen;
+      }
+      else
+      {
+         CFE_EVS_SendEvent(MQTT_V5_DECODE_ERR_EID, CFE_EVS_EventType_ERROR,
+                           "Received PUBLISH with undefined topic alias %d", (int)Alias);
+         return false;
+      }
+   }
+   else if (TopicLen == 0)
+   {
+      return false;
+   }
+
+   Topic->cstring        = NULL;
+   Topic->lenstring.len  = TopicLen;
+   Topic->lenstring.data = TopicName;
+
+   Msg->payload    = &Packet[Offset];
+   Msg->payloadlen = PacketLen - Offset;
+
+   return true;
+
+} /* End MQTT_V5_DecodePublish() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_DecodeSubAck
+**
+*/
+bool MQTT_V5_DecodeSubAck(const uint8 *Packet, uint32 PacketLen, uint16 *PacketId,
+                          uint8 *ReasonCode, uint16 ReasonCodeMax, uint16 *ReasonCodeCnt)
+{
+
+   uint32 RemLen;
+   uint32 Offset = DecodeFixedHeader(Packet, PacketLen, &RemLen);
+   uint32 End;
+   uint32 PropLen;
+   uint32 Len;
+
+   if (Offset == 0 || RemLen < 3)
+   {
+      return false;
+   }
+
+   End = Offset + RemLen;
+   *PacketId = (Packet[Offset] << 8) | Packet[Offset + 1];
+   Offset += 2;
+
+   Len = DecodeVarInt(&Packet[Offset], End - Offset, &PropLen);
+   if (Len == 0 || (Offset + Len + PropLen) > End)
+   {
+      return false;
+   }
+   Offset += Len + PropLen;
+
+   *ReasonCodeCnt = 0;
+   while (Offset < End && *ReasonCodeCnt < ReasonCodeMax)
+   {
+      ReasonCode[(*ReasonCodeCnt)++] = Packet[Offset++];
+   }
+
+   return true;
+
+} /* End MQTT_V5_DecodeSubAck() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_EncodePublish
+**
+** Notes:
+**   1. The property length is a single byte because the properties added
+**      are always shorter than 128 bytes.
+**
+*/
+const uint8 *MQTT_V5_EncodePublish(const uint8 *Packet, uint32 PacketLen, uint32 *EncodedLen)
+{
+
+   uint8  *Buf = MqttV5->PublishBuf;
+   uint8  Props[MQTT_V5_PUBLISH_PROP_MAX_LEN - 1];
+   uint32 PropLen = 0;
+   uint32 RemLen;
+   uint32 Offset = DecodeFixedHeader(Packet, PacketLen, &RemLen);
+   uint32 IdLen;
+   uint32 PayloadLen;
+   uint32 Len;
+   uint16 TopicLen;
+   uint16 Alias;
+   bool   AliasOnly = false;
+   const char *Topic;
+
+   if (Offset == 0 || (Offset + 2) > PacketLen)
+   {
+      return NULL;
+   }
+
+   TopicLen = (Packet[Offset] << 8) | Packet[Offset + 1];
+   Topic    = (const char *)&Packet[Offset + 2];
+   IdLen    = (Packet[0] & 0x06) ? 2 : 0;
+   Offset  += 2 + TopicLen;
+   if ((Offset + IdLen) > PacketLen)
+   {
+      return NULL;
+   }
+   PayloadLen = PacketLen - Offset - IdLen;
+
+   Alias = OutboundAlias(Topic, TopicLen, &AliasOnly);
+   if (Alias > 0)
+   {
+      Props[PropLen++] = PROP_TOPIC_ALIAS;
+      Props[PropLen++] = (uint8)(Alias >> 8);
+      Props[PropLen++] = (uint8)Alias;
+   }
+   if (MqttV5->MsgExpirySec > 0)
+   {
+      Props[PropLen++] = PROP_MSG_EXPIRY;
+      Props[PropLen++] = (uint8)(MqttV5->MsgExpirySec >> 24);
+      Props[PropLen++] = (uint8)(MqttV5->MsgExpirySec >> 16);
+      Props[PropLen++] = (uint8)(MqttV5->MsgExpirySec >> 8);
+      Props[PropLen++] = (uint8)MqttV5->MsgExpirySec;
+   }
+
+   RemLen = 2 + (AliasOnly ? 0 : TopicLen) + IdLen + 1 + PropLen + PayloadLen;
+   Len    = WriteFixedHeader(Buf, sizeof(MqttV5->PublishBuf), Packet[0], RemLen);
+   if (Len == 0)
+   {
+      return NULL;
+   }
+
+   Len += WriteString(&Buf[Len], Topic, AliasOnly ? 0 : TopicLen);
+   memcpy(&Buf[Len], &Packet[Offset], IdLen);
+   Len += IdLen;
+   Buf[Len++] = (uint8)PropLen;
+   memcpy(&Buf[Len], Props, PropLen);
+   Len += PropLen;
+   memcpy(&Buf[Len], &Packet[Offset + IdLen], PayloadLen);
+   Len += PayloadLen;
+
+   if (AliasOnly)
+   {
+      MqttV5->AliasPubCnt++;
+      MqttV5->AliasBytesSaved += TopicLen;
+   }
+
+   *EncodedLen = Len;
+
+   return Buf;
+
+} /* End MQTT_V5_EncodePublish() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_ReasonCode
+**
+*/
+uint8 MQTT_V5_ReasonCode(const uint8 *Packet, uint32 PacketLen)
+{
+
+   uint32 RemLen;
+   uint32 Offset = DecodeFixedHeader(Packet, PacketLen, &RemLen);
+   uint32 PropLen;
+   uint32 Len;
+   uint8  ReasonCode = 0;
+
+   if (Offset == 0 || RemLen <= 2)
+   {
+      return ReasonCode;
+   }
+
+   Offset += 2;
+   switch (Packet[0] >> 4)
+   {
+
+      case PUBACK:
+      case PUBREC:
+      case PUBREL:
+      case PUBCOMP:
+         ReasonCode = Packet[Offset];
+         break;
+
+      case SUBACK:
+      case UNSUBACK:
+         Len = DecodeVarInt(&Packet[Offset], PacketLen - Offset, &PropLen);
+         if (Len > 0 && (Offset + Len + PropLen) < PacketLen)
+         {
+            ReasonCode = Packet[Offset + Len + PropLen];
+         }
+         break;
+
+      default:
+         break;
+
+   } /* End packet type switch */
+
+   return ReasonCode;
+
+} /* End MQTT_V5_ReasonCode() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_ResetStatus
+**
+*/
+void MQTT_V5_ResetStatus(void)
+{
+
+   MqttV5->AliasPubCnt     = 0;
+   MqttV5->AliasBytesSaved = 0;
+
+} /* End MQTT_V5_ResetStatus() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeConnect
+**
+*/
+uint32 MQTT_V5_SerializeConnect(uint8 *Buf, uint32 BufLen, const char *ClientName, uint16 KeepAliveSec,
+                                bool CleanStart)
+{
+
+   uint16 ClientNameLen = strlen(ClientName);
+   uint32 SessionExpirySec = CleanStart ? 0 : MqttV5->SessionExpirySec;
+   uint32 PropLen = 6 + (SessionExpirySec > 0 ? 5 : 0);
+   uint32 RemLen = 10 + 1 + PropLen + 2 + ClientNameLen;
+   uint32 Len = WriteFixedHeader(Buf, BufLen, (CONNECT << 4), RemLen);
+
+   if (Len == 0)
+   {
+      return 0;
+   }
+
+   Len += WriteString(&Buf[Len], "MQTT", 4);
+   Buf[Len++] = MQTT_V5_PROTOCOL_LEVEL;
+   Buf[Len++] = CleanStart ? 0x02 : 0x00;
+   Buf[Len++] = (uint8)(KeepAliveSec >> 8);
+   Buf[Len++] = (uint8)KeepAliveSec;
+
+   Buf[Len++] = (uint8)PropLen;
+   if (SessionExpirySec > 0)
+   {
+      Buf[Len++] = PROP_SESSION_EXPIRY;
+      Buf[Len++] = (uint8)(SessionExpirySec >> 24);
+      Buf[Len++] = (uint8)(SessionExpirySec >> 16);
+      Buf[Len++] = (uint8)(SessionExpirySec >> 8);
+      Buf[Len++] = (uint8)SessionExpirySec;
+   }
+   Buf[Len++] = PROP_RECEIVE_MAX;
+   Buf[Len++] = (uint8)(MQTT_V5_RECEIVE_MAX >> 8);
+   Buf[Len++] = (uint8)MQTT_V5_RECEIVE_MAX;
+   Buf[Len++] = PROP_TOPIC_ALIAS_MAX;
+   Buf[Len++] = (uint8)(MQTT_V5_TOPIC_ALIAS_MAX >> 8);
+   Buf[Len++] = (uint8)MQTT_V5_TOPIC_ALIAS_MAX;
+
+   Len += WriteString(&Buf[Len], ClientName, ClientNameLen);
+
+   return Len;
+
+} /* End MQTT_V5_SerializeConnect() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeSubscribe
+**
+** Notes:
+**   1. The subscription options are the maximum QoS with the MQTT 3.1.1
+**      behavior for the No Local, Retain As Published and Retain Handling
+**      options.
+**
+*/
+uint32 MQTT_V5_SerializeSubscribe(uint8 *Buf, uint32 BufLen, uint16 PacketId, uint16 TopicCnt,
+                                  const char *Topic[], const int Qos[])
+{
+
+   uint32 RemLen = 2 + 1;
+   uint32 Len;
+   uint16 i;
+
+   for (i = 0; i < TopicCnt; i++)
+   {
+      RemLen += 2 + strlen(Topic[i]) + 1;
+   }
+
+   Len = WriteFixedHeader(Buf, BufLen, (SUBSCRIBE << 4) | 0x02, RemLen);
+   if (Len == 0)
+   {
+      return 0;
+   }
+
+   Buf[Len++] = (uint8)(PacketId >> 8);
+   Buf[Len++] = (uint8)PacketId;
+   Buf[Len++] = 0;   /* No properties */
+   for (i = 0; i < TopicCnt; i++)
+   {
+      Len += WriteString(&Buf[Len], Topic[i], strlen(Topic[i]));
+      Buf[Len++] = (uint8)Qos[i];
+   }
+
+   return Len;
+
+} /* End MQTT_V5_SerializeSubscribe() */
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeUnsubscribe
+**
+*/
+uint32 MQTT_V5_SerializeUnsubscribe(uint8 *Buf, uint32 BufLen, uint16 PacketId, const char *Topic)
+{
+
+   uint16 TopicLen = strlen(Topic);
+   uint32 Len = WriteFixedHeader(Buf, BufLen, (UNSUBSCRIBE << 4) | 0x02, 2 + 1 + 2 + TopicLen);
+
+   if (Len == 0)
+   {
+      return 0;
+   }
+
+   Buf[Len++] = (uint8)(PacketId >> 8);
+   Buf[Len++] = (uint8)PacketId;
+   Buf[Len++] = 0;   /* No properties */
+   Len += WriteString(&Buf[Len], Topic, TopicLen);
+
+   return Len;
+
+} /* End MQTT_V5_SerializeUnsubscribe() */
+
+
+/******************************************************************************
+** Function: DecodeFixedHeader
+**
+** Return the index of the byte following a packet's fixed header or zero
+** if the header is malformed or the packet is shorter than its remaining
+** length.
+**
+*/
+static uint32 DecodeFixedHeader(const uint8 *Packet, uint32 PacketLen, uint32 *RemLen)
+{
+
+   uint32 Len;
+
+   if (PacketLen < 2)
+   {
+      return 0;
+   }
+
+   Len = DecodeVarInt(&Packet[1], PacketLen - 1, RemLen);
+   if (Len == 0 || (1 + Len + *RemLen) > PacketLen)
+   {
+      return 0;
+   }
+
+   return (1 + Len);
+
+} /* End DecodeFixedHeader() */
+
+
+/******************************************************************************
+** Function: DecodeProperty
+**
+** Decode one property and return its length or zero if it's malformed.
+**
+** Notes:
+**   1. Value is set for integer properties. String, binary and user
+**      properties are skipped.
+**
+*/
+static uint32 DecodeProperty(const uint8 *Buf, uint32 Len, uint8 *Id, uint32 *Value)
+{
+
+   uint32 PropLen = 0;
+   uint32 StrLen;
+
+   if (Len < 2)
+   {
+      return 0;
+   }
+
+   *Id    = Buf[0];
+   *Value = 0;
+
+   switch (*Id)
+   {
+
+      case PROP_PAYLOAD_FORMAT:
+      case PROP_REQ_PROBLEM_INFO:
+      case PROP_REQ_RESPONSE_INFO:
+      case PROP_MAX_QOS:
+      case PROP_RETAIN_AVAILABLE:
+      case PROP_WILDCARD_SUB_AVAIL:
+      case PROP_SUB_ID_AVAIL:
+      case PROP_SHARED_SUB_AVAIL:
+         *Value  = Buf[1];
+         PropLen = 2;
+         break;
+
+      case PROP_SERVER_KEEP_ALIVE:
+      case PROP_RECEIVE_MAX:
+      case PROP_TOPIC_ALIAS_MAX:
+      case PROP_TOPIC_ALIAS:
+         if (Len >= 3)
+         {
+            *Value  = (Buf[1] << 8) | Buf[2];
+            PropLen = 3;
+         }
+         break;
+
+      case PROP_MSG_EXPIRY:
+      case PROP_SESSION_EXPIRY:
+      case PROP_WILL_DELAY:
+      case PROP_MAX_PACKET_SIZE:
+         if (Len >= 5)
+         {
+            *Value  = ((uint32)Buf[1] << 24) | ((uint32)Buf[2] << 16) | (Buf[3] << 8) | Buf[4];
+            PropLen = 5;
+         }
+         break;
+
+      case PROP_SUBSCRIPTION_ID:
+         PropLen = DecodeVarInt(&Buf[1], Len - 1, Value);
+         PropLen = (PropLen > 0) ? PropLen + 1 : 0;
+         break;
+
+      case PROP_CONTENT_TYPE:
+      case PROP_RESPONSE_TOPIC:
+      case PROP_CORRELATION_DATA:
+      case PROP_ASSIGNED_CLIENT_ID:
+      case PROP_AUTH_METHOD:
+      case PROP_AUTH_DATA:
+      case PROP_RESPONSE_INFO:
+      case PROP_SERVER_REFERENCE:
+      case PROP_REASON_STRING:
+         if (Len >= 3)
+         {
+            PropLen = 3 + ((Buf[1] << 8) | Buf[2]);
+         }
+         break;
+
+      case PROP_USER_PROPERTY:
+         if (Len >= 3)
+         {
+            PropLen = 3 + ((Buf[1] << 8) | Buf[2]);
+            if ((PropLen + 2) <= Len)
+            {
+               StrLen   = (Buf[PropLen] << 8) | Buf[PropLen + 1];
+               PropLen += 2 + StrLen;
+            }
+            else
+            {
+               PropLen = 0;
+            }
+         }
+         break;
+
+      default:
+         break;
+
+   } /* End property switch */
+
+   return (PropLen <= Len ? PropLen : 0);
+
+} /* End DecodeProperty() */
+
+
+/******************************************************************************
+** Function: DecodeVarInt
+**
+** Decode a variable byte integer and return its length or zero if it's
+** malformed.
+**
+*/
+static uint32 DecodeVarInt(const uint8 *Buf, uint32 Len, uint32 *Value)
+{
+
+   uint32 i = 0;
+   uint32 Multiplier = 1;
+
+   *Value = 0;
+   do
+   {
+      if (i >= Len || i >= 4)
+      {
+         return 0;
+      }
+      *Value     += (Buf[i] & 0x7F) * Multiplier;
+      Multiplier *= 128;
+   } while ((Buf[i++] & 0x80) != 0);
+
+   return i;
+
+} /* End DecodeVarInt() */
+
+
+/******************************************************************************
+** Function: EncodeVarInt
+**
+*/
+static uint32 EncodeVarInt(uint8 *Buf, uint32 Value)
+{
+
+   uint32 Len = 0;
+
+   do
+   {
+      Buf[Len] = Value % 128;
+      Value   /= 128;
+      if (Value > 0)
+      {
+         Buf[Len] |= 0x80;
+      }
+      Len++;
+   } while (Value > 0);
+
+   return Len;
+
+} /* End EncodeVarInt() */
+
+
+/******************************************************************************
+** Function: HashTopic
+**
+** FNV-1a hash of a topic name
+**
+*/
+static uint32 HashTopic(const char *Topic, uint16 TopicLen)
+{
+
+   uint32 Hash = 2166136261u;
+   uint16 i;
+
+   for (i = 0; i < TopicLen; i++)
+   {
+      Hash ^= (uint8)Topic[i];
+      Hash *= 16777619u;
+   }
+
+   return Hash;
+
+} /* End HashTopic() */
+
+
+/******************************************************************************
+** Function: OutboundAlias
+**
+** Return a topic's outbound alias, assigning one if the broker allows
+** another, or zero if the topic doesn't have one. AliasOnly is set when
+** the alias was already sent with the topic name so the name can be
+** omitted.
+**
+*/
+static uint16 OutboundAlias(const char *Topic, uint16 TopicLen, bool *AliasOnly)
+{
+
+   uint32 Hash = HashTopic(Topic, TopicLen);
+   MQTT_V5_TopicAlias_t *OutAlias;
+   uint16 i;
+
+   for (i = 0; i < MqttV5->OutAliasCnt; i++)
+   {
+      OutAlias = &MqttV5->OutAlias[i];
+      if (OutAlias->Hash == Hash && OutAlias->TopicLen == TopicLen &&
+          memcmp(OutAlias->Topic, Topic, TopicLen) == 0)
+      {
+         *AliasOnly = true;
+         return (i + 1);
+      }
+   }
+
+   if (MqttV5->OutAliasCnt < MqttV5->BrokerTopicAliasMax && TopicLen < JMSG_PLATFORM_TOPIC_NAME_MAX_LEN)
+   {
+      OutAlias = &MqttV5->OutAlias[MqttV5->OutAliasCnt++];
+      OutAlias->Hash     = Hash;
+      OutAlias->TopicLen = TopicLen;
+      memcpy(OutAlias->Topic, Topic, TopicLen);
+      return MqttV5->OutAliasCnt;
+   }
+
+   return 0;
+
+} /* End OutboundAlias() */
+
+
+/******************************************************************************
+** Function: WriteFixedHeader
+**
+** Write a fixed header and return its length or zero if the packet doesn't
+** fit in BufLen.
+**
+*/
+static uint32 WriteFixedHeader(uint8 *Buf, uint32 BufLen, uint8 Byte0, uint32 RemLen)
+{
+
+   uint8  RemLenBuf[4];
+   uint32 Len;
+
+   if (RemLen > 268435455)
+   {
+      return 0;
+   }
+
+   Len = EncodeVarInt(RemLenBuf, RemLen);
+   if ((1 + Len + RemLen) > BufLen)
+   {
+      return 0;
+   }
+
+   Buf[0] = Byte0;
+   memcpy(&Buf[1], RemLenBuf, Len);
+
+   return (1 + Len);
+
+} /* End WriteFixedHeader() */
+
+
+/******************************************************************************
+** Function: WriteString
+**
+** Write a length prefixed string and return the bytes written
+**
+*/
+static uint32 WriteString(uint8 *Buf, const char *Str, uint16 StrLen)
+{
+
+   Buf[0] = (uint8)(StrLen >> 8);
+   Buf[1] = (uint8)StrLen;
+   memcpy(&Buf[2], Str, StrLen);
+
+   return (2 + StrLen);
+
+} /* End WriteString() */
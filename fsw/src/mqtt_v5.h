@@ -0,0 +1,266 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Encode and decode the MQTT 5 packets used by MQTT_CLIENT
+**
+** Notes:
+**   1. The MQTT library only implements MQTT 3.1.1 so MQTT_CLIENT uses
+**      these functions for the packets that differ in MQTT 5. PINGREQ,
+**      DISCONNECT and acknowledgements without a reason code are the same
+**      in both versions.
+**   2. PUBLISH packets are still built in the MQTT 3.1.1 format and are
+**      converted by MQTT_V5_EncodePublish() as they're sent. This keeps the
+**      publish queue, journal and QoS window independent of the version.
+**   3. Topic aliases are assigned to the first topics published on a
+**      connection, up to the broker's Topic Alias Maximum. Later PUBLISH
+**      packets for those topics carry the 2 byte alias instead of the topic
+**      name. Aliases aren't reassigned so the busiest topics should be
+**      published first after a connect. Inbound aliases are accepted up
+**      to MQTT_V5_TOPIC_ALIAS_MAX.
+**   4. The broker's Receive Maximum limits the QoS1 and QoS2 messages
+**      waiting to be acknowledged, see MQTT_CLIENT_ReceiveMax().
+**   5. When MQTT5_MSG_EXPIRY_SEC is non-zero every PUBLISH carries a
+**      Message Expiry Interval so the broker drops stale telemetry rather
+**      than delivering it to a subscriber that connects later.
+**   6. Only the network owner task calls these functions.
+**
+*/
+#ifndef _mqtt_v5_
+#define _mqtt_v5_
+
+/*
+** Includes
+*/
+
+#include "MQTTLinux.h"  /* Must be included prior to "MQTTClient.h" */
+#include "MQTTClient.h"
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_V5_CONSTRUCTOR_EID  (MQTT_V5_BASE_EID + 0)
+#define MQTT_V5_CONNACK_EID      (MQTT_V5_BASE_EID + 1)
+#define MQTT_V5_DECODE_ERR_EID   (MQTT_V5_BASE_EID + 2)
+
+/* Receive Maximum assumed when a broker doesn't send one */
+#define MQTT_V5_RECEIVE_MAX_DEF  65535
+
+/*
+** Longest property section added to a converted PUBLISH: a 1 byte
+** property length, a Topic Alias and a Message Expiry Interval
+*/
+#define MQTT_V5_PUBLISH_PROP_MAX_LEN  9
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+typedef struct
+{
+
+   uint32  Hash;
+   uint16  TopicLen;
+   char    Topic[JMSG_PLATFORM_TOPIC_NAME_MAX_LEN];
+
+} MQTT_V5_TopicAlias_t;
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint32  MsgExpirySec;
+   uint32  SessionExpirySec;
+
+   /*
+   ** Negotiated by the CONNACK
+   */
+
+   uint16  BrokerReceiveMax;
+   uint16  BrokerTopicAliasMax;
+
+   /*
+   ** Topic aliases for the current connection. OutAlias[i] and InAlias[i]
+   ** are alias i+1.
+   */
+
+   uint16  OutAliasCnt;
+   MQTT_V5_TopicAlias_t  OutAlias[MQTT_V5_TOPIC_ALIAS_MAX];
+   MQTT_V5_TopicAlias_t  InAlias[MQTT_V5_TOPIC_ALIAS_MAX];
+
+   /*
+   ** Status
+   */
+
+   uint32  AliasPubCnt;       /* PUBLISH packets sent with an alias instead of the topic */
+   uint32  AliasBytesSaved;   /* Topic name bytes not sent */
+
+   uint8   PublishBuf[MQTT_CLIENT_SEND_BUF_LEN + MQTT_V5_PUBLISH_PROP_MAX_LEN];
+
+} MQTT_V5_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_V5_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_V5 instance.
+**
+*/
+void MQTT_V5_Constructor(MQTT_V5_Class_t *MqttV5Ptr, const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_V5_ConnAck
+**
+** Decode a CONNACK, save the broker's limits and clear the topic aliases
+** for the new connection.
+**
+** Notes:
+**   1. Returns false if the packet is malformed. ReasonCode and
+**      SessionPresent are only valid when true is returned, a zero
+**      ReasonCode means the connection was accepted.
+**
+*/
+bool MQTT_V5_ConnAck(const uint8 *Packet, uint32 PacketLen, uint8 *ReasonCode, bool *SessionPresent);
+
+
+/******************************************************************************
+** Function: MQTT_V5_DecodePublish
+**
+** Decode a PUBLISH into the MQTT library's message structures
+**
+** Notes:
+**   1. Topic and Msg point into Packet or the inbound alias table.
+**   2. Returns false if the packet is malformed or uses an unknown alias.
+**
+*/
+bool MQTT_V5_DecodePublish(MQTTString *Topic, MQTTMessage *Msg, uint8 *Packet, uint32 PacketLen);
+
+
+/******************************************************************************
+** Function: MQTT_V5_DecodeSubAck
+**
+** Decode a SUBACK's packet ID and the reason code of each topic filter
+**
+** Notes:
+**   1. Up to ReasonCodeMax reason codes are copied to ReasonCode and
+**      ReasonCodeCnt returns the number copied. A reason code is the
+**      granted QoS when it's less than 0x80.
+**   2. Returns false if the packet is malformed.
+**
+*/
+bool MQTT_V5_DecodeSubAck(const uint8 *Packet, uint32 PacketLen, uint16 *PacketId,
+                          uint8 *ReasonCode, uint16 ReasonCodeMax, uint16 *ReasonCodeCnt);
+
+
+/******************************************************************************
+** Function: MQTT_V5_EncodePublish
+**
+** Convert an MQTT 3.1.1 PUBLISH packet to MQTT 5 and return a pointer to
+** the converted packet
+**
+** Notes:
+**   1. The packet is written to PublishBuf so it's only valid until the
+**      next call.
+**   2. Returns NULL if the packet is malformed.
+**
+*/
+const uint8 *MQTT_V5_EncodePublish(const uint8 *Packet, uint32 PacketLen, uint32 *EncodedLen);
+
+
+/******************************************************************************
+** Function: MQTT_V5_ReasonCode
+**
+** Return the first reason code of a PUBACK, PUBREC, PUBREL, PUBCOMP,
+** SUBACK or UNSUBACK
+**
+** Notes:
+**   1. Acknowledgements without a reason code return zero, success.
+**   2. A SUBACK's reason code is the granted QoS when it's less than 0x80.
+**
+*/
+uint8 MQTT_V5_ReasonCode(const uint8 *Packet, uint32 PacketLen);
+
+
+/******************************************************************************
+** Function: MQTT_V5_ResetStatus
+**
+** Reset counters and status flags to a known reset state.
+**
+*/
+void MQTT_V5_ResetStatus(void);
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeConnect
+**
+** Serialize a CONNECT and return its length or zero if it doesn't fit in
+** BufLen.
+**
+** Notes:
+**   1. The CONNECT requests MQTT_V5_TOPIC_ALIAS_MAX inbound topic aliases
+**      and limits the broker to MQTT_V5_RECEIVE_MAX unacknowledged QoS1
+**      and QoS2 messages.
+**   2. When CleanStart is false the CONNECT asks the broker to keep the
+**      session for MQTT5_SESSION_EXPIRY_SEC after the connection closes.
+**
+*/
+uint32 MQTT_V5_SerializeConnect(uint8 *Buf, uint32 BufLen, const char *ClientName, uint16 KeepAliveSec,
+                                bool CleanStart);
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeSubscribe
+**
+** Serialize a SUBSCRIBE for TopicCnt topic filters and return its length or
+** zero if it doesn't fit in BufLen.
+**
+*/
+uint32 MQTT_V5_SerializeSubscribe(uint8 *Buf, uint32 BufLen, uint16 PacketId, uint16 TopicCnt,
+                                  const char *Topic[], const int Qos[]);
+
+
+/******************************************************************************
+** Function: MQTT_V5_SerializeUnsubscribe
+**
+** Serialize an UNSUBSCRIBE for one topic filter and return its length or
+** zero if it doesn't fit in BufLen.
+**
+*/
+uint32 MQTT_V5_SerializeUnsubscribe(uint8 *Buf, uint32 BufLen, uint16 PacketId, const char *Topic);
+
+
+#endif /* _mqtt_v5_ */
@@ -0,0 +1,179 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Compress and decompress topic payloads with zlib
+**
+** Notes:
+**   1. See mqtt_zlib.h for how compressed payloads are identified.
+**
+*/
+
+/*
+** Include Files:
+*/
+
+#include "mqtt_zlib.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+#define ZLIB_CM_DEFLATE    8
+#define ZLIB_CINFO_MIN     5   /* 8K window */
+#define ZLIB_FDICT         0x20
+
+
+/**********************/
+/** Global File Data **/
+/**********************/
+
+static MQTT_ZLIB_Class_t *MqttZlib = NULL;
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Constructor
+**
+*/
+void MQTT_ZLIB_Constructor(MQTT_ZLIB_Class_t *MqttZlibPtr,
+                           const INITBL_Class_t *IniTbl)
+{
+
+   int ZStatus;
+
+   MqttZlib = MqttZlibPtr;
+
+   CFE_PSP_MemSet((void*)MqttZlib, 0, sizeof(MQTT_ZLIB_Class_t));
+
+   MqttZlib->MinBytes = INITBL_GetIntConfig(IniTbl, CFG_ZLIB_MIN_BYTES);
+
+   ZStatus = deflateInit2(&MqttZlib->Deflate, INITBL_GetIntConfig(IniTbl, CFG_ZLIB_LEVEL), Z_DEFLATED,
+                          MQTT_ZLIB_WINDOW_BITS, MQTT_ZLIB_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+   MqttZlib->DeflateReady = (ZStatus == Z_OK);
+   if (!MqttZlib->DeflateReady)
+   {
+      CFE_EVS_SendEvent(MQTT_ZLIB_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "zlib deflate initialization failed with status %d, ZLIB_LEVEL %d. Payloads won't be compressed",
+                        ZStatus, (int)INITBL_GetIntConfig(IniTbl, CFG_ZLIB_LEVEL));
+   }
+
+   ZStatus = inflateInit(&MqttZlib->Inflate);
+   MqttZlib->InflateReady = (ZStatus == Z_OK);
+   if (!MqttZlib->InflateReady)
+   {
+      CFE_EVS_SendEvent(MQTT_ZLIB_CONSTRUCTOR_EID, CFE_EVS_EventType_ERROR,
+                        "zlib inflate initialization failed with status %d. Compressed payloads will be rejected",
+                        ZStatus);
+   }
+
+} /* End MQTT_ZLIB_Constructor() */
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Deflate
+**
+** Notes:
+**   1. The output buffer is limited to PayloadLen-1 bytes so deflate stops
+**      as soon as compression can't save anything.
+**
+*/
+bool MQTT_ZLIB_Deflate(uint8 *DeflateBuf, uint32 DeflateBufLen, uint32 *DeflateLen,
+                       const void *Payload, uint32 PayloadLen)
+{
+
+   z_stream *Stream = &MqttZlib->Deflate;
+   bool RetStatus = false;
+
+   if (MqttZlib->DeflateReady && PayloadLen >= MqttZlib->MinBytes && PayloadLen > 1)
+   {
+
+      Stream->next_in   = (Bytef *)Payload;
+      Stream->avail_in  = PayloadLen;
+      Stream->next_out  = DeflateBuf;
+      Stream->avail_out = (DeflateBufLen < PayloadLen) ? DeflateBufLen : (PayloadLen - 1);
+
+      if (deflate(Stream, Z_FINISH) == Z_STREAM_END)
+      {
+         *DeflateLen = Stream->total_out;
+         RetStatus = true;
+      }
+
+      deflateReset(Stream);
+
+   }
+
+   return RetStatus;
+
+} /* End MQTT_ZLIB_Deflate() */
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Inflate
+**
+*/
+bool MQTT_ZLIB_Inflate(uint8 *InflateBuf, uint32 InflateBufLen, uint32 *InflateLen,
+                       const void *Payload, uint32 PayloadLen)
+{
+
+   z_stream *Stream = &MqttZlib->Inflate;
+   bool RetStatus = false;
+
+   if (MqttZlib->InflateReady)
+   {
+
+      Stream->next_in   = (Bytef *)Payload;
+      Stream->avail_in  = PayloadLen;
+      Stream->next_out  = InflateBuf;
+      Stream->avail_out = InflateBufLen;
+
+      if (inflate(Stream, Z_FINISH) == Z_STREAM_END && Stream->avail_in == 0)
+      {
+         *InflateLen = Stream->total_out;
+         RetStatus = true;
+      }
+
+      inflateReset(Stream);
+
+   }
+
+   return RetStatus;
+
+} /* End MQTT_ZLIB_Inflate() */
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_IsDeflated
+**
+** Notes:
+**   1. Checks the RFC 1950 header's compression method, window size, check
+**      bits and that no preset dictionary is required.
+**
+*/
+bool MQTT_ZLIB_IsDeflated(const void *Payload, uint32 PayloadLen)
+{
+
+   const uint8 *Byte = (const uint8 *)Payload;
+
+   if (PayloadLen < 2)
+   {
+      return false;
+   }
+
+   return ((Byte[0] & 0x0F) == ZLIB_CM_DEFLATE &&
+           (Byte[0] >> 4) >= ZLIB_CINFO_MIN && (Byte[0] >> 4) <= (MAX_WBITS - 8) &&
+           (Byte[1] & ZLIB_FDICT) == 0 &&
+           ((Byte[0] << 8) | Byte[1]) % 31 == 0);
+
+} /* End MQTT_ZLIB_IsDeflated() */
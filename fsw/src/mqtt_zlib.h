@@ -0,0 +1,138 @@
+/*
+** Copyright 2022 bitValence, Inc.
+** All Rights Reserved.
+**
+** This program is free software; you can modify and/or redistribute it
+** under the terms of the GNU Affero General Public License
+** as published by the Free Software Foundation; version 3 with
+** attribution addendums as found in the LICENSE.txt
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** Purpose:
+**   Compress and decompress topic payloads with zlib
+**
+** Notes:
+**   1. Compression is applied after a topic's payload has been encoded so
+**      it's available for JSON, CBOR and raw topics. Payloads shorter than
+**      ZLIB_MIN_BYTES or that don't get smaller are sent uncompressed.
+**   2. Compressed payloads are identified by their zlib stream header so
+**      subscribers can receive both forms on the same topic. Only headers
+**      with a 8K to 32K window are accepted. Their first byte ('X', 'h' or
+**      'x') can't start a topic plugin's JSON object, a CBOR map or a
+**      CCSDS version 1 packet.
+**   3. The deflate stream is only used by the main task and the inflate
+**      stream by the network owner task. Both are allocated once by the
+**      constructor and reset for each payload.
+**
+*/
+#ifndef _mqtt_zlib_
+#define _mqtt_zlib_
+
+/*
+** Includes
+*/
+
+#include <zlib.h>
+
+#include "app_cfg.h"
+
+
+/***********************/
+/** Macro Definitions **/
+/***********************/
+
+
+/*
+** Event Message IDs
+*/
+
+#define MQTT_ZLIB_CONSTRUCTOR_EID  (MQTT_ZLIB_BASE_EID + 0)
+
+
+/**********************/
+/** Type Definitions **/
+/**********************/
+
+
+/*
+** Class Definition
+*/
+
+typedef struct
+{
+
+   uint32  MinBytes;
+
+   bool      DeflateReady;
+   bool      InflateReady;
+   z_stream  Deflate;
+   z_stream  Inflate;
+
+} MQTT_ZLIB_Class_t;
+
+
+/************************/
+/** Exported Functions **/
+/************************/
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Constructor
+**
+** Notes:
+**   1. This function must be called prior to any other functions being
+**      called using the same MQTT_ZLIB instance.
+**   2. If a stream can't be initialized an event is sent and payloads are
+**      neither compressed nor decompressed.
+**
+*/
+void MQTT_ZLIB_Constructor(MQTT_ZLIB_Class_t *MqttZlibPtr,
+                           const INITBL_Class_t *IniTbl);
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Deflate
+**
+** Compress a payload
+**
+** Notes:
+**   1. Returns false if the payload is shorter than ZLIB_MIN_BYTES, its
+**      compressed length isn't less than PayloadLen or it can't be
+**      compressed into DeflateBuf. The payload should then be sent
+**      uncompressed.
+**   2. Must only be called by the main task.
+**
+*/
+bool MQTT_ZLIB_Deflate(uint8 *DeflateBuf, uint32 DeflateBufLen, uint32 *DeflateLen,
+                       const void *Payload, uint32 PayloadLen);
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_Inflate
+**
+** Decompress a payload
+**
+** Notes:
+**   1. Returns false if the payload isn't a complete zlib stream or its
+**      decompressed length exceeds InflateBufLen.
+**   2. Must only be called by the network owner task.
+**
+*/
+bool MQTT_ZLIB_Inflate(uint8 *InflateBuf, uint32 InflateBufLen, uint32 *InflateLen,
+                       const void *Payload, uint32 PayloadLen);
+
+
+/******************************************************************************
+** Function: MQTT_ZLIB_IsDeflated
+**
+** Return true if the payload starts with a zlib stream header
+**
+*/
+bool MQTT_ZLIB_IsDeflated(const void *Payload, uint32 PayloadLen);
+
+
+#endif /* _mqtt_zlib_ */